@@ -0,0 +1,64 @@
+#! ../prog/BCI2000Shell
+@cls & ..\prog\BCI2000Shell %0 %* #! && exit /b 0 || exit /b 1
+#######################################################################################
+## $Id$
+## Description: BCI2000 pipeline benchmark. Runs SignalGenerator in fast mode,
+##   DummySignalProcessing, and DummyApplication without user interaction, for
+##   a range of channel counts, and sampling rates up to 30kHz, with blocks
+##   of 20ms.
+##   At the end of each run, SignalGenerator reports signal generation time,
+##   the time spent in the remaining pipeline (file writing, signal processing,
+##   and application modules), and whether the load was sustainable.
+##   Run duration in seconds may be given as an argument, and defaults to 10.
+##   For an Operator scripting reference, see
+##   http://doc.bci2000.org/index/User_Reference:Operator_Module_Scripting
+##
+## $BEGIN_BCI2000_LICENSE$
+##
+## This file is part of BCI2000, a platform for real-time bio-signal research.
+## [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+##
+## BCI2000 is free software: you can redistribute it and/or modify it under the
+## terms of the GNU General Public License as published by the Free Software
+## Foundation, either version 3 of the License, or (at your option) any later
+## version.
+##
+## BCI2000 is distributed in the hope that it will be useful, but
+##                         WITHOUT ANY WARRANTY
+## - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+## A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License along with
+## this program.  If not, see <http://www.gnu.org/licenses/>.
+##
+## $END_BCI2000_LICENSE$
+#######################################################################################
+Change directory $BCI2000LAUNCHDIR
+If [ $1 ]
+  Set Duration $1
+Else
+  Set Duration 10
+End
+Capture messages Log Warnings Errors
+For rate in 1000 2000 4000 8000 16000 30000
+  For channels in 16 64 256 1024
+    Reset system
+    Startup system localhost
+    Start executable SignalGenerator --local --GeneratorMode=1 --ReportLoad=1 --FileFormat=Null --VisualizeSource=0
+    Start executable DummySignalProcessing --local
+    Start executable DummyApplication --local
+    Wait for Connected
+    Set parameter SourceCh $channels
+    Set parameter SamplingRate ${rate}Hz
+    Set parameter SampleBlockSize ${Evaluate expression $rate/50}
+    Set config
+    Wait for Resting
+    Start
+    Sleep $Duration
+    Stop
+    Wait for Suspended
+    Flush messages
+  End
+End
+Reset system
+Quit
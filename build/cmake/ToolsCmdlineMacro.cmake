@@ -15,6 +15,7 @@ MACRO( BCI2000_ADD_TOOLS_CMDLINE ) # NAME SOURCES [HEADERS] REQUESTQT
     EXECUTABLE ${NAME}
     ${SOURCES}
     ${PROJECT_SRC_DIR}/core/Tools/cmdline/bci_tool.cpp
+    ${PROJECT_SRC_DIR}/core/Tools/cmdline/BlockBatch.cpp
     ${PROJECT_SRC_DIR}/shared/bcistream/BCIStream_tool.cpp
     OUTPUT_DIRECTORY "${PROJECT_ROOT_DIR}/tools/cmdline"
   )
@@ -76,7 +77,7 @@ MACRO( BCI2000_ADD_CMDLINE_FILTER )
 
   PARSE_ARGUMENTS(
     CMDLINEFILTER
-    "FROM;EXTRA_SOURCES;EXTRA_HEADERS;USING;INCLUDING"
+    "FROM;EXTRA_SOURCES;EXTRA_HEADERS;USING;INCLUDING;CHAIN"
     ""
     ${ARGN}
   )
@@ -87,14 +88,23 @@ MACRO( BCI2000_ADD_CMDLINE_FILTER )
     MESSAGE( "- WARNING: BCI2000_ADD_CMDLINE_FILTER is ignoring extraneous arguments: " ${CMDLINEFILTER_DEFAULT_ARGS} )
   ENDIF( ${NARGS} GREATER 0 )
     
-  SET( MAINSTEM ${NAME} )
-  IF( NOT ${CMDLINEFILTER_FROM} STREQUAL "" )
-    SET( MAINSTEM ${CMDLINEFILTER_FROM}/${MAINSTEM} )
-  ENDIF( NOT ${CMDLINEFILTER_FROM} STREQUAL "" )
-  #MESSAGE( "want to build command-line filter ${NAME} from ${CMDLINEFILTER_FROM} based on ${MAINSTEM}.cpp" )
+  # A CHAIN of filter stems builds a single tool that runs all of these
+  # filters in the order given by their filter positions.
+  SET( MAINSTEMS ${CMDLINEFILTER_CHAIN} )
+  IF( "${MAINSTEMS}" STREQUAL "" )
+    SET( MAINSTEMS ${NAME} )
+  ENDIF( "${MAINSTEMS}" STREQUAL "" )
+  SET( MAINSOURCES )
+  FOREACH( MAINSTEM ${MAINSTEMS} )
+    IF( NOT IS_ABSOLUTE ${MAINSTEM} AND NOT "${CMDLINEFILTER_FROM}" STREQUAL "" )
+      SET( MAINSTEM ${CMDLINEFILTER_FROM}/${MAINSTEM} )
+    ENDIF( NOT IS_ABSOLUTE ${MAINSTEM} AND NOT "${CMDLINEFILTER_FROM}" STREQUAL "" )
+    SET( MAINSOURCES ${MAINSOURCES} ${MAINSTEM}.cpp )
+  ENDFOREACH( MAINSTEM )
+  #MESSAGE( "want to build command-line filter ${NAME} from ${CMDLINEFILTER_FROM} based on ${MAINSOURCES}" )
   
   SET( SOURCES
-    ${MAINSTEM}.cpp
+    ${MAINSOURCES}
     ${PROJECT_SRC_DIR}/core/Tools/cmdline/bci_tool.cpp
     ${PROJECT_SRC_DIR}/core/Tools/cmdline/bci_filtertool.cpp
     ${CMDLINEFILTER_EXTRA_SOURCES}
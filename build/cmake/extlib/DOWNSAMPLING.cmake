@@ -0,0 +1,34 @@
+###########################################################################
+## $Id$
+## Authors: agent@local
+## Description: Sets up CMAKE variables for including the DownsamplingFilter
+## SETS:
+##       SRC_EXTLIB - Required source files
+##       HDR_EXTLIB - Required header files
+##       INC_EXTLIB - Include directories
+##       LIBDIR_EXTLIB - Library directories
+##       LIBS_EXTLIB - required libraries
+
+
+SET( SRC_EXTLIB
+  ${PROJECT_SRC_DIR}/shared/modules/signalprocessing/DownsamplingFilter.cpp
+)
+
+SET( HDR_EXTLIB
+  ${PROJECT_SRC_DIR}/shared/modules/signalprocessing/DownsamplingFilter.h
+  ${PROJECT_SRC_DIR}/extlib/math/FIRDecimator.h
+)
+
+SET( INC_EXTLIB
+  ${PROJECT_SRC_DIR}/extlib/math
+  ${PROJECT_SRC_DIR}/shared/modules/signalprocessing
+)
+
+SET( LIBDIR_EXTLIB
+)
+
+SET( LIBS_EXTLIB
+)
+
+# Set success
+SET( EXTLIB_OK TRUE )
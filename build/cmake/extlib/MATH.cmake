@@ -16,6 +16,7 @@ SET( SRC_EXTLIB
 SET( HDR_EXTLIB
   ${PROJECT_SRC_DIR}/extlib/math/Detrend.h
   ${PROJECT_SRC_DIR}/extlib/math/FilterDesign.h
+  ${PROJECT_SRC_DIR}/extlib/math/FIRDecimator.h
   ${PROJECT_SRC_DIR}/extlib/math/IIRFilter.h
   ${PROJECT_SRC_DIR}/extlib/math/LinearPredictor.h
   ${PROJECT_SRC_DIR}/extlib/math/MEMPredictor.h
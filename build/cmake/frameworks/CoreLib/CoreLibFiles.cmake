@@ -43,6 +43,7 @@ SET( SRC_BCI2000_FRAMEWORK
   ${PROJECT_SRC_DIR}/shared/types/HierarchicalLabel.cpp
   ${PROJECT_SRC_DIR}/shared/types/Label.cpp
   ${PROJECT_SRC_DIR}/shared/types/LabelIndex.cpp
+  ${PROJECT_SRC_DIR}/shared/types/LatencyTrace.cpp
   ${PROJECT_SRC_DIR}/shared/types/Param.cpp
   ${PROJECT_SRC_DIR}/shared/types/ParamList.cpp
   ${PROJECT_SRC_DIR}/shared/types/PhysicalUnit.cpp
@@ -68,6 +69,7 @@ SET( SRC_BCI2000_FRAMEWORK
 
   ${PROJECT_SRC_DIR}/shared/fileio/RunManager.cpp
   ${PROJECT_SRC_DIR}/shared/fileio/dat/BCI2000FileReader.cpp
+  ${PROJECT_SRC_DIR}/shared/fileio/dat/BCZCodec.cpp
   ${PROJECT_SRC_DIR}/extlib/math/FastConv.h
 )
 
@@ -18,6 +18,7 @@ SET( SRC_LIBTINY
   ${TINY_DIR}/Atomic.h
   ${TINY_DIR}/Synchronized.h
   ${TINY_DIR}/SynchronizedQueue.h
+  ${TINY_DIR}/LockfreeQueue.h
   ${TINY_DIR}/SpinLock.h
 
   ${TINY_DIR}/Waitable.cpp
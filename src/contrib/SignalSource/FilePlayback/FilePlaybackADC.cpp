@@ -34,6 +34,7 @@
 
 #include <cmath>
 #include <cctype>
+#include <algorithm>
 
 using namespace std;
 
@@ -48,7 +49,16 @@ mFileName(""),
 mTemplateFileName(""),
 mSpeedup(1),
 mDataFile(NULL),
-mReverse( false )
+mReverse( false ),
+mReadAhead( 0 ),
+mReadCursor( 0 ),
+mWriteCursor( 0 ),
+mBlocksReady( 0 ),
+mNextToRead( 0 ),
+mGeneration( 0 ),
+mBlocksPlayed( 0 ),
+mUnderruns( 0 ),
+mElapsedMs( 0 )
 {
   mTemplateFileName = string( OptionalParameter("PlaybackFileName", "") );
   if( mTemplateFileName.size() ) // --PlaybackFileName was given as a command-line option. Use this opportunity to declare all the parameters and states that are in the file, giving the file's parameter values as defaults (with a few exceptions, below).
@@ -162,7 +172,10 @@ mReverse( false )
     " % % % // a list of channels to acquire (empty for all). Use indices, or labels from the ChannelNames as they were recorded in the file.",
 
     "Source:Playback float PlaybackSpeed= 1 "
-    " 1 0 100 // a value indicating the factor by which the acquisition should be sped up",
+    " 1 0 100 // a value indicating the factor by which the acquisition should be sped up (0 for maximum speed)",
+
+    "Source:Playback float PlaybackReadAhead= 2s "
+    " 2s 0 % // amount of data to read ahead of playback (in blocks or seconds, 0 to read synchronously)",
 
     "Source:Playback int PlaybackStates= 0 "
     " 0 0 1 // play back state variable values (except timestamps)? (boolean)",
@@ -210,6 +223,7 @@ FilePlaybackADC::Preflight( const SignalProperties& Input,
   PreflightCondition( Parameter( "SamplingRate" ) > 0 );
   PreflightCondition( Parameter("PlaybackSpeed") >= 0.0f );
   PreflightCondition(Parameter("SampleBlockSize") > 0);
+  PreflightCondition( Parameter( "PlaybackReadAhead" ).InSampleBlocks() >= 0 );
   Parameter("PlaybackLooped");
   Parameter("PlaybackStartTime");
   State("Running");
@@ -308,6 +322,7 @@ FilePlaybackADC::MatchChannels( const BCI2000FileReader& inDataFile, vector<int>
 void
 FilePlaybackADC::Initialize( const SignalProperties&, const SignalProperties& )
 {
+  StopReadAhead();
   if (mDataFile != NULL){
     delete mDataFile;
     mDataFile = NULL;
@@ -338,6 +353,7 @@ FilePlaybackADC::Initialize( const SignalProperties&, const SignalProperties& )
   mSuspendAtEnd = (Parameter("PlaybackLooped") == 0);
 
   mStateMappings.clear();
+  mFileStates.clear();
   if( Parameter("PlaybackStates") != 0 )
   {
     StateList* statesHere = States;
@@ -350,7 +366,8 @@ FilePlaybackADC::Initialize( const SignalProperties&, const SignalProperties& )
       {
         unsigned int indf = statesFile->Index(statename);
         const class State& srf = (*statesFile)[indf];
-        mStateMappings.push_back(StateMapping( srf.Location(), srf.Length(), srh.Location(), srh.Length() ));
+        mStateMappings.push_back(StateMapping( srh.Location(), srh.Length() ));
+        mFileStates.push_back( &srf );
         //bciout << "Will play back " << statename << " from (" << indf << "," << srf.Location() << "," << srf.Length() << ")" << " to (" << i << "," << srh.Location() << "," << srh.Length() << ")" << endl;
       }
     }
@@ -358,6 +375,20 @@ FilePlaybackADC::Initialize( const SignalProperties&, const SignalProperties& )
   mClock.SetInterval( mBlockDuration );
   mClock.Reset();
   mClock.Start();
+
+  mSignalOptions.channels = mChList;
+  mReadAhead = static_cast<int>( Parameter( "PlaybackReadAhead" ).InSampleBlocks() );
+  mRing.clear();
+  mRing.resize( max( mReadAhead, 1 ) );
+  for( size_t i = 0; i < mRing.size(); ++i )
+  {
+    mRing[i].index = -1;
+    mRing[i].samples = 0;
+    mRing[i].signal.resize( mChList.size() * mBlockSize );
+    mRing[i].states.resize( mStateMappings.size() * mBlockSize );
+  }
+  if( mReadAhead > 0 && bcierr.Empty() )
+    StartReadAhead();
 }
 
 
@@ -366,6 +397,27 @@ FilePlaybackADC::StartRun()
 {
   mCurBlock = 0;
   for( unsigned int i = 0; i < mStateMappings.size(); i++ ) mStateMappings[i].Reset();
+  if( !OSThread::IsTerminated() )
+    RestartReadAhead( mCurBlock );
+  mBlocksPlayed = 0;
+  mUnderruns = 0;
+  mElapsedMs = 0;
+  mLastProcessTime = PrecisionTime::Now();
+}
+
+
+void
+FilePlaybackADC::StopRun()
+{
+  if( mReadAhead > 0 && mUnderruns > 0 && mSpeedup > 0 )
+    bciwarn << mUnderruns << " of " << mBlocksPlayed << " blocks were not read ahead in time "
+            << "for playback. Consider increasing the PlaybackReadAhead parameter." << endl;
+  if( mSpeedup <= 0 && mElapsedMs > 0 )
+    bciout << "Played back " << mBlocksPlayed << " blocks in " << mElapsedMs / 1e3 << "s "
+           << "(" << mBlocksPlayed * 1e3 * mBlockSize / mSamplingRate / mElapsedMs << " times real time)"
+           << endl;
+  if( mSpeedup <= 0 && mReadAhead > 0 )
+    bciout << mUnderruns << " of " << mBlocksPlayed << " blocks were not read ahead in time" << endl;
 }
 
 
@@ -378,30 +430,26 @@ FilePlaybackADC::Process( const GenericSignal&, GenericSignal& Output )
     mClock.Reset();
   }
 
-  int curCh;
-  long long curSample, curDataSample;
-  long long nSamples = mDataFile->NumSamples();
   bool playStates = ( mStateMappings.size() != 0 && State("Running") != 0 );
-  for( int el = 0; el < mBlockSize; el++ )
+  if( mReadAhead == 0 )
+    ReadBlock( mCurBlock, mRing[0] );
+  const Block& block = ( mReadAhead > 0 ) ? WaitForBlock( mCurBlock ) : mRing[0];
+  for( int el = 0; el < block.samples; el++ )
   {
-    curSample = mBlockSize * mCurBlock + el;
-    if (curSample >= mDataFile->NumSamples())
-      break;
-	if( mReverse ) curDataSample = mDataFile->NumSamples() - 1 - curSample;
-	else curDataSample = curSample;
     for (unsigned int ch = 0; ch < mChList.size(); ch++)
-	{
-      curCh = mChList[ch];
-      Output(ch, el) = mDataFile->RawValue(curCh, curDataSample);
-    }
+      Output(ch, el) = block.signal[ch * mBlockSize + el];
     if( playStates )
-    {
-      mDataFile->ReadStateVector( curSample );
-      const StateVector* sv = mDataFile->StateVector();
       for( unsigned int i = 0; i < mStateMappings.size(); i++ )
-        mStateMappings[i].Copy( sv, 0, Statevector, el );
-    }
+        mStateMappings[i].Write( block.states[i * mBlockSize + el], Statevector, el );
   }
+  if( mReadAhead > 0 )
+    ReleaseBlock();
+
+  ++mBlocksPlayed;
+  PrecisionTime now = PrecisionTime::Now();
+  mElapsedMs += PrecisionTime::UnsignedDiff( now, mLastProcessTime );
+  mLastProcessTime = now;
+
   mCurBlock++;
   if (mSuspendAtEnd && mCurBlock >= mMaxBlock-1 && State("Running")==1)
     State("Running") = 0;
@@ -416,10 +464,160 @@ FilePlaybackADC::Process( const GenericSignal&, GenericSignal& Output )
 void
 FilePlaybackADC::Halt()
 {
+  StopReadAhead();
   mClock.Stop();
   delete mDataFile;
   mDataFile = NULL;
 }
 
 
+// Decodes a data block, and the source state values of its samples.
+// Called from the read-ahead thread, or from Process() when there is no read-ahead.
+void
+FilePlaybackADC::ReadBlock( int inIndex, Block& outBlock )
+{
+  outBlock.index = inIndex;
+  outBlock.samples = 0;
+  long long numSamples = mDataFile->NumSamples(),
+            first = static_cast<long long>( mBlockSize ) * inIndex,
+            count = min<long long>( mBlockSize, numSamples - first );
+  if( count <= 0 )
+    return;
+
+  typedef BCI2000FileReader::Matrix<GenericSignal::ValueType> SignalMatrix;
+  typedef BCI2000FileReader::Matrix<State::ValueType> StateMatrix;
+  SignalMatrix signal;
+  if( !outBlock.signal.empty() )
+    signal = SignalMatrix( &outBlock.signal[0], mBlockSize, 1 );
+  StateMatrix states;
+  if( !mFileStates.empty() )
+    states = StateMatrix( &outBlock.states[0], mBlockSize, 1 );
+  if( mReverse )
+  { // Signal samples are played back in reverse order, state values are not.
+    if( signal.data )
+    {
+      signal.data += count - 1;
+      signal.columnStride = -1;
+      mDataFile->ReadSamples( numSamples - first - count, count, signal, mSignalOptions );
+    }
+    if( states.data )
+      mDataFile->ReadSamples( first, count, SignalMatrix(), mSignalOptions, states, mFileStates );
+  }
+  else
+    mDataFile->ReadSamples( first, count, signal, mSignalOptions, states, mFileStates );
+  outBlock.samples = static_cast<int>( count );
+}
+
+// The block that Process() is expected to play after the given one.
+int
+FilePlaybackADC::NextBlock( int inIndex ) const
+{
+  return ( inIndex + 1 >= mMaxBlock ) ? 0 : inIndex + 1;
+}
+
+void
+FilePlaybackADC::StartReadAhead()
+{
+  OSMutex::Lock lock( mRingMutex );
+  mReadCursor = 0;
+  mWriteCursor = 0;
+  mBlocksReady = 0;
+  mNextToRead = mCurBlock;
+  ++mGeneration;
+  OSThread::Start();
+}
 
+void
+FilePlaybackADC::StopReadAhead()
+{
+  if( OSThread::IsTerminated() )
+    return;
+  OSThread::Terminate();
+  {
+    OSMutex::Lock lock( mRingMutex );
+    mSlotFree.Set();
+  }
+  OSThread::TerminateWait();
+}
+
+// Discards blocks that have been read ahead, and continues reading at the given block.
+void
+FilePlaybackADC::RestartReadAhead( int inIndex )
+{
+  OSMutex::Lock lock( mRingMutex );
+  // Nothing to discard if the block is available, or being read.
+  if( mBlocksReady > 0 ? mRing[mReadCursor].index == inIndex : mNextToRead == inIndex )
+    return;
+  ++mGeneration;
+  mWriteCursor = mReadCursor;
+  mBlocksReady = 0;
+  mNextToRead = inIndex;
+  mSlotFree.Set();
+}
+
+// Returns the given block from the ring, and waits for the read-ahead thread
+// if it is not available yet.
+const FilePlaybackADC::Block&
+FilePlaybackADC::WaitForBlock( int inIndex )
+{
+  RestartReadAhead( inIndex );
+  OSMutex::Lock lock( mRingMutex );
+  if( mBlocksReady == 0 )
+    ++mUnderruns;
+  while( mBlocksReady == 0 )
+  {
+    mBlockReady.Reset();
+    OSMutex::Unlock unlock( mRingMutex );
+    mBlockReady.Wait();
+  }
+  return mRing[mReadCursor];
+}
+
+void
+FilePlaybackADC::ReleaseBlock()
+{
+  OSMutex::Lock lock( mRingMutex );
+  ++mReadCursor %= mRing.size();
+  --mBlocksReady;
+  mSlotFree.Set();
+}
+
+// The read-ahead thread decodes blocks into free ring slots.
+// A slot between the write cursor and the read cursor is not accessed by Process(),
+// so decoding is done without holding the lock.
+int
+FilePlaybackADC::OnExecute()
+{
+  while( !OSThread::IsTerminating() )
+  {
+    Block* pBlock = 0;
+    int index = 0,
+        generation = 0;
+    {
+      OSMutex::Lock lock( mRingMutex );
+      if( mBlocksReady < mRing.size() )
+      {
+        pBlock = &mRing[mWriteCursor];
+        index = mNextToRead;
+        generation = mGeneration;
+      }
+      else if( !OSThread::IsTerminating() )
+        mSlotFree.Reset();
+    }
+    if( !pBlock )
+    {
+      mSlotFree.Wait();
+      continue;
+    }
+    ReadBlock( index, *pBlock );
+    OSMutex::Lock lock( mRingMutex );
+    if( generation == mGeneration )
+    {
+      ++mWriteCursor %= mRing.size();
+      ++mBlocksReady;
+      mNextToRead = NextBlock( index );
+      mBlockReady.Set();
+    }
+  }
+  return 0;
+}
@@ -2,6 +2,8 @@
 // $Id$
 // Author: Adam Wilson, Jeremy Hill
 // Description: An ADC class for testing purposes.
+//   Data blocks are decoded ahead of time by a read-ahead thread into a ring
+//   of blocks, such that reading from the file does not delay playback.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -29,11 +31,15 @@
 #include "GenericADC.h"
 #include "Clock.h"
 #include "BCI2000FileReader.h"
+#include "OSThread.h"
+#include "OSEvent.h"
+#include "OSMutex.h"
+#include "PrecisionTime.h"
 #include <string>
 #include <vector>
 
 
-class FilePlaybackADC : public GenericADC
+class FilePlaybackADC : public GenericADC, private OSThread
 {
 	public:
 				   FilePlaybackADC();
@@ -42,6 +48,7 @@ class FilePlaybackADC : public GenericADC
 		virtual void Preflight( const SignalProperties&, SignalProperties& ) const;
 		virtual void Initialize( const SignalProperties&, const SignalProperties& );
 		virtual void StartRun();
+		virtual void StopRun();
 		virtual void Process( const GenericSignal&, GenericSignal& );
 		virtual void Halt();
 
@@ -51,6 +58,25 @@ class FilePlaybackADC : public GenericADC
 		void MatchChannels( const BCI2000FileReader& dataFile, std::vector<int>& chList ) const;
 		void CheckFile( std::string& fname, BCI2000FileReader& dataFile ) const;
 
+		// A decoded data block, with signal values stored by channel and sample,
+		// and source state values stored by mapping and sample.
+		struct Block
+		{
+			int index;
+			int samples;
+			std::vector<GenericSignal::ValueType> signal;
+			std::vector<State::ValueType> states;
+		};
+		void ReadBlock( int index, Block& );
+		int NextBlock( int index ) const;
+		// Read-ahead ring, filled by the read-ahead thread.
+		void StartReadAhead();
+		void StopReadAhead();
+		void RestartReadAhead( int index );
+		const Block& WaitForBlock( int index );
+		void ReleaseBlock();
+		virtual int OnExecute();
+
 		// Configuration
 		float  mSamplingRate;
 		int mBlockSize;
@@ -67,26 +93,42 @@ class FilePlaybackADC : public GenericADC
 		long long mNumSamples;
 		bool mReverse;
 
+		// Source states are read from the file by ReadSamples(), in the order of mFileStates.
 		class StateMapping {
 			public:
-				StateMapping(size_t srcLoc, size_t srcLen, size_t dstLoc, size_t dstLen) {mSrcLoc=srcLoc; mSrcLen=srcLen; mDstLoc=dstLoc; mDstLen=dstLen; mPrevVal=0;}
+				StateMapping(size_t dstLoc, size_t dstLen) {mDstLoc=dstLoc; mDstLen=dstLen; mPrevVal=0;}
 				void Reset() { mPrevVal = 0; }
-				void Copy(const StateVector* srcVec, size_t srcSampleOffset, StateVector* dstVec, size_t dstSampleOffset )
+				void Write(State::ValueType val, StateVector* dstVec, size_t dstSampleOffset )
 				{
-					State::ValueType val = srcVec->StateValue( mSrcLoc, mSrcLen, srcSampleOffset );
 					if( val == mPrevVal ) return;
 					mPrevVal = val;
 					dstVec->SetStateValue( mDstLoc, mDstLen, dstSampleOffset, val );
 				}
 			private:
-				size_t mSrcLoc;
-				size_t mSrcLen;
 				size_t mDstLoc;
 				size_t mDstLen;
 				State::ValueType mPrevVal;
 		};
 		std::vector<StateMapping> mStateMappings;
+		BCI2000FileReader::StateSelection mFileStates;
+		BCI2000FileReader::SignalOptions mSignalOptions;
     Clock mClock;
+
+		int mReadAhead;
+		std::vector<Block> mRing;
+		size_t mReadCursor,
+		       mWriteCursor;
+		size_t mBlocksReady;
+		int mNextToRead,
+		    mGeneration;
+		OSMutex mRingMutex;
+		OSEvent mBlockReady,
+		        mSlotFree;
+		// Statistics, reported at the end of each run.
+		int mBlocksPlayed,
+		    mUnderruns;
+		long long mElapsedMs;
+		PrecisionTime mLastProcessTime;
 };
 
 #endif // SIGNAL_GENERATOR_ADC_H
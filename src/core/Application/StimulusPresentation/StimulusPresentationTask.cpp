@@ -36,6 +36,7 @@
 #include "Expression/Expression.h"
 
 #include <algorithm>
+#include <set>
 
 using namespace std;
 
@@ -572,6 +573,16 @@ StimulusPresentationTask::OnStartRun()
   }
   mSequencePos = mSequence.begin();
   mToBeCopiedPos = mToBeCopied.begin();
+
+  // Preload stimuli in the order of their first occurrence in the sequence.
+  set<int> preloaded;
+  for( vector<int>::const_iterator i = mSequence.begin(); i != mSequence.end(); ++i )
+    if( *i > 0 && preloaded.insert( *i ).second )
+    {
+      AssociationMap::iterator j = Associations().find( *i );
+      if( j != Associations().end() )
+        j->second.Preload();
+    }
 }
 
 void
@@ -35,15 +35,17 @@ using namespace std;
 InterpreterExpression::InterpreterExpression( CommandInterpreter& inInterpreter, const string& inExpr )
 : Expression( inExpr.empty() ? inInterpreter.GetRemainingTokens() : inExpr ),
   mrInterpreter( inInterpreter ),
-  mAllowAssignment( true )
+  mAllowAssignment( true ),
+  mSample( 0 )
 {
   ThrowOnError( true );
   Compile( inInterpreter.ExpressionVariables() );
 }
 
 double
-InterpreterExpression::Execute() const
+InterpreterExpression::Execute( int inSample ) const
 {
+  mSample = inSample;
   return Expression::Execute( &mrInterpreter.StateMachine().ControlSignal() );
 }
 
@@ -71,7 +73,7 @@ Expression::Node*
 InterpreterExpression::Variable( const string& inName )
 {
   if( StateExists( mrInterpreter, inName ) )
-    return new StateNode( mrInterpreter, inName );
+    return new StateNode( mrInterpreter, inName, mSample );
   return ArithmeticExpression::Variable( inName );
 }
 
@@ -87,7 +89,7 @@ InterpreterExpression::VariableAssignment( const string& inName, Node* inRhs )
 Expression::Node*
 InterpreterExpression::State( const std::string& inName )
 {
-  return new StateNode( mrInterpreter, inName );
+  return new StateNode( mrInterpreter, inName, mSample );
 }
 
 Expression::Node*
@@ -103,7 +105,7 @@ InterpreterExpression::StateNode::OnEvaluate()
 {
   Lock lock( mrInterpreter.StateMachine() );
   AssertState( mrInterpreter, mName );
-  return mrInterpreter.StateMachine().GetStateValue( mName.c_str() );
+  return mrInterpreter.StateMachine().GetStateValue( mName.c_str(), mrSample );
 }
 
 double
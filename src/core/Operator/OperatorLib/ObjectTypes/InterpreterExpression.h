@@ -40,9 +40,11 @@ class InterpreterExpression : public Expression
   InterpreterExpression& ForbidAssignment()
     { mAllowAssignment = false; return *this; }
   
-  double Evaluate() const
-    { return Execute(); }
-  double Execute() const;
+  // State values are taken from the given sample of the most recently
+  // received state vector.
+  double Evaluate( int sample = 0 ) const
+    { return Execute( sample ); }
+  double Execute( int sample = 0 ) const;
 
  protected:
   Node* Variable( const std::string& );
@@ -59,17 +61,19 @@ class InterpreterExpression : public Expression
  private:
   CommandInterpreter& mrInterpreter;
   bool mAllowAssignment;
+  mutable int mSample;
 
   class StateNode : public Node
   {
    public:
-    StateNode( CommandInterpreter& interpreter, const std::string& name )
-    : mrInterpreter( interpreter ), mName( name ) {}
+    StateNode( CommandInterpreter& interpreter, const std::string& name, const int& sample )
+    : mrInterpreter( interpreter ), mName( name ), mrSample( sample ) {}
    protected:
     double OnEvaluate();
    private:
     CommandInterpreter& mrInterpreter;
     std::string mName;
+    const int& mrSample;
   };
 
   class StateAssignmentNode : public Node
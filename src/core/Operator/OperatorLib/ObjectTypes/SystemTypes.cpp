@@ -67,8 +67,10 @@ SystemType::Get( CommandInterpreter& inInterpreter )
     GetState( inInterpreter );
   else if( !::stricmp( noun.c_str(), "Version" ) )
     GetVersion( inInterpreter );
+  else if( !::stricmp( noun.c_str(), "Latencies" ) )
+    GetLatencies( inInterpreter );
   else
-    throw bciexception( "Cannot get anything from System except State or Version" );
+    throw bciexception( "Cannot get anything from System except State, Version, or Latencies" );
   return true;
 }
 
@@ -90,6 +92,16 @@ SystemType::GetVersion( CommandInterpreter& inInterpreter )
   return true;
 }
 
+bool
+SystemType::GetLatencies( CommandInterpreter& inInterpreter )
+{
+  LatencyReport report = inInterpreter.StateMachine().Latencies();
+  if( report.Traces() == 0 )
+    throw bciexception( "No latency traces available, set the LatencyTracing parameter to enable them" );
+  inInterpreter.Out() << report;
+  return true;
+}
+
 bool
 SystemType::WaitFor( CommandInterpreter& inInterpreter )
 {
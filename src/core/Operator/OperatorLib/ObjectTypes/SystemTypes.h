@@ -41,6 +41,7 @@ class SystemType : public ObjectType
   static bool Get( CommandInterpreter& );
   static bool GetState( CommandInterpreter& );
   static bool GetVersion( CommandInterpreter& );
+  static bool GetLatencies( CommandInterpreter& );
   static bool WaitFor( CommandInterpreter& );
   static bool Sleep( CommandInterpreter& );
   static bool SetConfig( CommandInterpreter& );
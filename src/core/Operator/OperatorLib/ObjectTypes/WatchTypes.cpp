@@ -53,7 +53,7 @@ WatchType::New( CommandInterpreter& inInterpreter )
 bool
 WatchType::Create( CommandInterpreter& inInterpreter, bool inSingleToken )
 {
-  enum { none, expr, sysstate };
+  enum { none, expr, sysstate, samples };
   int kind = none;
   static const struct { string pat; int kind; } kinds[] =
   {
@@ -61,7 +61,8 @@ WatchType::Create( CommandInterpreter& inInterpreter, bool inSingleToken )
     { "SYSTEMSTATE", sysstate },
   };
   static const size_t nKinds = sizeof( kinds ) / sizeof( *kinds );
-  static const string addressClause = "AT \\(\\<*\\>\\)";
+  static const string addressClause = "AT \\(\\<*\\>\\)",
+                      perSampleClause = "PER SAMPLE";
 
   vector<string> tokens;
   string token;
@@ -80,6 +81,11 @@ WatchType::Create( CommandInterpreter& inInterpreter, bool inSingleToken )
   }
   else
   {
+    if( inInterpreter.MatchTokens( perSampleClause ) )
+    {
+      inInterpreter.GetMatchingTokens( perSampleClause );
+      kind = samples;
+    }
     bool match = ( kind != none );
     for( size_t i = 0; !match && i < nKinds; ++i )
       if( match = inInterpreter.MatchTokens( kinds[i].pat ) )
@@ -112,6 +118,7 @@ WatchType::Create( CommandInterpreter& inInterpreter, bool inSingleToken )
       break;
       
     case expr:
+    case samples:
       if( tokens.empty() )
         throw bciexception( "No watch expression given" );
       token.clear();
@@ -126,7 +133,13 @@ WatchType::Create( CommandInterpreter& inInterpreter, bool inSingleToken )
             ++i;
         token.append( " " ).append( exp );
       }
-      pWatch = new ExpressionWatch( tokens, inInterpreter, address );
+      if( kind == samples )
+      {
+        pWatch = new SampleWatch( tokens, inInterpreter, address );
+        token = " " + perSampleClause + token;
+      }
+      else
+        pWatch = new ExpressionWatch( tokens, inInterpreter, address );
       break;
       
     default:
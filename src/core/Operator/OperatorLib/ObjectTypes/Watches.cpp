@@ -4,6 +4,8 @@
 // Description: A watch object, and a container for watches. A watch consists
 //   of a number of expressions which send their values to a UDP port whenever
 //   any of them changes.
+//   A SampleWatch evaluates its expressions for each sample of a state vector
+//   block, and sends all changes of a block as a single binary datagram.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -33,19 +35,24 @@
 #include "SystemStates.h"
 #include "WildcardMatch.h"
 #include "BCIException.h"
+#include "BinaryData.h"
+#include "UnitTest.h"
 #include <sstream>
 #include <iomanip>
 #include <limits>
 #include <algorithm>
+#include <stdint.h>
 
 using namespace std;
 
 // Watch
 Watch::Watch( CommandInterpreter& inInterpreter, const string& inAddress, long inID )
-: mInterpreter( inInterpreter.StateMachine() ),
-  mID( inID ),
-  mCount( 0 ),
+: mID( inID ),
+  mInterpreter( inInterpreter.StateMachine() ),
   mrList( inInterpreter.StateMachine().Watches() ),
+  mCount( 0 ),
+  mDropped( 0 ),
+  mLate( 0 ),
   mSendMessages( &Watch::SendMessages, this )
 {
   ::Lock lock( mrList );
@@ -93,7 +100,24 @@ Watch::QueueMessage( const std::string& inMessage )
   char header[] = { ( mCount / 10 ) % 10 + '0', mCount % 10 + '0', '\t', 0 },
        footer[] = "\r\n";
   ++mCount %= 100;
-  TemporaryLock( mQueue )().push( header + inMessage + footer );
+  TemporaryLock( mQueue )().push( header + inMessage + footer + '\0' );
+  mThread.Run( mSendMessages );
+}
+
+void
+Watch::QueueDatagram( const string& inData, const string& inDescription )
+{
+  OSMutex::Lock lock( mCountMutex );
+  mBuf = inDescription;
+  {
+    ::Lock queueLock( mQueue );
+    if( mQueue.size() >= MaxQueuedDatagrams )
+    {
+      ++mDropped;
+      return;
+    }
+    mQueue.push( inData );
+  }
   mThread.Run( mSendMessages );
 }
 
@@ -104,7 +128,7 @@ Watch::SendMessages()
   {
     string& s = mQueue.front();
     if( mSocket.is_open() )
-      mSocket.write( s.c_str(), s.length() + 1 );
+      mSocket.write( s.data(), s.length() );
     if( mID != BCI_None )
     { // hide header from callback
       const char* p = s.c_str();
@@ -114,7 +138,17 @@ Watch::SendMessages()
         ++p;
       Interpreter().StateMachine().ExecuteCallback( mID, p );
     }
-    TemporaryLock( mQueue )().pop();
+    bool late = false;
+    {
+      ::Lock lock( mQueue );
+      late = ( mQueue.size() > 1 );
+      mQueue.pop();
+    }
+    if( late )
+    {
+      OSMutex::Lock lock( mCountMutex );
+      ++mLate;
+    }
   }
 }
 
@@ -193,6 +227,242 @@ ExpressionWatch::OnTrigger()
   QueueMessage( oss.str() );
 }
 
+// SampleWatch
+SampleWatch::SampleWatch(
+  const vector<string>& inExpressions,
+  CommandInterpreter& inInterpreter,
+  const string& inAddress )
+: Watch( inInterpreter, inAddress, BCI_None ),
+  mBlock( inInterpreter.StateMachine().StateVectorsReceived() ),
+  mSamples( 0 )
+{
+  for( size_t i = 0; i < inExpressions.size(); ++i )
+  {
+    mExpressions.push_back( InterpreterExpression( Interpreter(), inExpressions[i] ) );
+    mExpressions.back().ForbidAssignment().Evaluate();
+  }
+  mValues.resize( mExpressions.size(), numeric_limits<double>::quiet_NaN() );
+  mDatagram.valuesPerRecord = static_cast<int>( mValues.size() );
+}
+
+bool
+SampleWatch::OnCheck()
+{
+  StateMachine& stateMachine = Interpreter().StateMachine();
+  StateMachine::DataLock lock( stateMachine );
+  unsigned int block = stateMachine.StateVectorsReceived();
+  if( block == mBlock )
+    return false;
+  if( block - mBlock > 1 ) // blocks that were never checked
+    CountDropped( block - mBlock - 1 );
+  mBlock = block;
+  mSamples = stateMachine.StateVectorSamples();
+  mDatagram.Clear();
+  for( int sample = 0; sample < mSamples; ++sample )
+  {
+    bool changed = false;
+    size_t idx = 0;
+    for( ExpressionList::iterator i = mExpressions.begin(); i != mExpressions.end(); ++i, ++idx )
+    {
+      double result = i->Evaluate( sample );
+      if( result != mValues[idx] )
+      {
+        changed = true;
+        mValues[idx] = result;
+      }
+    }
+    if( changed )
+      mDatagram.Add( sample, mValues );
+  }
+  return mDatagram.Records() > 0;
+}
+
+void
+SampleWatch::OnTrigger()
+{
+  if( mDatagram.Records() == 0 )
+    mDatagram.Add( max( mSamples - 1, 0 ), mValues );
+  QueueRecords();
+}
+
+void
+SampleWatch::QueueRecords()
+{
+  ostringstream description;
+  description << setprecision( 16 );
+  if( !mValues.empty() )
+    description << mValues[0];
+  for( size_t idx = 1; idx < mValues.size(); ++idx )
+    description << '\t' << mValues[idx];
+
+  mDatagram.block = mBlock;
+  mDatagram.dropped = Dropped();
+  mDatagram.late = Late();
+  vector<string> datagrams;
+  mDatagram.Split( datagrams );
+  for( size_t i = 0; i < datagrams.size(); ++i )
+    QueueDatagram( datagrams[i], description.str() );
+  mDatagram.Clear();
+}
+
+// SampleWatch::Datagram
+void
+SampleWatch::Datagram::Add( int inSample, const vector<double>& inValues )
+{
+  samples.push_back( inSample );
+  values.insert( values.end(), inValues.begin(), inValues.end() );
+}
+
+ostream&
+SampleWatch::Datagram::WriteBinary( ostream& os, int inBegin, int inEnd ) const
+{
+  BinaryData<uint32_t, LittleEndian>( block ).Put( os );
+  BinaryData<uint32_t, LittleEndian>( dropped ).Put( os );
+  BinaryData<uint32_t, LittleEndian>( late ).Put( os );
+  BinaryData<uint16_t, LittleEndian>( inEnd - inBegin ).Put( os );
+  BinaryData<uint16_t, LittleEndian>( valuesPerRecord ).Put( os );
+  for( int i = inBegin; i < inEnd; ++i )
+  {
+    BinaryData<uint16_t, LittleEndian>( samples[i] ).Put( os );
+    const double* p = &values[i * valuesPerRecord];
+    for( int j = 0; j < valuesPerRecord; ++j )
+      BinaryData<double, LittleEndian>( p[j] ).Put( os );
+  }
+  return os;
+}
+
+void
+SampleWatch::Datagram::Split( vector<string>& outDatagrams ) const
+{
+  int recordsPerDatagram = ( MaxSize - HeaderSize ) / RecordSize( valuesPerRecord );
+  recordsPerDatagram = max( recordsPerDatagram, 1 );
+  outDatagrams.clear();
+  for( int begin = 0; begin < Records(); begin += recordsPerDatagram )
+  {
+    ostringstream oss;
+    WriteBinary( oss, begin, min( begin + recordsPerDatagram, Records() ) );
+    outDatagrams.push_back( oss.str() );
+  }
+}
+
+bool
+SampleWatch::Datagram::ReadBinary( const char* inData, size_t inSize )
+{
+  Clear();
+  if( inSize < HeaderSize )
+    return false;
+  istringstream iss( string( inData, inSize ) );
+  istream& is = iss;
+  block = BinaryData<uint32_t, LittleEndian>( is );
+  dropped = BinaryData<uint32_t, LittleEndian>( is );
+  late = BinaryData<uint32_t, LittleEndian>( is );
+  int records = BinaryData<uint16_t, LittleEndian>( is );
+  valuesPerRecord = BinaryData<uint16_t, LittleEndian>( is );
+  if( inSize != HeaderSize + static_cast<size_t>( records * RecordSize( valuesPerRecord ) ) )
+    return false;
+  samples.resize( records );
+  values.resize( records * valuesPerRecord );
+  for( int i = 0; i < records; ++i )
+  {
+    samples[i] = BinaryData<uint16_t, LittleEndian>( is );
+    for( int j = 0; j < valuesPerRecord; ++j )
+      values[i * valuesPerRecord + j] = BinaryData<double, LittleEndian>( is );
+  }
+  return !!is;
+}
+
+UnitTest( SampleWatchDatagramTest )
+{
+  const int numValues = 3, numRecords = 100;
+  SampleWatch::Datagram d;
+  d.block = 12345;
+  d.dropped = 2;
+  d.late = 1;
+  d.valuesPerRecord = numValues;
+  vector<double> values( numValues );
+  for( int i = 0; i < numRecords; ++i )
+  {
+    for( int j = 0; j < numValues; ++j )
+      values[j] = i * 0.5 - j;
+    d.Add( 2 * i, values );
+  }
+  ostringstream oss;
+  d.WriteBinary( oss, 0, d.Records() );
+  string data = oss.str();
+  TestFail_if( data.size() != static_cast<size_t>( SampleWatch::Datagram::HeaderSize + numRecords * SampleWatch::Datagram::RecordSize( numValues ) ),
+               "encoded size is " << data.size() );
+  SampleWatch::Datagram r;
+  TestFail_if( !r.ReadBinary( data.data(), data.size() ), "could not decode datagram" );
+  TestFail_if( r.block != d.block || r.dropped != d.dropped || r.late != d.late, "header changed by round trip" );
+  TestFail_if( r.samples != d.samples || r.values != d.values, "records changed by round trip" );
+  TestFail_if( r.ReadBinary( data.data(), data.size() - 1 ), "truncated datagram accepted" );
+
+  // A block's records are split into as few datagrams as possible, each
+  // fitting into a single Ethernet frame, and carrying the block's header.
+  const size_t maxRecords = ( SampleWatch::Datagram::MaxSize - SampleWatch::Datagram::HeaderSize ) / SampleWatch::Datagram::RecordSize( numValues );
+  vector<string> datagrams;
+  d.Split( datagrams );
+  TestFail_if( datagrams.size() != ( numRecords + maxRecords - 1 ) / maxRecords, datagrams.size() << " datagrams" );
+  SampleWatch::Datagram all;
+  for( size_t i = 0; i < datagrams.size(); ++i )
+  {
+    TestFail_if( datagrams[i].size() > SampleWatch::Datagram::MaxSize, "datagram " << i << " too large" );
+    TestFail_if( !r.ReadBinary( datagrams[i].data(), datagrams[i].size() ), "could not decode datagram " << i );
+    TestFail_if( r.block != d.block || r.dropped != d.dropped || r.late != d.late, "header changed in datagram " << i );
+    size_t expected = ( i + 1 < datagrams.size() ) ? maxRecords : numRecords - i * maxRecords;
+    TestFail_if( static_cast<size_t>( r.Records() ) != expected, r.Records() << " records in datagram " << i );
+    all.samples.insert( all.samples.end(), r.samples.begin(), r.samples.end() );
+    all.values.insert( all.values.end(), r.values.begin(), r.values.end() );
+  }
+  TestFail_if( all.samples != d.samples || all.values != d.values, "records changed by splitting" );
+
+  // Records that do not fit into a frame are sent one per datagram.
+  SampleWatch::Datagram large;
+  large.valuesPerRecord = SampleWatch::Datagram::MaxSize / 8;
+  values.resize( large.valuesPerRecord );
+  large.Add( 0, values );
+  large.Add( 1, values );
+  large.Split( datagrams );
+  TestFail_if( datagrams.size() != 2, datagrams.size() << " datagrams for two large records" );
+
+  // Nothing is sent for an empty block.
+  large.Clear();
+  large.Split( datagrams );
+  TestFail_if( !datagrams.empty(), datagrams.size() << " datagrams for an empty block" );
+
+  // Send the datagrams of several blocks through a local socket. Each datagram
+  // is received before the next one is sent, so none is dropped for lack of
+  // buffer space, and each must arrive intact.
+  receiving_udpsocket receiver;
+  for( int port = 45000; !receiver.is_open() && port < 45100; ++port )
+    receiver.open( "127.0.0.1", port );
+  TestFail_if( !receiver.is_open(), "could not open receiving socket" );
+  sending_udpsocket sender( receiver.address() );
+  TestFail_if( !sender.is_open(), "could not open sending socket" );
+  const int numBlocks = 10;
+  int sent = 0,
+      received = 0;
+  vector<char> buf( 64 * 1024 );
+  for( int block = 0; block < numBlocks && receiver.is_open() && sender.is_open(); ++block )
+  {
+    d.block = block;
+    d.Split( datagrams );
+    for( size_t i = 0; i < datagrams.size(); ++i )
+    {
+      sender.write( datagrams[i].data(), datagrams[i].size() );
+      ++sent;
+      if( !receiver.wait_for_read() )
+        break;
+      size_t size = receiver.read( &buf[0], buf.size() );
+      ++received;
+      TestFail_if( string( &buf[0], size ) != datagrams[i], "block " << block << ", datagram " << i << " changed in transit" );
+      TestFail_if( !r.ReadBinary( &buf[0], size ), "could not decode block " << block << ", datagram " << i );
+      TestFail_if( r.block != static_cast<unsigned int>( block ), "block " << r.block << " received instead of " << block );
+    }
+  }
+  TestFail_if( received != sent, received << " of " << sent << " datagrams received" );
+}
+
 // Watch::Set
 Watch::Set::Set( const Watch::Set& other )
 : vector<Watch*>( other ), mpList( other.mpList )
@@ -4,6 +4,8 @@
 // Description: A watch object, and a container for watches. A watch consists
 //   of a number of expressions which send their values to a UDP port whenever
 //   any of them changes.
+//   A SampleWatch evaluates its expressions for each sample of a state vector
+//   block, and sends all changes of a block as a single binary datagram.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -54,6 +56,11 @@ class Watch
   const std::string& Check() { if( OnCheck() ) OnTrigger(); return mBuf; }
   const std::string& Trigger() { OnCheck(); OnTrigger(); return mBuf; }
 
+  // Number of datagrams discarded because the send queue was full, and number
+  // of datagrams sent while a more recent one was already waiting.
+  int Dropped() const { return mDropped; }
+  int Late() const { return mLate; }
+
  public:
   class List;
   class Set : protected std::vector<Watch*>
@@ -112,6 +119,10 @@ class Watch
 
   CommandInterpreter& Interpreter() { return mInterpreter; }
   void QueueMessage( const std::string& );
+  // Queues binary data for sending without adding a header or footer.
+  // When the queue is full, data is discarded, and counted as dropped.
+  void QueueDatagram( const std::string& data, const std::string& description );
+  void CountDropped( int count ) { OSMutex::Lock lock( mCountMutex ); mDropped += count; }
   virtual bool OnCheck() { return false; }
   virtual void OnTrigger() {}
 
@@ -123,9 +134,10 @@ class Watch
   CommandInterpreter mInterpreter;
   List& mrList;
 
+  enum { MaxQueuedDatagrams = 32 };
   struct Queue : std::queue<std::string>, Lockable<>
   {} mQueue;
-  int mCount;
+  int mCount, mDropped, mLate;
   OSMutex mCountMutex;
 
   sending_udpsocket mSocket;
@@ -164,4 +176,58 @@ class ExpressionWatch : public Watch
   std::vector<double> mValues;
 };
 
+class SampleWatch : public Watch
+{
+ public:
+  typedef ExpressionWatch::ExpressionList ExpressionList;
+
+  SampleWatch( const std::vector<std::string>& expressions, CommandInterpreter&, const std::string& address = "" );
+  const ExpressionList& Expressions() const { return mExpressions; }
+
+  // Datagram layout, all numbers little endian:
+  //   uint32 block number, uint32 dropped updates, uint32 late datagrams,
+  //   uint16 number of records, uint16 number of values per record,
+  //   followed by records, each consisting of a uint16 sample index within
+  //   the block, and a float64 for each value.
+  // Records are present for those samples in which any value has changed.
+  // A block's records may be split across multiple datagrams.
+  struct Datagram
+  {
+    enum { HeaderSize = 16, MaxSize = 1472 };
+    static int RecordSize( int valuesPerRecord )
+      { return 2 + 8 * valuesPerRecord; }
+
+    Datagram() : block( 0 ), dropped( 0 ), late( 0 ), valuesPerRecord( 0 ) {}
+    int Records() const
+      { return static_cast<int>( samples.size() ); }
+    void Clear()
+      { samples.clear(); values.clear(); }
+    void Add( int sample, const std::vector<double>& );
+    // Writes records [begin, end).
+    std::ostream& WriteBinary( std::ostream&, int begin, int end ) const;
+    // Writes all records into as few datagrams as possible, each of which
+    // contains at least one record.
+    void Split( std::vector<std::string>& ) const;
+    bool ReadBinary( const char*, size_t );
+
+    unsigned int block, dropped, late;
+    int valuesPerRecord;
+    std::vector<int> samples;
+    std::vector<double> values; // Records() * valuesPerRecord entries
+  };
+
+ protected:
+  bool OnCheck();
+  void OnTrigger();
+
+ private:
+  void QueueRecords();
+
+  ExpressionList mExpressions;
+  std::vector<double> mValues;
+  unsigned int mBlock;
+  int mSamples;
+  Datagram mDatagram;
+};
+
 #endif // WATCHES_H
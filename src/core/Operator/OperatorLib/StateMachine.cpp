@@ -58,11 +58,13 @@
 #include <ctime>
 #include <cmath>
 #include <cstdlib>
+#include <algorithm>
 
 using namespace std;
 
 StateMachine::StateMachine()
 : mSystemState( Idle ),
+  mStateVectorsReceived( 0 ),
   mEventLink( *this )
 {
   Init();
@@ -87,7 +89,9 @@ StateMachine::Init()
   mPreviousRandomSeed.clear();
   mStateVector = StateVector();
   mControlSignal = GenericSignal();
+  mLatencyReport.Clear();
   mVisualizations.clear();
+  mVisSignalBuffers.clear();
 }
 
 bool
@@ -120,6 +124,10 @@ StateMachine::Startup( const char* inArguments )
     "System:Protocol int AutoConfig= 1"
     " 1 0 1 // Use AutoConfig protocol extension (boolean)" );
 
+  mParameters.Add(
+    "System:Protocol int LatencyTracing= 0"
+    " 0 0 1 // Report per-block latencies between modules at the end of each run (boolean)" );
+
   mIntroducedRandomSeed = false;
   mLocalAddress.clear();
   mpSourceModule = 0;
@@ -241,12 +249,19 @@ StateMachine::SetStateValue( const char* inName, State::ValueType inValue )
 }
 
 State::ValueType
-StateMachine::GetStateValue( const char* inName ) const
+StateMachine::GetStateValue( const char* inName, int inSample ) const
 {
   DataLock lock( this );
-  if( !mStates.Exists( inName ) )
+  if( !mStates.Exists( inName ) || inSample < 0 || inSample >= mStateVector.Samples() )
     return 0;
-  return mStateVector.StateValue( inName );
+  return mStateVector.StateValue( inName, inSample );
+}
+
+int
+StateMachine::StateVectorSamples() const
+{
+  DataLock lock( this );
+  return max( mStateVector.Samples() - 1, 1 );
 }
 
 bool
@@ -454,13 +469,22 @@ StateMachine::SendNextModuleInfo()
 void
 StateMachine::BroadcastParameters()
 {
-  for( size_t i = 0; i < mConnections.size(); ++i )
-    if( mConnections[i]->Send( mParameters ) )
-      ThreadUtils::Yield();
+  BroadcastParameters( mParameters );
   for( int i = 0; i < mParameters.Size(); ++i )
     mParameters[i].Unchanged();
 }
 
+void
+StateMachine::BroadcastParameters( const ParamList& inParams, size_t inFirstConnection )
+{
+  vector<uint64_t> hashes( inParams.Size() );
+  for( int i = 0; i < inParams.Size(); ++i )
+    hashes[i] = inParams[i].Hash();
+  for( size_t i = inFirstConnection; i < mConnections.size(); ++i )
+    if( mConnections[i]->SendParameters( inParams, hashes ) )
+      ThreadUtils::Yield();
+}
+
 void
 StateMachine::BroadcastEndOfParameter()
 {
@@ -481,11 +505,7 @@ StateMachine::BroadcastParameterChanges()
     }
   }
   if( !changedParams.Empty() )
-  {
-    for( size_t i = 0; i < mConnections.size(); ++i )
-      if( mConnections[i]->Send( changedParams ) )
-        ThreadUtils::Yield();
-  }
+    BroadcastParameters( changedParams );
 }
 
 void
@@ -678,11 +698,13 @@ StateMachine::ExecuteTransitionCallbacks( int inTransition )
       break;
 
     case TRANSITION( Resting, RunningInitiated ):
+      TemporaryLock( *this )().mLatencyReport.Clear();
       TriggerEvent( BCI_OnStart );
       LogMessage( BCI_OnLogMessage, "Operator started operation" );
       break;
 
     case TRANSITION( Suspended, RunningInitiated ):
+      TemporaryLock( *this )().mLatencyReport.Clear();
       TriggerEvent( BCI_OnResume );
       LogMessage( BCI_OnLogMessage, "Operator resumed operation" );
       break;
@@ -693,6 +715,15 @@ StateMachine::ExecuteTransitionCallbacks( int inTransition )
 
     case TRANSITION( SuspendInitiated, Suspended ):
       TriggerEvent( BCI_OnSuspend );
+      {
+        LatencyReport report = Latencies();
+        if( report.Traces() > 0 )
+        {
+          ostringstream oss;
+          oss << report;
+          LogMessage( BCI_OnLogMessage, oss.str() );
+        }
+      }
       break;
 
     case TRANSITION( WaitingForConnection, Idle ):
@@ -1052,32 +1083,64 @@ bool
 StateMachine::HandleStateVector( const CoreConnection&, istream& is )
 {
   WatchDataLock lock( this );
-  return mStateVector.ReadBinary( is );
+  if( !mStateVector.ReadBinary( is ) )
+    return false;
+  ++mStateVectorsReceived;
+  return true;
 }
 
-void
-StateMachine::Handle( const CoreConnection&, const VisSignal& inSignal )
+bool
+StateMachine::HandleVisSignal( const CoreConnection&, istream& is )
 {
-  if( inSignal.SourceID().empty() )
+  VisID visID;
+  if( !VisBase::ReadVisID( is, visID ) )
+    return false;
+
+  if( visID.empty() )
+  {
+    GenericSignal signal;
+    if( signal.ReadBinary( is ) )
+    {
+      WatchDataLock lock( this );
+      mControlSignal = signal;
+    }
+    return !is.fail();
+  }
+
+  VisSignalBuffer& buffer = mVisSignalBuffers[visID];
+  if( !GenericSignal::ReadBinaryAsFloat( is, buffer.channels, buffer.elements, buffer.data ) )
   {
-    WatchDataLock lock( this );
-    mControlSignal = inSignal;
+    buffer.pending = false;
+    return false;
   }
-  else
+  int coalesce = 0;
   {
-    const string kind = "Graph";
-    CheckInitializeVis( inSignal.SourceID(), kind );
-    int channels = inSignal.Signal().Channels(),
-        elements = inSignal.Signal().Elements(),
-        size = channels * elements;
-    bciassert( size >= 0 );
-    float* pData = new float[ channels * elements ];
-    for( int ch = 0; ch < channels; ++ch )
-      for( int el = 0; el < elements; ++el )
-        pData[ ch * elements + el ] = static_cast<float>( inSignal.Signal()( ch, el ) );
-    ExecuteCallback( BCI_OnVisSignal, inSignal.SourceID().c_str(), channels, elements, pData );
-    delete[] pData;
+    DataLock lock( this );
+    mVisualizations[visID].Get( CfgID::CoalesceFrames, coalesce );
   }
+  if( coalesce && is.rdbuf() && is.rdbuf()->in_avail() > 0 )
+    buffer.pending = true;
+  else
+    DeliverVisSignal( visID, buffer );
+  return true;
+}
+
+void
+StateMachine::DeliverVisSignal( const string& inVisID, VisSignalBuffer& ioBuffer )
+{
+  ioBuffer.pending = false;
+  const string kind = "Graph";
+  CheckInitializeVis( inVisID, kind );
+  float* pData = ioBuffer.data.empty() ? 0 : &ioBuffer.data[0];
+  ExecuteCallback( BCI_OnVisSignal, inVisID.c_str(), ioBuffer.channels, ioBuffer.elements, pData );
+}
+
+void
+StateMachine::DeliverPendingVisSignals()
+{
+  for( VisSignalBuffers::iterator i = mVisSignalBuffers.begin(); i != mVisSignalBuffers.end(); ++i )
+    if( i->second.pending )
+      DeliverVisSignal( i->first, i->second );
 }
 
 void
@@ -1089,9 +1152,7 @@ StateMachine::Handle( const CoreConnection& c, const VisSignalProperties& v )
     if( ( SystemState() & ~StateFlags ) == SetConfigIssued )
     {
       size_t idx = c.Tag();
-      for( size_t i = idx; i < mConnections.size(); ++i )
-        if( mConnections[i]->Send( mAutoParameters ) )
-          ThreadUtils::Yield();
+      BroadcastParameters( mAutoParameters, idx );
       if( idx < mConnections.size() )
         mConnections[idx]->Send( v );
       else
@@ -1131,6 +1192,15 @@ StateMachine::Handle( const CoreConnection&, const VisCfg& v )
   ExecuteCallback( BCI_OnVisPropertyMessage, v.SourceID().c_str(), v.CfgID(), v.CfgValue().c_str() );
 }
 
+void
+StateMachine::Handle( const CoreConnection&, const LatencyTrace& t )
+{
+  DataLock lock( this );
+  int state = SystemState() & ~StateFlags;
+  if( state == RunningInitiated || state == Running || state == SuspendInitiated )
+    mLatencyReport.Add( t );
+}
+
 void
 StateMachine::Handle( const CoreConnection& inConnection, SysState inState )
 {
@@ -1212,6 +1282,25 @@ StateMachine::CoreConnection::Info() const
   return info;
 }
 
+bool
+StateMachine::CoreConnection::SendParameters( const ParamList& inParams, const vector<uint64_t>& inHashes )
+{
+  if( !Protocol().Provides( ProtocolVersion::ParamSnapshots ) )
+    return Send( inParams );
+
+  ::Lock _( mParamHashes );
+  for( int i = 0; i < inParams.Size(); ++i )
+  {
+    uint64_t& hash = mParamHashes[inParams[i].Name()];
+    if( hash != inHashes[i] )
+    {
+      Send( inParams[i] );
+      hash = inHashes[i];
+    }
+  }
+  return Output();
+}
+
 void
 StateMachine::CoreConnection::ProcessBCIMessages()
 {
@@ -1222,6 +1311,10 @@ StateMachine::CoreConnection::ProcessBCIMessages()
     ::Lock _( mrParent.mBCIMessageLock ); // Serialize messages
     HandleMessage();
   }
+  {
+    ::Lock _( mrParent.mBCIMessageLock );
+    mrParent.DeliverPendingVisSignals();
+  }
   if( !mSocket.connected() && State() != WaitingForConnection )
     OnDisconnect();
 }
@@ -1315,7 +1408,13 @@ StateMachine::CoreConnection::OnParam( istream& is )
 {
   Param param;
   if( param.ReadBinary( is ) )
+  {
+    {
+      ::Lock _( mParamHashes );
+      mParamHashes.erase( param.Name() );
+    }
     mrParent.Handle( *this, param );
+  }
   return true;
 }
 
@@ -1337,9 +1436,7 @@ StateMachine::CoreConnection::OnStateVector( istream& is )
 bool
 StateMachine::CoreConnection::OnVisSignal( istream& is )
 {
-  VisSignal v;
-  if( v.ReadBinary( is ) )
-    mrParent.Handle( *this, v );
+  mrParent.HandleVisSignal( *this, is );
   return true;
 }
 
@@ -1379,6 +1476,15 @@ StateMachine::CoreConnection::OnVisCfg( istream& is )
   return true;
 }
 
+bool
+StateMachine::CoreConnection::OnLatencyTrace( istream& is )
+{
+  LatencyTrace t;
+  if( t.ReadBinary( is ) )
+    mrParent.Handle( *this, t );
+  return true;
+}
+
 // ---------- EventLink definitions ------------
 void
 StateMachine::EventLink::ConfirmConnection()
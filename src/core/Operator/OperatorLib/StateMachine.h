@@ -43,6 +43,7 @@
 #include "VisTable.h"
 #include "VersionInfo.h"
 #include "ProtocolVersion.h"
+#include "LatencyTrace.h"
 #include "ScriptEvents.h"
 #include "Watches.h"
 #include "OSThread.h"
@@ -51,6 +52,8 @@
 
 #include <cstddef>
 #include <set>
+#include <map>
+#include <vector>
 #include <fstream>
 
 class CommandInterpreter;
@@ -139,7 +142,12 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
   const StateList& States() const
     { return mStates; }
   bool SetStateValue( const char* name, State::ValueType value );
-  State::ValueType GetStateValue( const char* name ) const;
+  State::ValueType GetStateValue( const char* name, int sample = 0 ) const;
+  // Number of state vector blocks received since startup, and number of
+  // samples per block, excluding the state vector's carry-over sample.
+  unsigned int StateVectorsReceived() const
+    { return mStateVectorsReceived; }
+  int StateVectorSamples() const;
 
   // Event list.
   StateList& Events()
@@ -152,6 +160,10 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
   const GenericSignal& ControlSignal() const
     { return mControlSignal; }
 
+  // Latency traces collected during the current or most recent run.
+  LatencyReport Latencies() const
+    { DataLock lock( this ); return mLatencyReport; }
+
   // Table of visualization properties.
   VisTable& Visualizations()
     { return mVisualizations; }
@@ -196,6 +208,7 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
 
   void SendNextModuleInfo();
   void BroadcastParameters();
+  void BroadcastParameters( const ParamList&, size_t firstConnection = 0 );
   void BroadcastEndOfParameter();
   void BroadcastParameterChanges();
   void BroadcastStates();
@@ -221,7 +234,9 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
   StateList         mStates,
                     mEvents;
   StateVector       mStateVector;
+  unsigned int      mStateVectorsReceived;
   GenericSignal     mControlSignal;
+  LatencyReport     mLatencyReport;
   VisTable          mVisualizations;
   std::string       mLocalAddress;
 
@@ -274,6 +289,9 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
 
     void ProcessBCIMessages();
     void EnterState( SysState );
+    // If the module keeps its parameters across configurations, sends only
+    // those parameters that differ from the versions last sent to it.
+    bool SendParameters( const ParamList&, const std::vector<uint64_t>& hashes );
 
    protected:
     bool OnStatus( std::istream& );
@@ -286,6 +304,7 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
     bool OnVisMemo( std::istream& );
     bool OnVisBitmap( std::istream& );
     bool OnVisCfg( std::istream& );
+    bool OnLatencyTrace( std::istream& );
 
    private:
     void OnAccept();
@@ -297,6 +316,9 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
     server_tcpsocket mSocket;
     sockstream       mStream;
     ConnectionInfo   mInfo;
+    // Hashes of parameters as last sent, with entries removed for parameters
+    // that the module has modified.
+    struct ParamHashes : std::map<std::string, uint64_t>, Lockable<OSMutex> {} mParamHashes;
     // Members that should not be accessed directly.
     SysState         mState_;
   };
@@ -307,16 +329,17 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
 
  public:
   bool HandleStateVector( const CoreConnection&, std::istream& );
+  bool HandleVisSignal( const CoreConnection&, std::istream& );
   void Handle( const CoreConnection&, const ProtocolVersion& );
   void Handle( const CoreConnection&, const Status& );
   void Handle( const CoreConnection&, const SysCommand& );
   void Handle( const CoreConnection&, const Param& );
   void Handle( const CoreConnection&, const State& );
-  void Handle( const CoreConnection&, const VisSignal& );
   void Handle( const CoreConnection&, const VisSignalProperties& );
   void Handle( const CoreConnection&, const VisMemo& );
   void Handle( const CoreConnection&, const VisBitmap& );
   void Handle( const CoreConnection&, const VisCfg& );
+  void Handle( const CoreConnection&, const LatencyTrace& );
   void Handle( const CoreConnection&, SysState );
 
  private:
@@ -332,6 +355,24 @@ class StateMachine : public CallbackBase, public Lockable<>, private OSThread
  private:
   bool CheckInitializeVis( const std::string& sourceID, const std::string& kind );
 
+  // Visualization signals are decoded into per-visID buffers that are reused
+  // across messages. When a visualization has its CoalesceFrames property set,
+  // delivery of a frame is deferred while further messages are waiting, such that
+  // only the most recent frame is passed on once input has been processed.
+  struct VisSignalBuffer
+  {
+    VisSignalBuffer() : channels( 0 ), elements( 0 ), pending( false ) {}
+    int channels,
+        elements;
+    std::vector<float> data;
+    bool pending;
+  };
+  typedef std::map<std::string, VisSignalBuffer> VisSignalBuffers;
+  VisSignalBuffers mVisSignalBuffers;
+
+  void DeliverVisSignal( const std::string& visID, VisSignalBuffer& );
+  void DeliverPendingVisSignals();
+
   class EventLink;
   friend class EventLink;
   class EventLink : public sockstream, public Lockable<>, private OSThread
@@ -36,6 +36,7 @@ SOURCES += main.cpp \
     ../../../shared/utils/VersionInfo.cpp \
     ShowStates.cpp \
     ../../../shared/fileio/dat/BCI2000FileReader.cpp \
+    ../../../shared/fileio/dat/BCZCodec.cpp \
     ../../../shared/types/SignalProperties.cpp \
     ../../../shared/types/PhysicalUnit.cpp \
     ../../../shared/types/SignalType.cpp \
@@ -47,6 +48,7 @@ SOURCES += main.cpp \
     ../../../extlib/math/FilterDesign.cpp \
     ../../../shared/types/GenericSignal.cpp \
     ../../../shared/gui/SignalDisplay.cpp \
+    ../../../shared/gui/SignalEnvelope.cpp \
     ../../../shared/types/Label.cpp \
     VisDisplayBase.cpp \
     VisDisplayMemo.cpp \
@@ -86,6 +88,7 @@ HEADERS += MainWindow.h \
     ../../../shared/utils/VersionInfo.h \
     ShowStates.h \
     ../../../shared/fileio/dat/BCI2000FileReader.h \
+    ../../../shared/fileio/dat/BCZCodec.h \
     ../../../shared/types/SignalProperties.h \
     ../../../shared/types/SignalType.h \
     ../../../shared/types/PhysicalUnit.h \
@@ -97,6 +100,7 @@ HEADERS += MainWindow.h \
     ../../../extlib/math/IIRFilter.h \
     ../../../shared/types/GenericSignal.h \
     ../../../shared/gui/SignalDisplay.h \
+    ../../../shared/gui/SignalEnvelope.h \
     ../../../shared/types/Label.h \
     DisplayFilter.h \
     VisDisplayBase.h \
@@ -2,6 +2,12 @@
 // $Id$
 // Author: schalk@wadsworth.org, juergen.mellinger@uni-tuebingen.de
 // Description: An ADC class for testing purposes.
+//   In fast mode, sine sources are computed by rotating complex phasors,
+//   mixed into channels through a sparse mixing matrix, and noise is taken
+//   from a counter-based random generator, such that large numbers of
+//   channels may be generated at high sampling rates for load testing.
+//   Optionally, state changes may be replayed from a list of events, and
+//   pipeline timing may be reported at the end of each run.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -29,6 +35,7 @@
 #include "SignalGeneratorADC.h"
 #include "BCIStream.h"
 #include "GenericSignal.h"
+#include <algorithm>
 
 #if _WIN32
 # include <Windows.h>
@@ -44,16 +51,29 @@ using namespace std;
 RegisterFilter( SignalGeneratorADC, 1 );
 
 SignalGeneratorADC::SignalGeneratorADC()
-: mRandomGenerator( this ),
+: mMode( exact ),
   mNoiseAmplitude( 0 ),
   mDCOffset( 0 ),
   mSineChannelX( 0 ),
   mSineChannelY( 0 ),
   mSineChannelZ( 0 ),
   mModulateAmplitude( 1 ),
+  mNoiseKey( 0 ),
+  mNoiseCounter( 0 ),
+  mReplayPeriod( 0 ),
+  mPeriodBegin( 0 ),
+  mSampleCount( 0 ),
+  mNextEvent( 0 ),
+  mReportLoad( false ),
+  mBlockDuration( 0 ),
+  mMaxPipeline( 0 ),
+  mMaxCompute( 0 ),
+  mBlocks( 0 ),
+  mOverruns( 0 ),
   mAmplitudeX( 1 ),
   mAmplitudeY( 1 ),
-  mAmplitudeZ( 1 )
+  mAmplitudeZ( 1 ),
+  mRandomGenerator( this )
 {
 }
 
@@ -106,6 +126,18 @@ SignalGeneratorADC::Publish()
         
     "Source matrix SourceProperties= 0 [ Frequency Amplitude ] // Source properties",
     "Source matrix MixingMatrix= 0 1 // Source-to-sensor projection, rows are sources, columns are sensors",
+    "Source int GeneratorMode= 0 0 0 1 "
+      "// signal computation: "
+        " 0: exact,"
+        " 1: fast, for load testing "
+        "(enumeration)",
+
+    "Source matrix ReplayEvents= 0 { Time State Value } % % % "
+      "// state changes to replay, with time relative to the beginning of a run",
+    "Source float ReplayPeriod= 0s 0s 0 % "
+      "// period after which ReplayEvents repeat, 0 for no repetition",
+    "Source int ReportLoad= 0 0 0 1 "
+      "// report pipeline timing at the end of each run (boolean)",
   END_PARAMETER_DEFINITIONS
 }
 
@@ -172,6 +204,25 @@ SignalGeneratorADC::Preflight( const SignalProperties&,
       bcierr << "Unknown SignalType value" << endl;
   }
   Output.SetType( signalType );
+
+  Parameter( "GeneratorMode" );
+  Parameter( "ReportLoad" );
+  ParamRef ReplayEvents = Parameter( "ReplayEvents" );
+  double samplingRate = Parameter( "SamplingRate" ).InHertz(),
+         replayPeriod = Parameter( "ReplayPeriod" ).InSeconds() * samplingRate,
+         lastEvent = 0;
+  if( ReplayEvents->NumRows() > 0 && ReplayEvents->NumColumns() != 3 )
+    bcierr << "ReplayEvents must have three columns: Time, State, and Value" << endl;
+  else for( int i = 0; i < ReplayEvents->NumRows(); ++i )
+  {
+    double time = ReplayEvents( i, 0 ).InSeconds() * samplingRate;
+    if( time < 0 )
+      bcierr << "Negative time in row " << i + 1 << " of ReplayEvents" << endl;
+    lastEvent = max( lastEvent, time );
+    State( ReplayEvents( i, 1 ).ToString() );
+  }
+  if( replayPeriod > 0 && replayPeriod <= lastEvent )
+    bcierr << "ReplayPeriod must exceed the time of the last event in ReplayEvents" << endl;
 }
 
 
@@ -247,6 +298,57 @@ SignalGeneratorADC::Initialize( const SignalProperties&, const SignalProperties&
     mSourcePhases.resize( numSrc, 0 );
   }
 
+  mMode = Parameter( "GeneratorMode" );
+  mOscillators.clear();
+  mSparseMixing.clear();
+  if( mMode == fast )
+  {
+    mOscillators.resize( mSourceFrequencies.size() );
+    for( size_t i = 0; i < mOscillators.size(); ++i )
+    {
+      Oscillator& o = mOscillators[i];
+      o.re = 1;
+      o.im = 0;
+      o.rotRe = ::cos( 2 * Pi() * mSourceFrequencies[i] );
+      o.rotIm = ::sin( 2 * Pi() * mSourceFrequencies[i] );
+      o.amplitude = mSourceAmplitudes[i];
+    }
+    mSparseMixing.resize( mMixingMatrix.size() );
+    for( size_t ch = 0; ch < mMixingMatrix.size(); ++ch )
+      for( size_t src = 0; src < mMixingMatrix[ch].size(); ++src )
+        if( mMixingMatrix[ch][src] != 0 )
+        {
+          Weight w = { static_cast<int>( src ), mMixingMatrix[ch][src] };
+          mSparseMixing[ch].push_back( w );
+        }
+    mSourceBlock.resize( mOscillators.size() * Output.Elements() );
+    mRawOffset.resize( Output.Channels() );
+    mRawGain.resize( Output.Channels() );
+    for( int ch = 0; ch < Output.Channels(); ++ch )
+    {
+      const PhysicalUnit& u = Output.ValueUnit( ch );
+      mRawOffset[ch] = u.PhysicalToRawValue( 0 );
+      mRawGain[ch] = u.PhysicalToRawValue( 1 ) - mRawOffset[ch];
+    }
+  }
+
+  mReplayEvents.clear();
+  ParamRef ReplayEvents = Parameter( "ReplayEvents" );
+  double samplingRate = Parameter( "SamplingRate" ).InHertz();
+  for( int i = 0; i < ReplayEvents->NumRows(); ++i )
+  {
+    ReplayEvent e;
+    e.time = static_cast<int64_t>( ReplayEvents( i, 0 ).InSeconds() * samplingRate + 0.5 );
+    e.state = ResolveState( ReplayEvents( i, 1 ).ToString() );
+    e.value = ReplayEvents( i, 2 );
+    mReplayEvents.push_back( e );
+  }
+  stable_sort( mReplayEvents.begin(), mReplayEvents.end(), &ReplayEvent::Earlier );
+  mReplayPeriod = static_cast<int64_t>( Parameter( "ReplayPeriod" ).InSeconds() * samplingRate + 0.5 );
+
+  mReportLoad = ( Parameter( "ReportLoad" ) != 0 );
+  mBlockDuration = 1e3 * MeasurementUnits::SampleBlockDuration();
+
   mClock.SetInterval( 1e3 * MeasurementUnits::SampleBlockDuration() );
   mClock.Reset();
   mClock.Start();
@@ -257,16 +359,74 @@ void
 SignalGeneratorADC::StartRun()
 {
   if( Parameter( "RandomSeed" ) != 0 )
+  {
     for( size_t i = 0; i < mSourcePhases.size(); ++i )
       mSourcePhases[i] = 0;
+    for( size_t i = 0; i < mOscillators.size(); ++i )
+      mOscillators[i].re = 1, mOscillators[i].im = 0;
+  }
+  mNoiseKey = mRandomGenerator.Random();
+  mNoiseKey = mNoiseKey << 32 | mRandomGenerator.Random();
+  mNoiseCounter = 0;
+
+  mSampleCount = 0;
+  mPeriodBegin = 0;
+  mNextEvent = 0;
+
+  mPipelineWatch.Reset();
+  mWaitWatch.Reset();
+  mComputeWatch.Reset();
+  mMaxPipeline = 0;
+  mMaxCompute = 0;
+  mBlocks = 0;
+  mOverruns = 0;
+}
+
+
+void
+SignalGeneratorADC::StopRun()
+{
+  if( mReportLoad && mBlocks > 1 )
+  {
+    // The time between two calls to Process() is spent in the remainder
+    // of the source module, and in the signal processing and application
+    // modules. The first block's pipeline time is not known.
+    double pipeline = mPipelineWatch.Total() / ( mBlocks - 1 ),
+           compute = mComputeWatch.Total() / mBlocks,
+           busy = ( mPipelineWatch.Total() + mComputeWatch.Total() )
+                  / ( mPipelineWatch.Total() + mComputeWatch.Total() + mWaitWatch.Total() );
+    int channels = Parameter( "SourceCh" );
+    double samplingRate = Parameter( "SamplingRate" ).InHertz();
+    bciout << "Load report for " << channels << " channels at " << samplingRate << "Hz "
+           << "(" << channels * samplingRate << " values/s), "
+           << mBlocks << " blocks of " << mBlockDuration << "ms:\n"
+           << " signal generation: " << compute << "ms per block on average, " << mMaxCompute << "ms max\n"
+           << " remaining pipeline: " << pipeline << "ms per block on average, " << mMaxPipeline << "ms max\n"
+           << " busy " << 100 * busy << "% of the time, "
+           << mOverruns << " blocks exceeded the block duration\n"
+           << ( mOverruns == 0 ? " load is sustainable" : " load is not sustainable" )
+           << endl;
+  }
 }
 
 
 void
 SignalGeneratorADC::Process( const GenericSignal&, GenericSignal& Output )
 {
+  double pipeline = 0;
+  if( mReportLoad )
+  {
+    if( mBlocks > 0 )
+      pipeline = mPipelineWatch.Stop();
+    mWaitWatch.Start();
+  }
   mClock.Wait();
   mClock.Reset();
+  if( mReportLoad )
+  {
+    mWaitWatch.Stop();
+    mComputeWatch.Start();
+  }
 
 #if _WIN32
   if( mModulateAmplitude )
@@ -294,6 +454,31 @@ SignalGeneratorADC::Process( const GenericSignal&, GenericSignal& Output )
   }
 #endif // !_WIN32, !USE_QT
 
+  if( mMode == fast )
+    ProcessFast( Output );
+  else
+    ProcessExact( Output );
+  Replay( Output.Elements() );
+
+  if( mReportLoad )
+  {
+    double compute = mComputeWatch.Stop();
+    if( mBlocks > 0 )
+    {
+      mMaxPipeline = max( mMaxPipeline, pipeline );
+      mMaxCompute = max( mMaxCompute, compute );
+      if( pipeline + compute >= mBlockDuration )
+        ++mOverruns;
+    }
+    ++mBlocks;
+    mPipelineWatch.Start();
+  }
+}
+
+
+void
+SignalGeneratorADC::ProcessExact( GenericSignal& Output )
+{
   double offset = mDCOffset;
   if( offset != 0 )
     offset *= mOffsetMultiplier.Evaluate();
@@ -331,6 +516,106 @@ SignalGeneratorADC::Process( const GenericSignal&, GenericSignal& Output )
 }
 
 
+void
+SignalGeneratorADC::ProcessFast( GenericSignal& Output )
+{
+  // Source gains, and offset, are evaluated once per block rather than
+  // once per sample.
+  double multiplier = mAmplitudeMultiplier.Evaluate();
+  vector<double> gain( mOscillators.size() );
+  for( size_t i = 0; i < mOscillators.size(); ++i )
+    gain[i] = mOscillators[i].amplitude * multiplier;
+  if( mSineChannelX > 0 )
+    gain[mSineChannelX - 1] *= mAmplitudeX;
+  if( mSineChannelY > 0 )
+    gain[mSineChannelY - 1] *= mAmplitudeY;
+  else if( mSineChannelY == 0 )
+    for( size_t i = 0; i < gain.size(); ++i )
+      gain[i] *= mAmplitudeY;
+  if( mSineChannelZ > 0 )
+    gain[mSineChannelZ - 1] *= mAmplitudeZ;
+
+  double offset = mDCOffset;
+  if( offset != 0 )
+    offset *= mOffsetMultiplier.Evaluate();
+
+  const size_t numSources = mOscillators.size();
+  const int numSamples = Output.Elements();
+  double* pSource = numSources ? &mSourceBlock[0] : 0;
+  for( int sample = 0; sample < numSamples; ++sample )
+    for( size_t i = 0; i < numSources; ++i )
+    {
+      Oscillator& o = mOscillators[i];
+      double re = o.re * o.rotRe - o.im * o.rotIm;
+      o.im = o.im * o.rotRe + o.re * o.rotIm;
+      o.re = re;
+      *pSource++ = gain[i] * o.im;
+    }
+  // Correct for rounding errors accumulating in the phasors' magnitudes.
+  for( size_t i = 0; i < numSources; ++i )
+  {
+    Oscillator& o = mOscillators[i];
+    double correction = 1.5 - 0.5 * ( o.re * o.re + o.im * o.im );
+    o.re *= correction;
+    o.im *= correction;
+  }
+
+  const double minValue = Output.Type().Min(),
+               maxValue = Output.Type().Max();
+  for( int ch = 0; ch < Output.Channels(); ++ch )
+  {
+    const vector<Weight>& weights = mSparseMixing[ch];
+    const Weight* pBegin = weights.empty() ? 0 : &weights[0],
+                * pEnd = pBegin + weights.size();
+    const double* pSample = numSources ? &mSourceBlock[0] : 0;
+    for( int sample = 0; sample < numSamples; ++sample, pSample += numSources )
+    {
+      double value = offset;
+      for( const Weight* w = pBegin; w != pEnd; ++w )
+        value += w->value * pSample[w->source];
+      if( mNoiseAmplitude != 0 )
+        value += mNoiseAmplitude * NoiseValue();
+      value = mRawOffset[ch] + mRawGain[ch] * value;
+      Output( ch, sample ) = min( max( value, minValue ), maxValue );
+    }
+  }
+}
+
+
+double
+SignalGeneratorADC::NoiseValue()
+{
+  // A counter-based generator: a SplitMix64 hash of a key and a counter,
+  // mapped to a uniform distribution over [-0.5, 0.5).
+  uint64_t x = mNoiseKey + ++mNoiseCounter * 0x9E3779B97F4A7C15ULL;
+  x = ( x ^ ( x >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+  x = ( x ^ ( x >> 27 ) ) * 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return ( x >> 11 ) * ( 1.0 / 9007199254740992.0 ) - 0.5;
+}
+
+
+void
+SignalGeneratorADC::Replay( int inSamples )
+{
+  int64_t blockEnd = mSampleCount + inSamples;
+  while( mNextEvent < mReplayEvents.size() )
+  {
+    const ReplayEvent& e = mReplayEvents[mNextEvent];
+    int64_t time = mPeriodBegin + e.time;
+    if( time >= blockEnd )
+      break;
+    e.state( static_cast<size_t>( max<int64_t>( time - mSampleCount, 0 ) ) ) = e.value;
+    if( ++mNextEvent == mReplayEvents.size() && mReplayPeriod > 0 )
+    {
+      mNextEvent = 0;
+      mPeriodBegin += mReplayPeriod;
+    }
+  }
+  mSampleCount = blockEnd;
+}
+
+
 void
 SignalGeneratorADC::Halt()
 {
@@ -2,6 +2,12 @@
 // $Id$
 // Author: schalk@wadsworth.org, juergen.mellinger@uni-tuebingen.de
 // Description: An ADC class for testing purposes.
+//   In fast mode, sine sources are computed by rotating complex phasors,
+//   mixed into channels through a sparse mixing matrix, and noise is taken
+//   from a counter-based random generator, such that large numbers of
+//   channels may be generated at high sampling rates for load testing.
+//   Optionally, state changes may be replayed from a list of events, and
+//   pipeline timing may be reported at the end of each run.
 //
 // $BEGIN_BCI2000_LICENSE$
 // 
@@ -30,6 +36,7 @@
 #include "Clock.h"
 #include "Expression.h"
 #include "RandomGenerator.h"
+#include "StopWatch.h"
 #include <vector>
 #include <valarray>
 
@@ -44,13 +51,21 @@ class SignalGeneratorADC : public GenericADC
   void Preflight( const SignalProperties&, SignalProperties& ) const;
   void Initialize( const SignalProperties&, const SignalProperties& );
   void StartRun();
+  void StopRun();
   void Process( const GenericSignal&, GenericSignal& );
   void Halt();
 
   bool IsRealTimeSource() const { return false; } // permits --EvaluateTiming=0, to launch without realtime checking
 
  private:
+  void ProcessExact( GenericSignal& );
+  void ProcessFast( GenericSignal& );
+  void Replay( int samples );
+  double NoiseValue();
+
   // Configuration
+  enum { exact = 0, fast = 1 };
+  int mMode;
   double mNoiseAmplitude,
          mDCOffset;
   Expression mOffsetMultiplier,
@@ -67,6 +82,53 @@ class SignalGeneratorADC : public GenericADC
          mSineChannelY,
          mSineChannelZ;
   bool   mModulateAmplitude;
+
+  // Fast mode
+  struct Oscillator
+  {
+    double re, im,        // current phasor
+           rotRe, rotIm,  // rotation per sample
+           amplitude;
+  };
+  std::vector<Oscillator> mOscillators;
+  struct Weight
+  {
+    int source;
+    double value;
+  };
+  std::vector< std::vector<Weight> > mSparseMixing; // non-zero entries of each channel's row
+  std::vector<double> mSourceBlock,                 // source values, sample-major
+                      mRawOffset,                   // per-channel linear map to raw values
+                      mRawGain;
+  uint64_t mNoiseKey,
+           mNoiseCounter;
+
+  // Event replay
+  struct ReplayEvent
+  {
+    int64_t time; // in samples, relative to the beginning of a run or period
+    StateHandle state;
+    long value;
+    static bool Earlier( const ReplayEvent& a, const ReplayEvent& b )
+      { return a.time < b.time; }
+  };
+  std::vector<ReplayEvent> mReplayEvents;
+  int64_t mReplayPeriod,
+          mPeriodBegin,
+          mSampleCount;
+  size_t mNextEvent;
+
+  // Load report
+  bool mReportLoad;
+  double mBlockDuration; // ms
+  StopWatch mPipelineWatch,
+            mWaitWatch,
+            mComputeWatch;
+  double mMaxPipeline,
+         mMaxCompute;
+  int mBlocks,
+      mOverruns;
+
   // Internal State
   double mAmplitudeX,
          mAmplitudeY,
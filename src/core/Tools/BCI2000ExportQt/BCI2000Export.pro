@@ -9,6 +9,7 @@ SOURCES += main.cpp \
     Converters/ASCIIConverter.cpp \
     Converters/BrainVisionConverter.cpp \
     ../../../shared/fileio/dat/BCI2000FileReader.cpp \
+    ../../../shared/fileio/dat/BCZCodec.cpp \
     ../../../shared/types/StateVectorSample.cpp \
     ../../../shared/types/StateVector.cpp \
     ../../../shared/types/StateList.cpp \
@@ -31,7 +32,8 @@ SOURCES += main.cpp \
     ../../../shared/utils/Expression/ArithmeticExpression.cpp \
     ../../../shared/utils/Expression/ExpressionParser.cpp
 HEADERS += MainWindow.h \
-    ../../../shared/fileio/dat/BCI2000FileReader.h
+    ../../../shared/fileio/dat/BCI2000FileReader.h \
+    ../../../shared/fileio/dat/BCZCodec.h
 FORMS += 
 INCLUDEPATH += \
     Converters \
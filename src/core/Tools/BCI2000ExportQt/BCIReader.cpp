@@ -123,28 +123,40 @@ BCIReader::Process( const StringList& inChannelNames,
     if( bcierr__.Flushes() )
       return;
 
+    // Read signal and states for each block in a single pass, and keep the
+    // last value of each state to detect changes.
     const StateVector& stateVector = *mInputData.StateVector();
-    StateVector        lastStateVector( stateVector );
-    StatePosMap        StateSampleBeginPos;
+    BCI2000FileReader::StateSelection stateSelection( statesToConsider.begin(), statesToConsider.end() );
+    vector<State::ValueType> lastValues,
+                             stateValues( stateSelection.size() * sampleBlockSize );
+    for( size_t i = 0; i < stateSelection.size(); ++i )
+      lastValues.push_back( stateVector.StateValue( stateSelection[ i ]->Location(), stateSelection[ i ]->Length() ) );
+    vector<GenericSignal::ValueType> signalValues( numChannels * sampleBlockSize );
+    BCI2000FileReader::SignalOptions signalOptions;
+    signalOptions.calibrated = true;
+    StatePosMap StateSampleBeginPos;
 
     for( long long block = 0; block < numBlocks; ++block )
     {
+      mInputData.ReadSamples(
+        block * sampleBlockSize, sampleBlockSize,
+        BCI2000FileReader::Matrix<GenericSignal::ValueType>( &signalValues[ 0 ], sampleBlockSize, 1 ),
+        signalOptions,
+        BCI2000FileReader::Matrix<State::ValueType>( stateValues.empty() ? NULL : &stateValues[ 0 ], sampleBlockSize, 1 ),
+        stateSelection
+      );
       for( int sample = 0; sample < sampleBlockSize; ++sample )
       {
         long long curSamplePos = block * sampleBlockSize + sample;
 
         for( unsigned long channel = 0; channel < numChannels; ++channel )
-          signal( channel, sample ) = mInputData.CalibratedValue( channel, curSamplePos );
+          signal( channel, sample ) = signalValues[ channel * sampleBlockSize + sample ];
 
-        mInputData.ReadStateVector( curSamplePos );
-        for( StateSet::iterator i = statesToConsider.begin();
-                i != statesToConsider.end(); ++i )
+        for( size_t i = 0; i < stateSelection.size(); ++i )
         {
-          const State*     pState = *i;
-          int              location = pState->Location(),
-                           length = pState->Length();
-          State::ValueType lastValue = lastStateVector.StateValue( location, length ),
-                           curValue = stateVector.StateValue( location, length );
+          const State*     pState = stateSelection[ i ];
+          State::ValueType lastValue = lastValues[ i ],
+                           curValue = stateValues[ i * sampleBlockSize + sample ];
 
           OutputStateValue( *pState, curValue, curSamplePos );
           if( bcierr__.Flushes() )
@@ -168,8 +180,8 @@ BCIReader::Process( const StringList& inChannelNames,
             if( bcierr__.Flushes() )
               return;
           }
+          lastValues[ i ] = curValue;
         }
-        lastStateVector = stateVector;
       }
       OutputSignal( signal, block * sampleBlockSize );
       if( bcierr__.Flushes() )
@@ -177,16 +189,16 @@ BCIReader::Process( const StringList& inChannelNames,
     }
 
     // If there are open state ranges, close them.
-    for( StatePosMap::iterator i = StateSampleBeginPos.begin();
-            i != StateSampleBeginPos.end(); ++i )
+    for( size_t i = 0; i < stateSelection.size(); ++i )
     {
-      const State*     pState = i->first;
-      int              location = pState->Location(),
-                       length = pState->Length();
-      State::ValueType value = stateVector.StateValue( location, length );
-      OutputStateRange( *pState, value, i->second, numBlocks * sampleBlockSize );
-      if( bcierr__.Flushes() )
-          return;
+      const State* pState = stateSelection[ i ];
+      StatePosMap::iterator j = StateSampleBeginPos.find( pState );
+      if( j != StateSampleBeginPos.end() )
+      {
+        OutputStateRange( *pState, lastValues[ i ], j->second, numBlocks * sampleBlockSize );
+        if( bcierr__.Flushes() )
+            return;
+      }
     }
     ExitOutput();
   }
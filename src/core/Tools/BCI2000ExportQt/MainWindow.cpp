@@ -260,7 +260,7 @@ void
 MainWindow::on_FileOpen()
 {
   QStringList files = QFileDialog::getOpenFileNames( this,
-    tr("Open Data Files"), QDir::currentPath(), tr("BCI2000 Data Files (*.dat)") );
+    tr("Open Data Files"), QDir::currentPath(), tr("BCI2000 Data Files (*.dat *.bcz)") );
   if( !files.empty() )
   {
     QDir::setCurrent( QFileInfo( files.first() ).canonicalPath() );
@@ -97,7 +97,7 @@ void BCI2000FileInfo::on_parmButton_clicked()
 
 void BCI2000FileInfo::on_actionOpen_triggered()
 {
-    QString filename = QFileDialog::getOpenFileName(this, tr("Open Data File"), QDir::currentPath(), tr("BCI2000 Data Files (*.dat)"));
+    QString filename = QFileDialog::getOpenFileName(this, tr("Open Data File"), QDir::currentPath(), tr("BCI2000 Data Files (*.dat *.bcz)"));
     if( !filename.isEmpty() )
     {
       QDir::setCurrent( QFileInfo( filename ).canonicalPath() );
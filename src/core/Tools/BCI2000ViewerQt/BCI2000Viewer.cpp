@@ -631,7 +631,7 @@ void BCI2000Viewer::on_signalDisplay_customContextMenuRequested( QPoint inPos )
 void BCI2000Viewer::FileOpen()
 {
   QString filename = QFileDialog::getOpenFileName( this,
-    tr("Open Data File"), QDir::currentPath(), tr("BCI2000 Data Files (*.dat)") );
+    tr("Open Data File"), QDir::currentPath(), tr("BCI2000 Data Files (*.dat *.bcz)") );
   if( !filename.isEmpty() )
   {
     QDir::setCurrent( QFileInfo( filename ).canonicalPath() );
@@ -7,7 +7,9 @@ SOURCES += main.cpp \
     BCI2000Viewer.cpp \
     ../../../shared/types/GenericSignal.cpp \
     ../../../shared/fileio/dat/BCI2000FileReader.cpp \
+    ../../../shared/fileio/dat/BCZCodec.cpp \
     ../../../shared/gui/SignalDisplay.cpp \
+    ../../../shared/gui/SignalEnvelope.cpp \
     ../../../shared/types/Color.cpp \
     ../../../shared/types/SignalType.cpp \
     ../../../shared/types/SignalProperties.cpp \
@@ -0,0 +1,114 @@
+#include "CollectResponses.h"
+#include "GetP3Responses.h"
+#include "ReusableThread.h"
+#include "Runnable.h"
+#include "Atomic.h"
+#include "ThreadUtils.h"
+#include <QElapsedTimer>
+#include <exception>
+
+namespace
+{
+struct Job
+{
+	const vector<string>* files;
+	int mode;
+	const InitialParameter* IniParam;
+	vector<FileResponses>* responses;
+	volatile int32_t next;
+};
+
+void CollectFileResponses(const Job& job, int idx)
+{
+	const InitialParameter& IniParam = *job.IniParam;
+	FileResponses& r = (*job.responses)[idx];
+	QElapsedTimer timer;
+	timer.start();
+	try
+	{
+		// Keep only the channels from the channel set in memory, and apply the
+		// common average reference while loading.
+		ap::template_1d_array<double, true> chset;
+		chset.setbounds(0, static_cast<int>(IniParam.channel_set.size())-1);
+		vector<int> channels;
+		for (size_t i=0; i<IniParam.channel_set.size(); i++)
+		{
+			chset(static_cast<int>(i)) = IniParam.channel_set[i];
+			channels.push_back(IniParam.channel_set[i]-1);
+		}
+		load_BCIdat((*job.files)[idx], job.mode, channels, IniParam.SF == 2, r.signal, r.parms, r.state);
+		r.loadTime = timer.restart()/1000.0;
+
+		r.windowlen.setbounds(0, static_cast<int>(IniParam.windlen.size())-1);
+		r.windowlen(0) = ap::round(IniParam.windlen[0]*r.parms.SamplingRate/1000);
+		r.windowlen(1) = ap::round(IniParam.windlen[1]*r.parms.SamplingRate/1000);
+		r.DF = ap::iceil((double)r.parms.SamplingRate/(IniParam.Decimation_Frequency+0.000001));
+		r.MA = r.DF;
+		// The signal is filtered and decimated before the SWLDA is applied
+		GetP3Responses(r.signal, r.state.trialnr, r.windowlen, r.state.StimulusCode,
+		               r.state.StimulusType, r.state.Flashing, chset, r.MA, r.DF);
+		r.responseTime = timer.elapsed()/1000.0;
+	}
+	catch (const exception& e)
+	{
+		r.error = e.what();
+	}
+	catch (...)
+	{
+		r.error = "Unknown error";
+	}
+}
+
+class CollectThread : public ReusableThread, private Runnable
+{
+public:
+	CollectThread(Job& job) : mJob(job) {}
+	void Start()
+	{
+		if (!ReusableThread::Run(*this))
+			OnRun();
+	}
+
+private:
+	void OnRun()
+	{
+		int idx;
+		while ((idx = Atomic(mJob.next)++) < static_cast<int>(mJob.files->size()))
+			CollectFileResponses(mJob, idx);
+	}
+	Job& mJob;
+};
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// Loads BCI2000 data files, and collects P300 responses from them. Files are
+/// processed concurrently, and data are filtered while streaming from the file,
+/// such that the full signal matrix of a file is never held in memory.
+/// Responses are returned in the order of files.
+/// @param [in] files       Paths of the BCI2000 data files.
+/// @param [in] mode        Mode as determined when validating the files.
+/// @param [in] IniParam    Initial parameters.
+/// @param [out] responses  Responses, one entry per file.
+/// @param [in] numThreads  Number of threads to use, number of processors if 0.
+
+void CollectResponses(const vector<string>& files, int mode, const InitialParameter& IniParam,
+                      vector<FileResponses>& responses, int numThreads)
+{
+	responses.clear();
+	responses.resize(files.size());
+	Job job = { &files, mode, &IniParam, &responses, 0 };
+	if (numThreads <= 0)
+		numThreads = ThreadUtils::NumberOfProcessors();
+	numThreads = min(numThreads, static_cast<int>(files.size()));
+
+	vector<CollectThread*> threads;
+	for (int i=0; i<numThreads; i++)
+		threads.push_back(new CollectThread(job));
+	for (size_t i=0; i<threads.size(); i++)
+		threads[i]->Start();
+	for (size_t i=0; i<threads.size(); i++)
+	{
+		threads[i]->Wait();
+		delete threads[i];
+	}
+}
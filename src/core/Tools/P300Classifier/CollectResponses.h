@@ -0,0 +1,40 @@
+#ifndef _CollectResponses_h
+#define _CollectResponses_h
+
+#include <string>
+#include <vector>
+#include "ap.h"
+#include "load_BCIdat.h"
+#include "ReadIniParameters.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \struct FileResponses
+/// This structure contains the P300 responses collected from a single BCI2000
+/// data file, together with the parameters used to collect them.
+struct FileResponses
+{
+	/// Filtered and decimated responses, one row per stimulus presentation.
+	ap::template_2d_array<float, true> signal;
+	/// States, one entry per stimulus presentation.
+	ste state;
+	/// Parameters read from the data file.
+	prm parms;
+	/// Response window in samples.
+	ap::template_1d_array<double, true> windowlen;
+	/// Filter order.
+	int MA;
+	/// Decimation factor.
+	int DF;
+	/// Time spent loading the data file, in seconds.
+	double loadTime;
+	/// Time spent filtering, decimating, and collecting responses, in seconds.
+	double responseTime;
+	/// Error message, empty if no error occurred.
+	string error;
+};
+
+void CollectResponses(const vector<string>& files, int mode, const InitialParameter& IniParam,
+                      vector<FileResponses>& responses, int numThreads = 0);
+#endif
@@ -11,13 +11,25 @@
 /// \date July 05, 2009
 
 void load_BCIdat(string FILE, int mode, ap::template_2d_array<float, true>& signal, prm &parms, ste &state)
+{
+  load_BCIdat(FILE, mode, vector<int>(), false, signal, parms, state);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Loads data as above, applying calibration, and optionally a common average
+/// reference, while streaming data from the file. Only the given channels are
+/// kept in memory.
+/// @param [in] channels  Zero-based indices of channels to keep, all channels if empty.
+/// @param [in] car       Subtract the average over all channels in the file from each sample.
+
+void load_BCIdat(string FILE, int mode, const vector<int>& channels, bool car,
+                 ap::template_2d_array<float, true>& signal, prm &parms, ste &state)
 {
 ///////////////////////////////////////////////////////////////////////////////
 // Section: Define variables
 int cum, cc;
 vector<int> channelsInFile;
 vector<int> samplesInFile;
-ap::template_2d_array<float, true> sig;
 vector<unsigned short int> stateCode;
 vector<unsigned short int> stateType;
 vector<unsigned short int> stateSelectedTarget;
@@ -39,45 +51,25 @@ CurrentFile->Open(FILE.c_str());
 int NumSamples = static_cast<int>( CurrentFile->NumSamples() );
 int NumChannels = CurrentFile->SignalProperties().Channels();
 
-signal.setbounds(0, NumSamples-1, 0, NumChannels-1);
-sig.setbounds(0, NumSamples-1, 0, NumChannels-1);
+vector<int> OutputChannels = channels;
+if (OutputChannels.empty())
+  for (int j=0; j<NumChannels; j++)
+    OutputChannels.push_back(j);
+int NumOutputChannels = static_cast<int>(OutputChannels.size());
+for (int k=0; k<NumOutputChannels; k++)
+  if (OutputChannels[k] < 0 || OutputChannels[k] >= NumChannels)
+  {
+    delete CurrentFile;
+    throw std_range_error("Channel " << OutputChannels[k]+1 << " does not exist in file " << FILE);
+  }
+
+signal.setbounds(0, NumSamples-1, 0, NumOutputChannels-1);
 state.StimulusCode.setbounds(0, NumSamples-1);
 state.StimulusType.setbounds(0, NumSamples-1);
 state.Flashing.setbounds(0, NumSamples-1);
 state.trialnr.setbounds(0, NumSamples-1);
 state.TargetDefinitions.clear(); // jm
 
-// Get the signal in float type //
-for (int j=0; j<NumChannels; j++)
-{
-  for (int i=0; i<NumSamples; i++)
-    sig(i,j)=static_cast<float>(CurrentFile->RawValue(j,i));
-}
-
-//Get some states
-const StateVector* stateVector = CurrentFile->StateVector();
-for (int i=0; i<NumSamples; i++)
-{
-  CurrentFile->ReadStateVector(i);
-  if (CurrentFile->States()->Exists("StimulusCode"))
-    stateCode.push_back(static_cast<unsigned short>(stateVector->StateValue("StimulusCode")));
-
-  if (CurrentFile->States()->Exists("StimulusType"))
-    stateType.push_back(static_cast<unsigned short>(stateVector->StateValue("StimulusType")));
-
-  if (CurrentFile->States()->Exists("PhaseInSequence"))
-    statePhaseInSequence.push_back(static_cast<short>(stateVector->StateValue("PhaseInSequence")));
-
-  if (CurrentFile->States()->Exists("StimulusBegin"))
-    stateStimulusBegin.push_back(static_cast<unsigned char>(stateVector->StateValue("StimulusBegin")));
-
-  if (CurrentFile->States()->Exists("SelectedTarget"))
-    stateSelectedTarget.push_back(static_cast<unsigned short>(stateVector->StateValue("SelectedTarget")));
-
-  if (CurrentFile->States()->Exists("SelectedStimulus"))
-    stateSelectedStimulus.push_back(static_cast<unsigned short>(stateVector->StateValue("SelectedStimulus")));
-}
-
 // Get the channel gains
 if (CurrentFile->Parameters()->Exists("SourceChGain"))
 {
@@ -96,11 +88,68 @@ if (CurrentFile->Parameters()->Exists("SourceChOffSet"))
     SourceChOffSet(i) = (float)CurrentFile->Parameter("SourceChOffSet")(i);
 }
 
-// Calibrate the signal
-for (int j=0; j<NumChannels; j++)
+// Get the calibrated signal in float type, and some states, in a single pass over the file //
+enum { StimulusCodeRow, StimulusTypeRow, PhaseInSequenceRow, StimulusBeginRow, SelectedTargetRow, SelectedStimulusRow, NumStates };
+const char* stateNames[NumStates] =
+{ "StimulusCode", "StimulusType", "PhaseInSequence", "StimulusBegin", "SelectedTarget", "SelectedStimulus" };
+BCI2000FileReader::StateSelection states;
+int stateRows[NumStates];
+for (int k=0; k<NumStates; k++)
+{
+  stateRows[k] = -1;
+  if (CurrentFile->States()->Exists(stateNames[k]))
+  {
+    stateRows[k] = static_cast<int>(states.size());
+    states.push_back(&(*CurrentFile->States())[stateNames[k]]);
+  }
+}
+
+const int BlockSize = 8192;
+vector<float> signalValues(NumChannels*BlockSize);
+vector<State::ValueType> stateValues(states.size()*BlockSize);
+for (int begin=0; begin<NumSamples; begin+=BlockSize)
 {
-  for (int i=0; i<NumSamples; i++)
-    signal(i,j) = (sig(i,j) - SourceChOffSet(j))*SourceChGain(j);
+  int count = min(BlockSize, NumSamples-begin);
+  CurrentFile->ReadSamples(begin, count,
+    BCI2000FileReader::Matrix<float>(&signalValues[0], 1, NumChannels),
+    BCI2000FileReader::SignalOptions(),
+    BCI2000FileReader::Matrix<State::ValueType>(states.empty() ? NULL : &stateValues[0], BlockSize, 1),
+    states);
+  for (int i=0; i<count; i++)
+  {
+    float* sample = &signalValues[i*NumChannels];
+    for (int j=0; j<NumChannels; j++)
+      sample[j] = (sample[j] - SourceChOffSet(j))*SourceChGain(j);
+    if (car)
+    { // Same order of operations as CARfilter()
+      float val = 0;
+      for (int j=0; j<NumChannels; j++)
+        val += sample[j];
+      val *= ((float)1)/NumChannels;
+      for (int j=0; j<NumChannels; j++)
+        sample[j] -= val;
+    }
+    for (int k=0; k<NumOutputChannels; k++)
+      signal(begin+i,k) = sample[OutputChannels[k]];
+
+    if (stateRows[StimulusCodeRow] >= 0)
+      stateCode.push_back(static_cast<unsigned short>(stateValues[stateRows[StimulusCodeRow]*BlockSize+i]));
+
+    if (stateRows[StimulusTypeRow] >= 0)
+      stateType.push_back(static_cast<unsigned short>(stateValues[stateRows[StimulusTypeRow]*BlockSize+i]));
+
+    if (stateRows[PhaseInSequenceRow] >= 0)
+      statePhaseInSequence.push_back(static_cast<short>(stateValues[stateRows[PhaseInSequenceRow]*BlockSize+i]));
+
+    if (stateRows[StimulusBeginRow] >= 0)
+      stateStimulusBegin.push_back(static_cast<unsigned char>(stateValues[stateRows[StimulusBeginRow]*BlockSize+i]));
+
+    if (stateRows[SelectedTargetRow] >= 0)
+      stateSelectedTarget.push_back(static_cast<unsigned short>(stateValues[stateRows[SelectedTargetRow]*BlockSize+i]));
+
+    if (stateRows[SelectedStimulusRow] >= 0)
+      stateSelectedStimulus.push_back(static_cast<unsigned short>(stateValues[stateRows[SelectedStimulusRow]*BlockSize+i]));
+  }
 }
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -48,4 +48,6 @@ struct ste
 };
 
 void load_BCIdat(string FILE, int mode, ap::template_2d_array<float, true>& sig, prm &parms, ste &state);
+void load_BCIdat(string FILE, int mode, const vector<int>& channels, bool car,
+                 ap::template_2d_array<float, true>& sig, prm &parms, ste &state);
 #endif
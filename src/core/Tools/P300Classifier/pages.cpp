@@ -4,6 +4,9 @@
 #include <QtCore/QTextStream>
 #include <set>
 #include "FileUtils.h"
+#include "ProcessUtils.h"
+#include "CollectResponses.h"
+#include <QElapsedTimer>
 
 GenerateFeatureWeightsThread *g_pGenerateFeatureWeightsThread = NULL;
 DataPage *g_pDataPage = NULL;
@@ -65,6 +68,27 @@ PrintClassificationResults( ostream& oss, const vector<string>& predicted, const
 
 // end jm
 
+// Reports wall clock time per processing stage, and peak memory usage.
+// Load and response times are summed over files, which are processed concurrently.
+static ostream& PrintStageTimings( ostream& oss, int numFiles, double collectTime, double loadTime,
+                                   double responseTime, double swldaTime, double scoreTime )
+{
+  std::ios_base::fmtflags savedFlags = oss.flags();
+  oss.precision(3);
+  oss.setf(ios::fixed, ios::floatfield);
+  oss << "Stage timings [s]:\n"
+      << "  Loading and collecting responses from " << numFiles << " file(s): " << collectTime << "\n"
+      << "    Loading, summed over files: " << loadTime << "\n"
+      << "    Filtering and decimating, summed over files: " << responseTime << "\n";
+  if( swldaTime >= 0 )
+    oss << "  Stepwise linear discriminant analysis: " << swldaTime << "\n";
+  oss << "  Scoring and classification: " << scoreTime << "\n";
+  oss.precision(1);
+  oss << "Peak memory usage [MB]: " << ProcessUtils::PeakMemoryUsage()/1048576.0 << "\n\n";
+  oss.flags( savedFlags );
+  return oss;
+}
+
 void callback_status(string message)
 {
   if (g_pGenerateFeatureWeightsThread)
@@ -1771,14 +1795,13 @@ void DataPage::ApplyFeatures()
 
 void GenerateFeatureWeightsThread::run()
 {
-  ap::template_2d_array<float, true> signal;
   ap::template_2d_array<float,true> signal_tmp;
   ap::template_2d_array<float,true> signal_all_files;
   ap::template_1d_array<double,true> windowlen;
   ap::template_1d_array<double,true> chset;
   ap::real_2d_array pscore;
   double NumberOfChoices;
-  int row_signal, row_chset,
+  int row_chset,
     files, DF, MA, numSequences = 1e6, maxValue = 0,
     Target, nonTarget;
   vector<string> file;
@@ -1796,8 +1819,8 @@ void GenerateFeatureWeightsThread::run()
 
   ostringstream oss;
 
-  clock_t Clock0;
-  Clock0 = clock(); // start timer
+  QElapsedTimer elapsedTimer;
+  elapsedTimer.start();
 
   windowlen.setbounds(0, static_cast<int>(g_pDataPage->IniParam.windlen.size())-1);
 
@@ -1826,48 +1849,42 @@ void GenerateFeatureWeightsThread::run()
   }
 
   int TotalFiles = static_cast<int>(g_pDataPage->fPathArr_TrainingData.size());
+  oss << "Loading files, collecting responses, filtering and decimating" << "...\n";
+  emit signalProgressText(oss.str().c_str());
+  oss.str("");
+  // Load signal, parameters, and states from the BCI2000 data files, and collect
+  // responses from all files concurrently
+  QElapsedTimer stageTimer;
+  stageTimer.start();
+  vector<FileResponses> responses;
+  CollectResponses(g_pDataPage->fPathArr_TrainingData, g_pDataPage->mode_TrainingData, g_pDataPage->IniParam, responses);
+  double collectTime = stageTimer.restart()/1000.0,
+         loadTime = 0,
+         responseTime = 0;
   for (files=0; files<TotalFiles; files++)
   {
-    oss << "Loading file " << "[" << files+1 << "/" << TotalFiles << "]" << "...";
-    emit signalProgressText(oss.str().c_str());
-    oss.str("");
-    // Load signal, parameters, and states from the BCI2000 data file
-    load_BCIdat(g_pDataPage->fPathArr_TrainingData[files], g_pDataPage->mode_TrainingData, signal, parms, state_tmp);
-    emit signalProgressBar(files+1, TotalFiles, 1);
+    FileResponses& r = responses[files];
+    if (!r.error.empty())
+    {
+      oss << "Could not process " << g_pDataPage->fPathArr_TrainingData[files] << ": " << r.error << endl;
+      emit errorMessage(oss.str().c_str());
+      g_pDataPage->IfGenerateFeatureWeightsThread = false;
+      return;
+    }
+    loadTime += r.loadTime;
+    responseTime += r.responseTime;
+    signal_tmp = r.signal;
+    state_tmp = r.state;
+    parms = r.parms;
+    windowlen = r.windowlen;
+    DF = r.DF;
+    MA = r.MA;
+    emit signalProgressBar(files+1, TotalFiles, 2);
 
     // Take the minimum number of sequences that a file has
     if (parms.NumberOfSequences < numSequences)
       numSequences = parms.NumberOfSequences;
 
-    // Check if the channel set given in the initial parameter is a subset of
-    // the channels recorded in the BCI2000 data file
-
-    windowlen(0) = ap::round(g_pDataPage->IniParam.windlen[0]*parms.SamplingRate/1000);
-    windowlen(1) = ap::round(g_pDataPage->IniParam.windlen[1]*parms.SamplingRate/1000);
-    DF = ap::iceil((double)parms.SamplingRate/(g_pDataPage->IniParam.Decimation_Frequency+0.000001));
-    MA = DF;
-
-    if (g_pDataPage->IniParam.SF == 2)
-    // Apply common average reference to the channels
-      CARfilter(signal);
-
-    row_signal = signal.gethighbound(1)+1;
-
-    // Extract from signal only the channels specified in the initial parameter channel set
-    signal_tmp.setbounds(0, row_signal-1, 0, row_chset-1);
-    for (int i=0; i<row_chset; i++)
-      ap::vmove(signal_tmp.getcolumn(i, 0, row_signal-1), signal.getcolumn(chset(i)-1, 0, row_signal-1));
-
-    oss << "Collecting Responses from file " << "[" << files+1 << "/" << TotalFiles << "]" << "...\n";
-    oss << "Filtering and Decimating file " << "[" << files+1 << "/" << TotalFiles << "]" << "...\n";
-    emit signalProgressText(oss.str().c_str());
-    oss.str("");
-
-    // The signal is filtered and decimated before the SWLDA is applied */
-    GetP3Responses(signal_tmp, state_tmp.trialnr, windowlen, state_tmp.StimulusCode,
-             state_tmp.StimulusType, state_tmp.Flashing, chset, MA, DF);
-    emit signalProgressBar(files+1, TotalFiles, 2);
-
     // Concatenate signal and states
     // Cristhian modification, Sep 11, 2009
     //if (files == 0)
@@ -1931,6 +1948,7 @@ void GenerateFeatureWeightsThread::run()
   }
 
   // Perform the Stepwise Linear Discriminant Analysis
+  stageTimer.restart();
   if (! SWLDA(signal_all_files, state.StimulusType, state.trialnr, windowlen, chset, MA, DF, g_pDataPage->IniParam.SF,
       parms.SamplingRate, g_pDataPage->IniParam.penter, g_pDataPage->IniParam.premove, g_pDataPage->IniParam.maxiter,
       parms.SoftwareCh, g_pDataPage->tMUD, &callback_status))
@@ -1941,6 +1959,7 @@ void GenerateFeatureWeightsThread::run()
     return;
   }
   emit signalProgressBar(1, 5, 3);
+  double swldaTime = stageTimer.restart()/1000.0;
 
   // jm Oct 24, 2012
   ap::template_1d_array<unsigned short int, true> stimCode_GetScore = state.StimulusCode;
@@ -1983,8 +2002,14 @@ void GenerateFeatureWeightsThread::run()
 
     PrintClassificationResults( oss, predicted, vresult );
   }
+  double scoreTime = stageTimer.elapsed()/1000.0;
   oss << "Done!\n\n";
-  oss << "Time elapsed [s]: " << ((clock()-Clock0)/(float) CLOCKS_PER_SEC) << endl << endl;
+  oss << "Time elapsed [s]: " << elapsedTimer.elapsed()/1000.0 << endl << endl;
+  ostringstream timings;
+  PrintStageTimings( timings, TotalFiles, collectTime, loadTime, responseTime, swldaTime, scoreTime );
+  oss << timings.str();
+  if( g_pDataPage->mAutoWrite )
+    cout << timings.str() << flush;
 
   QTextCodec* codec = QTextCodec::codecForLocale();
   // Cristhian Modification, May 04, 2010
@@ -2061,14 +2086,13 @@ void DataPage::slotErrorMessageDialog(QString errorMessage)
 
 void ApplyFeatureWeightsThread::run()
 {
-  ap::template_2d_array<float, true> signal;
   ap::template_2d_array<float,true> signal_tmp;
   ap::template_2d_array<float,true> signal_all_files;
   ap::template_1d_array<double,true> windowlen;
   ap::template_1d_array<double,true> chset;
   ap::real_2d_array pscore;
   double NumberOfChoices;
-  int row_signal, row_chset,
+  int row_chset,
     files, DF, MA, numSequences = 1e6, maxValue = 0,
     Target, nonTarget;
   vector<string> file;
@@ -2086,8 +2110,8 @@ void ApplyFeatureWeightsThread::run()
 
   ostringstream oss;
 
-  clock_t Clock0;
-  Clock0 = clock(); // start timer
+  QElapsedTimer elapsedTimer;
+  elapsedTimer.start();
 
   windowlen.setbounds(0, static_cast<int>(g_pDataPage->IniParam.windlen.size())-1);
   chset.setbounds(0, static_cast<int>(g_pDataPage->IniParam.channel_set.size())-1);
@@ -2114,48 +2138,41 @@ void ApplyFeatureWeightsThread::run()
   }
 
   int TotalFiles = static_cast<int>(g_pDataPage->fPathArr_TestingData.size());
+  oss << "Loading files, collecting responses, filtering and decimating" << "...\n";
+  emit signalProgressText(oss.str().c_str());
+  oss.str("");
+  // Load signal, parameters, and states from the BCI2000 data files, and collect
+  // responses from all files concurrently
+  QElapsedTimer stageTimer;
+  stageTimer.start();
+  vector<FileResponses> responses;
+  CollectResponses(g_pDataPage->fPathArr_TestingData, g_pDataPage->mode_TestingData, g_pDataPage->IniParam, responses);
+  double collectTime = stageTimer.restart()/1000.0,
+         loadTime = 0,
+         responseTime = 0;
   for (files=0; files<TotalFiles; files++)
   {
-    oss << "Loading file " << "[" << files+1 << "/" << TotalFiles << "]" << "...";
-    emit signalProgressText(oss.str().c_str());
-    oss.str("");
-    // Load signal, parameters, and states from the BCI2000 data file
-    load_BCIdat(g_pDataPage->fPathArr_TestingData[files], g_pDataPage->mode_TestingData, signal, parms, state_tmp);
-    emit signalProgressBar(files+1, TotalFiles, 1);
+    FileResponses& r = responses[files];
+    if (!r.error.empty())
+    {
+      oss << "Could not process " << g_pDataPage->fPathArr_TestingData[files] << ": " << r.error << endl;
+      emit signalProgressText(oss.str().c_str());
+      return;
+    }
+    loadTime += r.loadTime;
+    responseTime += r.responseTime;
+    signal_tmp = r.signal;
+    state_tmp = r.state;
+    parms = r.parms;
+    windowlen = r.windowlen;
+    DF = r.DF;
+    MA = r.MA;
+    emit signalProgressBar(files+1, TotalFiles, 2);
 
     // Take the minimum number of sequences that a file has
     if (parms.NumberOfSequences < numSequences)
       numSequences = parms.NumberOfSequences;
 
-    // Check if the channel set given in the initial parameter is a subset of
-    // the channels recorded in the BCI2000 data file
-
-    windowlen(0) = ap::round(g_pDataPage->IniParam.windlen[0]*parms.SamplingRate/1000);
-    windowlen(1) = ap::round(g_pDataPage->IniParam.windlen[1]*parms.SamplingRate/1000);
-    DF = ap::iceil((double)parms.SamplingRate/(g_pDataPage->IniParam.Decimation_Frequency+0.000001));
-    MA = DF;
-
-    if (g_pDataPage->IniParam.SF == 2)
-    // Apply common average reference to the channels
-      CARfilter(signal);
-
-    row_signal = signal.gethighbound(1)+1;
-
-    // Extract from signal only the channels specified in the initial parameter channel set
-    signal_tmp.setbounds(0, row_signal-1, 0, row_chset-1);
-    for (int i=0; i<row_chset; i++)
-      ap::vmove(signal_tmp.getcolumn(i, 0, row_signal-1), signal.getcolumn(chset(i)-1, 0, row_signal-1));
-
-    oss << "Collecting Responses from file " << "[" << files+1 << "/" << TotalFiles << "]" << "...\n";
-    oss << "Filtering and Decimating file " << "[" << files+1 << "/" << TotalFiles << "]" << "...\n";
-    emit signalProgressText(oss.str().c_str());
-    oss.str("");
-
-    // The signal is filtered and decimated before the SWLDA is applied */
-    GetP3Responses(signal_tmp, state_tmp.trialnr, windowlen, state_tmp.StimulusCode,
-             state_tmp.StimulusType, state_tmp.Flashing, chset, MA, DF);
-    emit signalProgressBar(files+1, TotalFiles, 2);
-
     // Concatenate signal and states
     // Cristhian modification, Sep 11, 2009
 
@@ -2209,6 +2226,7 @@ void ApplyFeatureWeightsThread::run()
   oss.str("");
 
   // jm Oct 24, 2012
+  stageTimer.restart();
   ap::template_1d_array<unsigned short int, true> stimCode_GetScore = state.StimulusCode;
   NumberOfChoices = FixupStimulusCodes( stimCode_GetScore );
 
@@ -2241,8 +2259,10 @@ void ApplyFeatureWeightsThread::run()
     numSequences = 1e6;
     PrintClassificationResults( oss, predicted, vresult );
   }
+  double scoreTime = stageTimer.elapsed()/1000.0;
   oss << "Done!\n\n";
-  oss << "Time elapsed [s]: " << ((clock()-Clock0)/(float) CLOCKS_PER_SEC) << endl << endl;
+  oss << "Time elapsed [s]: " << elapsedTimer.elapsed()/1000.0 << endl << endl;
+  PrintStageTimings( oss, TotalFiles, collectTime, loadTime, responseTime, -1, scoreTime );
 
   QTextCodec* codec = QTextCodec::codecForLocale();
   // Cristhian Modification, May 04, 2010
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: Batched stream framing for the command line tools.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////
+#include "BlockBatch.h"
+#include "StateList.h"
+#include "BCIAssert.h"
+#include <algorithm>
+
+using namespace std;
+
+BlockBatch::BlockBatch( int inCapacity )
+: mCapacity( max( inCapacity, 1 ) ),
+  mBlocks( 0 ),
+  mBlockElements( 0 ),
+  mBlockSamples( 0 ),
+  mHaveStates( false )
+{
+}
+
+BlockBatch&
+BlockBatch::Add( const GenericSignal& inSignal, const StateVector* inpStates )
+{
+  bciassert( !Full() );
+  if( mBlocks == 0 )
+  {
+    mHaveStates = ( inpStates != 0 );
+    mBlockElements = inSignal.Elements();
+    SignalProperties properties( inSignal.Properties() );
+    properties.SetElements( mCapacity * mBlockElements );
+    mSignal.SetProperties( properties );
+    if( mHaveStates )
+    {
+      mBlockSamples = inpStates->Samples();
+      if( mStates.Samples() != mCapacity * mBlockSamples
+          || mStates.Length() != inpStates->Length()
+          || &mStates.StateList() != &inpStates->StateList() )
+        // The statevector constructor takes a non-const list reference but
+        // does not modify the list.
+        mStates = StateVector( const_cast<StateList&>( inpStates->StateList() ), mCapacity * mBlockSamples );
+    }
+  }
+  bciassert( mHaveStates == ( inpStates != 0 ) );
+  bciassert( inSignal.Channels() == mSignal.Channels() && inSignal.Elements() == mBlockElements );
+  int offset = mBlocks * mBlockElements;
+  for( int ch = 0; ch < inSignal.Channels(); ++ch )
+    for( int el = 0; el < mBlockElements; ++el )
+      mSignal( ch, offset + el ) = inSignal( ch, el );
+  if( inpStates )
+  {
+    bciassert( inpStates->Samples() == mBlockSamples );
+    offset = mBlocks * mBlockSamples;
+    for( int sample = 0; sample < mBlockSamples; ++sample )
+      mStates( offset + sample ) = ( *inpStates )( sample );
+  }
+  ++mBlocks;
+  return *this;
+}
+
+bool
+BlockBatch::Send( MessageChannel& inChannel )
+{
+  bool result = true;
+  if( mBlocks == mCapacity )
+  {
+    if( mHaveStates )
+      result = inChannel.Send( mStates );
+    result = result && inChannel.Send( mSignal );
+  }
+  else if( mBlocks > 0 )
+  { // A partial batch, or a single block from a batch that was cut short.
+    if( mHaveStates )
+    {
+      StateVector states( const_cast<StateList&>( mStates.StateList() ), mBlocks * mBlockSamples );
+      for( int sample = 0; sample < states.Samples(); ++sample )
+        states( sample ) = mStates( sample );
+      result = inChannel.Send( states );
+    }
+    SignalProperties properties( mSignal.Properties() );
+    properties.SetElements( mBlocks * mBlockElements );
+    GenericSignal signal( properties );
+    for( int ch = 0; ch < signal.Channels(); ++ch )
+      for( int el = 0; el < signal.Elements(); ++el )
+        signal( ch, el ) = mSignal( ch, el );
+    result = result && inChannel.Send( signal );
+  }
+  mBlocks = 0;
+  return result;
+}
+
+bool
+BlockBatch::Announce( MessageChannel& inChannel )
+{
+  return inChannel.Send( ProtocolVersion::Current() );
+}
+
+int
+BlockBatch::Count( const GenericSignal& inSignal, const SignalProperties& inBlock, bool inAnnounced )
+{
+  if( !inAnnounced )
+    return inSignal.Properties() == inBlock ? 1 : 0;
+  if( inBlock.Elements() < 1
+      || inSignal.Channels() != inBlock.Channels()
+      || inSignal.Type() != inBlock.Type()
+      || inSignal.Elements() % inBlock.Elements() )
+    return 0;
+  return inSignal.Elements() / inBlock.Elements();
+}
+
+void
+BlockBatch::GetBlock( const GenericSignal& inBatch, int inBlock, GenericSignal& outSignal )
+{
+  int elements = outSignal.Elements(),
+      offset = inBlock * elements;
+  bciassert( inBatch.Channels() == outSignal.Channels() );
+  bciassert( offset + elements <= inBatch.Elements() );
+  for( int ch = 0; ch < outSignal.Channels(); ++ch )
+    for( int el = 0; el < elements; ++el )
+      outSignal( ch, el ) = inBatch( ch, offset + el );
+}
+
+void
+BlockBatch::GetBlock( const StateVector& inBatch, int inBlock, StateVector& outStates )
+{
+  int samples = outStates.Samples(),
+      offset = inBlock * samples;
+  bciassert( offset + samples <= inBatch.Samples() );
+  for( int sample = 0; sample < samples; ++sample )
+    outStates( sample ) = inBatch( offset + sample );
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: Batched stream framing for the command line tools.
+//   A batch of data blocks is transmitted as a single StateVector
+//   message holding the states of all blocks' samples, followed by
+//   a single VisSignal message holding the blocks' signals side by
+//   side along the element dimension.
+//   Receivers recognize a batch from its number of elements, which
+//   is a multiple of the number of elements announced in the most
+//   recent VisSignalProperties message.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////
+#ifndef BLOCK_BATCH_H
+#define BLOCK_BATCH_H
+
+#include "GenericSignal.h"
+#include "StateVector.h"
+#include "MessageChannel.h"
+
+class BlockBatch
+{
+ public:
+  explicit BlockBatch( int capacity = 1 );
+
+  int Capacity() const
+    { return mCapacity; }
+  int Blocks() const
+    { return mBlocks; }
+  bool Full() const
+    { return mBlocks >= Capacity(); }
+  bool Empty() const
+    { return mBlocks == 0; }
+
+  // Adds a block to the batch. When no statevector is given, only signals
+  // are transmitted.
+  BlockBatch& Add( const GenericSignal&, const StateVector* = 0 );
+  // Sends all blocks in the batch, and clears the batch.
+  // A batch holding a single block is sent as an ordinary block.
+  bool Send( MessageChannel& );
+
+  // A stream may only contain batches when this has been announced by a
+  // ProtocolVersion message that provides ProtocolVersion::BlockBatches,
+  // sent before any signal.
+  static bool Announce( MessageChannel& );
+  static bool Announced( const ProtocolVersion& p )
+    { return p.Provides( ProtocolVersion::BlockBatches ); }
+  // Returns the number of blocks contained in a signal, given the
+  // properties of a single block, or zero if the signal is not composed of
+  // such blocks. Unless batches have been announced, a signal always
+  // contains a single block.
+  static int Count( const GenericSignal&, const SignalProperties&, bool announced );
+  // Copies a block out of a batch. The output signal must have the
+  // properties of a single block.
+  static void GetBlock( const GenericSignal& batch, int block, GenericSignal& );
+  // Copies the states of a block out of a batch's statevector. The output
+  // statevector must have the number of samples in a single block.
+  static void GetBlock( const StateVector& batch, int block, StateVector& );
+
+ private:
+  // Blocks are copied into a signal and statevector that are sized for a
+  // full batch, and kept across batches.
+  int mCapacity,
+      mBlocks,
+      mBlockElements,
+      mBlockSamples;
+  bool mHaveStates;
+  GenericSignal mSignal;
+  StateVector mStates;
+};
+
+#endif // BLOCK_BATCH_H
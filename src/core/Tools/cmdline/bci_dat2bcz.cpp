@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////
+// $Id$
+// Author:  agent@local
+// Description: See the ToolInfo definition below.
+//
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////
+#include "bci_tool.h"
+#include "SignalType.h"
+#include "BCZCodec.h"
+#include "BCIException.h"
+#include "RedirectIO.h"
+#include "Version.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+string ToolInfo[] =
+{
+  "bci_dat2bcz",
+  PROJECT_VERSION_DEF,
+  "Compress a BCI2000 data file.",
+  "Reads a BCI2000 data file (*.dat) from standard input, "
+    "and writes it to standard output as a losslessly compressed "
+    "BCI2000 data file (*.bcz).",
+  "binary",
+  "-c<n>,    --chunk=<n>           Encode chunks of <n> samples",
+  "-r,       --report              Verify the output, and report compression",
+  "                                ratio and throughput on standard error",
+  ""
+};
+
+ToolResult ToolInit()
+{
+  return noError;
+}
+
+ToolResult ToolMain( OptionSet& options, istream& in, ostream& out )
+{
+  int chunkSamples = ::atoi( options.getopt( "-c|-C|--chunk", "0" ).c_str() );
+  if( chunkSamples < 1 )
+    chunkSamples = BCZCodec::DefaultChunkSamples;
+  bool report = options.findopt( "-r|-R|--report" );
+
+  // Read the header's first line, and the remainder of the header.
+  string line;
+  if( !getline( in, line, '\n' ) )
+  {
+    cerr << "Illegal header format or content" << endl;
+    return illegalInput;
+  }
+  istringstream linestream( line );
+  map<string, string> fields;
+  string name, value;
+  while( linestream >> name >> value )
+    fields[ name ] = value;
+  int headerLength = ::atoi( fields[ "HeaderLen=" ].c_str() ),
+      sourceCh = ::atoi( fields[ "SourceCh=" ].c_str() ),
+      statevectorLength = ::atoi( fields[ "StatevectorLen=" ].c_str() );
+  SignalType dataFormat = SignalType::int16;
+  istringstream dataFormatField( fields[ "DataFormat=" ] );
+  if( !fields[ "Compression=" ].empty()
+      || ( !dataFormatField.str().empty() && !( dataFormatField >> dataFormat ) )
+      || headerLength <= static_cast<int>( line.length() ) + 1 || sourceCh < 1 || statevectorLength < 1 )
+  {
+    cerr << "Illegal header format or content" << endl;
+    return illegalInput;
+  }
+  vector<char> headerRest( headerLength - line.length() - 1 );
+  if( !in.read( &headerRest[ 0 ], headerRest.size() ) )
+  {
+    cerr << "Unexpected end of input" << endl;
+    return illegalInput;
+  }
+  switch( dataFormat )
+  {
+    case SignalType::int16:
+    case SignalType::int32:
+    case SignalType::float32:
+      break;
+    default:
+      cerr << dataFormat.Name() << " data type unsupported for compression" << endl;
+      return illegalInput;
+  }
+
+  // Write a header with a Compression field, and an adapted HeaderLen field.
+  ostringstream fieldsAfterLength;
+  fieldsAfterLength << " SourceCh= " << sourceCh
+                    << " StatevectorLen= " << statevectorLength
+                    << " Compression= " << BCZCodec::Name()
+                    << " DataFormat= " << dataFormat.Name()
+                    << "\r\n";
+  const string headerBegin = "BCI2000V= 1.1 HeaderLen= ";
+  size_t newHeaderLength = headerBegin.length() + fieldsAfterLength.str().length() + headerRest.size(),
+         prevHeaderLength = 0;
+  while( newHeaderLength != prevHeaderLength )
+  { // The header length includes the length of its own decimal representation.
+    ostringstream oss;
+    oss << newHeaderLength;
+    prevHeaderLength = newHeaderLength;
+    newHeaderLength = headerBegin.length() + oss.str().length()
+                      + fieldsAfterLength.str().length() + headerRest.size();
+  }
+  out << headerBegin << newHeaderLength << fieldsAfterLength.str();
+  out.write( &headerRest[ 0 ], headerRest.size() );
+
+  // Encode records.
+  const int recordSize = sourceCh * dataFormat.Size() + statevectorLength;
+  vector<char> records( static_cast<size_t>( chunkSamples ) * recordSize ),
+               decoded( records.size() );
+  BCZCodec::Encoder encoder;
+  encoder.Initialize( dataFormat, sourceCh, statevectorLength );
+  BCZCodec::ChunkTable chunks;
+  long long offset = newHeaderLength,
+            inputBytes = 0;
+  clock_t encodingTime = 0,
+          decodingTime = 0;
+  bool verified = true;
+  while( in )
+  {
+    in.read( &records[ 0 ], records.size() );
+    int count = static_cast<int>( in.gcount() / recordSize );
+    if( count < 1 )
+      break;
+    clock_t start = ::clock();
+    ostringstream chunk;
+    encoder.Add( &records[ 0 ], count ).Encode( chunk );
+    encodingTime += ::clock() - start;
+    const string& data = chunk.str();
+    out.write( data.data(), data.size() );
+
+    BCZCodec::Chunk entry;
+    entry.firstSample = chunks.empty() ? 0 : chunks.back().firstSample + chunks.back().samples;
+    entry.offset = offset;
+    entry.samples = count;
+    chunks.push_back( entry );
+    offset += data.size();
+    inputBytes += static_cast<long long>( count ) * recordSize;
+
+    if( report )
+    {
+      start = ::clock();
+      BCZCodec::DecodeChunk( data.data() + BCZCodec::ChunkHeaderSize, data.size() - BCZCodec::ChunkHeaderSize,
+                             count, dataFormat, sourceCh, statevectorLength, &decoded[ 0 ] );
+      decodingTime += ::clock() - start;
+      verified = verified && equal( decoded.begin(), decoded.begin() + count * recordSize, records.begin() );
+    }
+  }
+  if( in.gcount() % recordSize )
+    cerr << "Non-integer number of records in input" << endl;
+  BCZCodec::WriteIndex( out, chunks, offset );
+
+  if( report )
+  {
+    long long outputBytes = offset + BCZCodec::IndexHeaderSize
+                            + chunks.size() * BCZCodec::IndexEntrySize + BCZCodec::TrailerSize;
+    inputBytes += headerLength;
+    double mb = ( inputBytes - headerLength ) / 1e6;
+    Tiny::Cerr() << "Samples: " << ( chunks.empty() ? 0 : chunks.back().firstSample + chunks.back().samples )
+         << ", input: " << inputBytes << " bytes"
+         << ", output: " << outputBytes << " bytes"
+         << ", ratio: " << static_cast<double>( inputBytes ) / outputBytes << "\n"
+         << "Encoding: " << mb / max( 1e-9, static_cast<double>( encodingTime ) / CLOCKS_PER_SEC ) << " MB/s"
+         << ", decoding: " << mb / max( 1e-9, static_cast<double>( decodingTime ) / CLOCKS_PER_SEC ) << " MB/s"
+         << " (single thread)\n"
+         << "Verification " << ( verified ? "passed" : "FAILED" ) << endl;
+  }
+  return verified ? noError : genericError;
+}
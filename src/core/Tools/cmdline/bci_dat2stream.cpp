@@ -32,6 +32,9 @@
 #include "StateVector.h"
 #include "GenericSignal.h"
 #include "MessageChannel.h"
+#include "BlockBatch.h"
+#include "BCZCodec.h"
+#include "BCIException.h"
 #include "Version.h"
 #include <iostream>
 #include <fstream>
@@ -39,6 +42,7 @@
 #include <sstream>
 #include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cassert>
 
 using namespace std;
@@ -48,7 +52,7 @@ string ToolInfo[] =
   "bci_dat2stream",
   PROJECT_VERSION_DEF,
   "Convert a BCI2000 data file into a BCI2000 stream.",
-  "Reads a BCI2000 data file (*.dat) compliant stream from "
+  "Reads a BCI2000 data file (*.dat or *.bcz) compliant stream from "
     "standard input and writes it to the standard output as a BCI2000 "
     "compliant binary stream.",
   "binary",
@@ -58,6 +62,7 @@ string ToolInfo[] =
   "-p<file>, --parameters=<file>   Incorporate parameters from named file",
   "-s<time>, --start=<time>        Start at a given offset within the file",
   "-d<time>, --duration=<time>     Transmit only a limited amount of signal",
+  "          --batch=<n>           Transmit data in batches of <n> blocks",
   " ",
   "Amounts of <time> are expressed in SampleBlocks or (if the unit is",
   "explicitly appended) as a number of seconds or milliseconds that",
@@ -70,6 +75,40 @@ ToolResult ToolInit()
   return noError;
 }
 
+// Reads and decodes the next chunk of a compressed data file, and makes its
+// records available from the given string stream.
+// Returns false at the end of the sequence of chunks, or on error.
+static bool
+ReadChunk( istream& in, istringstream& outRecords, SignalType inType,
+           int inChannels, int inStatevectorLength, bool& outError )
+{
+  char header[ BCZCodec::ChunkHeaderSize ];
+  int samples = 0;
+  uint32_t payloadSize = 0;
+  // The seek index, or the end of input, follows the last chunk.
+  if( !in.read( header, sizeof( header ) ) || !BCZCodec::ParseChunkHeader( header, samples, payloadSize ) )
+    return false;
+  vector<char> payload( payloadSize + 1 );
+  string records( static_cast<size_t>( samples ) * ( inChannels * inType.Size() + inStatevectorLength ), '\0' );
+  try
+  {
+    if( !in.read( &payload[ 0 ], payloadSize ) )
+      throw std_runtime_error( "Unexpected end of compressed data" );
+    if( samples > 0 )
+      BCZCodec::DecodeChunk( &payload[ 0 ], payloadSize, samples, inType,
+                             inChannels, inStatevectorLength, &records[ 0 ] );
+  }
+  catch( const exception& e )
+  {
+    cerr << e.what() << endl;
+    outError = true;
+    return false;
+  }
+  outRecords.clear();
+  outRecords.str( records );
+  return true;
+}
+
 ToolResult ToolMain( OptionSet& options, istream& in, ostream& out )
 {
   ToolResult result = noError;
@@ -81,6 +120,9 @@ ToolResult ToolMain( OptionSet& options, istream& in, ostream& out )
   string paramFileName = options.getopt( "-p|-P|--parameters", "" );
   string offsetString = options.getopt( "-s|-S|--start", "" );
   string durationString = options.getopt( "-d|-D|--duration", "" );
+  int batchSize = ::atoi( options.getopt( "--batch", "1" ).c_str() );
+  if( batchSize < 1 )
+    return illegalOption;
 
   // Read the BCI2000 header.
   string token;
@@ -88,6 +130,7 @@ ToolResult ToolMain( OptionSet& options, istream& in, ostream& out )
       sourceCh,
       stateVectorLength;
   SignalType dataFormat;
+  string compression;
   StateList states;
   enum { v10, v11 } fileFormatVersion = v10;
 
@@ -113,8 +156,13 @@ ToolResult ToolMain( OptionSet& options, istream& in, ostream& out )
       dataFormat = SignalType::int16;
       break;
     case v11:
+      legalInput = legalInput &&
+        in >> token;
+      if( legalInput && token == "Compression=" )
+        legalInput &=
+          in >> compression && compression == BCZCodec::Name() && in >> token;
       legalInput &=
-        in >> token && token == "DataFormat=" && in >> dataFormat;
+        token == "DataFormat=" && in >> dataFormat;
       break;
     default:
       assert( false );
@@ -134,6 +182,9 @@ ToolResult ToolMain( OptionSet& options, istream& in, ostream& out )
   }
 
   MessageChannel output( out );
+  output.SetAutoFlush( false );
+  if( transmitData && batchSize > 1 )
+    BlockBatch::Announce( output );
   if( transmitStates )
   { // Transmit states ordered by name, i.e. independently of their order in the file.
     vector<string> stateNames;
@@ -247,24 +298,28 @@ ToolResult ToolMain( OptionSet& options, istream& in, ostream& out )
 
     int curSample = 0;
     int nBlocksRead = 0, nBlocksTransmitted = 0;
+    BlockBatch batch( transmitData ? batchSize : 1 );
     GenericSignal inputSignal( inputProperties );
-    while( in && in.peek() != EOF && ( duration < 0.0 || nBlocksTransmitted < duration ) )
+    // For compressed files, records are read from decoded chunks.
+    istringstream decodedRecords;
+    istream& data = compression.empty() ? in : decodedRecords;
+    bool decodingError = false;
+    while( ( ( data && data.peek() != EOF )
+             || ( !compression.empty() && ReadChunk( in, decodedRecords, dataFormat, sourceCh, stateVectorLength, decodingError ) ) )
+           && ( duration < 0.0 || nBlocksTransmitted < duration ) )
     {
       for( int i = 0; i < sourceCh; ++i )
-        inputSignal.ReadValueBinary( in, i, curSample );
-      in.read( (char*)statevector( curSample ).Data(), statevector.Length() );
+        inputSignal.ReadValueBinary( data, i, curSample );
+      data.read( (char*)statevector( curSample ).Data(), statevector.Length() );
 
       if( ++curSample == sampleBlockSize )
       {
         curSample = 0;
         if ( ++nBlocksRead > offset )
         {
-          if( transmitStates )
-          {
-            output.Send( statevector );
-          }
           if( transmitData )
           {
+            const StateVector* pStatevector = transmitStates ? &statevector : NULL;
             if( calibrateData )
             {
               SignalProperties outputProperties( inputProperties );
@@ -274,17 +329,26 @@ ToolResult ToolMain( OptionSet& options, istream& in, ostream& out )
                 for( int j = 0; j < sampleBlockSize; ++j )
                   outputSignal( i, j )
                     = ( inputSignal( i, j ) - offsets[ i ] ) * gains[ i ];
-              // Send the data.
-              output.Send( outputSignal );
+              batch.Add( outputSignal, pStatevector );
             }
             else
-              output.Send( inputSignal );
+              batch.Add( inputSignal, pStatevector );
+            // Send the data.
+            if( batch.Full() )
+              batch.Send( output );
+          }
+          else if( transmitStates )
+          {
+            output.Send( statevector );
           }
           nBlocksTransmitted++;
         }
       }
     }
-    if( curSample != 0 )
+    batch.Send( output );
+    if( decodingError )
+      result = illegalInput;
+    else if( curSample != 0 )
     {
       cerr << "Non-integer number of data blocks in input" << endl;
       result = illegalInput;
@@ -30,6 +30,7 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <algorithm>
 
 #include "bci_tool.h"
 #include "Param.h"
@@ -40,6 +41,7 @@
 #include "GenericVisualization.h"
 #include "GenericFilter.h"
 #include "MessageChannel.h"
+#include "BlockBatch.h"
 #include "ClassName.h"
 #include "Version.h"
 #include "SysCommand.h"
@@ -76,10 +78,12 @@ class FilterWrapper : public MessageChannel
  private:
   virtual bool OnParam( istream& );
   virtual bool OnState( istream& );
+  virtual bool OnProtocolVersion( istream& );
   virtual bool OnVisSignalProperties( istream& );
   virtual bool OnVisSignal( istream& );
   virtual bool OnStateVector( istream& );
 
+  void ProcessBlock( const GenericSignal&, istream&, BlockBatch& );
   void FinishProcessing();
   void StopRun();
   void OutputParameterChanges();
@@ -90,6 +94,7 @@ class FilterWrapper : public MessageChannel
 
  private:
   MessageChannel mOperator;
+  ProtocolVersion mInputProtocol;
   SignalProperties* mpInputProperties;
   GenericSignal mOutputSignal;
   ParamList mParamlist;
@@ -143,6 +148,8 @@ FilterWrapper::FilterWrapper( istream& arIn, ostream& arOut, ostream& arOp )
   mpOutputStatevector( NULL ),
   mSingleStatevector( true )
 {
+  SetAutoFlush( false );
+  SetBufferedInput( true );
   GenericVisualization::SetOutputChannel( &mOperator );
 }
 
@@ -168,7 +175,15 @@ FilterWrapper::FilterName()
          << "\"RegisterFilter\" statement linked into the executable."
          << endl;
   else
-    name = ClassName( typeid( *pFilter ) );
+  {
+    // When multiple filters are linked into a single executable, they form
+    // a filter chain that is applied within a single process.
+    GenericFilter::ChainInfo chain = GenericFilter::GetChainInfo();
+    name = "";
+    for( size_t i = 0; i < chain.size(); ++i )
+      name += ( i > 0 ? ", " : "" ) + chain[i].name;
+  }
+  GenericFilter::DisposeFilters();
   return name;
 }
 
@@ -187,6 +202,8 @@ FilterWrapper::Run()
   while( Input() && Input().peek() != EOF )
     HandleMessage();
   FinishProcessing();
+  // Filters must be gone before the filter directory is destructed at exit.
+  GenericFilter::DisposeFilters();
 }
 
 bool
@@ -237,6 +254,16 @@ FilterWrapper::OnStateVector( istream& arIn )
   return true;
 }
 
+bool
+FilterWrapper::OnProtocolVersion( istream& arIn )
+{
+  mInputProtocol.ReadBinary( arIn );
+  // Output is batched like the input.
+  if( BlockBatch::Announced( mInputProtocol ) )
+    BlockBatch::Announce( *this );
+  return true;
+}
+
 bool
 FilterWrapper::OnVisSignalProperties( istream& arIn )
 {
@@ -255,100 +282,141 @@ FilterWrapper::OnVisSignal( istream& arIn )
   if( s.ReadBinary( arIn ) && s.SourceID().empty() )
   {
     const GenericSignal& inputSignal = s;
-    SignalProperties outputProperties;
-    switch( Environment::Phase() )
+    int blocks = 0;
+    if( mpInputProperties != NULL )
+      blocks = BlockBatch::Count( inputSignal, *mpInputProperties, BlockBatch::Announced( mInputProtocol ) );
+    // Batches are processed block by block, and output as a batch of the same size.
+    BlockBatch output( max( blocks, 1 ) );
+    if( blocks < 2 )
+      ProcessBlock( inputSignal, arIn, output );
+    else
     {
-      case Environment::nonaccess:
+      StateVector* pBatchStatevector = NULL;
+      if( mpInputStatevector != NULL
+          && mpInputStatevector->Samples() >= blocks
+          && mpInputStatevector->Samples() % blocks == 0 )
+      {
+        pBatchStatevector = new StateVector( *mpInputStatevector );
+        *mpInputStatevector = StateVector( mInputStatelist, pBatchStatevector->Samples() / blocks );
+      }
+      GenericSignal block( *mpInputProperties );
+      for( int i = 0; i < blocks && arIn; ++i )
+      {
+        BlockBatch::GetBlock( inputSignal, i, block );
+        if( pBatchStatevector != NULL )
         {
-          GenericFilter::DisposeFilters();
-
-          ParamList filterParams;
-          mFilterStatelist.Clear();
-          EnvironmentBase::EnterConstructionPhase( &filterParams, &mFilterStatelist, NULL );
-          GenericFilter::InstantiateFilters();
-          if( bcierr__.Flushes() > 0 )
-          {
-            arIn.setstate( ios::failbit );
-            break;
-          }
-          // Make sure the filter's parameters get their properties from the filter
-          // rather than the input stream.
-          for( int i = 0; i < filterParams.Size(); ++i )
+          BlockBatch::GetBlock( *pBatchStatevector, i, *mpInputStatevector );
+          SynchronizeStatevectors();
+          if( !mpInputStatevector->StateValue( "Running" )
+              && Environment::Phase() == Environment::processing )
           {
-            const string& name = filterParams[i].Name();
-            if( mParamlist.Exists( name ) )
-              filterParams[i].AssignValues( mParamlist[name] );
-            mParamlist[name] = filterParams[i];
+            output.Send( *this );
+            StopRun();
           }
         }
-        /* no break */
-      case Environment::construction:
-        if( mpInputStatevector == NULL )
-          InitializeInputStatevector();
-        InitializeOutputStatevector();
-        for( int i = 0; i < mOutputStatelist.Size(); ++i )
-          Send( mOutputStatelist[ i ] );
-        EnvironmentBase::EnterPreflightPhase( &mParamlist, &mOutputStatelist, mpOutputStatevector );
-        if( mpInputProperties != NULL
-            && inputSignal.Channels() == mpInputProperties->Channels()
-            && inputSignal.Elements() == mpInputProperties->Elements() )
-        {
-          mpInputProperties->SetUpdateRate( 1.0 / MeasurementUnits::SampleBlockDuration() );
-          GenericFilter::PreflightFilters( *mpInputProperties, outputProperties );
-        }
-        else
-        {
-          delete mpInputProperties;
-          mpInputProperties = NULL;
-          SignalProperties inputProperties( inputSignal.Properties() );
-          inputProperties.SetUpdateRate( 1.0 / MeasurementUnits::SampleBlockDuration() );
-          GenericFilter::PreflightFilters( inputProperties, outputProperties );
-        }
-        mOutputSignal.SetProperties( outputProperties );
+        ProcessBlock( block, arIn, output );
+      }
+      delete pBatchStatevector;
+    }
+    output.Send( *this );
+  }
+  return arIn;
+}
+
+void
+FilterWrapper::ProcessBlock( const GenericSignal& inputSignal, istream& arIn, BlockBatch& output )
+{
+  SignalProperties outputProperties;
+  switch( Environment::Phase() )
+  {
+    case Environment::nonaccess:
+      {
+        GenericFilter::DisposeFilters();
+
+        ParamList filterParams;
+        mFilterStatelist.Clear();
+        EnvironmentBase::EnterConstructionPhase( &filterParams, &mFilterStatelist, NULL );
+        GenericFilter::InstantiateFilters();
         if( bcierr__.Flushes() > 0 )
         {
           arIn.setstate( ios::failbit );
           break;
         }
-        /* no break */
-      case Environment::preflight:
-        EnvironmentBase::EnterInitializationPhase( &mParamlist, &mOutputStatelist, mpOutputStatevector );
-        GenericFilter::InitializeFilters();
-        for( int i = 0; i < mParamlist.Size(); ++i )
-          Send( mParamlist[ i ] );
-        Send( outputProperties );
+        // Make sure the filter's parameters get their properties from the filter
+        // rather than the input stream.
+        for( int i = 0; i < filterParams.Size(); ++i )
+        {
+          const string& name = filterParams[i].Name();
+          if( mParamlist.Exists( name ) )
+            filterParams[i].AssignValues( mParamlist[name] );
+          mParamlist[name] = filterParams[i];
+        }
+      }
+      /* no break */
+    case Environment::construction:
+      if( mpInputStatevector == NULL )
+        InitializeInputStatevector();
+      InitializeOutputStatevector();
+      for( int i = 0; i < mOutputStatelist.Size(); ++i )
+        Send( mOutputStatelist[ i ] );
+      EnvironmentBase::EnterPreflightPhase( &mParamlist, &mOutputStatelist, mpOutputStatevector );
+      if( mpInputProperties != NULL
+          && inputSignal.Channels() == mpInputProperties->Channels()
+          && inputSignal.Elements() == mpInputProperties->Elements() )
+      {
+        mpInputProperties->SetUpdateRate( 1.0 / MeasurementUnits::SampleBlockDuration() );
+        GenericFilter::PreflightFilters( *mpInputProperties, outputProperties );
+      }
+      else
+      {
+        delete mpInputProperties;
+        mpInputProperties = NULL;
+        SignalProperties inputProperties( inputSignal.Properties() );
+        inputProperties.SetUpdateRate( 1.0 / MeasurementUnits::SampleBlockDuration() );
+        GenericFilter::PreflightFilters( inputProperties, outputProperties );
+      }
+      mOutputSignal.SetProperties( outputProperties );
+      if( bcierr__.Flushes() > 0 )
+      {
+        arIn.setstate( ios::failbit );
+        break;
+      }
+      /* no break */
+    case Environment::preflight:
+      EnvironmentBase::EnterInitializationPhase( &mParamlist, &mOutputStatelist, mpOutputStatevector );
+      GenericFilter::InitializeFilters();
+      for( int i = 0; i < mParamlist.Size(); ++i )
+        Send( mParamlist[ i ] );
+      Send( outputProperties );
+      if( bcierr__.Flushes() > 0 )
+      {
+        arIn.setstate( ios::failbit );
+        break;
+      }
+      /* no break */
+    case Environment::initialization:
+    case Environment::resting:
+      /* no break */
+      EnvironmentBase::EnterStartRunPhase( &mParamlist, &mOutputStatelist, mpOutputStatevector );
+      GenericFilter::StartRunFilters();
+      EnvironmentBase::EnterNonaccessPhase();
+      EnvironmentBase::EnterProcessingPhase( &mParamlist, &mOutputStatelist, mpOutputStatevector );
+      /* no break */
+    case Environment::processing:
+      {
+        GenericFilter::ProcessFilters( inputSignal, mOutputSignal );
         if( bcierr__.Flushes() > 0 )
         {
           arIn.setstate( ios::failbit );
           break;
         }
-        /* no break */
-      case Environment::initialization:
-      case Environment::resting:
-        /* no break */
-        EnvironmentBase::EnterStartRunPhase( &mParamlist, &mOutputStatelist, mpOutputStatevector );
-        GenericFilter::StartRunFilters();
-        EnvironmentBase::EnterNonaccessPhase();
-        EnvironmentBase::EnterProcessingPhase( &mParamlist, &mOutputStatelist, mpOutputStatevector );
-        /* no break */
-      case Environment::processing:
-        {
-          GenericFilter::ProcessFilters( inputSignal, mOutputSignal );
-          if( bcierr__.Flushes() > 0 )
-          {
-            arIn.setstate( ios::failbit );
-            break;
-          }
-          Send( *mpOutputStatevector );
-          Send( mOutputSignal );
-        }
-        break;
-      default:
-        bcierr << "Unknown Environment phase" << endl;
-        arIn.setstate( ios::failbit );
-    }
+        output.Add( mOutputSignal, mpOutputStatevector );
+      }
+      break;
+    default:
+      bcierr << "Unknown Environment phase" << endl;
+      arIn.setstate( ios::failbit );
   }
-  return arIn;
 }
 
 void
@@ -26,6 +26,7 @@
 #include <iostream>
 #include <cstdio>
 #include <set>
+#include <vector>
 
 #include "bci_tool.h"
 #include "Param.h"
@@ -35,6 +36,7 @@
 #include "StateVector.h"
 #include "GenericVisualization.h"
 #include "MessageChannel.h"
+#include "BlockBatch.h"
 #include "BCIError.h"
 #include "Version.h"
 #include "defines.h"
@@ -82,7 +84,11 @@ class StreamToMat : public MessageChannel
   StreamToMat( istream& is, ostream& os )
   : MessageChannel( is, os ), mpStatevector( NULL ), mSignalProperties( 0, 0 ),
     mDataElementSizePos( 0 ), mDataColsPos( 0 ), mDataSizePos( 0 ), mDataCols( 0 ),
-    mParamsDumped( false ) {}
+    mParamsDumped( false )
+  {
+    SetAutoFlush( false );
+    SetBufferedInput( true );
+  }
   ~StreamToMat() { delete mpStatevector; }
   void FinishHeader();
 
@@ -91,10 +97,12 @@ class StreamToMat : public MessageChannel
   bool                mParamsDumped;
   StateList           mStatelist;
   StateVector*        mpStatevector;
+  ProtocolVersion     mInputProtocol;
   SignalProperties    mSignalProperties;
   typedef set<string> StringSet; // A set is a sorted container of unique values.
   StringSet           mStateNames;
   size_t              mDataCols;
+  std::vector<float32_t> mDataRow;
   streamoff           mDataElementSizePos,
                       mDataColsPos,
                       mDataSizePos;
@@ -106,7 +114,7 @@ class StreamToMat : public MessageChannel
   void WriteString(const string& name, const string& str);
 
   void WriteHeader();
-  void WriteData( const GenericSignal& );
+  void WriteData( const GenericSignal&, int block, int blocks );
   void Write16( uint16_t value )
   { Output().write( reinterpret_cast<const char*>( &value ), sizeof( value ) ); }
   void Write32( uint32_t value )
@@ -115,6 +123,7 @@ class StreamToMat : public MessageChannel
   { Output().write( reinterpret_cast<const char*>( &value ), sizeof( value ) ); }
   void Pad();
 
+  virtual bool OnProtocolVersion(       istream& );
   virtual bool OnState(                 istream& );
   virtual bool OnVisSignal(             istream& );
   virtual bool OnVisSignalProperties(   istream& );
@@ -319,18 +328,27 @@ StreamToMat::WriteHeader()
 }
 
 void
-StreamToMat::WriteData( const GenericSignal& s )
+StreamToMat::WriteData( const GenericSignal& s, int block, int blocks )
 {
+  // In a batch of blocks, the statevector holds the states of all blocks.
+  int sample = 0;
+  if( mpStatevector != NULL && mpStatevector->Samples() % blocks == 0 )
+    sample = block * ( mpStatevector->Samples() / blocks );
+  int elements = mSignalProperties.Elements(),
+      offset = block * elements;
+
+  mDataRow.clear();
   if( mpStatevector == NULL )
-    for( size_t i = 0; i < mStateNames.size(); ++i )
-      WriteFloat32( 0 );
+    mDataRow.resize( mStateNames.size(), 0 );
   else
     for( StringSet::const_iterator i = mStateNames.begin(); i != mStateNames.end(); ++i )
-      WriteFloat32( static_cast<float32_t>( mpStatevector->StateValue( i->c_str() ) ) );
+      mDataRow.push_back( static_cast<float32_t>( mpStatevector->StateValue( i->c_str(), sample ) ) );
 
   for( int i = 0; i < s.Channels(); ++i )
-    for( int j = 0; j < s.Elements(); ++j )
-      WriteFloat32( static_cast<float32_t>( s( i, j ) ) );
+    for( int j = 0; j < elements; ++j )
+      mDataRow.push_back( static_cast<float32_t>( s( i, offset + j ) ) );
+  if( !mDataRow.empty() )
+    Output().write( reinterpret_cast<const char*>( &mDataRow[0] ), mDataRow.size() * sizeof( float32_t ) );
   ++mDataCols;
 }
 
@@ -347,6 +365,13 @@ StreamToMat::FinishHeader()
   Output().seekp( endPos );
 }
 
+bool
+StreamToMat::OnProtocolVersion( istream& arIn )
+{
+  mInputProtocol.ReadBinary( arIn );
+  return true;
+}
+
 bool
 StreamToMat::OnState( istream& arIn )
 {
@@ -373,10 +398,12 @@ StreamToMat::OnVisSignal( istream& arIn )
   const GenericSignal& s = v;
   if( mSignalProperties.IsEmpty() )
     bcierr << "Internal error: HandleVisSignalProperties should have written the header already, but has not" << endl;
-  if( s.Properties() != mSignalProperties )
+  int blocks = BlockBatch::Count( s, mSignalProperties, BlockBatch::Announced( mInputProtocol ) );
+  if( blocks < 1 )
     bcierr << "Ignored signal with inconsistent properties" << endl;
   else
-    WriteData( s );
+    for( int block = 0; block < blocks; ++block )
+      WriteData( s, block, blocks );
   return true;
 }
 
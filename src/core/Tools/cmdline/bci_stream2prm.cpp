@@ -54,6 +54,8 @@ class StreamToPrm : public MessageChannel
   : MessageChannel( arIn, arOut ) {}
 
  private:
+  virtual bool OnProtocolVersion( istream& is )
+    { return ProtocolVersion().ReadBinary( is ); }
   virtual bool OnParam( istream& );
 };
 
@@ -35,6 +35,7 @@
 #include "StateVector.h"
 #include "GenericVisualization.h"
 #include "MessageChannel.h"
+#include "BlockBatch.h"
 #include "BCIError.h"
 #include "Version.h"
 
@@ -57,26 +58,32 @@ class StreamToTable : public MessageChannel
  public:
   StreamToTable( istream& is, ostream& os )
   : MessageChannel( is, os ), mpStatevector( NULL ), mSignalProperties( 0, 0 ),
-    mInitialized( false ), mWriteoutPending( false ) {}
+    mInitialized( false ), mWriteoutPending( false )
+  {
+    SetAutoFlush( false );
+    SetBufferedInput( true );
+  }
   ~StreamToTable() { delete mpStatevector; }
   void Finish();
 
  private:
   StateList           mStatelist;
   StateVector*        mpStatevector;
+  ProtocolVersion     mInputProtocol;
   SignalProperties    mSignalProperties;
   typedef set<string> StringSet; // A set is a sorted container of unique values.
   StringSet           mStateNames;
   bool                mInitialized,
                       mWriteoutPending;
 
+  virtual bool OnProtocolVersion( istream& );
   virtual bool OnParam( istream& );
   virtual bool OnState( istream& );
   virtual bool OnVisSignalProperties( istream& );
   virtual bool OnVisSignal( istream& );
   virtual bool OnStateVector( istream& );
 
-  void WriteOut( const GenericSignal& );
+  void WriteOut( const GenericSignal&, int block = 0, int blocks = 1 );
 };
 
 ToolResult
@@ -106,6 +113,12 @@ StreamToTable::Finish()
     WriteOut( GenericSignal() );
 }
 
+bool
+StreamToTable::OnProtocolVersion( istream& arIn )
+{
+  return mInputProtocol.ReadBinary( arIn );
+}
+
 bool
 StreamToTable::OnParam( istream& arIn )
 {
@@ -144,7 +157,19 @@ StreamToTable::OnVisSignal( istream& arIn )
 {
   VisSignal v;
   v.ReadBinary( arIn );
-  WriteOut( v );
+  const GenericSignal& s = v;
+  int blocks = BlockBatch::Count( s, mSignalProperties, BlockBatch::Announced( mInputProtocol ) );
+  if( blocks < 2 )
+    WriteOut( s );
+  else
+  {
+    GenericSignal block( mSignalProperties );
+    for( int i = 0; i < blocks; ++i )
+    {
+      BlockBatch::GetBlock( s, i, block );
+      WriteOut( block, i, blocks );
+    }
+  }
   return true;
 }
 
@@ -162,7 +187,7 @@ StreamToTable::OnStateVector( istream& arIn )
 }
 
 void
-StreamToTable::WriteOut( const GenericSignal& inSignal )
+StreamToTable::WriteOut( const GenericSignal& inSignal, int inBlock, int inBlocks )
 {
   // Print a header line before the first line of data.
   if( !mInitialized )
@@ -176,7 +201,7 @@ StreamToTable::WriteOut( const GenericSignal& inSignal )
       Output() << "\t" << *i;
     for( int i = 0; i < inSignal.Channels(); ++i )
       for( int j = 0; j < inSignal.Elements(); ++j )
-        Output() << "\tSignal(" << mSignalProperties.ChannelLabels()[i] << "," << mSignalProperties.ElementLabels()[i] << ")";
+        Output() << "\tSignal(" << mSignalProperties.ChannelLabels()[i] << "," << mSignalProperties.ElementLabels()[j] << ")";
     Output() << endl;
     mInitialized = true;
   }
@@ -184,9 +209,13 @@ StreamToTable::WriteOut( const GenericSignal& inSignal )
     bcierr << "Ignored signal with inconsistent properties" << endl;
   else
   {
+    // In a batch of blocks, the statevector holds the states of all blocks.
+    int sample = 0;
+    if( mpStatevector != NULL && mpStatevector->Samples() % inBlocks == 0 )
+      sample = inBlock * ( mpStatevector->Samples() / inBlocks );
     if( mpStatevector != NULL )
       for( StringSet::const_iterator i = mStateNames.begin(); i != mStateNames.end(); ++i )
-        Output() << "\t" << mpStatevector->StateValue( i->c_str() );
+        Output() << "\t" << mpStatevector->StateValue( i->c_str(), sample );
     else
       for( StringSet::const_iterator i = mStateNames.begin(); i != mStateNames.end(); ++i )
         Output() << "\t0";
@@ -194,7 +223,7 @@ StreamToTable::WriteOut( const GenericSignal& inSignal )
     for( int i = 0; i < inSignal.Channels(); ++i )
       for( int j = 0; j < inSignal.Elements(); ++j )
         Output() << "\t" << inSignal( i, j );
-    Output() << endl;
+    Output() << '\n';
   }
   mWriteoutPending = false;
 }
@@ -26,6 +26,7 @@
 ////////////////////////////////////////////////////////////////////
 #include "bci_tool.h"
 #include "ExceptionCatcher.h"
+#include "RedirectIO.h"
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -103,7 +104,7 @@ int main( int argc, char** argv )
   }
   options.inputFile = toolOptions.getopt( "-i|-I|--input", "" );
   options.outputFile = toolOptions.getopt( "-o|-O|--output", "" );
-  string buffer = toolOptions.getopt( "-b|-B|--buffer", "4096" );
+  string buffer = toolOptions.getopt( "-b|-B|--buffer", "65536" );
   if( buffer.empty() )
   {
     options.execute = false;
@@ -155,10 +156,13 @@ int main( int argc, char** argv )
   if( result == noError && options.execute )
   {
     FunctionCall< ToolResult( OptionSet&, istream&, ostream& ) >
-      callMain( ToolMain, toolOptions, cin, cout );
+      callMain( ToolMain, toolOptions, Tiny::Cin(), Tiny::Cout() );
     bool finished = ExceptionCatcher()
                    .SetMessage( "Aborting " + ToolInfo[ name ] )
                    .Run( callMain );
+    // Tools do not flush after each message, so make sure all output has been
+    // written before static objects are destroyed.
+    Tiny::Cout().flush();
     if( !finished )
     {
       result = genericError;
@@ -179,7 +183,7 @@ int main( int argc, char** argv )
   options.help |= ( result == illegalOption );
   if( options.help )
   {
-    ostream& out = ( result == noError ? cout : cerr );
+    ostream& out = ( result == noError ? Tiny::Cout() : Tiny::Cerr() );
     out << "Usage: " << ToolInfo[ name ] << " [OPTION]\n"
         << "Options are:\n"
         << "\t-h,       --help                Display this help\n"
@@ -193,9 +197,9 @@ int main( int argc, char** argv )
     out.flush();
   }
   if( options.version )
-    cout << ToolInfo[ name ] << " " << ToolInfo[ version ] << endl;
+    Tiny::Cout() << ToolInfo[ name ] << " " << ToolInfo[ version ] << endl;
 
-  if( !cout )
+  if( !Tiny::Cout() )
   {
     cerr << "Error writing to standard output" << endl;
     result = genericError;
@@ -0,0 +1,46 @@
+#!/bin/sh
+################################################################################
+# $Id$
+# Author: agent@local
+# Description: Measures throughput of a command line filter pipeline,
+#   bci_dat2stream | <filter> | bci_stream2mat, in samples per second,
+#   once with one block per message, and once for each batch size given.
+#   Usage: benchmark.sh <file.dat> <filter> [<parameter file>] [<batch size> ...]
+#   Execute this script from the directory containing the tools.
+#
+# (C) 2000-2012, BCI2000 Project
+# http://www.bci2000.org
+################################################################################
+if [ $# -lt 2 ]; then
+  echo "Usage: $0 <file.dat> <filter> [<parameter file>] [<batch size> ...]" >&2;
+  exit 1;
+fi;
+DATFILE="$1";
+FILTER="$2";
+shift 2;
+PRMOPTION="";
+if [ $# -gt 0 ] && [ -f "$1" ]; then
+  PRMOPTION="-p$1";
+  shift;
+fi;
+BATCHES="1 $*";
+
+# Number of samples, computed from the data file's header line.
+SAMPLES=`head -n 1 "$DATFILE" | awk -v size=\`wc -c < "$DATFILE"\` '{
+  for( i = 1; i < NF; ++i ) field[$i] = $(i+1);
+  bytes = 2;
+  if( field["DataFormat="] == "int32" || field["DataFormat="] == "float32" ) bytes = 4;
+  print int( ( size - field["HeaderLen="] ) / ( field["SourceCh="] * bytes + field["StatevectorLen="] ) );
+}'`;
+
+now() { date +%s.%N; }
+
+echo "$DATFILE: $SAMPLES samples";
+for BATCH in $BATCHES; do
+  START=`now`;
+  ./bci_dat2stream $PRMOPTION --batch=$BATCH < "$DATFILE" | ./$FILTER | ./bci_stream2mat > /dev/null;
+  END=`now`;
+  echo "$START $END" | awk -v batch=$BATCH -v samples=$SAMPLES '{
+    printf( "batch %4d: %8.3f s, %12.0f samples/s\n", batch, $2 - $1, samples / ( $2 - $1 ) );
+  }';
+done;
@@ -67,6 +67,7 @@ MEXSRC = { ...
     [ BCIFRM 'bcistream/BCIException.cpp' ], ...
     [ BCIFRM 'bcistream/BCIStream.cpp' ], ...
     [ BCIFRM 'fileio/dat/BCI2000FileReader.cpp' ], ...
+    [ BCIFRM 'fileio/dat/BCZCodec.cpp' ], ...
     [ BCIFRM 'fileio/dat/BCI2000OutputFormat.cpp' ], ...
     [ BCIFRM 'fileio/edf_gdf/EDFOutputBase.cpp' ], ...
     [ BCIFRM 'fileio/edf_gdf/EDFOutputFormat.cpp' ], ...
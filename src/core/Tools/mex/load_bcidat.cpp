@@ -46,8 +46,6 @@ using namespace std;
 
 struct StateInfo
 {
-  int       location,
-            length;
   union
   {
     uint8_t*  data8;
@@ -88,16 +86,14 @@ ReadSignal( FileContainer& inFiles, mxArray* ioSignal )
 
   for( FileContainer::iterator i = inFiles.begin(); i != inFiles.end(); ++i )
   {
-    BCI2000FileReader* file = i->data;
     int64_t numSamples = i->end - i->begin;
-    int numChannels = file->SignalProperties().Channels();
-    for( int64_t sample = 0; sample < numSamples; ++sample )
-      for( int channel = 0; channel < numChannels; ++channel )
-        data[ totalSamples * channel + sample + sampleOffset ]
-          = static_cast<T>(
-              Raw ? file->RawValue( channel, sample + i->begin )
-                  : file->CalibratedValue( channel, sample + i->begin )
-            );
+    BCI2000FileReader::SignalOptions options;
+    options.calibrated = !Raw;
+    i->data->ReadSamples(
+      i->begin, numSamples,
+      BCI2000FileReader::Matrix<T>( data + sampleOffset, totalSamples, 1 ),
+      options
+    );
     sampleOffset += numSamples;
   }
 }
@@ -309,41 +305,49 @@ BCIMexFunction( int nargout, mxArray* varargout[],
       mxSetFieldByNumber( states, 0, i, stateArray );
       stateInfo[ i ].data8 = reinterpret_cast<uint8_t*>( mxGetData( stateArray ) );
     }
+    const int64_t blockSize = 65536;
+    vector<State::ValueType> values( numStates * blockSize );
     for( FileContainer::iterator file = files.begin(); file != files.end(); ++file )
     { // Locations and lengths are not necessarily compatible across files, so we must
-      // create StateInfos for each file individually.
-      const StateVector* statevector = file->data->StateVector();
-      const StateList& curStatelist = statevector->StateList();
+      // select states for each file individually.
+      const StateList& curStatelist = file->data->StateVector()->StateList();
+      BCI2000FileReader::StateSelection selection;
       for( int i = 0; i < numStates; ++i )
-      {
-        const State& s = curStatelist[ stateNames[ i ] ];
-        stateInfo[ i ].location = s.Location();
-        stateInfo[ i ].length = s.Length();
-      }
-      for( int64_t sample = file->begin; sample < file->end; ++sample )
-      { // Iterating over samples in the outer loop will avoid scanning
+        selection.push_back( &curStatelist[ stateNames[ i ] ] );
+      for( int64_t begin = file->begin; numStates > 0 && begin < file->end; begin += blockSize )
+      { // Reading blocks of samples for all states at once will avoid scanning
         // the file multiple times.
-        file->data->ReadStateVector( sample );
+        int64_t count = min( blockSize, file->end - begin );
+        file->data->ReadSamples(
+          begin, count,
+          BCI2000FileReader::Matrix<double>(),
+          BCI2000FileReader::SignalOptions(),
+          BCI2000FileReader::Matrix<State::ValueType>( &values[ 0 ], blockSize, 1 ),
+          selection
+        );
         for( int i = 0; i < numStates; ++i )
         {
-          State::ValueType value
-            = statevector->StateValue( stateInfo[ i ].location, stateInfo[ i ].length );
+          const State::ValueType* value = &values[ i * blockSize ];
           switch( stateInfo[ i ].classID )
           {
             case mxUINT8_CLASS:
-              *stateInfo[ i ].data8++ = static_cast<uint8_t>( value );
+              for( int64_t j = 0; j < count; ++j )
+                *stateInfo[ i ].data8++ = static_cast<uint8_t>( value[ j ] );
               break;
 
             case mxUINT16_CLASS:
-              *stateInfo[ i ].data16++ = static_cast<uint16_t>( value );
+              for( int64_t j = 0; j < count; ++j )
+                *stateInfo[ i ].data16++ = static_cast<uint16_t>( value[ j ] );
               break;
 
             case mxUINT32_CLASS:
-              *stateInfo[ i ].data32++ = static_cast<uint32_t>( value );
+              for( int64_t j = 0; j < count; ++j )
+                *stateInfo[ i ].data32++ = static_cast<uint32_t>( value[ j ] );
               break;
 
             case mxUINT64_CLASS:
-              *stateInfo[ i ].data64++ = static_cast<uint64_t>( value );
+              for( int64_t j = 0; j < count; ++j )
+                *stateInfo[ i ].data64++ = static_cast<uint64_t>( value[ j ] );
               break;
 
             default:
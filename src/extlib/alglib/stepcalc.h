@@ -10,6 +10,48 @@
 #include "remmean.h"
 #include "tcdf.h"
 
+#include <vector>
+
+///////////////////////////////////////////////////////////////////
+/// A linear model whose predictors may be entered and removed one at a
+/// time, as required by stepwise regression.
+/// The model keeps an orthonormal basis of the in-model predictors
+/// together with the residuals of all out-of-model predictors and of
+/// the response. Entering a predictor updates the residuals with a
+/// single Gram-Schmidt step; removing a predictor rebuilds the basis
+/// from the remaining predictors. An intercept is always part of the
+/// model.
+class StepwiseModel
+{
+ public:
+  StepwiseModel(const ap::real_2d_array& X, const ap::real_1d_array& y);
+  // Enters and removes predictors to match the given in-model vector.
+  void Update(const ap::boolean_1d_array& in);
+  // Computes coefficients, standard errors, and p-values as stepcalc() does.
+  void Compute(ap::real_1d_array& B, ap::real_1d_array& SE, ap::real_1d_array& PVAL) const;
+
+ private:
+  void Reset();
+  void Enter(int predictor);
+
+  int mRows, mCols;
+  const ap::real_2d_array& mX;
+  const ap::real_1d_array& my;
+  std::vector<bool> mIn;
+  std::vector<int> mOrder;  // in-model predictors, in order of entering
+  // In-model predictors that were not entered because they are collinear
+  // with the basis.
+  std::vector<int> mCollinear;
+  // Residual columns of predictors and response, with mRows entries each.
+  std::vector<double> mXr, myr;
+  // Norms of the original predictor columns.
+  std::vector<double> mNorm;
+  // Projection coefficients, one row of mCols values for each basis vector.
+  std::vector<double> mCoeff, myCoeff;
+  // Basis vectors, mRows entries each, and diagonal of R.
+  std::vector<double> mQ, mRdiag;
+};
+
 void stepcalc(const ap::real_2d_array& X,
               const ap::real_1d_array& y,
               ap::boolean_1d_array& in,
@@ -18,8 +18,11 @@ static void Normalize( const ap::real_2d_array& inX, const ap::real_1d_array& in
   X.setbounds( inX.getlowbound(1), inX.gethighbound(1) );
   assert( inX.getlowbound(2) == ioB.getlowbound() && inX.gethighbound(2) == ioB.gethighbound() );
   for( int i = inX.getlowbound(1); i <= inX.gethighbound(1); ++i )
+  {
+    X(i) = 0;
     for( int j = inX.getlowbound(2); j <= inX.gethighbound(2); ++j )
       X(i) += inX(i,j) * ioB(j);
+  }
 
   double P0 = 0,
          P1X = 0, P1Y = 0,
@@ -78,6 +81,7 @@ void stepwisefit(const ap::real_2d_array& X, const ap::real_1d_array& y, const d
   int swap;
   int iter=1;
   ostringstream oss;
+  StepwiseModel model(X, y);
   ///////////////////////////////////////////////////////////////////
   // Section: Compute B, SE, PVAL, and the next step
   while(FLAG==TRUE)
@@ -91,7 +95,8 @@ void stepwisefit(const ap::real_2d_array& X, const ap::real_1d_array& y, const d
     else
       printf("Added feature... %d\n", iter);
 
-    stepcalc(X, y, in, B, SE, PVAL);
+    model.Update(in);
+    model.Compute(B, SE, PVAL);
     swap = stepnext(in, PVAL, penter, premove);
     if (swap==-1)
       FLAG=FALSE;
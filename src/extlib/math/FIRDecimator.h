@@ -0,0 +1,259 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: An FIR lowpass filter combined with downsampling.
+//   The filter is evaluated in polyphase fashion, i.e. only at those samples
+//   that are kept after downsampling, and taps that are zero are skipped
+//   altogether. When the cutoff frequency equals the output Nyquist
+//   frequency, as designed by DesignLowpass(), every Decimation'th
+//   coefficient except the central one is zero; in particular, for a
+//   decimation factor of 2 this results in a half-band filter.
+//
+//   Internally, samples are stored with all channels of a sample adjacent
+//   in memory, such that the innermost loop runs over channels.
+//
+//   The Process() function requires the number of input samples to be
+//   Decimation() times the number of output samples.
+//   One version of Process() is templatized for its argument signal type T.
+//   This type must provide the following member functions:
+//     T::Channels() to return the number of channels,
+//     T::Elements() to return the number of elements (samples),
+//     T::operator()(channel, sample) for read/write access.
+//   Input and output must not refer to the same object.
+//   Another version of Process() reads and writes data in the internal
+//   layout, which avoids conversion when multiple decimators are cascaded.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FIR_DECIMATOR_H
+#define FIR_DECIMATOR_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "BCIAssert.h"
+
+template<typename Real>
+class FIRDecimator
+{
+ public:
+  typedef std::vector<Real> RealVector;
+
+  FIRDecimator()
+    : mDecimation( 1 ),
+      mChannels( 0 )
+    {}
+  ~FIRDecimator()
+    {}
+
+  // Properties
+  int Decimation() const
+    { return mDecimation; }
+  FIRDecimator& SetDecimation( int d )
+    { mDecimation = std::max( d, 1 ); return Initialize(); }
+  const RealVector& Coefficients() const
+    { return mCoefficients; }
+  FIRDecimator& SetCoefficients( const RealVector& c )
+    { mCoefficients = c; return Initialize(); }
+  int Channels() const
+    { return static_cast<int>( mChannels ); }
+  FIRDecimator& SetChannels( int c )
+    { return Initialize( c ); }
+
+  // Methods
+  FIRDecimator& Initialize();
+  FIRDecimator& Initialize( size_t inChannels );
+  template<typename T>
+   FIRDecimator& Process( const T&, T& );
+  // Input and output are given as consecutive groups of Channels() values,
+  // one group per sample.
+  FIRDecimator& Process( const Real* input, int inputSamples, Real* output );
+
+  // Designs a Kaiser windowed sinc lowpass suited for decimation by the given factor.
+  // The passband edge is given in units of the input sampling rate, and the stopband
+  // starts where aliases of the passband begin. When decimating in multiple stages,
+  // use the final passband edge for all stages.
+  static RealVector DesignLowpass( int decimation, Real passbandEdge, Real attenuation_dB );
+
+ private:
+  Real* AppendInput( int samples );
+  void Decimate( int outputSamples, Real* output );
+  static Real BesselI0( Real );
+
+  int           mDecimation;
+  size_t        mChannels;
+  RealVector    mCoefficients;
+  // Nonzero taps, given as offsets back in time from the current sample.
+  std::vector<int> mTapOffsets;
+  RealVector    mTapValues,
+                mBuffer,
+                mOutput;
+};
+
+
+template<typename Real>
+inline FIRDecimator<Real>&
+FIRDecimator<Real>::Initialize()
+{
+  return Initialize( mChannels );
+}
+
+template<typename Real>
+inline FIRDecimator<Real>&
+FIRDecimator<Real>::Initialize( size_t inChannels )
+{
+  mChannels = inChannels;
+  mTapOffsets.clear();
+  mTapValues.clear();
+  for( size_t i = 0; i < mCoefficients.size(); ++i )
+    if( mCoefficients[i] != 0 )
+    {
+      mTapOffsets.push_back( static_cast<int>( i ) );
+      mTapValues.push_back( mCoefficients[i] );
+    }
+  size_t history = mCoefficients.empty() ? 0 : mCoefficients.size() - 1;
+  mBuffer.clear();
+  mBuffer.resize( history * mChannels, 0 );
+  return *this;
+}
+
+template<typename Real>
+template<typename T>
+inline FIRDecimator<Real>&
+FIRDecimator<Real>::Process( const T& Input, T& Output )
+{
+  bciassert( static_cast<size_t>( Input.Channels() ) == mChannels );
+  bciassert( Input.Elements() == Output.Elements() * mDecimation );
+  const int channels = Input.Channels();
+  Real* p = AppendInput( Input.Elements() );
+  for( int sample = 0; sample < Input.Elements(); ++sample )
+    for( int ch = 0; ch < channels; ++ch )
+      *p++ = Input( ch, sample );
+  mOutput.resize( Output.Elements() * channels );
+  Decimate( Output.Elements(), mOutput.empty() ? 0 : &mOutput[0] );
+  const Real* q = mOutput.empty() ? 0 : &mOutput[0];
+  for( int sample = 0; sample < Output.Elements(); ++sample )
+    for( int ch = 0; ch < channels; ++ch )
+      Output( ch, sample ) = *q++;
+  return *this;
+}
+
+template<typename Real>
+inline FIRDecimator<Real>&
+FIRDecimator<Real>::Process( const Real* inInput, int inSamples, Real* outOutput )
+{
+  bciassert( inSamples % mDecimation == 0 );
+  std::copy( inInput, inInput + inSamples * mChannels, AppendInput( inSamples ) );
+  Decimate( inSamples / mDecimation, outOutput );
+  return *this;
+}
+
+template<typename Real>
+inline Real*
+FIRDecimator<Real>::AppendInput( int inSamples )
+{
+  // Input is appended to the history kept from the previous call.
+  size_t historySize = mBuffer.size();
+  mBuffer.resize( historySize + inSamples * mChannels );
+  return mBuffer.empty() ? 0 : &mBuffer[historySize];
+}
+
+template<typename Real>
+inline void
+FIRDecimator<Real>::Decimate( int inOutputSamples, Real* outOutput )
+{
+  const int channels = static_cast<int>( mChannels ),
+            history = mCoefficients.empty() ? 0 : static_cast<int>( mCoefficients.size() ) - 1,
+            numTaps = static_cast<int>( mTapValues.size() );
+  // Compute the output for the last sample of each group of Decimation() samples.
+  for( int outSample = 0; outSample < inOutputSamples; ++outSample )
+  {
+    int current = history + ( outSample + 1 ) * mDecimation - 1;
+    Real* pOut = outOutput + outSample * channels;
+    std::fill( pOut, pOut + channels, Real( 0 ) );
+    for( int tap = 0; tap < numTaps; ++tap )
+    {
+      const Real coefficient = mTapValues[tap],
+                 * pIn = &mBuffer[( current - mTapOffsets[tap] ) * channels];
+      for( int ch = 0; ch < channels; ++ch )
+        pOut[ch] += coefficient * pIn[ch];
+    }
+  }
+  // Keep the most recent samples for the next call.
+  if( history > 0 )
+    std::copy( mBuffer.end() - history * channels, mBuffer.end(), mBuffer.begin() );
+  mBuffer.resize( history * channels );
+}
+
+template<typename Real>
+inline typename FIRDecimator<Real>::RealVector
+FIRDecimator<Real>::DesignLowpass( int inDecimation, Real inPassbandEdge, Real inAttenuation )
+{
+  // Kaiser's formulae for window length and shape parameter.
+  Real stopbandStart = Real( 1 ) / inDecimation - inPassbandEdge,
+       transition = std::max<Real>( stopbandStart - inPassbandEdge, 1e-3 ),
+       beta = 0;
+  if( inAttenuation > 50 )
+    beta = 0.1102 * ( inAttenuation - 8.7 );
+  else if( inAttenuation > 21 )
+    beta = 0.5842 * ::pow( inAttenuation - 21, 0.4 ) + 0.07886 * ( inAttenuation - 21 );
+  int length = static_cast<int>( ::ceil( ( inAttenuation - 7.95 ) / ( 14.36 * transition ) ) ) + 1;
+  length = std::max( length, 3 ) | 1; // odd length, for an integer group delay
+  const int center = length / 2;
+  // The cutoff is centered between passband edge and stopband, i.e. at the
+  // output Nyquist frequency, so the ideal lowpass vanishes at multiples of the
+  // decimation factor.
+  const Real cutoff = Real( 0.5 ) / inDecimation,
+             norm = BesselI0( beta );
+  RealVector h( length, 0 );
+  Real sum = 0;
+  for( int i = 0; i < length; ++i )
+  {
+    int d = i - center;
+    if( d == 0 )
+      h[i] = 2 * cutoff;
+    else if( d % inDecimation != 0 )
+      h[i] = ::sin( 2 * M_PI * cutoff * d ) / ( M_PI * d );
+    Real r = Real( d ) / center;
+    h[i] *= BesselI0( beta * ::sqrt( std::max<Real>( 0, 1 - r * r ) ) ) / norm;
+    sum += h[i];
+  }
+  for( int i = 0; i < length; ++i )
+    h[i] /= sum; // unity gain at DC
+  return h;
+}
+
+template<typename Real>
+inline Real
+FIRDecimator<Real>::BesselI0( Real x )
+{
+  Real result = 1,
+       term = 1,
+       x2 = x * x / 4;
+  for( int k = 1; term > 1e-12 * result; ++k )
+  {
+    term *= x2 / ( k * k );
+    result += term;
+  }
+  return result;
+}
+
+#endif // FIR_DECIMATOR_H
@@ -79,6 +79,10 @@ class CombinedObserver : public virtual PowerSumObserver, public virtual Histogr
       if( mUseHistogram )
         HistogramObserver::DoClear();
     }
+  virtual void DoFlush()
+    {
+      PowerSumObserver::DoFlush();
+    }
 
  public:
   virtual Number PowerSum0( MemPool& ioPool ) const
@@ -58,8 +58,8 @@ StatisticalObserver::RSquared( const ObserverBase& inObs1, const ObserverBase& i
 
   MatrixPtr result = ioPool.NewMatrix( inObs1.SampleSize(), inObs2.SampleSize() );
 
-  Number n1 = inObs1.Count(),
-         n2 = inObs2.Count();
+  Number n1 = inObs1.Count( ioPool ),
+         n2 = inObs2.Count( ioPool );
   if( n1 < eps || n2 < eps )
   {
     *result = 0;
@@ -88,9 +88,9 @@ StatisticalObserver::RSquared( const ObserverBase& inObs1, const ObserverBase& i
 MatrixPtr
 StatisticalObserver::ZScore( const ObserverBase& inDist, const ObserverBase& inRef, MemPool& ioPool )
 {
-  VectorPtr mean = inDist.Mean(),
-            refMean = inRef.Mean(),
-            refStd = inRef.Variance();
+  VectorPtr mean = inDist.Mean( ioPool ),
+            refMean = inRef.Mean( ioPool ),
+            refStd = inRef.Variance( ioPool );
   refStd->transform( ::sqrt );
   MatrixPtr result = ioPool.NewMatrix( mean->size(), refMean->size() );
   for( size_t i = 0; i < mean->size(); ++i )
@@ -152,6 +152,13 @@ ObserverBase::AgeBy( unsigned int inCount )
   return *this;
 }
 
+ObserverBase&
+ObserverBase::Flush()
+{
+  DoFlush();
+  return *this;
+}
+
 ObserverBase&
 ObserverBase::Clear()
 {
@@ -245,7 +252,7 @@ ObserverBase::Covariance( MemPool& ioPool ) const
 {
   REQUIRE( Covariance );
   MatrixPtr result = PowerSum2Full( ioPool );
-  *result /= Count();
+  *result /= Count( ioPool );
   result->SubtractOuterProduct( *Mean( ioPool ) );
   return result;
 }
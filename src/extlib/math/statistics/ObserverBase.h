@@ -101,6 +101,12 @@ class ObserverBase
   //  Typically, you call AgeBy(1) prior to Observe().
   ObserverBase& AgeBy( unsigned int count );
   ObserverBase& Clear();
+  //  Descendants may defer part of the work of Observe() in order to process
+  //  observations in blocks. Statistics functions flush deferred observations
+  //  implicitly; call Flush() after a series of observations to make subsequent
+  //  calls to statistics functions free of side effects, e.g. when they are
+  //  made concurrently from multiple threads.
+  ObserverBase& Flush();
 
   // Properties, observation interface to the user
   //
@@ -182,6 +188,7 @@ class ObserverBase
   virtual void DoAgeBy( unsigned int count ) = 0; // Age existing data.
   virtual void DoObserve( const Vector&, Number weight ) = 0; // Add new data, without aging.
   virtual void DoClear() = 0;                     // Remove existing data.
+  virtual void DoFlush() {}                       // Commit deferred observations.
 
  public:
   //  Computation-related methods
@@ -34,7 +34,9 @@ using namespace StatisticalObserver;
 PowerSumObserver::PowerSumObserver( int inConfig )
 : ObserverBase( inConfig, Supports ),
   mCovarianceRequired( ImpliedConfig( inConfig ) & StatisticalObserver::Covariance ),
-  mPowerSum0( 0 )
+  mPowerSum0( 0 ),
+  mPendingCount( 0 ),
+  mFullScale( 1 )
 {
 }
 
@@ -55,7 +57,13 @@ PowerSumObserver::DoAgeBy( unsigned int inCount )
   mPowerSum0 *= factor;
   mPowerSum1 *= factor;
   mPowerSum2Diag *= factor;
-  mPowerSum2Full *= factor;
+  if( mCovarianceRequired )
+  {
+    mFullScale *= factor;
+    // Avoid loss of precision in pending weights.
+    if( mFullScale < 1e-20 )
+      FlushPending();
+  }
 }
 
 void
@@ -66,10 +74,52 @@ PowerSumObserver::DoObserve( const Vector& inV, Number inWeight )
   {
     mPowerSum1[i] += inV[i] * inWeight;
     mPowerSum2Diag[i] += inV[i] * inV[i] * inWeight;
-    if( mCovarianceRequired )
-      for( int j = 0; j < SampleSize(); ++j )
-        mPowerSum2Full[i][j] += inV[i] * inV[j] * inWeight;
   }
+  if( mCovarianceRequired )
+  {
+    for( int i = 0; i < SampleSize(); ++i )
+      mPending[i][mPendingCount] = inV[i];
+    mPendingWeights[mPendingCount] = inWeight / mFullScale;
+    if( ++mPendingCount == PendingBlockSize )
+      FlushPending();
+  }
+}
+
+void
+PowerSumObserver::DoFlush()
+{
+  FlushPending();
+}
+
+void
+PowerSumObserver::FlushPending() const
+{
+  if( !mCovarianceRequired || ( mPendingCount == 0 && mFullScale == 1 ) )
+    return;
+
+  // Rank-k update of the upper triangle, followed by mirroring.
+  // Rows of mPending are contiguous in memory, so the inner loop is a
+  // weighted dot product over pending observations.
+  const size_t n = mPending.size(),
+               k = mPendingCount;
+  for( size_t i = 0; i < n; ++i )
+  {
+    const Number* pRowI = &mPending[i][0];
+    Number* pResult = &mPowerSum2Full[i][0];
+    for( size_t j = i; j < n; ++j )
+    {
+      const Number* pRowJ = &mPending[j][0];
+      Number sum = 0;
+      for( size_t l = 0; l < k; ++l )
+        sum += pRowI[l] * pRowJ[l] * mPendingWeights[l];
+      pResult[j] = mFullScale * ( pResult[j] + sum );
+    }
+  }
+  for( size_t i = 0; i < n; ++i )
+    for( size_t j = 0; j < i; ++j )
+      mPowerSum2Full[i][j] = mPowerSum2Full[j][i];
+  mPendingCount = 0;
+  mFullScale = 1;
 }
 
 void
@@ -79,10 +129,18 @@ PowerSumObserver::DoClear()
   mPowerSum1.resize( 0 );
   mPowerSum2Diag.resize( 0 );
   mPowerSum2Full.resize( 0 );
+  mPending.resize( 0 );
+  mPendingWeights.resize( 0 );
+  mPendingCount = 0;
+  mFullScale = 1;
   mPowerSum1.resize( SampleSize() );
   mPowerSum2Diag.resize( SampleSize() );
   if( mCovarianceRequired )
+  {
     mPowerSum2Full.resize( SampleSize(), Vector( SampleSize() ) );
+    mPending.resize( SampleSize(), Vector( PendingBlockSize ) );
+    mPendingWeights.resize( PendingBlockSize );
+  }
 }
 
 VectorPtr
@@ -104,6 +162,7 @@ PowerSumObserver::PowerSum2Diag( MemPool& ioPool ) const
 MatrixPtr
 PowerSumObserver::PowerSum2Full( MemPool& ioPool ) const
 {
+  FlushPending();
   MatrixPtr result = ioPool.NewMatrix( SampleSize(), SampleSize() );
   *result = mPowerSum2Full;
   return result;
@@ -54,6 +54,7 @@ class PowerSumObserver : public virtual ObserverBase
   virtual void DoAgeBy( unsigned int count );
   virtual void DoObserve( const Vector&, Number weight );
   virtual void DoClear();
+  virtual void DoFlush();
 
  public:
   virtual Number PowerSum0( MemPool& ) const
@@ -63,11 +64,22 @@ class PowerSumObserver : public virtual ObserverBase
   virtual MatrixPtr PowerSum2Full( MemPool& ) const;
 
  private:
+  void FlushPending() const;
+
   bool mCovarianceRequired;
   Number mPowerSum0;
   Vector mPowerSum1,
          mPowerSum2Diag;
-  Matrix mPowerSum2Full;
+  // Observations entering into the full second power sum are collected, and
+  // added as a single blocked rank-k update once the block is full.
+  // Rather than scaling the full matrix on each call to DoAgeBy(), aging is
+  // accumulated into mFullScale, and pending weights are divided by it.
+  enum { PendingBlockSize = 32 };
+  mutable Matrix mPowerSum2Full,
+                 mPending; // one row per sample dimension, one column per pending observation
+  mutable Vector mPendingWeights;
+  mutable size_t mPendingCount;
+  mutable Number mFullScale;
 };
 
 } // namespace StatisticalObserver
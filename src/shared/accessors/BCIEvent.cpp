@@ -52,6 +52,29 @@ BCIEvent::DenyEvents()
     spQueue->DenyEvents();
 }
 
+int
+BCIEvent::StateIndex( const string& inName )
+{
+  if( !spQueue )
+    throw std_runtime_error( "No event queue specified" );
+  int idx = spQueue->FindEventState( inName );
+  if( idx < 0 )
+    throw std_invalid_argument(
+      "State \"" << inName << "\" does not exist, or was not defined as an event state. "
+      "Use BEGIN_EVENT_DEFINITIONS/END_EVENT_DEFINITIONS to define states "
+      "as event states."
+    );
+  return idx;
+}
+
+void
+BCIEvent::Post( int inStateIndex, State::ValueType inValue, int inDuration )
+{
+  if( !spQueue )
+    throw std_runtime_error( "No event queue specified" );
+  spQueue->PushBack( inStateIndex, inValue, inDuration, PrecisionTime::Now() );
+}
+
 int
 BCIEvent::StringBuf::sync()
 {
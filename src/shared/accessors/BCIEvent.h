@@ -55,6 +55,12 @@ class BCIEvent : public std::ostream
   std::ostream& operator()( const char* inDescriptor = "" )
     { return *this << inDescriptor; }
 
+  // For high event rates, obtain a state's index once, and post binary events
+  // without formatting and parsing of event descriptors.
+  // StateIndex() throws an exception if there is no event state with the given name.
+  static int StateIndex( const std::string& stateName );
+  static void Post( int stateIndex, State::ValueType value, int duration = -1 );
+
  private:
   static void SetEventQueue( EventQueue* inpQueue )
     { spQueue = inpQueue; }
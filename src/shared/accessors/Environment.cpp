@@ -448,6 +448,21 @@ EnvironmentBase::OptionalState( const std::string& inName, State::ValueType inDe
   return StateRef( pState, pStatevector, 0, inDefaultValue );
 }
 
+// Resolve a state for repeated access.
+StateHandle
+EnvironmentBase::ResolveState( const std::string& inName ) const
+{
+  const class State* pState = State( inName ).operator->();
+  return StateHandle( pState, pState ? static_cast<StateVector*>( Statevector ) : NULL );
+}
+
+StateHandle
+EnvironmentBase::ResolveOptionalState( const std::string& inName, State::ValueType inDefaultValue ) const
+{
+  const class State* pState = OptionalState( inName, inDefaultValue ).operator->();
+  return StateHandle( pState, pState ? static_cast<StateVector*>( Statevector ) : NULL, inDefaultValue );
+}
+
 const StateList*
 EnvironmentBase::StateListAccess() const
 {
@@ -233,6 +233,10 @@ class EnvironmentBase
   // Read-only access to states that are not required.
   // The second argument is a default value.
   StateRef OptionalState( const std::string& name, State::ValueType defaultValue = 0 ) const;
+  // Resolve states once, e.g. during Initialize(), for repeated access from
+  // Process() without name lookup. Access checks are done when resolving.
+  StateHandle ResolveState( const std::string& name ) const;
+  StateHandle ResolveOptionalState( const std::string& name, State::ValueType defaultValue = 0 ) const;
 
  private:
   const StateList* StateListAccess() const;
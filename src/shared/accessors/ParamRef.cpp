@@ -44,14 +44,7 @@ ParamRef::ToNumber() const
   if( mpParam )
   {
     const Param* p = mpParam;
-    const std::string& val = p->Value( index( mIdx1 ), index( mIdx2 ) );
-    result = std::atof( val.c_str() );
-    if( result == 0.0 )
-    {
-      uint64_t n = 0;
-      if( std::istringstream( val ) >> std::hex >> n )
-        result = static_cast<double>( n );
-    }
+    result = p->Value( index( mIdx1 ), index( mIdx2 ) ).ToNumber();
   }
   return result;
 }
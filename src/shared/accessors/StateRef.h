@@ -4,6 +4,8 @@
 // Description: A class that holds references to state values, and
 //         allows for convenient automatic type
 //         conversions when accessing state values.
+//         A StateHandle holds a state that has been resolved once,
+//         and creates StateRefs to it without any name lookup.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -39,6 +41,11 @@ class StateRef
             StateVector*,
             int sample,
             long defaultValue = 0 );
+  StateRef( const State*,
+            StateVector*,
+            int sample,
+            long defaultValue,
+            const StateAccessor& );
   StateRef& operator=( const StateRef& );
   const StateRef& operator=( long );
   operator long() const;
@@ -54,6 +61,27 @@ class StateRef
   StateVector* mpStateVector;
   int          mSample;
   long         mDefaultValue;
+  StateAccessor mAccessor;
+};
+
+class StateHandle
+{
+ public:
+  StateHandle();
+  StateHandle( const State*,
+               StateVector*,
+               long defaultValue = 0 );
+  // Access to the state's value at the given sample position.
+  StateRef operator()( size_t sample = 0 ) const;
+  const State* operator->() const;
+  // True if the handle refers to an existing state.
+  bool IsValid() const;
+
+ private:
+  const State* mpState;
+  StateVector* mpStateVector;
+  long         mDefaultValue;
+  StateAccessor mAccessor;
 };
 
 class StateRefFloat
@@ -95,7 +123,22 @@ StateRef::StateRef( const State* inState,
 : mpState( inState ),
   mpStateVector( inStateVector ),
   mSample( inSample ),
-  mDefaultValue( inDefaultValue )
+  mDefaultValue( inDefaultValue ),
+  mAccessor( inState ? StateAccessor( *inState ) : StateAccessor() )
+{
+}
+
+inline
+StateRef::StateRef( const State* inState,
+                    StateVector* inStateVector,
+                    int inSample,
+                    long inDefaultValue,
+                    const StateAccessor& inAccessor )
+: mpState( inState ),
+  mpStateVector( inStateVector ),
+  mSample( inSample ),
+  mDefaultValue( inDefaultValue ),
+  mAccessor( inAccessor )
 {
 }
 
@@ -112,7 +155,7 @@ const StateRef&
 StateRef::operator=( long inValue )
 {
   if( mpState != NULL && mpStateVector != NULL )
-    mpStateVector->SetStateValue( mpState->Location(), mpState->Length(), mSample, inValue );
+    mpStateVector->SetStateValue( mAccessor, mSample, inValue );
   return *this;
 }
 
@@ -121,7 +164,7 @@ StateRef::operator long() const
 {
   long value = mDefaultValue;
   if( mpStateVector != NULL )
-    value = mpStateVector->StateValue( mpState->Location(), mpState->Length(), mSample );
+    value = mpStateVector->StateValue( mAccessor, mSample );
   return value;
 }
 
@@ -129,7 +172,7 @@ inline
 StateRef
 StateRef::operator()( size_t inOffset ) const
 {
-  return StateRef( mpState, mpStateVector, static_cast<int>( mSample + inOffset ), mDefaultValue );
+  return StateRef( mpState, mpStateVector, static_cast<int>( mSample + inOffset ), mDefaultValue, mAccessor );
 }
 
 inline
@@ -139,6 +182,46 @@ StateRef::operator->() const
   return mpState;
 }
 
+inline
+StateHandle::StateHandle()
+: mpState( NULL ),
+  mpStateVector( NULL ),
+  mDefaultValue( 0 )
+{
+}
+
+inline
+StateHandle::StateHandle( const State* inState,
+                          StateVector* inStateVector,
+                          long inDefaultValue )
+: mpState( inState ),
+  mpStateVector( inStateVector ),
+  mDefaultValue( inDefaultValue ),
+  mAccessor( inState ? StateAccessor( *inState ) : StateAccessor() )
+{
+}
+
+inline
+StateRef
+StateHandle::operator()( size_t inSample ) const
+{
+  return StateRef( mpState, mpStateVector, static_cast<int>( inSample ), mDefaultValue, mAccessor );
+}
+
+inline
+const State*
+StateHandle::operator->() const
+{
+  return mpState;
+}
+
+inline
+bool
+StateHandle::IsValid() const
+{
+  return mpState != NULL && mpStateVector != NULL;
+}
+
 inline
 StateRefFloat
 StateRef::AsFloat()
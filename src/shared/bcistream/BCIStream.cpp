@@ -35,6 +35,11 @@
 #include "ParamList.h"
 #include "ParamRef.h"
 #include "RedirectIO.h"
+#include "LockfreeQueue.h"
+#include "Thread.h"
+#include "OSMutex.h"
+#include "PrecisionTime.h"
+#include "UnitTest.h"
 #include <set>
 #include <ctime>
 
@@ -68,8 +73,51 @@ class MessageDispatcher : public Dispatcher
   string mPrevMessage;
 };
 
+// Deferred messages are queued without locking, and dispatched from a
+// background thread. The queue is polled, so queueing a message does not
+// involve a system call.
+class MessageQueue : private Thread
+{
+ public:
+  enum
+  {
+    MaxPending = 4096,
+    PollingInterval = 10, // ms
+    MaxDelay = 1000, // ms, longer delays are noted in the message
+  };
+  MessageQueue();
+  ~MessageQueue();
+  // May be called from any thread. Returns false if there is no queue.
+  static bool Defer( Dispatcher*, const string& context, const string& message );
+  static void DispatchPending();
+
+  void Push( Dispatcher*, const string& context, const string& message );
+  void Drain();
+  const LockableObject& ConsumerLock() const { return mConsumerLock; }
+
+ private:
+  int OnExecute();
+
+  struct Record
+  {
+    long long time; // ns
+    Dispatcher* pDispatcher;
+    string context, message;
+  };
+  LockfreeQueue<Record> mQueue;
+  Lockable<OSMutex> mConsumerLock;
+  volatile int32_t mPending, mDropped, mStarted;
+
+  static MessageQueue* spInstance;
+};
+
 } // namespace
 
+// The message queue must be constructed before, and destructed after,
+// the OutStreams.
+MessageQueue* MessageQueue::spInstance = 0;
+static MessageQueue sMessageQueue;
+
 // Make sure ios_base is properly initialized before our OutStreams are
 // constructed.
 static ios_base::Init ios_base_Init_;
@@ -117,6 +165,7 @@ OutStream::OutStream( Action f, int level )
 OutStream::~OutStream()
 {
   mBuf.SetDispatcher( 0 );
+  DispatchPendingMessages();
   delete mpDispatcher;
 }
 
@@ -126,6 +175,7 @@ OutStream::SetAction( Action inAction )
   if( mpDispatcher && mpDispatcher->Action() != inAction )
   {
     mBuf.SetDispatcher( 0 );
+    DispatchPendingMessages();
     delete mpDispatcher;
     mpDispatcher = 0;
   }
@@ -246,7 +296,14 @@ OutStream::StringBuf::Flush()
     s = s.substr( 0, pos ) + s.substr( pos + 1 );
 
   if( mpDispatcher )
+  {
+    Action action = mpDispatcher->Action();
+    bool deferred = ( action == &DebugMessage || action == &PlainMessage || action == &Warning );
+    if( deferred && DeferMessages() && MessageQueue::Defer( mpDispatcher, mContext, s ) )
+      return;
+    MessageQueue::DispatchPending();
     mpDispatcher->Dispatch( mContext, s );
+  }
 }
 
 int
@@ -260,6 +317,12 @@ OutStream::StringBuf::sync()
   return r;
 }
 
+void
+BCIStream::DispatchPendingMessages()
+{
+  MessageQueue::DispatchPending();
+}
+
 // Dispatcher
 void
 Dispatcher::Dispatch( const string& inContext, const string& inMessage )
@@ -382,3 +445,128 @@ MessageDispatcher::GlobalMutex()
   static Lockable<> mLock;
   return mLock;
 }
+
+// MessageQueue
+MessageQueue::MessageQueue()
+: mPending( 0 ),
+  mDropped( 0 ),
+  mStarted( 0 )
+{
+  if( !spInstance )
+    spInstance = this;
+}
+
+MessageQueue::~MessageQueue()
+{
+  if( spInstance == this )
+    spInstance = 0;
+  TerminateWait();
+  Drain();
+}
+
+bool
+MessageQueue::Defer( Dispatcher* inpDispatcher, const string& inContext, const string& inMessage )
+{
+  if( !spInstance )
+    return false;
+  spInstance->Push( inpDispatcher, inContext, inMessage );
+  return true;
+}
+
+void
+MessageQueue::DispatchPending()
+{
+  if( spInstance )
+    spInstance->Drain();
+}
+
+void
+MessageQueue::Push( Dispatcher* inpDispatcher, const string& inContext, const string& inMessage )
+{
+  if( Atomic( mPending )++ >= MaxPending )
+  {
+    Atomic( mPending )--;
+    Atomic( mDropped )++;
+    return;
+  }
+  Record r = { PrecisionTime::Nanoseconds(), inpDispatcher, inContext, inMessage };
+  mQueue.Produce( r );
+  if( !mStarted && Atomic( mStarted ).IfEqual( 0 ).Exchange( 1 ) == 0 )
+    Thread::Start();
+}
+
+void
+MessageQueue::Drain()
+{
+  Lock _( mConsumerLock );
+  while( !mQueue.Empty() )
+  {
+    // Remove the record before dispatching it, in case dispatching results
+    // in another call to Drain().
+    Record r = *mQueue.Front();
+    mQueue.Pop();
+    Atomic( mPending )--;
+    int dropped = Atomic( mDropped ).Exchange( 0 );
+    if( dropped > 0 )
+    {
+      ostringstream oss;
+      oss << dropped << " messages dropped because the message queue was full";
+      r.pDispatcher->Dispatch( "", oss.str() );
+    }
+    long long delay = ( PrecisionTime::Nanoseconds() - r.time ) / 1000000;
+    if( delay > MaxDelay )
+    {
+      if( !r.message.empty() && *r.message.rbegin() == '\n' )
+        r.message.erase( r.message.length() - 1 );
+      ostringstream oss;
+      oss << " (delayed by " << delay << "ms)";
+      r.message += oss.str();
+    }
+    r.pDispatcher->Dispatch( r.context, r.message );
+  }
+}
+
+int
+MessageQueue::OnExecute()
+{
+  while( !IsTerminating() )
+  {
+    ThreadUtils::SleepFor( PollingInterval );
+    Drain();
+  }
+  return 0;
+}
+
+namespace {
+
+int sCount = 0;
+void CountMessage( const string& )
+{
+  ++sCount;
+}
+
+} // namespace
+
+UnitTest( BCIStreamMessageQueueTest )
+{
+  const int count = MessageQueue::MaxPending / 2;
+  Dispatcher dispatcher( &CountMessage );
+  string message = "Test message, block 12345";
+  MessageQueue queue;
+  // Holding the consumer lock keeps the background thread from draining
+  // the queue. Drain() re-acquires the lock from the same thread.
+  Lock _( queue.ConsumerLock() );
+  sCount = 0;
+  for( int i = 0; i < count; ++i )
+    queue.Push( &dispatcher, "Context: ", message );
+  TestFail_if( sCount != 0, "messages were dispatched when queued" );
+  queue.Drain();
+  TestFail_if( sCount != count, sCount );
+
+  // When the queue is full, messages are dropped, and reported as a single message.
+  sCount = 0;
+  for( int i = 0; i < 2 * MessageQueue::MaxPending; ++i )
+    queue.Push( &dispatcher, "", message );
+  queue.Drain();
+  TestFail_if( sCount != MessageQueue::MaxPending + 1, sCount );
+}
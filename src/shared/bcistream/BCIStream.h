@@ -85,6 +85,11 @@ namespace BCIStream
 {
   // Stream message handling actions for bcierr/bciout/bciwarn/bcidebug
   bool CompressMessages();
+  // When DeferMessages() returns true, debug messages, plain messages, and
+  // warnings are queued, and dispatched from a background thread. Errors are
+  // dispatched immediately, after any pending messages.
+  bool DeferMessages();
+  void DispatchPendingMessages();
   typedef void (*Action)( const std::string& );
   void DebugMessage( const std::string& );
   void PlainMessage( const std::string& );
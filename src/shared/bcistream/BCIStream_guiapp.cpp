@@ -88,6 +88,12 @@ BCIStream::CompressMessages()
   return false;
 }
 
+bool
+BCIStream::DeferMessages()
+{
+  return false;
+}
+
 void
 BCIStream::PlainMessage( const string& message )
 {
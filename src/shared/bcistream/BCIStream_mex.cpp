@@ -36,6 +36,12 @@ BCIStream::CompressMessages()
   return false;
 }
 
+bool
+BCIStream::DeferMessages()
+{
+  return false;
+}
+
 void
 BCIStream::PlainMessage( const string& s )
 {
@@ -39,6 +39,7 @@ static MessageChannel* spChannel = NULL;
 void
 BCIStream::SetOutputChannel( MessageChannel* pChannel )
 {
+  BCIStream::DispatchPendingMessages();
   spChannel = pChannel;
 }
 
@@ -48,6 +49,12 @@ BCIStream::CompressMessages()
   return true;
 }
 
+bool
+BCIStream::DeferMessages()
+{
+  return true;
+}
+
 #if _WIN32
 static void
 ShowMessageBox( const string& inText, const string& inTitle, unsigned int inFlags )
@@ -44,6 +44,12 @@ BCIStream::CompressMessages()
   return false;
 }
 
+bool
+BCIStream::DeferMessages()
+{
+  return false;
+}
+
 void
 BCIStream::PlainMessage( const string& s )
 {
@@ -0,0 +1,532 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A std::streambuf that writes a file from a separate thread.
+//
+// $BEGIN_BCI2000_LICENSE$
+// 
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+// 
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+// 
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "AsyncFilebuf.h"
+#include "PrecisionTime.h"
+
+#if _WIN32
+# include <Windows.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <cerrno>
+#endif // _WIN32
+
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+
+double
+Now()
+{
+  return 1e-9 * PrecisionTime::Nanoseconds();
+}
+
+double
+Percentile( vector<float>& ioSorted, double inP )
+{
+  if( ioSorted.empty() )
+    return 0;
+  size_t i = static_cast<size_t>( inP * ( ioSorted.size() - 1 ) + 0.5 );
+  return ioSorted[i];
+}
+
+} // namespace
+
+AsyncFilebuf::Statistics::Statistics()
+: bytes( 0 ),
+  writes( 0 ),
+  checkpoints( 0 ),
+  stalls( 0 ),
+  maxPendingBuffers( 0 ),
+  latency50( 0 ),
+  latency95( 0 ),
+  latency99( 0 ),
+  latencyMax( 0 ),
+  checkpointMax( 0 )
+{
+}
+
+AsyncFilebuf::AsyncFilebuf()
+: mBufferSize( DefaultBufferSize ),
+  mNumBuffers( DefaultNumBuffers ),
+  mPreallocation( 0 ),
+  mCheckpointInterval( 0 ),
+  mOpen( false ),
+  mpCurrent( 0 ),
+  mOffset( 0 ),
+  mEnd( 0 ),
+  mCheckpointRequest( false ),
+  mFailed( false ),
+  mAllocated( 0 ),
+  mCheckpoints( 0 ),
+  mStalls( 0 ),
+  mMaxPending( 0 ),
+  mBytes( 0 ),
+  mCheckpointMax( 0 )
+{
+  setp( 0, 0 );
+}
+
+AsyncFilebuf::~AsyncFilebuf()
+{
+  Close();
+}
+
+AsyncFilebuf&
+AsyncFilebuf::SetBufferSize( size_t inSize )
+{
+  mBufferSize = max<size_t>( ( inSize + Alignment - 1 ) / Alignment, 1 ) * Alignment;
+  return *this;
+}
+
+AsyncFilebuf&
+AsyncFilebuf::SetNumBuffers( int inCount )
+{
+  mNumBuffers = max( inCount, 2 );
+  return *this;
+}
+
+AsyncFilebuf&
+AsyncFilebuf::SetPreallocation( long long inBytes )
+{
+  mPreallocation = max( inBytes, 0LL );
+  return *this;
+}
+
+AsyncFilebuf&
+AsyncFilebuf::SetCheckpointInterval( double inSeconds )
+{
+  mCheckpointInterval = max( inSeconds, 0.0 );
+  return *this;
+}
+
+bool
+AsyncFilebuf::IsOpen() const
+{
+  return mOpen;
+}
+
+bool
+AsyncFilebuf::Open( const string& inName )
+{
+  Close();
+#if _WIN32
+  mFile = ::CreateFileA( inName.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                         CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+  if( mFile == INVALID_HANDLE_VALUE )
+    return false;
+#else
+  mFile = ::open( inName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+  if( mFile < 0 )
+    return false;
+#endif // _WIN32
+
+  mMemory.resize( mNumBuffers * mBufferSize + Alignment );
+  size_t misalignment = reinterpret_cast<size_t>( &mMemory[0] ) % Alignment;
+  char* pAligned = &mMemory[0] + ( Alignment - misalignment ) % Alignment;
+  mBuffers.resize( mNumBuffers );
+  mPending.clear();
+  mFree.clear();
+  for( int i = 0; i < mNumBuffers; ++i )
+  {
+    mBuffers[i].data = pAligned + i * mBufferSize;
+    mBuffers[i].length = 0;
+    mBuffers[i].offset = 0;
+    mFree.push_back( &mBuffers[i] );
+  }
+  mFreeEvent.Set();
+  mPendingEvent.Reset();
+  mIdleEvent.Set();
+  mpCurrent = 0;
+  setp( 0, 0 );
+  mOffset = 0;
+  mEnd = 0;
+  mCheckpointRequest = false;
+  mFailed = false;
+  mAllocated = 0;
+  mLatencies.clear();
+  mCheckpoints = 0;
+  mStalls = 0;
+  mMaxPending = 0;
+  mBytes = 0;
+  mCheckpointMax = 0;
+
+  mOpen = true;
+  Thread::Start();
+  return true;
+}
+
+bool
+AsyncFilebuf::Close()
+{
+  if( !mOpen )
+    return !mFailed;
+  if( mCheckpointInterval > 0 )
+    Checkpoint();
+  else
+  {
+    Submit();
+    WaitIdle();
+  }
+  SharedPointer<Waitable> pTerminationEvent = Thread::Terminate();
+  mPendingEvent.Set();
+  pTerminationEvent->Wait();
+#if _WIN32
+  ::CloseHandle( mFile );
+#else
+  if( mAllocated > mEnd ) // release space allocated beyond the end of data
+    ::ftruncate( mFile, mEnd );
+  ::close( mFile );
+#endif // _WIN32
+  mOpen = false;
+  return !mFailed;
+}
+
+bool
+AsyncFilebuf::Checkpoint()
+{
+  if( !mOpen )
+    return false;
+  Submit();
+  {
+    Lock _( mLock );
+    mCheckpointRequest = true;
+    mIdleEvent.Reset();
+    mPendingEvent.Set();
+  }
+  WaitIdle();
+  return !mFailed;
+}
+
+AsyncFilebuf::Statistics
+AsyncFilebuf::GetStatistics() const
+{
+  Statistics s;
+  vector<float> latencies;
+  {
+    Lock _( mLock );
+    latencies = mLatencies;
+    s.bytes = mBytes;
+    s.checkpoints = mCheckpoints;
+    s.checkpointMax = mCheckpointMax;
+    s.maxPendingBuffers = mMaxPending;
+    s.stalls = mStalls;
+  }
+  s.writes = static_cast<int>( latencies.size() );
+  sort( latencies.begin(), latencies.end() );
+  s.latency50 = Percentile( latencies, 0.5 );
+  s.latency95 = Percentile( latencies, 0.95 );
+  s.latency99 = Percentile( latencies, 0.99 );
+  s.latencyMax = latencies.empty() ? 0 : latencies.back();
+  return s;
+}
+
+// Writing thread
+AsyncFilebuf::int_type
+AsyncFilebuf::overflow( int_type c )
+{
+  if( !mOpen || mFailed )
+    return traits_type::eof();
+  if( mpCurrent && pptr() == epptr() )
+    Submit();
+  if( !mpCurrent && !AcquireBuffer() )
+    return traits_type::eof();
+  if( !traits_type::eq_int_type( c, traits_type::eof() ) )
+  {
+    *pptr() = traits_type::to_char_type( c );
+    pbump( 1 );
+  }
+  return traits_type::not_eof( c );
+}
+
+streamsize
+AsyncFilebuf::xsputn( const char* s, streamsize n )
+{
+  streamsize written = 0;
+  while( written < n )
+  {
+    if( pptr() == epptr() && traits_type::eq_int_type( overflow( traits_type::eof() ), traits_type::eof() ) )
+      break;
+    streamsize count = min<streamsize>( n - written, epptr() - pptr() );
+    ::memcpy( pptr(), s + written, static_cast<size_t>( count ) );
+    pbump( static_cast<int>( count ) );
+    written += count;
+  }
+  return written;
+}
+
+int
+AsyncFilebuf::sync()
+{
+  Submit();
+  return mFailed ? -1 : 0;
+}
+
+AsyncFilebuf::pos_type
+AsyncFilebuf::seekoff( off_type inOffset, ios_base::seekdir inDir, ios_base::openmode inWhich )
+{
+  if( !mOpen || !( inWhich & ios_base::out ) )
+    return pos_type( off_type( -1 ) );
+  long long current = mOffset + ( pptr() - pbase() );
+  switch( inDir )
+  {
+    case ios_base::beg:
+      return seekpos( pos_type( inOffset ), inWhich );
+    case ios_base::cur:
+      return seekpos( pos_type( current + inOffset ), inWhich );
+    case ios_base::end:
+      return seekpos( pos_type( max( mEnd, current ) + inOffset ), inWhich );
+    default:
+      ;
+  }
+  return pos_type( off_type( -1 ) );
+}
+
+AsyncFilebuf::pos_type
+AsyncFilebuf::seekpos( pos_type inPos, ios_base::openmode inWhich )
+{
+  long long pos = static_cast<off_type>( inPos );
+  if( !mOpen || !( inWhich & ios_base::out ) || pos < 0 )
+    return pos_type( off_type( -1 ) );
+  if( pos != mOffset + ( pptr() - pbase() ) )
+  { // Buffers are written in order of submission, so data written after
+    // seeking will overwrite data written before.
+    Submit();
+    mOffset = pos;
+  }
+  return inPos;
+}
+
+void
+AsyncFilebuf::Submit()
+{
+  if( !mpCurrent )
+    return;
+  size_t length = pptr() - pbase();
+  Lock _( mLock );
+  if( length > 0 )
+  {
+    mpCurrent->length = length;
+    mpCurrent->offset = mOffset;
+    mOffset += length;
+    mEnd = max( mEnd, mOffset );
+    mPending.push_back( mpCurrent );
+    mMaxPending = max( mMaxPending, static_cast<int>( mPending.size() ) );
+    mIdleEvent.Reset();
+    mPendingEvent.Set();
+  }
+  else
+  {
+    mFree.push_front( mpCurrent );
+    mFreeEvent.Set();
+  }
+  mpCurrent = 0;
+  setp( 0, 0 );
+}
+
+bool
+AsyncFilebuf::AcquireBuffer()
+{
+  bool stalled = false;
+  while( !mpCurrent )
+  {
+    {
+      Lock _( mLock );
+      if( !mFree.empty() )
+      {
+        mpCurrent = mFree.front();
+        mFree.pop_front();
+      }
+      else
+        mFreeEvent.Reset();
+    }
+    if( !mpCurrent )
+    {
+      stalled = true;
+      mFreeEvent.Wait();
+    }
+  }
+  if( stalled )
+  {
+    Lock _( mLock );
+    ++mStalls;
+  }
+  setp( mpCurrent->data, mpCurrent->data + mBufferSize );
+  return true;
+}
+
+bool
+AsyncFilebuf::WaitIdle()
+{
+  return mIdleEvent.Wait();
+}
+
+// I/O thread
+int
+AsyncFilebuf::OnExecute()
+{
+  double lastCheckpoint = Now();
+  bool dirty = false;
+  while( true )
+  {
+    Buffer* pBuffer = 0;
+    bool checkpoint = false;
+    {
+      Lock _( mLock );
+      if( !mPending.empty() )
+        pBuffer = mPending.front();
+      else if( mCheckpointRequest )
+      {
+        checkpoint = true;
+        mCheckpointRequest = false;
+      }
+      else
+      {
+        mPendingEvent.Reset();
+        mIdleEvent.Set();
+        if( IsTerminating() )
+          break;
+      }
+    }
+    if( pBuffer )
+    {
+      WriteBuffer( *pBuffer );
+      dirty = true;
+      Lock _( mLock );
+      mPending.pop_front();
+      mFree.push_back( pBuffer );
+      mFreeEvent.Set();
+    }
+    if( mCheckpointInterval > 0 && dirty && Now() - lastCheckpoint >= mCheckpointInterval )
+      checkpoint = true;
+    if( checkpoint )
+    {
+      SyncFile();
+      lastCheckpoint = Now();
+      dirty = false;
+    }
+    if( !pBuffer && !checkpoint )
+    {
+      int timeout = Tiny::InfiniteTimeout;
+      if( mCheckpointInterval > 0 && dirty )
+        timeout = max( 0, static_cast<int>( 1e3 * ( lastCheckpoint + mCheckpointInterval - Now() ) ) + 1 );
+      mPendingEvent.Wait( timeout );
+    }
+  }
+  return 0;
+}
+
+bool
+AsyncFilebuf::WriteBuffer( const Buffer& inBuffer )
+{
+  if( mFailed )
+    return false;
+  long long end = inBuffer.offset + inBuffer.length;
+  if( mPreallocation > 0 && end > mAllocated )
+    Preallocate( end + mPreallocation );
+
+  double t = Now();
+  const char* p = inBuffer.data;
+  size_t remaining = inBuffer.length;
+  long long offset = inBuffer.offset;
+  bool ok = true;
+  while( ok && remaining > 0 )
+  {
+#if _WIN32
+    OVERLAPPED overlapped = { 0 };
+    overlapped.Offset = static_cast<DWORD>( offset & 0xffffffff );
+    overlapped.OffsetHigh = static_cast<DWORD>( offset >> 32 );
+    DWORD written = 0;
+    ok = ::WriteFile( mFile, p, static_cast<DWORD>( remaining ), &written, &overlapped )
+         && written > 0;
+#else
+    ssize_t written = ::pwrite( mFile, p, remaining, offset );
+    if( written < 0 )
+    { // Retry only if interrupted by a signal.
+      ok = ( errno == EINTR );
+      written = 0;
+    }
+    else
+      ok = ( written > 0 ); // no progress would loop forever
+#endif // _WIN32
+    p += written;
+    offset += written;
+    remaining -= written;
+  }
+  double latency = 1e3 * ( Now() - t );
+
+  Lock _( mLock );
+  mLatencies.push_back( static_cast<float>( latency ) );
+  mBytes += inBuffer.length;
+  if( !ok )
+    mFailed = true;
+  return ok;
+}
+
+bool
+AsyncFilebuf::Preallocate( long long inEnd )
+{ // Allocate space without changing the file's size, so readers will not see
+  // the preallocated space as data.
+  bool ok = false;
+#if __linux__
+  ok = ( 0 == ::fallocate( mFile, FALLOC_FL_KEEP_SIZE, mAllocated, inEnd - mAllocated ) );
+#elif _WIN32 && _WIN32_WINNT >= 0x0600
+  FILE_ALLOCATION_INFO info;
+  info.AllocationSize.QuadPart = inEnd;
+  ok = ::SetFileInformationByHandle( mFile, FileAllocationInfo, &info, sizeof( info ) );
+#endif
+  if( ok )
+    mAllocated = inEnd;
+  else // don't try again
+    mAllocated = numeric_limits<long long>::max();
+  return ok;
+}
+
+bool
+AsyncFilebuf::SyncFile()
+{
+  double t = Now();
+#if _WIN32
+  bool ok = ::FlushFileBuffers( mFile );
+#elif __linux__
+  bool ok = ( 0 == ::fdatasync( mFile ) );
+#else
+  bool ok = ( 0 == ::fsync( mFile ) );
+#endif
+  double duration = 1e3 * ( Now() - t );
+
+  Lock _( mLock );
+  ++mCheckpoints;
+  mCheckpointMax = max( mCheckpointMax, duration );
+  if( !ok )
+    mFailed = true;
+  return ok;
+}
@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A std::streambuf that writes a file from a separate thread.
+//   Output is collected into large buffers, which are written by the I/O thread
+//   at explicit file offsets, so seeking does not need to wait for pending
+//   writes. When the writing thread gets ahead of the I/O thread by the number
+//   of available buffers, it blocks until a buffer has been written.
+//   File space is preallocated ahead of the write position where the OS
+//   supports this without changing the file size. Optionally, data are made
+//   durable in regular intervals ("checkpoints").
+//   Write latencies and the number of pending buffers are recorded, and
+//   available as statistics.
+//
+//
+// $BEGIN_BCI2000_LICENSE$
+// 
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+// 
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+// 
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef ASYNC_FILEBUF_H
+#define ASYNC_FILEBUF_H
+
+#include "Thread.h"
+#include "Waitable.h"
+#include "Lockable.h"
+#include "Mutex.h"
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <deque>
+
+class AsyncFilebuf : public std::streambuf, private Thread
+{
+ public:
+  enum
+  {
+    Alignment = 4096,
+    DefaultBufferSize = 1024 * 1024,
+    DefaultNumBuffers = 8,
+  };
+
+  struct Statistics
+  {
+    Statistics();
+    long long bytes;
+    int writes,
+        checkpoints,
+        stalls,            // number of times the writing thread had to wait for a buffer
+        maxPendingBuffers;
+    double latency50,      // write latency percentiles in ms
+           latency95,
+           latency99,
+           latencyMax,
+           checkpointMax;  // maximum duration of a checkpoint in ms
+  };
+
+  AsyncFilebuf();
+  ~AsyncFilebuf();
+
+  // Settings take effect when a file is opened.
+  // The buffer size is rounded up to a multiple of the alignment.
+  AsyncFilebuf& SetBufferSize( size_t );
+  AsyncFilebuf& SetNumBuffers( int );
+  // Amount of file space to allocate ahead of the write position, 0 to disable.
+  AsyncFilebuf& SetPreallocation( long long bytes );
+  // Interval between checkpoints, 0 to disable.
+  AsyncFilebuf& SetCheckpointInterval( double seconds );
+
+  // Truncates an existing file.
+  bool Open( const std::string& );
+  // Writes pending data, and closes the file. Returns false if there
+  // was an error at any time since the file was opened.
+  bool Close();
+  bool IsOpen() const;
+  // Waits until all data have been written, and makes them durable.
+  bool Checkpoint();
+  bool Failed() const
+    { return mFailed; }
+
+  // Statistics refer to the current or most recently closed file.
+  Statistics GetStatistics() const;
+
+ protected:
+  int_type overflow( int_type );
+  std::streamsize xsputn( const char*, std::streamsize );
+  int sync();
+  pos_type seekoff( off_type, std::ios_base::seekdir, std::ios_base::openmode );
+  pos_type seekpos( pos_type, std::ios_base::openmode );
+
+ private:
+  struct Buffer
+  {
+    char* data;
+    size_t length;
+    long long offset;
+  };
+  void Submit();
+  bool AcquireBuffer();
+  bool WaitIdle();
+
+  int OnExecute();
+  bool WriteBuffer( const Buffer& );
+  bool Preallocate( long long end );
+  bool SyncFile();
+
+  size_t mBufferSize;
+  int mNumBuffers;
+  long long mPreallocation;
+  double mCheckpointInterval;
+
+#if _WIN32
+  typedef void* FileHandle;
+#else
+  typedef int FileHandle;
+#endif
+  FileHandle mFile;
+  bool mOpen;
+  std::vector<char> mMemory;
+  Buffer* mpCurrent;
+  long long mOffset, // file offset of the current buffer
+            mEnd;    // end of data submitted so far
+  Lockable<Mutex> mLock;
+  std::deque<Buffer*> mPending,
+                      mFree;
+  std::vector<Buffer> mBuffers;
+  Waitable mPendingEvent,
+           mFreeEvent,
+           mIdleEvent;
+  bool mCheckpointRequest,
+       mFailed;
+  long long mAllocated;
+
+  std::vector<float> mLatencies;
+  int mCheckpoints,
+      mStalls,
+      mMaxPending;
+  long long mBytes;
+  double mCheckpointMax;
+};
+
+#endif // ASYNC_FILEBUF_H
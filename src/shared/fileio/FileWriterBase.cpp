@@ -28,13 +28,19 @@
 #pragma hdrstop
 
 #include "FileWriterBase.h"
+#include "AsyncFilebuf.h"
 #include "BCIStream.h"
 #include "FileUtils.h"
 #include "ClassName.h"
+#include "Thread.h"
+#include "Waitable.h"
+#include "PrecisionTime.h"
 
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <algorithm>
 
 using namespace std;
 
@@ -48,27 +54,158 @@ ParameterFile( const string& inDataFile )
        + bciParameterExtension;
 }
 
+// A block of data, shared between all outputs. Blocks are kept unencoded, as
+// each output format encodes data in its own way.
+struct FileWriterBase::Block
+{
+  Block( const GenericSignal& inSignal, const StateVector& inStatevector )
+  : signal( inSignal ), statevector( inStatevector )
+  {}
+  GenericSignal signal;
+  StateVector   statevector;
+};
+
+// An output format together with its file, and a thread that writes queued
+// blocks into the file.
+class FileWriterBase::Output : private Thread
+{
+ public:
+  Output( FileWriterBase& inParent, GenericOutputFormat& inFormat )
+  : mrParent( inParent ),
+    mrFormat( inFormat ),
+    mStream( &mFilebuf ),
+    mPosition( 0 ),
+    mEncodingTime( 0 )
+  {}
+  ~Output()
+  { Halt(); }
+
+  GenericOutputFormat& Format()
+  { return mrFormat; }
+  const GenericOutputFormat& Format() const
+  { return mrFormat; }
+  AsyncFilebuf& Filebuf()
+  { return mFilebuf; }
+  const AsyncFilebuf& Filebuf() const
+  { return mFilebuf; }
+  const string& FileName() const
+  { return mFileName; }
+  // Time spent in the output format's Write() function, in ms.
+  double EncodingTime() const
+  { return mEncodingTime; }
+
+  void Close()
+  {
+    mFilebuf.Close();
+    mStream.clear();
+  }
+  void StartRun( const string& inFileName )
+  {
+    Close();
+    mFileName = inFileName;
+    if( !mFilebuf.Open( mFileName ) )
+      mStream.setstate( ios::failbit );
+    mrFormat.StartRun( mStream, mFileName );
+    mPosition = 0;
+    mEncodingTime = 0;
+    Thread::Start();
+  }
+  bool StopRun()
+  {
+    mrFormat.StopRun( mStream );
+    // Closing flushes buffered data, so the file is complete only if
+    // closing, and all previous writes, succeeded.
+    bool ok = mFilebuf.Close() && mStream;
+    mStream.clear();
+    return ok;
+  }
+  void Halt()
+  {
+    SharedPointer<Waitable> pTerminationEvent = Thread::Terminate();
+    mEvent.Set();
+    pTerminationEvent->Wait();
+  }
+
+ private:
+  int OnExecute()
+  {
+    bool reported = false;
+    const Block* pBlock = 0;
+    // When terminating, write remaining blocks before exiting.
+    while( ( pBlock = mrParent.NextBlock( *this ) ) || !IsTerminating() )
+    {
+      if( !pBlock )
+        mEvent.Wait();
+      else
+      {
+        long long t = PrecisionTime::Nanoseconds();
+        mrFormat.Write( mStream, pBlock->signal, pBlock->statevector );
+        mEncodingTime += 1e-6 * ( PrecisionTime::Nanoseconds() - t );
+        mrParent.ReleaseBlock( *this );
+        if( !mStream && !reported )
+        {
+          mrParent.OnWriteError( *this );
+          reported = true;
+        }
+      }
+    }
+    return 0;
+  }
+
+  friend class FileWriterBase;
+  FileWriterBase&      mrParent;
+  GenericOutputFormat& mrFormat;
+  string               mFileName;
+  AsyncFilebuf         mFilebuf;
+  ostream              mStream;
+  Waitable             mEvent;
+  long long            mPosition; // index of the next block to write
+  double               mEncodingTime;
+};
+
 
 FileWriterBase::FileWriterBase( GenericOutputFormat& inOutputFormat )
-: mrOutputFormat( inOutputFormat )
+: mQueueBegin( 0 ),
+  mMaxQueueDepth( 0 )
+{
+  AddOutputFormat( inOutputFormat );
+}
+
+FileWriterBase::FileWriterBase()
+: mQueueBegin( 0 ),
+  mMaxQueueDepth( 0 )
 {
 }
 
 FileWriterBase::~FileWriterBase()
 {
   Halt();
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+    delete mOutputs[i];
+  ClearQueue();
+}
+
+void
+FileWriterBase::AddOutputFormat( GenericOutputFormat& inOutputFormat )
+{
+  mOutputs.push_back( new Output( *this, inOutputFormat ) );
 }
 
 void
 FileWriterBase::Publish()
 {
-  mrOutputFormat.Publish();
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+    mOutputs[i]->Format().Publish();
 
-  string ext = mrOutputFormat.DataFileExtension();
-  size_t i = 0;
-  while( i < ext.length() && ::ispunct( ext[i] ) )
-    ++i;
-  string formatName = ext.substr( i );
+  string formatName;
+  if( !mOutputs.empty() )
+  {
+    string ext = mOutputs.front()->Format().DataFileExtension();
+    size_t i = 0;
+    while( i < ext.length() && ::ispunct( ext[i] ) )
+      ++i;
+    formatName = ext.substr( i );
+  }
 
   if( Parameters->Exists( "FileFormat" ) )
     Parameters->Delete( "FileFormat" );
@@ -84,40 +221,56 @@ FileWriterBase::Publish()
         "// save additional parameter file for each run (0=no, 1=yes) (boolean)",
     END_PARAMETER_DEFINITIONS
   }
+
+  BEGIN_PARAMETER_DEFINITIONS
+    "Storage:File%20Writer int WriteBufferSize= 1024 1024 4 % "
+      "// size of file write buffers in kB",
+    "Storage:File%20Writer int FilePreallocation= 16 16 0 % "
+      "// file space to allocate ahead of writing in MB, 0 to disable",
+    "Storage:File%20Writer float CheckpointInterval= 0s 0s 0 % "
+      "// interval between forcing data to disk, 0 to disable",
+    "Storage:File%20Writer int ReportWriteStatistics= 0 0 0 1 "
+      "// report write latency and buffer usage at the end of each run (boolean)",
+  END_PARAMETER_DEFINITIONS
 }
 
 void
 FileWriterBase::Preflight( const SignalProperties& Input,
                                  SignalProperties& Output ) const
 {
-  mrOutputFormat.Preflight( Input, *Statevector );
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+    mOutputs[i]->Format().Preflight( Input, *Statevector );
 
   // State availability.
   State( "Recording" );
 
   // File accessibility.
-  string dataFile = CurrentRun();
-
-  // Does the data file exist?
-  ifstream dataRead( dataFile.c_str() );
-  if( dataRead.is_open() )
-    bcierr << "Data file " << dataFile << " already exists, "
-           << "will not be touched." << endl;
-  else
+  string run = CurrentRun();
+  for( size_t i = 0; i < mOutputs.size(); ++i )
   {
-    // It does not exist, can we write to it?
-    ofstream dataWrite( dataFile.c_str() );
-    if( !dataWrite.is_open() )
-      bcierr << "Cannot write to file " << dataFile << endl;
+    string dataFile = FileName( run, i );
+
+    // Does the data file exist?
+    ifstream dataRead( dataFile.c_str() );
+    if( dataRead.is_open() )
+      bcierr << "Data file " << dataFile << " already exists, "
+             << "will not be touched." << endl;
     else
     {
-      dataWrite.close();
-      ::remove( dataFile.c_str() );
+      // It does not exist, can we write to it?
+      ofstream dataWrite( dataFile.c_str() );
+      if( !dataWrite.is_open() )
+        bcierr << "Cannot write to file " << dataFile << endl;
+      else
+      {
+        dataWrite.close();
+        ::remove( dataFile.c_str() );
+      }
     }
   }
   if( OptionalParameter( "SavePrmFile" ) == 1 )
   {
-    string paramFile = ParameterFile( dataFile );
+    string paramFile = ParameterFile( run );
     ifstream paramRead( paramFile.c_str() );
     if( paramRead.is_open() )
       bcierr << "Parameter file " << paramFile << " already exists, "
@@ -134,6 +287,14 @@ FileWriterBase::Preflight( const SignalProperties& Input,
       }
     }
   }
+  if( Parameter( "WriteBufferSize" ) < 4 )
+    bcierr << "WriteBufferSize must be at least 4kB" << endl;
+  if( Parameter( "FilePreallocation" ) < 0 )
+    bcierr << "FilePreallocation must not be negative" << endl;
+  if( Parameter( "CheckpointInterval" ).InSeconds() < 0 )
+    bcierr << "CheckpointInterval must not be negative" << endl;
+  Parameter( "ReportWriteStatistics" );
+
   Output = SignalProperties( 0, 0 );
 }
 
@@ -142,20 +303,22 @@ void
 FileWriterBase::Initialize( const SignalProperties& Input,
                             const SignalProperties& /*Output*/ )
 {
-  mOutputFile.close();
-  mOutputFile.clear();
-
-  mrOutputFormat.Initialize( Input, *Statevector );
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+  {
+    Output& output = *mOutputs[i];
+    output.Close();
+    output.Filebuf().SetBufferSize( int( Parameter( "WriteBufferSize" ) ) * 1024 )
+                    .SetPreallocation( int( Parameter( "FilePreallocation" ) ) * 1024LL * 1024 )
+                    .SetCheckpointInterval( Parameter( "CheckpointInterval" ).InSeconds() );
+    output.Format().Initialize( Input, *Statevector );
+  }
 }
 
 
 void
 FileWriterBase::StartRun()
 {
-  mOutputFile.close();
-  mOutputFile.clear();
   mFileName = CurrentRun();
-  mOutputFile.open( mFileName.c_str(), ios::out | ios::binary );
 
   if( OptionalParameter( "SavePrmFile" ) == 1 )
   {
@@ -167,9 +330,10 @@ FileWriterBase::StartRun()
              << endl;
   }
 
-  mrOutputFormat.StartRun( mOutputFile, mFileName );
-  mQueue.Clear();
-  Thread::Start();
+  ClearQueue();
+  mMaxQueueDepth = 0;
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+    mOutputs[i]->StartRun( FileName( mFileName, i ) );
 }
 
 
@@ -177,46 +341,112 @@ void
 FileWriterBase::StopRun()
 {
   Halt();
-  mrOutputFormat.StopRun( mOutputFile );
-  mOutputFile.close();
-  mOutputFile.clear();
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+    if( !mOutputs[i]->StopRun() )
+      bcierr << "Error writing to file \"" << mOutputs[i]->FileName() << "\"" << endl;
 
-  if( !mQueue.Empty() )
+  if( !mQueue.empty() )
     bcierr << "Nonempty buffering queue" << endl;
+
+  if( Parameter( "ReportWriteStatistics" ) != 0 )
+    ReportStatistics();
 }
 
 void
 FileWriterBase::Halt()
 {
-  SharedPointer<Waitable> pTerminationEvent = Thread::Terminate();
-  mQueue.WakeConsumer();
-  pTerminationEvent->Wait();
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+    mOutputs[i]->Halt();
 }
 
 void
 FileWriterBase::Write( const GenericSignal& Signal,
                        const StateVector&   Statevector )
 {
-  mQueue.Produce( make_pair( Signal, Statevector ) );
+  Block* pBlock = new Block( Signal, Statevector );
+  Lock _( mQueueLock );
+  mQueue.push_back( pBlock );
+  mMaxQueueDepth = max( mMaxQueueDepth, static_cast<int>( mQueue.size() ) );
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+    mOutputs[i]->mEvent.Set();
+}
+
+string
+FileWriterBase::FileName( const string& inRun, size_t inOutput ) const
+{
+  if( inOutput == 0 )
+    return inRun;
+  return FileUtils::StripExtension( inRun ) + mOutputs[inOutput]->Format().DataFileExtension();
+}
+
+const FileWriterBase::Block*
+FileWriterBase::NextBlock( Output& inOutput )
+{
+  Lock _( mQueueLock );
+  size_t i = static_cast<size_t>( inOutput.mPosition - mQueueBegin );
+  if( i < mQueue.size() )
+    return mQueue[i];
+  inOutput.mEvent.Reset();
+  return 0;
 }
 
-int FileWriterBase::OnExecute()
+void
+FileWriterBase::ReleaseBlock( Output& inOutput )
 {
-  Queue::Consumable c;
-  while( mOutputFile && !IsTerminating() && ( c = mQueue.AwaitConsumption() ) )
+  Lock _( mQueueLock );
+  long long position = ++inOutput.mPosition;
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+    position = min( position, mOutputs[i]->mPosition );
+  while( mQueueBegin < position )
   {
-    mrOutputFormat.Write( mOutputFile, c->first, c->second );
-    if( !mOutputFile )
-    {
-      bcierr << "Error writing to file \"" << mFileName << "\"" << endl;
-      State( "Recording" ) = 0;
-    }
+    delete mQueue.front();
+    mQueue.pop_front();
+    ++mQueueBegin;
   }
-  while( !mQueue.Empty() )
+}
+
+void
+FileWriterBase::ClearQueue()
+{
+  Lock _( mQueueLock );
+  while( !mQueue.empty() )
   {
-    c = mQueue.Consume();
-    mrOutputFormat.Write( mOutputFile, c->first, c->second );
+    delete mQueue.front();
+    mQueue.pop_front();
   }
+  mQueueBegin = 0;
+}
 
-  return 0;
+void
+FileWriterBase::OnWriteError( const Output& inOutput )
+{
+  bcierr << "Error writing to file \"" << inOutput.FileName() << "\"" << endl;
+  State( "Recording" ) = 0;
+}
+
+void
+FileWriterBase::ReportStatistics() const
+{
+  for( size_t i = 0; i < mOutputs.size(); ++i )
+  {
+    const Output& output = *mOutputs[i];
+    AsyncFilebuf::Statistics s = output.Filebuf().GetStatistics();
+    double encodingTime = output.EncodingTime();
+    ostringstream oss;
+    oss << s.bytes << " bytes in " << s.writes << " writes, "
+        << setprecision( 3 )
+        << "encoding time " << encodingTime << "ms";
+    if( encodingTime > 0 )
+      oss << " (" << s.bytes / encodingTime / 1e3 << "MB/s)";
+    oss << ", latency p50/p95/p99/max: "
+        << s.latency50 << "/" << s.latency95 << "/"
+        << s.latency99 << "/" << s.latencyMax << "ms, "
+        << s.checkpoints << " checkpoints (max " << s.checkpointMax << "ms), "
+        << "max pending buffers: " << s.maxPendingBuffers << ", "
+        << "stalls: " << s.stalls;
+    bciout << "Write statistics for \"" << output.FileName() << "\": "
+           << oss.str()
+           << endl;
+  }
+  bciout << "Maximum number of queued blocks: " << mMaxQueueDepth << endl;
 }
@@ -3,6 +3,9 @@
 // Author: juergen.mellinger@uni-tuebingen.de
 // Description: A base class that implements functionality common to all
 //              file writer classes that output into a file.
+//              Descendants may write more than one output format at a time.
+//              Blocks are then queued once, and written into each format's
+//              file by a separate thread.
 //
 // $BEGIN_BCI2000_LICENSE$
 // 
@@ -29,16 +32,24 @@
 
 #include "GenericFileWriter.h"
 #include "GenericOutputFormat.h"
-#include "SynchronizedQueue.h"
+#include "Lockable.h"
 
 #include <string>
-#include <fstream>
-#include "Thread.h"
+#include <vector>
+#include <deque>
 
-class FileWriterBase: public GenericFileWriter, Thread
+class FileWriterBase: public GenericFileWriter
 {
  protected:
           FileWriterBase( GenericOutputFormat& );
+          // For descendants that add output formats themselves.
+          FileWriterBase();
+          // Adds an output format. The first format added determines the
+          // FileFormat parameter, and is written into the file given by the
+          // DataFile parameter. Files for further formats differ by extension.
+          void AddOutputFormat( GenericOutputFormat& );
+          int  NumOutputFormats() const
+               { return static_cast<int>( mOutputs.size() ); }
  public:
   virtual ~FileWriterBase();
   virtual void Publish();
@@ -53,13 +64,24 @@ class FileWriterBase: public GenericFileWriter, Thread
                       const StateVector&   Statevector );
 
  private:
-  virtual int OnExecute();
+  struct Block;
+  class Output;
+  friend class Output;
 
-  GenericOutputFormat&     mrOutputFormat;
+  std::string FileName( const std::string& run, size_t output ) const;
+  const Block* NextBlock( Output& );
+  void ReleaseBlock( Output& );
+  void ClearQueue();
+  void OnWriteError( const Output& );
+  void ReportStatistics() const;
+
+  std::vector<Output*>     mOutputs;
   std::string              mFileName;
-  std::ofstream            mOutputFile;
-  typedef SynchronizedQueue< std::pair<GenericSignal, StateVector> > Queue;
-  Queue mQueue;
+  // Blocks are removed from the queue when all outputs have written them.
+  Lockable<Mutex>          mQueueLock;
+  std::deque<Block*>       mQueue;
+  long long                mQueueBegin;
+  int                      mMaxQueueDepth;
 };
 
 #endif // FILE_WRITER_BASE_H
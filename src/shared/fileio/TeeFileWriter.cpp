@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A FileWriter filter that stores data in multiple formats at
+//   once.
+//
+// $BEGIN_BCI2000_LICENSE$
+// 
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+// 
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+// 
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "TeeFileWriter.h"
+#include "StringUtils.h"
+#include "BCIStream.h"
+
+#include <sstream>
+#include <algorithm>
+#include <ctime>
+
+using namespace std;
+
+// File writer filters must have a position string greater than
+// that of the DataIOFilter.
+RegisterFilter( TeeFileWriter, 1 );
+
+static const char* cDefaultFormats = "BCI2000,GDF";
+
+TeeFileWriter::TeeFileWriter()
+: mWritesStorageTime( false )
+{
+  string formats = OptionalParameter( "TeeFormats", cDefaultFormats );
+  replace( formats.begin(), formats.end(), ',', ' ' );
+  istringstream iss( formats );
+  string name;
+  while( iss >> name )
+  {
+    name = StringUtils::ToUpper( name );
+    if( name == "DAT" )
+      name = "BCI2000";
+    GenericOutputFormat* pFormat = NULL;
+    if( name == "BCI2000" )
+      pFormat = &mBCI2000Format;
+    else if( name == "BCZ" )
+      pFormat = &mBCZFormat;
+    else if( name == "EDF" )
+      pFormat = &mEDFFormat;
+    else if( name == "GDF" )
+      pFormat = &mGDFFormat;
+
+    if( !pFormat )
+      mUnknownFormats += " " + name;
+    else if( find( mFormatNames.begin(), mFormatNames.end(), name ) == mFormatNames.end() )
+    {
+      AddOutputFormat( *pFormat );
+      mFormatNames.push_back( name );
+      mWritesStorageTime |= ( pFormat == &mBCI2000Format || pFormat == &mBCZFormat );
+    }
+  }
+  if( mFormatNames.empty() )
+  {
+    AddOutputFormat( mBCI2000Format );
+    mFormatNames.push_back( "BCI2000" );
+    mWritesStorageTime = true;
+  }
+}
+
+void
+TeeFileWriter::Publish()
+{
+  FileWriterBase::Publish();
+
+  string formats;
+  for( size_t i = 0; i < mFormatNames.size(); ++i )
+    formats += ( i > 0 ? "," : "" ) + mFormatNames[i];
+  if( Parameters->Exists( "TeeFormats" ) )
+    Parameters->Delete( "TeeFormats" );
+  string def = "Storage string TeeFormats= " + formats + " % % % // formats of data files (readonly)";
+  BEGIN_PARAMETER_DEFINITIONS
+    def.c_str(),
+  END_PARAMETER_DEFINITIONS
+
+  if( mWritesStorageTime )
+  {
+    BEGIN_PARAMETER_DEFINITIONS
+      "Storage:Documentation string StorageTime= % % % % "
+        "// time of beginning of data storage",
+    END_PARAMETER_DEFINITIONS
+  }
+
+  if( !mUnknownFormats.empty() )
+    bcierr << "Unknown data file format(s) in TeeFormats:" << mUnknownFormats
+           << ", available formats are BCI2000, BCZ, EDF, and GDF"
+           << endl;
+}
+
+void
+TeeFileWriter::Preflight( const SignalProperties& Input,
+                                SignalProperties& Output ) const
+{
+  FileWriterBase::Preflight( Input, Output );
+
+  if( mWritesStorageTime && !string( Parameter( "StorageTime" ) ).empty() )
+    bciout << "The StorageTime parameter will be overwritten with the"
+           << " recording's actual date and time"
+           << endl;
+}
+
+void
+TeeFileWriter::StartRun()
+{
+  if( mWritesStorageTime )
+  {
+    time_t now = ::time( NULL );
+    struct tm* timeinfo = ::localtime( &now );
+    char buffer[20];
+    ::strftime( buffer, sizeof( buffer ), "%Y-%m-%dT%H:%M:%S", timeinfo );
+    Parameter( "StorageTime" ) = buffer;
+  }
+  FileWriterBase::StartRun();
+}
@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A FileWriter filter that stores data in multiple formats at
+//   once. Formats are selected with the TeeFormats command line option, e.g.
+//   --FileFormat=Tee --TeeFormats=BCI2000,GDF
+//   Available formats are BCI2000 (or dat), BCZ, EDF, and GDF.
+//   All files share the name given by the DataFile parameter, and differ by
+//   extension.
+//   Formats share a single queue of unencoded blocks, and each format encodes
+//   blocks on its own writing thread. The formats have no encoding in common:
+//   BCI2000 files interleave samples with state vectors, BCZ Rice codes
+//   per-channel prediction residuals, and EDF and GDF write scaled per-channel
+//   records, so there is no encoded representation that could be staged once
+//   for all of them.
+//
+// $BEGIN_BCI2000_LICENSE$
+// 
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+// 
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+// 
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef TEE_FILE_WRITER_H
+#define TEE_FILE_WRITER_H
+
+#include "FileWriterBase.h"
+#include "BCI2000OutputFormat.h"
+#include "BCZOutputFormat.h"
+#include "EDFOutputFormat.h"
+#include "GDFOutputFormat.h"
+
+#include <string>
+#include <vector>
+
+class TeeFileWriter : public FileWriterBase
+{
+ public:
+  TeeFileWriter();
+  virtual void Publish();
+  virtual void Preflight( const SignalProperties& Input,
+                                SignalProperties& Output ) const;
+  virtual void StartRun();
+
+ private:
+  std::vector<std::string> mFormatNames;
+  std::string mUnknownFormats;
+  bool mWritesStorageTime;
+
+  BCI2000OutputFormat mBCI2000Format;
+  BCZOutputFormat mBCZFormat;
+  EDFOutputFormat mEDFFormat;
+  GDFOutputFormat mGDFFormat;
+};
+
+#endif // TEE_FILE_WRITER_H
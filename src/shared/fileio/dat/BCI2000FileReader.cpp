@@ -27,11 +27,14 @@
 #include "BCI2000FileReader.h"
 #include "BCIException.h"
 #include "defines.h"
+#include "BinaryData.h"
 
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
 
 #if _MSC_VER
 # define ftello64 _ftelli64
@@ -77,6 +80,45 @@ ReadValue_SwapBytes( const char* p )
   return *reinterpret_cast<const T*>( reinterpret_cast<char*>( b ) );
 }
 
+// **************************************************************************
+// Function:   DecodeValue<DataType>
+// Purpose:    Reads a little endian value from the given memory location,
+//             independently of alignment and machine byte order.
+// Parameters: Pointer into memory buffer.
+// Returns:    Data value.
+// **************************************************************************
+template<typename T>
+static inline
+T
+DecodeValue( const char* p )
+{
+  BinaryData<T, LittleEndian> value;
+  value.Get( p );
+  return value;
+}
+
+// **************************************************************************
+// Function:   FindChunk
+// Purpose:    Finds the compressed chunk that contains a given sample.
+// Parameters: Chunk table, sample position.
+// Returns:    Index into the chunk table.
+// **************************************************************************
+static size_t
+FindChunk( const BCZCodec::ChunkTable& inChunks, long long inSample )
+{
+  size_t begin = 0,
+         end = inChunks.size();
+  while( end - begin > 1 )
+  {
+    size_t mid = ( begin + end ) / 2;
+    if( inChunks[ mid ].firstSample <= inSample )
+      begin = mid;
+    else
+      end = mid;
+  }
+  return begin;
+}
+
 
 // **************************************************************************
 // Function:   BCI2000FileReader
@@ -141,6 +183,11 @@ BCI2000FileReader::Reset()
   mBufferEnd = 0;
 
   mFileFormatVersion = "n/a";
+  mCompression = "";
+  mChunks.clear();
+  mChunkBuffer.clear();
+  mChunkRecords.clear();
+  mDecodedChunk = -1;
   mChannels = 0;
   mHeaderLength = 0;
   mStatevectorLength = 0;
@@ -303,6 +350,142 @@ BCI2000FileReader::ReadStateVector( long long inSample )
   return *this;
 }
 
+// **************************************************************************
+// Function:   ReadSamples
+// Purpose:    Reads signal and state values for a range of samples in a
+//             single sequential pass over the file.
+// Parameters: firstSample, numSamples - range of samples to read
+//             signal - output matrix for signal values
+//             options - channel selection and calibration
+//             states - output matrix for state values
+//             selection - states to read
+// Returns:    *this
+// **************************************************************************
+template<typename SignalT>
+BCI2000FileReader&
+BCI2000FileReader::ReadSamples( long long inFirstSample, long long inNumSamples,
+                                const Matrix<SignalT>& outSignal, const SignalOptions& inOptions,
+                                const Matrix<State::ValueType>& outStates, const StateSelection& inSelection )
+{
+  if( inNumSamples <= 0 )
+    return *this;
+  long long numSamplesInFile = static_cast<long long>( mNumSamples );
+  if( inFirstSample < 0 || inFirstSample + inNumSamples > numSamplesInFile )
+    throw std_range_error(
+      "Sample range " << inFirstSample << "-" << inFirstSample + inNumSamples
+      << " exceeds file size of " << numSamplesInFile
+    );
+  for( size_t i = 0; i < inOptions.channels.size(); ++i )
+    if( inOptions.channels[ i ] < 0 || inOptions.channels[ i ] >= mChannels )
+      throw std_range_error( "Channel index " << inOptions.channels[ i ] << " exceeds number of channels" );
+  vector<StateAccessor> accessors;
+  if( outStates.data )
+    for( size_t i = 0; i < inSelection.size(); ++i )
+    {
+      accessors.push_back( StateAccessor( *inSelection[ i ] ) );
+      if( accessors.back().RequiredBytes() > static_cast<size_t>( StateVectorLength() ) )
+        throw std_range_error( "State " << inSelection[ i ]->Name() << " exceeds state vector length" );
+    }
+
+  const int signalSize = mDataSize * mChannels,
+            recordSize = signalSize + StateVectorLength(),
+            recordsPerChunk = max( mBufferSize / recordSize, 1 );
+  size_t chunk = 0;
+  if( mCompression.empty() )
+  {
+    mBulkBuffer.resize( recordsPerChunk * recordSize + StateAccessor::Padding );
+    if( 0 != ::fseeko64( mpFile, HeaderLength() + inFirstSample * recordSize, SEEK_SET ) )
+      throw std_runtime_error( "Could not seek to sample position" );
+  }
+  else
+    chunk = FindChunk( mChunks, inFirstSample );
+
+  for( long long column = 0; column < inNumSamples; )
+  {
+    const char* records = NULL;
+    int numRecords = 0;
+    if( mCompression.empty() )
+    {
+      numRecords = static_cast<int>( min<long long>( recordsPerChunk, inNumSamples - column ) );
+      size_t bytes = static_cast<size_t>( numRecords ) * recordSize;
+      if( ::fread( &mBulkBuffer[ 0 ], 1, bytes, mpFile ) != bytes )
+      {
+        ::clearerr( mpFile );
+        throw std_runtime_error( "Could not read sample data" );
+      }
+      records = &mBulkBuffer[ 0 ];
+    }
+    else
+    { // Compressed chunks are decoded as a whole, and records are taken from the
+      // decoded chunk.
+      const BCZCodec::Chunk& c = mChunks[ chunk ];
+      long long offset = inFirstSample + column - c.firstSample;
+      numRecords = static_cast<int>( min<long long>( c.samples - offset, inNumSamples - column ) );
+      records = DecodeChunk( chunk++ ) + offset * recordSize;
+    }
+    if( outSignal.data )
+      switch( mSignalType )
+      {
+        case SignalType::int16:
+          DecodeSignal<int16_t>( records, numRecords, outSignal, inOptions, column );
+          break;
+        case SignalType::int32:
+          DecodeSignal<int32_t>( records, numRecords, outSignal, inOptions, column );
+          break;
+        case SignalType::float32:
+          DecodeSignal<float32_t>( records, numRecords, outSignal, inOptions, column );
+          break;
+        default:
+          throw std_runtime_error( "Unsupported signal type: " << mSignalType );
+      }
+    for( size_t i = 0; i < accessors.size(); ++i )
+    {
+      const unsigned char* p = reinterpret_cast<const unsigned char*>( records + signalSize );
+      State::ValueType* q = outStates.data + i * outStates.rowStride + column * outStates.columnStride;
+      for( int r = 0; r < numRecords; ++r, p += recordSize, q += outStates.columnStride )
+        *q = accessors[ i ].Get( p );
+    }
+    column += numRecords;
+  }
+  return *this;
+}
+
+template<typename T, typename SignalT>
+void
+BCI2000FileReader::DecodeSignal( const char* inRecords, int inNumRecords, const Matrix<SignalT>& outSignal,
+                                 const SignalOptions& inOptions, long long inColumn ) const
+{
+  const int recordSize = mDataSize * mChannels + StateVectorLength(),
+            numRows = inOptions.channels.empty() ? mChannels : static_cast<int>( inOptions.channels.size() );
+  for( int row = 0; row < numRows; ++row )
+  {
+    int channel = inOptions.channels.empty() ? row : inOptions.channels[ row ];
+    const char* p = inRecords + channel * sizeof( T );
+    SignalT* q = outSignal.data + row * outSignal.rowStride + inColumn * outSignal.columnStride;
+    if( inOptions.calibrated )
+    {
+      GenericSignal::ValueType offset = mSourceOffsets[ channel ],
+                               gain = mSourceGains[ channel ];
+      for( int r = 0; r < inNumRecords; ++r, p += recordSize, q += outSignal.columnStride )
+        *q = static_cast<SignalT>( ( DecodeValue<T>( p ) - offset ) * gain );
+    }
+    else
+    {
+      for( int r = 0; r < inNumRecords; ++r, p += recordSize, q += outSignal.columnStride )
+        *q = static_cast<SignalT>( DecodeValue<T>( p ) );
+    }
+  }
+}
+
+#define INSTANTIATE_READ_SAMPLES( T )                                               \
+template BCI2000FileReader& BCI2000FileReader::ReadSamples<T>( long long, long long, \
+  const Matrix<T>&, const SignalOptions&, const Matrix<State::ValueType>&, const StateSelection& );
+INSTANTIATE_READ_SAMPLES( int16_t )
+INSTANTIATE_READ_SAMPLES( int32_t )
+INSTANTIATE_READ_SAMPLES( float )
+INSTANTIATE_READ_SAMPLES( double )
+#undef INSTANTIATE_READ_SAMPLES
+
 // **************************************************************************
 // Function:   ReadHeader
 // Purpose:    This method reads the header of a BCI2000 data file
@@ -338,7 +521,16 @@ BCI2000FileReader::ReadHeader()
     return;
 
   mSignalType = SignalType::int16;
-  if( linestream >> element )
+  element = "";
+  linestream >> element;
+  if( element == "Compression=" )
+  {
+    if( !( linestream >> mCompression ) || mCompression != BCZCodec::Name() )
+      return;
+    element = "";
+    linestream >> element;
+  }
+  if( !element.empty() )
   {
     if( element != "DataFormat=" )
       return;
@@ -418,7 +610,13 @@ void
 BCI2000FileReader::CalculateNumSamples()
 {
   mNumSamples = 0;
-  if( mpFile )
+  if( mpFile && !mCompression.empty() )
+  {
+    ReadChunkTable();
+    if( !mChunks.empty() )
+      mNumSamples = mChunks.back().firstSample + mChunks.back().samples;
+  }
+  else if( mpFile )
   {
     long long curPos = ::ftello64( mpFile );
     ::fseeko64( mpFile, 0, SEEK_END );
@@ -429,6 +627,106 @@ BCI2000FileReader::CalculateNumSamples()
   }
 }
 
+// **************************************************************************
+// Function:   ReadChunkTable
+// Purpose:    Reads the positions of compressed chunks from the seek index
+//             at the end of the file. When there is no valid index, e.g.
+//             because recording was interrupted, chunk positions are
+//             determined by following chunk headers.
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000FileReader::ReadChunkTable()
+{
+  mChunks.clear();
+  mDecodedChunk = -1;
+  ::fseeko64( mpFile, 0, SEEK_END );
+  long long fileSize = ::ftello64( mpFile );
+
+  char buf[ BCZCodec::ChunkHeaderSize + BCZCodec::IndexHeaderSize + BCZCodec::TrailerSize ];
+  long long indexOffset = 0;
+  int entries = 0;
+  if( fileSize - mHeaderLength >= BCZCodec::IndexHeaderSize + BCZCodec::TrailerSize
+      && 0 == ::fseeko64( mpFile, fileSize - BCZCodec::TrailerSize, SEEK_SET )
+      && ::fread( buf, 1, BCZCodec::TrailerSize, mpFile ) == BCZCodec::TrailerSize
+      && BCZCodec::ParseTrailer( buf, indexOffset )
+      && indexOffset >= mHeaderLength
+      && indexOffset <= fileSize - BCZCodec::IndexHeaderSize - BCZCodec::TrailerSize
+      && 0 == ::fseeko64( mpFile, indexOffset, SEEK_SET )
+      && ::fread( buf, 1, BCZCodec::IndexHeaderSize, mpFile ) == BCZCodec::IndexHeaderSize
+      && BCZCodec::ParseIndexHeader( buf, entries )
+      && entries >= 0
+      && indexOffset + BCZCodec::IndexHeaderSize + static_cast<long long>( entries ) * BCZCodec::IndexEntrySize
+         + BCZCodec::TrailerSize == fileSize )
+  {
+    vector<char> index( entries * BCZCodec::IndexEntrySize + 1 );
+    size_t bytes = entries * BCZCodec::IndexEntrySize;
+    if( ::fread( &index[ 0 ], 1, bytes, mpFile ) == bytes )
+      BCZCodec::ParseIndex( &index[ 0 ], entries, mChunks );
+  }
+  else
+  {
+    long long pos = mHeaderLength;
+    int samples = 0;
+    uint32_t payloadSize = 0;
+    while( pos + BCZCodec::ChunkHeaderSize <= fileSize
+           && 0 == ::fseeko64( mpFile, pos, SEEK_SET )
+           && ::fread( buf, 1, BCZCodec::ChunkHeaderSize, mpFile ) == BCZCodec::ChunkHeaderSize
+           && BCZCodec::ParseChunkHeader( buf, samples, payloadSize )
+           && pos + BCZCodec::ChunkHeaderSize + payloadSize <= fileSize )
+    {
+      BCZCodec::Chunk c;
+      c.firstSample = mChunks.empty() ? 0 : mChunks.back().firstSample + mChunks.back().samples;
+      c.offset = pos;
+      c.samples = samples;
+      mChunks.push_back( c );
+      pos += BCZCodec::ChunkHeaderSize + payloadSize;
+    }
+  }
+  ::clearerr( mpFile );
+}
+
+// **************************************************************************
+// Function:   DecodeChunk
+// Purpose:    Reads and decodes a compressed chunk, unless it is the chunk
+//             decoded most recently.
+// Parameters: Index into the chunk table
+// Returns:    Pointer to the chunk's first record
+// **************************************************************************
+const char*
+BCI2000FileReader::DecodeChunk( size_t inIndex )
+{
+  const BCZCodec::Chunk& chunk = mChunks[ inIndex ];
+  if( mDecodedChunk != static_cast<long long>( inIndex ) )
+  {
+    mDecodedChunk = -1;
+    char header[ BCZCodec::ChunkHeaderSize ];
+    int samples = 0;
+    uint32_t payloadSize = 0;
+    if( 0 != ::fseeko64( mpFile, chunk.offset, SEEK_SET )
+        || ::fread( header, 1, sizeof( header ), mpFile ) != sizeof( header )
+        || !BCZCodec::ParseChunkHeader( header, samples, payloadSize )
+        || samples != chunk.samples )
+    {
+      ::clearerr( mpFile );
+      throw std_runtime_error( "Could not read compressed data at file position " << chunk.offset );
+    }
+    mChunkBuffer.resize( payloadSize + 1 );
+    if( ::fread( &mChunkBuffer[ 0 ], 1, payloadSize, mpFile ) != payloadSize )
+    {
+      ::clearerr( mpFile );
+      throw std_runtime_error( "Could not read compressed data at file position " << chunk.offset );
+    }
+    const int recordSize = mDataSize * mChannels + StateVectorLength();
+    mChunkRecords.resize( static_cast<size_t>( samples ) * recordSize + StateAccessor::Padding );
+    BCZCodec::DecodeChunk( &mChunkBuffer[ 0 ], payloadSize, samples, mSignalType,
+                           mChannels, StateVectorLength(), &mChunkRecords[ 0 ] );
+    mDecodedChunk = inIndex;
+  }
+  return &mChunkRecords[ 0 ];
+}
+
 // **************************************************************************
 // Function:   BufferSample
 // Purpose:    Moves the data buffer such that it contains the given sample.
@@ -441,6 +739,12 @@ BCI2000FileReader::BufferSample( long long inSample )
   if( inSample >= NumSamples() )
     throw std_range_error( "Sample position " << inSample << " exceeds file size of " << NumSamples() );
   int numChannels = SignalProperties().Channels();
+  if( !mCompression.empty() )
+  {
+    size_t chunk = FindChunk( mChunks, inSample );
+    return DecodeChunk( chunk ) + ( inSample - mChunks[ chunk ].firstSample )
+                                  * ( mDataSize * numChannels + StateVectorLength() );
+  }
   long long filepos = HeaderLength() + inSample * ( mDataSize * numChannels + StateVectorLength() );
   if( filepos < mBufferBegin || filepos + mDataSize * numChannels + StateVectorLength() >= mBufferEnd )
   {
@@ -35,10 +35,12 @@
 #include "StateVector.h"
 #include "StateRef.h"
 #include "GenericSignal.h"
+#include "BCZCodec.h"
 
 #include <vector>
 #include <fstream>
 #include <string>
+#include <cstddef>
 
 class BCI2000FileReader
 {
@@ -83,6 +85,10 @@ class BCI2000FileReader
   const std::string&
         FileFormatVersion() const
         { return mFileFormatVersion; }
+  // Empty for uncompressed files, or the name of the compression scheme.
+  const std::string&
+        Compression() const
+        { return mCompression; }
 
   // Parameter/State access
   //  Accessor functions consistent with the Environment class interface.
@@ -108,13 +114,54 @@ class BCI2000FileReader
   virtual BCI2000FileReader&
         ReadStateVector( long long sample );
 
+  // Bulk data access
+  //  ReadSamples() decodes a range of samples in a single sequential pass over
+  //  the file, writing signal and state values into caller-provided memory.
+  //  A Matrix describes the memory layout of the output: the value for
+  //  row r and column c is written to data[r * rowStride + c * columnStride].
+  //  For signals, rows correspond to entries in the channels list, or to all
+  //  channels if the list is empty; for states, rows correspond to entries in
+  //  the states list. Columns correspond to samples, counted from firstSample.
+  //  Either Matrix may have a NULL data pointer, in which case it is ignored.
+  //  Sample positions always refer to the file that is currently open.
+  template<typename T> struct Matrix
+  {
+    Matrix( T* inData = NULL, std::ptrdiff_t inRowStride = 0, std::ptrdiff_t inColumnStride = 0 )
+      : data( inData ), rowStride( inRowStride ), columnStride( inColumnStride ) {}
+    T* data;
+    std::ptrdiff_t rowStride,
+                   columnStride;
+  };
+  struct SignalOptions
+  {
+    SignalOptions()
+      : calibrated( false ) {}
+    std::vector<int> channels;
+    bool calibrated;
+  };
+  typedef std::vector<const class State*> StateSelection;
+
+  // Instantiations exist for signals of type int16_t, int32_t, float, and double.
+  template<typename SignalT>
+  BCI2000FileReader&
+        ReadSamples( long long firstSample, long long numSamples,
+                     const Matrix<SignalT>& signal,
+                     const SignalOptions& = SignalOptions(),
+                     const Matrix<State::ValueType>& states = Matrix<State::ValueType>(),
+                     const StateSelection& = StateSelection() );
+
  protected:
   void               Reset();
 
  private:
   void               ReadHeader();
   void               CalculateNumSamples();
+  void               ReadChunkTable();
   const char*        BufferSample( long long sample );
+  const char*        DecodeChunk( size_t index );
+  template<typename T, typename SignalT>
+   void              DecodeSignal( const char* records, int numRecords, const Matrix<SignalT>&,
+                                   const SignalOptions&, long long column ) const;
 
  private:
   ParamList          mParamlist;
@@ -124,7 +171,8 @@ class BCI2000FileReader
 
   std::FILE*         mpFile;
   std::string        mFilename,
-                     mFileFormatVersion;
+                     mFileFormatVersion,
+                     mCompression;
 
   ::SignalProperties mSignalProperties;
   SignalType         mSignalType;
@@ -144,6 +192,13 @@ class BCI2000FileReader
   long long          mBufferBegin,
                      mBufferEnd;
 
+  std::vector<char>  mBulkBuffer;
+
+  BCZCodec::ChunkTable mChunks;
+  std::vector<char>  mChunkBuffer,
+                     mChunkRecords;
+  long long          mDecodedChunk;
+
   int                mErrorState;
 };
 
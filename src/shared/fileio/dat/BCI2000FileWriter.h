@@ -40,6 +40,12 @@ class BCI2000FileWriter : public FileWriterBase
                                 SignalProperties& Output ) const;
   virtual void StartRun();
 
+ protected:
+  // For descendants that write the same header with a different data layout.
+  BCI2000FileWriter( BCI2000OutputFormat& inOutputFormat )
+  : FileWriterBase( inOutputFormat )
+  {}
+
  private:
   BCI2000OutputFormat mOutputFormat;
 };
@@ -29,14 +29,41 @@
 #include "BCI2000OutputFormat.h"
 
 #include "BCIError.h"
+#include "BinaryData.h"
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <iomanip>
 #include <ctime>
+#include <cstring>
 
 using namespace std;
 
+namespace
+{
+
+size_t
+RecordSize( SignalType inType, const GenericSignal& inSignal, const StateVector& inStatevector )
+{
+  return inSignal.Channels() * inType.Size() + inStatevector.Length();
+}
+
+template<typename T>
+void
+PutRecords( const GenericSignal& inSignal, const StateVector& inStatevector, char* p )
+{
+  for( int j = 0; j < inSignal.Elements(); ++j )
+  {
+    for( int i = 0; i < inSignal.Channels(); ++i )
+      p = BinaryData<T, LittleEndian>( inSignal( i, j ) ).Put( p );
+    const StateVectorSample& s = inStatevector( min( j, inStatevector.Samples() - 1 ) );
+    ::memcpy( p, s.Data(), inStatevector.Length() );
+    p += inStatevector.Length();
+  }
+}
+
+} // namespace
+
 void
 BCI2000OutputFormat::Publish() const
 {
@@ -75,8 +102,15 @@ BCI2000OutputFormat::Initialize( const SignalProperties& inProperties,
 void
 BCI2000OutputFormat::StartRun( ostream& os, const string& )
 {
-  // We write 16 bit data in the old format to maintain backward compatibility.
-  bool useOldFormat = ( mInputProperties.Type() == SignalType::int16 );
+  WriteHeader( os );
+}
+
+void
+BCI2000OutputFormat::WriteHeader( ostream& os, const string& inCompression ) const
+{
+  // We write uncompressed 16 bit data in the old format to maintain backward
+  // compatibility.
+  bool useOldFormat = ( mInputProperties.Type() == SignalType::int16 && inCompression.empty() );
 
   // Write the header.
   //
@@ -87,6 +121,10 @@ BCI2000OutputFormat::StartRun( ostream& os, const string& )
   header << " "
          << "SourceCh= " << ( int )Parameter( "SourceCh" ) << " "
          << "StatevectorLen= " << mStatevectorLength;
+  if( !inCompression.empty() )
+    header << " "
+           << "Compression= "
+           << inCompression;
   if( !useOldFormat )
     header << " "
            << "DataFormat= "
@@ -138,14 +176,26 @@ BCI2000OutputFormat::Write( ostream& os, const GenericSignal& inSignal, const St
     case SignalType::int32:
       // Note that the order of Elements and Channels differs from the one in the
       // socket protocol.
-      for( int j = 0; j < inSignal.Elements(); ++j )
+      // Records are collected into a single buffer, and written at once.
+      mRecordBuffer.resize( inSignal.Elements() * RecordSize( mInputProperties.Type(), inSignal, inStatevector ) );
+      if( !mRecordBuffer.empty() )
       {
-        for( int i = 0; i < inSignal.Channels(); ++i )
-          inSignal.WriteValueBinary( os, i, j );
-        os.write(
-          reinterpret_cast<const char*>( inStatevector( min( j, inStatevector.Samples() - 1 ) ).Data() ),
-          inStatevector.Length()
-        );
+        char* p = &mRecordBuffer[0];
+        switch( mInputProperties.Type() )
+        {
+          case SignalType::int16:
+            PutRecords<int16_t>( inSignal, inStatevector, p );
+            break;
+          case SignalType::float32:
+            PutRecords<float>( inSignal, inStatevector, p );
+            break;
+          case SignalType::int32:
+            PutRecords<int32_t>( inSignal, inStatevector, p );
+            break;
+          default:
+            throw std_logic_error( "Unexpected signal type: " << mInputProperties.Type().Name() );
+        }
+        os.write( p, mRecordBuffer.size() );
       }
       break;
 
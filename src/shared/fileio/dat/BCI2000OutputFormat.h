@@ -27,6 +27,7 @@
 #define BCI2000_OUTPUT_FORMAT_H
 
 #include "GenericOutputFormat.h"
+#include <vector>
 
 class BCI2000OutputFormat : public GenericOutputFormat
 {
@@ -44,9 +45,16 @@ class BCI2000OutputFormat : public GenericOutputFormat
 
   virtual const char* DataFileExtension() const { return ".dat"; }
 
- private:
+ protected:
+  // Writes a BCI2000 file header. For compressed data, the header's first line
+  // contains an additional Compression field with the given value.
+  void WriteHeader( std::ostream&, const std::string& compression = "" ) const;
+
   SignalProperties mInputProperties;
   int              mStatevectorLength;
+
+ private:
+  std::vector<char> mRecordBuffer;
 };
 
 #endif // BCI2000_OUTPUT_FORMAT_H
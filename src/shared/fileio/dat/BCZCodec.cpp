@@ -0,0 +1,755 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: Lossless compression of BCI2000 data records.
+//   See the header file for a description of the format.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "BCZCodec.h"
+#include "GenericSignal.h"
+#include "StateVector.h"
+#include "BCIException.h"
+#include "UnitTest.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+
+using namespace std;
+
+// A chunk's payload consists of the size of each channel's data, the
+// channels' data, the size of the state data, and the state data.
+// Channel data are bit streams, starting with the predictor order in 3 bits,
+// followed by partitions of residuals. A partition starts with its Rice
+// parameter in 6 bits. Residuals are mapped to unsigned values by zigzag
+// coding, and written as unary quotient and binary remainder; quotients
+// exceeding the escape length are replaced with the value's bit length and
+// the value itself.
+// State data are a sequence of varints giving the number of bytes that equal
+// the byte at the same position in the previous sample, followed by a
+// varint giving the number of changed bytes, and the changed bytes XORed
+// with their previous values.
+// All numbers outside bit streams are little endian.
+
+namespace
+{
+
+const char cChunkMagic[] = "BCZC",
+           cIndexMagic[] = "BCZI",
+           cTrailerMagic[] = "BCZE";
+
+enum
+{
+  PartitionSize = 256,
+  MaxOrder = 4,
+  OrderBits = 3,
+  RiceBits = 6,
+  MaxRice = 40,
+  EscapeLength = 32,
+  LengthBits = 6,
+};
+
+void
+PutLE( string& s, uint64_t value, int bytes )
+{
+  for( int i = 0; i < bytes; ++i, value >>= 8 )
+    s += static_cast<char>( value & 0xff );
+}
+
+uint64_t
+GetLE( const char* p, int bytes )
+{
+  uint64_t value = 0;
+  for( int i = bytes - 1; i >= 0; --i )
+    value = value << 8 | static_cast<uint8_t>( p[i] );
+  return value;
+}
+
+void
+PutVarint( string& s, uint64_t value )
+{
+  while( value >= 0x80 )
+  {
+    s += static_cast<char>( ( value & 0x7f ) | 0x80 );
+    value >>= 7;
+  }
+  s += static_cast<char>( value );
+}
+
+uint64_t
+GetVarint( const char*& p, const char* end )
+{
+  uint64_t value = 0;
+  for( int shift = 0; shift < 64; shift += 7 )
+  {
+    if( p == end )
+      break;
+    uint8_t c = *p++;
+    value |= uint64_t( c & 0x7f ) << shift;
+    if( !( c & 0x80 ) )
+      return value;
+  }
+  throw std_runtime_error( "Corrupt state data in compressed chunk" );
+}
+
+class BitWriter
+{
+ public:
+  BitWriter( string& s ) : mrString( s ), mAcc( 0 ), mBits( 0 ) {}
+  // Writes up to 32 bits.
+  void Put( uint32_t value, int bits )
+  {
+    mAcc = mAcc << bits | value;
+    mBits += bits;
+    while( mBits >= 8 )
+    {
+      mBits -= 8;
+      mrString += static_cast<char>( mAcc >> mBits );
+    }
+  }
+  void PutLong( uint64_t value, int bits )
+  {
+    if( bits > 32 )
+    {
+      Put( static_cast<uint32_t>( value >> 32 ), bits - 32 );
+      bits = 32;
+    }
+    Put( static_cast<uint32_t>( value & 0xffffffff ) & Mask( bits ), bits );
+  }
+  void Flush()
+  {
+    if( mBits > 0 )
+      Put( 0, 8 - mBits );
+  }
+  static uint32_t Mask( int bits )
+  { return bits < 32 ? ( uint32_t( 1 ) << bits ) - 1 : 0xffffffff; }
+
+ private:
+  string& mrString;
+  uint64_t mAcc;
+  int mBits;
+};
+
+class BitReader
+{
+ public:
+  BitReader( const char* begin, const char* end )
+    : mp( reinterpret_cast<const uint8_t*>( begin ) ),
+      mpEnd( reinterpret_cast<const uint8_t*>( end ) ),
+      mAcc( 0 ), mBits( 0 ) {}
+  // Reads up to 32 bits.
+  uint32_t Get( int bits )
+  {
+    while( mBits < bits )
+    {
+      if( mp == mpEnd )
+        throw std_runtime_error( "Unexpected end of channel data in compressed chunk" );
+      mAcc = mAcc << 8 | *mp++;
+      mBits += 8;
+    }
+    mBits -= bits;
+    return static_cast<uint32_t>( mAcc >> mBits ) & BitWriter::Mask( bits );
+  }
+  uint64_t GetLong( int bits )
+  {
+    uint64_t value = 0;
+    if( bits > 32 )
+    {
+      value = uint64_t( Get( bits - 32 ) ) << 32;
+      bits = 32;
+    }
+    return value | Get( bits );
+  }
+  int GetUnary( int limit )
+  {
+    int count = 0;
+    while( count < limit )
+    {
+      if( mBits == 0 )
+      {
+        if( mp == mpEnd )
+          throw std_runtime_error( "Unexpected end of channel data in compressed chunk" );
+        mAcc = mAcc << 8 | *mp++;
+        mBits = 8;
+      }
+      if( !( mAcc >> --mBits & 1 ) )
+        break;
+      ++count;
+    }
+    return count;
+  }
+
+ private:
+  const uint8_t* mp,
+               * mpEnd;
+  uint64_t mAcc;
+  int mBits;
+};
+
+// Float bit patterns are mapped to integers such that the integers' order
+// matches the order of float values, and prediction is meaningful.
+inline int32_t
+FromFloatBits( uint32_t u )
+{
+  return ( u & 0x80000000 ) ? -static_cast<int32_t>( u & 0x7fffffff ) - 1 : static_cast<int32_t>( u );
+}
+
+inline uint32_t
+ToFloatBits( int32_t v )
+{
+  return v >= 0 ? static_cast<uint32_t>( v ) : 0x80000000 | static_cast<uint32_t>( -( v + 1 ) );
+}
+
+inline int64_t
+Prediction( const int32_t* x, int order )
+{
+  switch( order )
+  {
+    case 0:
+      return 0;
+    case 1:
+      return x[-1];
+    case 2:
+      return 2 * int64_t( x[-1] ) - x[-2];
+    case 3:
+      return 3 * ( int64_t( x[-1] ) - x[-2] ) + x[-3];
+    case 4:
+      return 4 * ( int64_t( x[-1] ) + x[-3] ) - 6 * int64_t( x[-2] ) - x[-4];
+  }
+  return 0;
+}
+
+inline uint64_t
+ZigZag( int64_t e )
+{
+  return static_cast<uint64_t>( e ) << 1 ^ static_cast<uint64_t>( e >> 63 );
+}
+
+inline int64_t
+UnZigZag( uint64_t u )
+{
+  return static_cast<int64_t>( u >> 1 ) ^ -static_cast<int64_t>( u & 1 );
+}
+
+int
+BitLength( uint64_t u )
+{
+  int length = 0;
+  while( u )
+    ++length, u >>= 1;
+  return length;
+}
+
+// Chooses the predictor order that minimizes the sum of absolute residuals,
+// computing residuals of all orders as successive differences.
+int
+ChooseOrder( const int32_t* x, int n )
+{
+  uint64_t sum[MaxOrder + 1] = { 0 };
+  int64_t prev[MaxOrder] = { 0 };
+  for( int i = 0; i < n; ++i )
+  {
+    int64_t d = x[i];
+    for( int k = 0; k <= MaxOrder; ++k )
+    {
+      if( i >= MaxOrder )
+        sum[k] += d < 0 ? -d : d;
+      if( k < MaxOrder )
+      {
+        int64_t next = d - prev[k];
+        prev[k] = d;
+        d = next;
+      }
+    }
+  }
+  int order = 0;
+  for( int k = 1; k <= MaxOrder; ++k )
+    if( sum[k] < sum[order] )
+      order = k;
+  return order;
+}
+
+void
+EncodeValues( const int32_t* x, int n, string& out )
+{
+  out.clear();
+  BitWriter writer( out );
+  int order = ChooseOrder( x, n );
+  writer.Put( order, OrderBits );
+  vector<uint64_t> residuals( min<int>( n, PartitionSize ) );
+  for( int begin = 0; begin < n; begin += PartitionSize )
+  {
+    int end = min( begin + PartitionSize, n );
+    uint64_t sum = 0;
+    for( int i = begin; i < end; ++i )
+    {
+      uint64_t u = ZigZag( x[i] - Prediction( x + i, min( i, order ) ) );
+      residuals[i - begin] = u;
+      sum += u;
+    }
+    uint64_t count = end - begin;
+    int k = 0;
+    while( k < MaxRice && ( count << ( k + 1 ) ) <= sum )
+      ++k;
+    writer.Put( k, RiceBits );
+    for( int i = 0; i < end - begin; ++i )
+    {
+      uint64_t u = residuals[i],
+               q = u >> k;
+      if( q < EscapeLength )
+      {
+        writer.Put( BitWriter::Mask( static_cast<int>( q ) ) << 1, static_cast<int>( q ) + 1 );
+        writer.PutLong( u, k );
+      }
+      else
+      {
+        writer.Put( BitWriter::Mask( EscapeLength ), EscapeLength );
+        int length = BitLength( u );
+        writer.Put( length, LengthBits );
+        writer.PutLong( u, length );
+      }
+    }
+  }
+  writer.Flush();
+}
+
+void
+DecodeValues( const char* begin, const char* end, int n, int32_t* x )
+{
+  BitReader reader( begin, end );
+  int order = reader.Get( OrderBits );
+  if( order > MaxOrder )
+    throw std_runtime_error( "Invalid predictor order in compressed chunk" );
+  for( int pbegin = 0; pbegin < n; pbegin += PartitionSize )
+  {
+    int pend = min( pbegin + PartitionSize, n );
+    int k = reader.Get( RiceBits );
+    for( int i = pbegin; i < pend; ++i )
+    {
+      uint64_t u;
+      int q = reader.GetUnary( EscapeLength );
+      if( q < EscapeLength )
+        u = uint64_t( q ) << k | reader.GetLong( k );
+      else
+        u = reader.GetLong( reader.Get( LengthBits ) );
+      x[i] = static_cast<int32_t>( UnZigZag( u ) + Prediction( x + i, min( i, order ) ) );
+    }
+  }
+}
+
+template<typename T>
+void
+PutRecordValue( char* p, T t )
+{
+  uint64_t u = static_cast<uint64_t>( t );
+  for( size_t i = 0; i < sizeof( T ); ++i, u >>= 8 )
+    p[i] = static_cast<char>( u & 0xff );
+}
+
+} // namespace
+
+// BCZCodec::Encoder
+BCZCodec::Encoder::Encoder()
+: mStatevectorLength( 0 ),
+  mSamples( 0 )
+{
+}
+
+BCZCodec::Encoder&
+BCZCodec::Encoder::Initialize( SignalType inType, int inChannels, int inStatevectorLength )
+{
+  switch( inType )
+  {
+    case SignalType::int16:
+    case SignalType::int32:
+    case SignalType::float32:
+      break;
+    default:
+      throw std_invalid_argument( inType.Name() << " data type unsupported for compression" );
+  }
+  mType = inType;
+  mStatevectorLength = inStatevectorLength;
+  mSamples = 0;
+  mValues.clear();
+  mValues.resize( inChannels );
+  mEncodedChannels.clear();
+  mEncodedChannels.resize( inChannels );
+  mStates.clear();
+  mEncodedStates.clear();
+  return *this;
+}
+
+BCZCodec::Encoder&
+BCZCodec::Encoder::Add( const GenericSignal& inSignal, const StateVector& inStatevector )
+{
+  if( inSignal.Channels() != Channels() || inStatevector.Length() != mStatevectorLength )
+    throw std_invalid_argument( "Signal or state vector inconsistent with encoder configuration" );
+  for( int ch = 0; ch < Channels(); ++ch )
+  {
+    vector<int32_t>& values = mValues[ch];
+    switch( mType )
+    {
+      case SignalType::int16:
+        for( int el = 0; el < inSignal.Elements(); ++el )
+          values.push_back( static_cast<int16_t>( inSignal( ch, el ) ) );
+        break;
+      case SignalType::int32:
+        for( int el = 0; el < inSignal.Elements(); ++el )
+          values.push_back( static_cast<int32_t>( inSignal( ch, el ) ) );
+        break;
+      case SignalType::float32:
+        for( int el = 0; el < inSignal.Elements(); ++el )
+        {
+          float f = static_cast<float>( inSignal( ch, el ) );
+          uint32_t u;
+          ::memcpy( &u, &f, sizeof( u ) );
+          values.push_back( FromFloatBits( u ) );
+        }
+        break;
+      default:
+        ;
+    }
+  }
+  for( int el = 0; el < inSignal.Elements(); ++el )
+  {
+    const unsigned char* p = inStatevector( min( el, inStatevector.Samples() - 1 ) ).Data();
+    mStates.insert( mStates.end(), p, p + mStatevectorLength );
+  }
+  mSamples += inSignal.Elements();
+  return *this;
+}
+
+BCZCodec::Encoder&
+BCZCodec::Encoder::Add( const char* inRecords, int inCount )
+{
+  const int size = mType.Size(),
+            recordSize = Channels() * size + mStatevectorLength;
+  for( int r = 0; r < inCount; ++r )
+  {
+    const char* p = inRecords + r * recordSize;
+    for( int ch = 0; ch < Channels(); ++ch, p += size )
+    {
+      uint32_t u = static_cast<uint32_t>( GetLE( p, size ) );
+      switch( mType )
+      {
+        case SignalType::int16:
+          mValues[ch].push_back( static_cast<int16_t>( u ) );
+          break;
+        case SignalType::int32:
+          mValues[ch].push_back( static_cast<int32_t>( u ) );
+          break;
+        case SignalType::float32:
+          mValues[ch].push_back( FromFloatBits( u ) );
+          break;
+        default:
+          ;
+      }
+    }
+    mStates.insert( mStates.end(), p, p + mStatevectorLength );
+  }
+  mSamples += inCount;
+  return *this;
+}
+
+void
+BCZCodec::Encoder::EncodeChannel( int inChannel )
+{
+  const vector<int32_t>& values = mValues[inChannel];
+  EncodeValues( values.empty() ? 0 : &values[0], mSamples, mEncodedChannels[inChannel] );
+}
+
+void
+BCZCodec::Encoder::EncodeStates()
+{
+  string& out = mEncodedStates;
+  out.clear();
+  const size_t size = mStates.size(),
+               length = mStatevectorLength;
+  size_t i = 0;
+  while( i < size )
+  {
+    size_t begin = i;
+    while( i < size && ( i < length ? 0 : mStates[i - length] ) == mStates[i] )
+      ++i;
+    PutVarint( out, i - begin );
+    begin = i;
+    while( i < size && ( i < length ? 0 : mStates[i - length] ) != mStates[i] )
+      ++i;
+    PutVarint( out, i - begin );
+    for( size_t j = begin; j < i; ++j )
+      out += static_cast<char>( mStates[j] ^ ( j < length ? 0 : mStates[j - length] ) );
+  }
+}
+
+ostream&
+BCZCodec::Encoder::WriteChunk( ostream& os )
+{
+  string header;
+  size_t payloadSize = 4 * ( Channels() + 1 ) + mEncodedStates.size();
+  for( int ch = 0; ch < Channels(); ++ch )
+    payloadSize += mEncodedChannels[ch].size();
+  header.append( cChunkMagic, 4 );
+  PutLE( header, mSamples, 4 );
+  PutLE( header, payloadSize, 4 );
+  for( int ch = 0; ch < Channels(); ++ch )
+    PutLE( header, mEncodedChannels[ch].size(), 4 );
+  os.write( header.data(), header.size() );
+  for( int ch = 0; ch < Channels(); ++ch )
+    os.write( mEncodedChannels[ch].data(), mEncodedChannels[ch].size() );
+  string statesSize;
+  PutLE( statesSize, mEncodedStates.size(), 4 );
+  os.write( statesSize.data(), statesSize.size() );
+  os.write( mEncodedStates.data(), mEncodedStates.size() );
+
+  for( int ch = 0; ch < Channels(); ++ch )
+    mValues[ch].clear();
+  mStates.clear();
+  mSamples = 0;
+  return os;
+}
+
+ostream&
+BCZCodec::Encoder::Encode( ostream& os )
+{
+  for( int ch = 0; ch < Channels(); ++ch )
+    EncodeChannel( ch );
+  EncodeStates();
+  return WriteChunk( os );
+}
+
+// BCZCodec
+void
+BCZCodec::DecodeChunk( const char* inPayload, size_t inSize, int inSamples,
+                       SignalType inType, int inChannels, int inStatevectorLength,
+                       char* outRecords )
+{
+  const int size = inType.Size(),
+            recordSize = inChannels * size + inStatevectorLength;
+  const char* p = inPayload,
+            * end = inPayload + inSize;
+  if( inSize < 4u * inChannels )
+    throw std_runtime_error( "Compressed chunk too short" );
+  const char* data = p + 4 * inChannels;
+  vector<int32_t> values( inSamples );
+  for( int ch = 0; ch < inChannels; ++ch )
+  {
+    size_t channelSize = static_cast<size_t>( GetLE( p + 4 * ch, 4 ) );
+    if( channelSize > static_cast<size_t>( end - data ) )
+      throw std_runtime_error( "Channel data exceed compressed chunk" );
+    if( inSamples > 0 )
+      DecodeValues( data, data + channelSize, inSamples, &values[0] );
+    data += channelSize;
+    char* q = outRecords + ch * size;
+    for( int i = 0; i < inSamples; ++i, q += recordSize )
+      switch( inType )
+      {
+        case SignalType::int16:
+          PutRecordValue( q, static_cast<int16_t>( values[i] ) );
+          break;
+        case SignalType::int32:
+          PutRecordValue( q, values[i] );
+          break;
+        case SignalType::float32:
+          PutRecordValue( q, ToFloatBits( values[i] ) );
+          break;
+        default:
+          throw std_runtime_error( inType.Name() << " data type unsupported for compression" );
+      }
+  }
+  if( end - data < 4 )
+    throw std_runtime_error( "Compressed chunk too short" );
+  size_t statesSize = static_cast<size_t>( GetLE( data, 4 ) );
+  data += 4;
+  if( statesSize != static_cast<size_t>( end - data ) )
+    throw std_runtime_error( "Inconsistent state data size in compressed chunk" );
+
+  const size_t length = inStatevectorLength,
+               total = length * inSamples;
+  size_t i = 0;
+  while( i < total )
+  {
+    uint64_t unchanged = GetVarint( data, end );
+    if( unchanged > total - i )
+      throw std_runtime_error( "Corrupt state data in compressed chunk" );
+    for( uint64_t j = 0; j < unchanged; ++j, ++i )
+    {
+      char* q = outRecords + ( i / length ) * recordSize + inChannels * size + i % length;
+      *q = i < length ? 0 : *( q - recordSize );
+    }
+    uint64_t changed = GetVarint( data, end );
+    if( changed > total - i || changed > static_cast<uint64_t>( end - data ) )
+      throw std_runtime_error( "Corrupt state data in compressed chunk" );
+    for( uint64_t j = 0; j < changed; ++j, ++i )
+    {
+      char* q = outRecords + ( i / length ) * recordSize + inChannels * size + i % length;
+      *q = *data++ ^ ( i < length ? 0 : *( q - recordSize ) );
+    }
+  }
+}
+
+bool
+BCZCodec::ParseChunkHeader( const char* p, int& outSamples, uint32_t& outPayloadSize )
+{
+  if( ::memcmp( p, cChunkMagic, 4 ) )
+    return false;
+  outSamples = static_cast<int>( GetLE( p + 4, 4 ) );
+  outPayloadSize = static_cast<uint32_t>( GetLE( p + 8, 4 ) );
+  return true;
+}
+
+ostream&
+BCZCodec::WriteIndex( ostream& os, const ChunkTable& inChunks, long long inIndexOffset )
+{
+  string data;
+  data.append( cIndexMagic, 4 );
+  PutLE( data, inChunks.size(), 4 );
+  for( size_t i = 0; i < inChunks.size(); ++i )
+  {
+    PutLE( data, inChunks[i].offset, 8 );
+    PutLE( data, inChunks[i].samples, 4 );
+  }
+  PutLE( data, inIndexOffset, 8 );
+  data.append( cTrailerMagic, 4 );
+  return os.write( data.data(), data.size() );
+}
+
+bool
+BCZCodec::ParseTrailer( const char* p, long long& outIndexOffset )
+{
+  if( ::memcmp( p + 8, cTrailerMagic, 4 ) )
+    return false;
+  outIndexOffset = static_cast<long long>( GetLE( p, 8 ) );
+  return true;
+}
+
+bool
+BCZCodec::ParseIndexHeader( const char* p, int& outEntries )
+{
+  if( ::memcmp( p, cIndexMagic, 4 ) )
+    return false;
+  outEntries = static_cast<int>( GetLE( p + 4, 4 ) );
+  return true;
+}
+
+void
+BCZCodec::ParseIndex( const char* p, int inEntries, ChunkTable& ioChunks )
+{
+  for( int i = 0; i < inEntries; ++i, p += IndexEntrySize )
+  {
+    Chunk c;
+    c.firstSample = ioChunks.empty() ? 0 : ioChunks.back().firstSample + ioChunks.back().samples;
+    c.offset = static_cast<long long>( GetLE( p, 8 ) );
+    c.samples = static_cast<int>( GetLE( p + 8, 4 ) );
+    ioChunks.push_back( c );
+  }
+}
+
+UnitTest( BCZCodecRoundtripTest )
+{
+  const int channels = 5, statevectorLength = 3, blockSize = 100, blocks = 7;
+  SignalType types[] = { SignalType::int16, SignalType::int32, SignalType::float32 };
+  for( size_t t = 0; t < sizeof( types ) / sizeof( *types ); ++t )
+  {
+    SignalType type = types[t];
+    int size = type.Size(),
+        recordSize = channels * size + statevectorLength,
+        samples = blockSize * blocks;
+    vector<char> records( samples * recordSize );
+    for( int i = 0; i < samples; ++i )
+    {
+      char* p = &records[i * recordSize];
+      for( int ch = 0; ch < channels; ++ch, p += size )
+      {
+        double value = 0;
+        switch( ch )
+        {
+          case 0: value = 1000 * ::sin( i * 0.05 ); break;
+          case 1: value = ::rand() % 2000 - 1000; break;
+          case 2: value = i % 50 ? 0 : ( i % 100 ? -32768 : 32767 ); break;
+          case 3: value = i; break;
+          case 4: value = 0; break;
+        }
+        switch( type )
+        {
+          case SignalType::int16:
+            PutRecordValue( p, static_cast<int16_t>( value ) );
+            break;
+          case SignalType::int32:
+            PutRecordValue( p, static_cast<int32_t>( ch == 2 ? value * 65536 : value ) );
+            break;
+          case SignalType::float32:
+          {
+            float f = static_cast<float>( ch == 4 ? ( i % 2 ? -0.0 : 0.0 ) : value / 3 );
+            uint32_t u;
+            ::memcpy( &u, &f, sizeof( u ) );
+            if( ch == 4 && i % 7 == 0 )
+              u = 0xffffffff; // a NaN with all bits set
+            PutRecordValue( p, u );
+          } break;
+          default:
+            ;
+        }
+      }
+      p[0] = i / 10;
+      p[1] = 0;
+      p[2] = ::rand() % 3 ? 0 : 1;
+    }
+    BCZCodec::Encoder encoder;
+    encoder.Initialize( type, channels, statevectorLength );
+    BCZCodec::ChunkTable chunks;
+    ostringstream oss;
+    for( int b = 0; b < blocks; b += 2 )
+    {
+      int count = min( 2, blocks - b ) * blockSize;
+      encoder.Add( &records[b * blockSize * recordSize], count );
+      BCZCodec::Chunk c = { b * blockSize, static_cast<long long>( oss.tellp() ), count };
+      chunks.push_back( c );
+      encoder.Encode( oss );
+    }
+    BCZCodec::WriteIndex( oss, chunks, oss.tellp() );
+    string data = oss.str();
+    TestFail_if( data.size() >= records.size(), type.Name() << " data not compressed" );
+
+    long long indexOffset = 0;
+    TestFail_if( !BCZCodec::ParseTrailer( data.data() + data.size() - BCZCodec::TrailerSize, indexOffset ), "no trailer" );
+    int entries = 0;
+    TestFail_if( !BCZCodec::ParseIndexHeader( data.data() + indexOffset, entries ), "no index" );
+    BCZCodec::ChunkTable index;
+    BCZCodec::ParseIndex( data.data() + indexOffset + BCZCodec::IndexHeaderSize, entries, index );
+    TestFail_if( index.size() != chunks.size(), "index size mismatch" );
+    vector<char> decoded( samples * recordSize );
+    for( size_t i = 0; i < index.size(); ++i )
+    {
+      TestFail_if( index[i].firstSample != chunks[i].firstSample, "first sample mismatch in chunk " << i );
+      int count = 0;
+      uint32_t payloadSize = 0;
+      const char* p = data.data() + index[i].offset;
+      TestFail_if( !BCZCodec::ParseChunkHeader( p, count, payloadSize ), "no chunk header" );
+      TestFail_if( count != index[i].samples, "sample count mismatch in chunk " << i );
+      BCZCodec::DecodeChunk( p + BCZCodec::ChunkHeaderSize, payloadSize, count, type, channels, statevectorLength,
+                   &decoded[index[i].firstSample * recordSize] );
+    }
+    TestFail_if( decoded != records, type.Name() << " records differ after decoding" );
+  }
+}
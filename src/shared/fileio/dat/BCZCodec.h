@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: Lossless compression of BCI2000 data records.
+//   A compressed data file (*.bcz) has the same header as a BCI2000 dat
+//   file, with an additional "Compression=" field in its first line.
+//   Records are stored in chunks of consecutive samples, which may be decoded
+//   independently of each other, followed by a seek index that lists the
+//   chunks' positions.
+//   Within a chunk, each channel is encoded separately: samples are predicted
+//   from preceding samples by a fixed polynomial predictor of order 0 to 4,
+//   and prediction residuals are Rice coded. Integer samples are encoded
+//   exactly; float32 samples are encoded as integers obtained from their bit
+//   patterns, so they are restored bit by bit.
+//   State vectors are encoded as run lengths of unchanged bytes, and literals
+//   of changed bytes.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCZ_CODEC_H
+#define BCZ_CODEC_H
+
+#include "SignalType.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+
+class GenericSignal;
+class StateVector;
+
+class BCZCodec
+{
+ public:
+  enum
+  {
+    ChunkHeaderSize = 12,   // "BCZC", number of samples, payload size
+    IndexHeaderSize = 8,    // "BCZI", number of entries
+    IndexEntrySize = 12,    // file offset, number of samples
+    TrailerSize = 12,       // index offset, "BCZE"
+    DefaultChunkSamples = 4096,
+  };
+  // Value of the "Compression=" header field.
+  static const char* Name()
+    { return "lpc1"; }
+
+  struct Chunk
+  {
+    long long firstSample,
+              offset; // file offset of the chunk header
+    int samples;
+  };
+  typedef std::vector<Chunk> ChunkTable;
+
+  // Collects records, and encodes them into a chunk.
+  // Encoding is split into EncodeChannel() and EncodeStates() jobs, which
+  // may be run concurrently.
+  class Encoder
+  {
+   public:
+    Encoder();
+    Encoder& Initialize( SignalType, int channels, int statevectorLength );
+    int Samples() const
+      { return mSamples; }
+    int Channels() const
+      { return static_cast<int>( mValues.size() ); }
+    // As in the dat format, the i-th signal element is stored with the i-th
+    // state vector sample.
+    Encoder& Add( const GenericSignal&, const StateVector& );
+    // Adds records in dat layout.
+    Encoder& Add( const char* records, int count );
+
+    void EncodeChannel( int );
+    void EncodeStates();
+    // Writes a chunk from the results of EncodeChannel() and EncodeStates()
+    // for all channels, and clears the encoder's records.
+    std::ostream& WriteChunk( std::ostream& );
+    // Encodes and writes a chunk in the calling thread.
+    std::ostream& Encode( std::ostream& );
+
+   private:
+    SignalType mType;
+    int mStatevectorLength,
+        mSamples;
+    std::vector< std::vector<int32_t> > mValues;
+    std::vector<unsigned char> mStates;
+    std::vector<std::string> mEncodedChannels;
+    std::string mEncodedStates;
+  };
+
+  // Decodes a chunk's payload into records in dat layout.
+  // Throws an exception if the payload is inconsistent.
+  static void DecodeChunk( const char* payload, size_t size, int samples,
+                           SignalType, int channels, int statevectorLength,
+                           char* records );
+
+  // Parses a chunk header. Returns false if the data is not a chunk header.
+  static bool ParseChunkHeader( const char*, int& samples, uint32_t& payloadSize );
+  // Writes a seek index, and a trailer pointing to the index, which is
+  // located at the given file offset.
+  static std::ostream& WriteIndex( std::ostream&, const ChunkTable&, long long indexOffset );
+  // Parses a trailer. Returns false if the data is not a trailer.
+  static bool ParseTrailer( const char*, long long& indexOffset );
+  // Parses an index header. Returns false if the data is not an index header.
+  static bool ParseIndexHeader( const char*, int& entries );
+  // Parses index entries, and appends them to a chunk table.
+  static void ParseIndex( const char*, int entries, ChunkTable& );
+};
+
+#endif // BCZ_CODEC_H
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: An output class for compressed BCI2000 data files (*.bcz).
+//
+//
+// $BEGIN_BCI2000_LICENSE$
+// 
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+// 
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+// 
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCZOutputFormat.h"
+
+#include "ReusableThread.h"
+#include "Runnable.h"
+#include "ThreadUtils.h"
+#include "BCIException.h"
+#include <algorithm>
+
+using namespace std;
+
+// Each thread encodes every n-th channel, with the state vector data
+// counting as an additional channel.
+static void
+EncodeJobs( BCZCodec::Encoder& ioEncoder, int inFirst, int inStride )
+{
+  for( int job = inFirst; job <= ioEncoder.Channels(); job += inStride )
+    if( job < ioEncoder.Channels() )
+      ioEncoder.EncodeChannel( job );
+    else
+      ioEncoder.EncodeStates();
+}
+
+class BCZOutputFormat::EncoderThread : public ReusableThread, private Runnable
+{
+ public:
+  EncoderThread( BCZCodec::Encoder& inEncoder, int inFirst, int inStride )
+    : mrEncoder( inEncoder ), mFirst( inFirst ), mStride( inStride ) {}
+  void Start()
+    {
+      if( !ReusableThread::Run( *this ) )
+        throw std_runtime_error( "Could not start execution: thread busy" );
+    }
+
+ private:
+  void OnRun()
+    { EncodeJobs( mrEncoder, mFirst, mStride ); }
+
+  BCZCodec::Encoder& mrEncoder;
+  int mFirst,
+      mStride;
+};
+
+BCZOutputFormat::BCZOutputFormat()
+: mSamplesWritten( 0 )
+{
+}
+
+BCZOutputFormat::~BCZOutputFormat()
+{
+  DeleteThreads();
+}
+
+void
+BCZOutputFormat::DeleteThreads()
+{
+  for( size_t i = 0; i < mThreads.size(); ++i )
+    delete mThreads[i];
+  mThreads.clear();
+}
+
+void
+BCZOutputFormat::Initialize( const SignalProperties& inProperties,
+                             const StateVector& inStatevector )
+{
+  BCI2000OutputFormat::Initialize( inProperties, inStatevector );
+  mEncoder.Initialize( inProperties.Type(), inProperties.Channels(), inStatevector.Length() );
+  // The file writer thread takes a share of the encoding jobs itself.
+  DeleteThreads();
+  int numJobs = inProperties.Channels() + 1,
+      numThreads = min( ThreadUtils::NumberOfProcessors(), numJobs );
+  for( int i = 1; i < numThreads; ++i )
+    mThreads.push_back( new EncoderThread( mEncoder, i, numThreads ) );
+}
+
+void
+BCZOutputFormat::StartRun( ostream& os, const string& )
+{
+  mEncoder.Initialize( mInputProperties.Type(), mInputProperties.Channels(), mStatevectorLength );
+  mChunks.clear();
+  mSamplesWritten = 0;
+  WriteHeader( os, BCZCodec::Name() );
+}
+
+void
+BCZOutputFormat::StopRun( ostream& os )
+{
+  WriteChunk( os );
+  BCZCodec::WriteIndex( os, mChunks, os.tellp() );
+}
+
+void
+BCZOutputFormat::Write( ostream& os, const GenericSignal& inSignal, const StateVector& inStatevector )
+{
+  mEncoder.Add( inSignal, inStatevector );
+  if( mEncoder.Samples() >= BCZCodec::DefaultChunkSamples )
+    WriteChunk( os );
+}
+
+void
+BCZOutputFormat::WriteChunk( ostream& os )
+{
+  if( mEncoder.Samples() < 1 )
+    return;
+  for( size_t i = 0; i < mThreads.size(); ++i )
+    mThreads[i]->Start();
+  EncodeJobs( mEncoder, 0, static_cast<int>( mThreads.size() ) + 1 );
+  for( size_t i = 0; i < mThreads.size(); ++i )
+    mThreads[i]->Wait();
+
+  BCZCodec::Chunk chunk;
+  chunk.firstSample = mSamplesWritten;
+  chunk.offset = os.tellp();
+  chunk.samples = mEncoder.Samples();
+  mChunks.push_back( chunk );
+  mSamplesWritten += chunk.samples;
+  mEncoder.WriteChunk( os );
+}
@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: An output class for compressed BCI2000 data files (*.bcz).
+//   Records are collected into chunks, and channels are encoded concurrently
+//   when a chunk is complete. See BCZCodec.h for a description of the format.
+//
+//
+// $BEGIN_BCI2000_LICENSE$
+// 
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+// 
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+// 
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCZ_OUTPUT_FORMAT_H
+#define BCZ_OUTPUT_FORMAT_H
+
+#include "BCI2000OutputFormat.h"
+#include "BCZCodec.h"
+#include <vector>
+
+class BCZOutputFormat : public BCI2000OutputFormat
+{
+ public:
+          BCZOutputFormat();
+  virtual ~BCZOutputFormat();
+
+  virtual void Initialize( const SignalProperties&, const StateVector& );
+  virtual void StartRun( std::ostream&, const std::string& );
+  virtual void StopRun( std::ostream& );
+  virtual void Write( std::ostream&, const GenericSignal&, const StateVector& );
+
+  virtual const char* DataFileExtension() const { return ".bcz"; }
+
+ private:
+  void WriteChunk( std::ostream& );
+  void DeleteThreads();
+
+  class EncoderThread;
+  std::vector<EncoderThread*> mThreads;
+  BCZCodec::Encoder    mEncoder;
+  BCZCodec::ChunkTable mChunks;
+  long long            mSamplesWritten;
+};
+
+#endif // BCZ_OUTPUT_FORMAT_H
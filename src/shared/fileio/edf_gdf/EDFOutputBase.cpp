@@ -95,6 +95,8 @@ EDFOutputBase::Preflight( const SignalProperties&,
   }
   Parameter( "SourceChGain" );
   Parameter( "SourceChOffset" );
+  Parameter( "SampleBlockSize" );
+  Parameter( "SamplingRate" );
 }
 
 
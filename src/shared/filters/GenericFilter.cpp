@@ -459,8 +459,9 @@ GenericFilter::NewInstance( const GenericFilter* existingInstance )
 Directory::Node::~Node()
 {
   SetParent( 0 );
-  for( Container::iterator i = mChildren.begin(); i != mChildren.end(); ++i )
-    ( *i )->SetParent( 0 );
+  // SetParent() removes a child from mChildren.
+  while( !mChildren.empty() )
+    mChildren.front()->SetParent( 0 );
 }
 
 void 
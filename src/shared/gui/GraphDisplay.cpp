@@ -40,6 +40,7 @@
 #include "BitmapImage.h"
 
 #include <algorithm>
+#include <cmath>
 
 using namespace GUI;
 using namespace std;
@@ -141,6 +142,15 @@ BitmapImageFromHDC( BitmapImage& ioImage, HDC inDC, const RECT& inSourceRect )
 #endif // _WIN32
 
 #if USE_QT
+static RGBColor
+RGBColorFromQRgb( QRgb inRgb )
+{
+  QColor color = QColor::fromRgba( inRgb );
+  if( color.alpha() == 0 )
+    return RGBColor::NullColor;
+  return RGBColor( color.red(), color.green(), color.blue() );
+}
+
 static void
 BitmapImageFromQPixmap( BitmapImage& ioImage, const QPixmap& inPixmap )
 {
@@ -148,22 +158,15 @@ BitmapImageFromQPixmap( BitmapImage& ioImage, const QPixmap& inPixmap )
       height = ioImage.Height();
   QImage img( inPixmap.scaled( width, height ).toImage() );
   for( int x = 0; x < width; ++x )
-  {
     for( int y = 0; y < height; ++y )
-    {
-      QColor color = QColor::fromRgba( img.pixel( x, y ) );
-      if( color.alpha() == 0 )
-        ioImage( x, y ) = RGBColor::NullColor;
-      else
-        ioImage( x, y ) = RGBColor( color.red(), color.green(), color.blue() );
-    }
-  }
+      ioImage( x, y ) = RGBColorFromQRgb( img.pixel( x, y ) );
 }
 #endif // USE_QT
 
 // GraphDisplay definitions
 GraphDisplay::GraphDisplay()
-: mColor( RGBColor::Gray )
+: mColor( RGBColor::Gray ),
+  mNextTile( 0 )
 {
   mContext.rect.left = 0;
   mContext.rect.top = 0;
@@ -348,6 +351,21 @@ GraphDisplay::Invalidate()
 GraphDisplay&
 GraphDisplay::InvalidateRect( const GUI::Rect& inRect )
 {
+  mDirtyRects.push_back( inRect );
+  const size_t cMaxDirtyRects = 64;
+  if( mDirtyRects.size() > cMaxDirtyRects )
+  { // Replace with bounding rectangle.
+    Rect r = mDirtyRects.front();
+    for( size_t i = 1; i < mDirtyRects.size(); ++i )
+    {
+      r.left = min( r.left, mDirtyRects[i].left );
+      r.top = min( r.top, mDirtyRects[i].top );
+      r.right = max( r.right, mDirtyRects[i].right );
+      r.bottom = max( r.bottom, mDirtyRects[i].bottom );
+    }
+    mDirtyRects.clear();
+    mDirtyRects.push_back( r );
+  }
 #if USE_QT
   QRegion rgn(
       static_cast<int>( inRect.left ),
@@ -436,6 +454,127 @@ GraphDisplay::BitmapData( int inWidth, int inHeight ) const
   return image;
 }
 
+GraphDisplay&
+GraphDisplay::UpdateBitmapData( BitmapImage& ioImage, vector<int>& outTiles,
+                                int inWidth, int inHeight, int inMaxTiles )
+{
+  int width = inWidth,
+      height = inHeight,
+      originalWidth = static_cast<int>( mContext.rect.right - mContext.rect.left ),
+      originalHeight = static_cast<int>( mContext.rect.bottom - mContext.rect.top );
+  if( width == 0 && height == 0 )
+  {
+    width = originalWidth;
+    height = originalHeight;
+  }
+  outTiles.clear();
+  if( ioImage.Width() != width || ioImage.Height() != height
+      || mDirtyTiles.size() != static_cast<size_t>( ioImage.Tiles() ) )
+  {
+    if( ioImage.Width() != width || ioImage.Height() != height )
+      ioImage = BitmapImage( width, height );
+    mDirtyTiles.clear();
+    mDirtyTiles.resize( ioImage.Tiles(), true );
+    inMaxTiles = 0;
+  }
+  else if( originalWidth > 0 && originalHeight > 0 )
+  { // Mark tiles containing pixels that sample from invalidated areas.
+    int horizontalTiles = ioImage.HorizontalTiles(),
+        verticalTiles = ioImage.VerticalTiles();
+    for( size_t i = 0; i < mDirtyRects.size(); ++i )
+    {
+      const Rect& r = mDirtyRects[i];
+      int left = static_cast<int>( ::floor( ( r.left - mContext.rect.left ) * width / originalWidth ) ),
+          top = static_cast<int>( ::floor( ( r.top - mContext.rect.top ) * height / originalHeight ) ),
+          right = static_cast<int>( ::ceil( ( r.right - mContext.rect.left ) * width / originalWidth ) ),
+          bottom = static_cast<int>( ::ceil( ( r.bottom - mContext.rect.top ) * height / originalHeight ) );
+      left = max( left, 0 ) / BitmapImage::TileSize;
+      top = max( top, 0 ) / BitmapImage::TileSize;
+      right = min( ( right + BitmapImage::TileSize - 1 ) / BitmapImage::TileSize, horizontalTiles );
+      bottom = min( ( bottom + BitmapImage::TileSize - 1 ) / BitmapImage::TileSize, verticalTiles );
+      for( int y = top; y < bottom; ++y )
+        for( int x = left; x < right; ++x )
+          mDirtyTiles[y * horizontalTiles + x] = true;
+    }
+  }
+  mDirtyRects.clear();
+  // Continue where the previous call stopped, such that all tiles are
+  // eventually read when the number of tiles per call is limited.
+  int tiles = static_cast<int>( mDirtyTiles.size() );
+  for( int i = 0; i < tiles && ( inMaxTiles <= 0 || static_cast<int>( outTiles.size() ) < inMaxTiles ); ++i )
+  {
+    int tile = ( mNextTile + i ) % tiles;
+    if( mDirtyTiles[tile] )
+    {
+      outTiles.push_back( tile );
+      mDirtyTiles[tile] = false;
+    }
+  }
+  if( !outTiles.empty() )
+    mNextTile = ( outTiles.back() + 1 ) % tiles;
+  sort( outTiles.begin(), outTiles.end() );
+  ReadTiles( ioImage, outTiles );
+  return *this;
+}
+
+#if USE_QT
+void
+GraphDisplay::ReadTiles( BitmapImage& ioImage, const vector<int>& inTiles ) const
+{
+  int width = ioImage.Width(),
+      height = ioImage.Height(),
+      originalWidth = static_cast<int>( mContext.rect.right - mContext.rect.left ),
+      originalHeight = static_cast<int>( mContext.rect.bottom - mContext.rect.top ),
+      horizontalTiles = ioImage.HorizontalTiles();
+  if( inTiles.empty() || width < 1 || height < 1 )
+    return;
+  // Read only the display area that covers the tiles' bounding rectangle.
+  int left = width,
+      top = height,
+      right = 0,
+      bottom = 0;
+  for( size_t i = 0; i < inTiles.size(); ++i )
+  {
+    int x = ( inTiles[i] % horizontalTiles ) * BitmapImage::TileSize,
+        y = ( inTiles[i] / horizontalTiles ) * BitmapImage::TileSize;
+    left = min( left, x );
+    top = min( top, y );
+    right = max( right, min<int>( x + BitmapImage::TileSize, width ) );
+    bottom = max( bottom, min<int>( y + BitmapImage::TileSize, height ) );
+  }
+  int sourceLeft = ( left * originalWidth ) / width,
+      sourceTop = ( top * originalHeight ) / height,
+      sourceWidth = ( ( right - 1 ) * originalWidth ) / width + 1 - sourceLeft,
+      sourceHeight = ( ( bottom - 1 ) * originalHeight ) / height + 1 - sourceTop;
+  QImage img;
+  if( mpOffscreenBmp != NULL )
+    img = mpOffscreenBmp->copy( sourceLeft, sourceTop, sourceWidth, sourceHeight ).toImage();
+  else if( mpWidget != NULL )
+    img = QPixmap::grabWindow( mpWidget->winId(), sourceLeft, sourceTop, sourceWidth, sourceHeight ).toImage();
+  if( img.isNull() )
+    return;
+  // Each target pixel is sampled from a single display pixel.
+  for( size_t i = 0; i < inTiles.size(); ++i )
+  {
+    int tileLeft = ( inTiles[i] % horizontalTiles ) * BitmapImage::TileSize,
+        tileTop = ( inTiles[i] / horizontalTiles ) * BitmapImage::TileSize,
+        tileRight = min<int>( tileLeft + BitmapImage::TileSize, width ),
+        tileBottom = min<int>( tileTop + BitmapImage::TileSize, height );
+    for( int y = tileTop; y < tileBottom; ++y )
+    {
+      int sourceY = ( y * originalHeight ) / height - sourceTop;
+      for( int x = tileLeft; x < tileRight; ++x )
+        ioImage( x, y ) = RGBColorFromQRgb( img.pixel( ( x * originalWidth ) / width - sourceLeft, sourceY ) );
+    }
+  }
+}
+#else // USE_QT
+void
+GraphDisplay::ReadTiles( BitmapImage&, const vector<int>& ) const
+{
+}
+#endif // USE_QT
+
 void
 GraphDisplay::ClearOffscreenBuffer()
 {
@@ -33,6 +33,7 @@
 #include "Color.h"
 #include <set>
 #include <list>
+#include <vector>
 #if USE_QT
 # include <QWidget>
 namespace GUI { class WidgetBase; }
@@ -88,6 +89,13 @@ public:
 
   // Read bitmap data, resampled to target resolution
   BitmapImage BitmapData( int width = 0, int height = 0 ) const;
+  // Read bitmap data into those tiles of an image that cover areas invalidated
+  // since the previous call, and report the tiles' indices.
+  // If the image does not match the target resolution, it is resized, and all
+  // of its tiles are read. Otherwise, if maxTiles is nonzero, at most maxTiles
+  // tiles are read, and the remaining ones are kept for subsequent calls.
+  GraphDisplay& UpdateBitmapData( BitmapImage&, std::vector<int>& outTiles,
+                                  int width = 0, int height = 0, int maxTiles = 0 );
 
   // Graphics functions
   //  Invalidate the display's entire area
@@ -107,11 +115,16 @@ public:
 
  private:
   void ClearOffscreenBuffer();
+  void ReadTiles( BitmapImage&, const std::vector<int>& ) const;
 
   DrawContext         mContext;
   RGBColor            mColor;
   SetOfGraphObjects   mObjects;
   QueueOfGraphObjects mObjectsClicked;
+  // Areas invalidated since the last call to UpdateBitmapData(), in pixel coordinates.
+  std::vector<Rect>   mDirtyRects;
+  std::vector<bool>   mDirtyTiles;
+  int                 mNextTile;
 
 #if USE_QT
   friend class GUI::WidgetBase;
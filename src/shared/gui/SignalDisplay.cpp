@@ -34,6 +34,7 @@
 #include "IIRFilter.h"
 
 #include <cmath>
+#include <cstdlib>
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
@@ -177,6 +178,7 @@ SignalDisplay::AdaptTo( const GenericSignal& inSignal )
   {
     OSMutex::Lock lock( mDataLock );
     mData = GenericSignal( inSignal.Channels(), mNumSamples );
+    mEnvelope.Rebuild( mData );
     SetDisplayGroups( DisplayGroups() );
     SyncLabelWidth();
     mSampleCursor = 0;
@@ -197,6 +199,15 @@ SignalDisplay::WrapForward( const GenericSignal& inSignal )
   for( int i = 0; i < inSignal.Channels(); ++i )
     for( int j = 0; j < inSignal.Elements(); ++j )
       mData( i, ( mSampleCursor + j ) % mData.Elements() ) = inSignal( i, j );
+  if( inSignal.Elements() >= mData.Elements() )
+    mEnvelope.Rebuild( mData );
+  else
+  {
+    int end = mSampleCursor + inSignal.Elements();
+    mEnvelope.Update( mData, mSampleCursor, end );
+    if( end > mData.Elements() )
+      mEnvelope.Update( mData, 0, end - mData.Elements() );
+  }
 
   SyncGraphics();
 
@@ -297,6 +308,7 @@ SignalDisplay::ScrollForward( const GenericSignal& inSignal )
     while( j < mData.Elements() )
       mData( i, j++ ) = inSignal( i, k++ );
   }
+  mEnvelope.Rebuild( mData );
 
   SyncGraphics();
   Invalidate();
@@ -327,6 +339,7 @@ SignalDisplay::ScrollBack( const GenericSignal& inSignal )
     while( j > 0 )
       mData( i, --j ) = inSignal( i, --k );
   }
+  mEnvelope.Rebuild( mData );
 
   SyncGraphics();
   Invalidate();
@@ -469,17 +482,15 @@ SignalDisplay::SetNumSamples( int inNumSamples )
       idx1 = ( idx1 - idx2 ) % mNumSamples;
       idx2 = 0;
     }
-    for( int i = 0; i < idx2; ++i )
-      for( int ch = 0; ch < newData.Channels(); ++ch )
-        newData( ch, i ) = NaN( newData( ch, i ) );
-    while( idx2 < newNumSamples )
+    for( int ch = 0; ch < newData.Channels(); ++ch )
     {
-      for( int ch = 0; ch < newData.Channels(); ++ch )
-        newData( ch, idx2 ) = mData( ch, idx1 );
-      ++idx1 %= mNumSamples;
-      ++idx2;
+      for( int i = 0; i < idx2; ++i )
+        newData( ch, i ) = NaN( newData( ch, i ) );
+      for( int i = idx1, j = idx2; j < newNumSamples; ++i %= mNumSamples, ++j )
+        newData( ch, j ) = mData( ch, i );
     }
     mData = newData;
+    mEnvelope.Rebuild( mData );
     mSampleCursor = 0;
     Invalidate();
     mNumSamples = newNumSamples;
@@ -619,6 +630,12 @@ SignalDisplay::DrawSignalPolyline( const PaintInfo& p )
     }
   }
 
+  if( mNumSamples > cEnvelopeSamplesPerPixel * mDataWidth )
+  { // Drawing cost is determined by the number of pixels rather than samples.
+    DrawSignalEnvelope( p );
+    return;
+  }
+
   int sampleBegin = 0,
       sampleEnd = mNumSamples;
   if( p.updateRgn )
@@ -687,6 +704,88 @@ SignalDisplay::DrawSignalPolyline( const PaintInfo& p )
   }
 }
 
+void
+SignalDisplay::DrawSignalEnvelope( const PaintInfo& p )
+{
+  float baseInterval = mNumDisplayGroups > 0
+                       ? mDataHeight / mNumDisplayGroups
+                       : mDataHeight;
+  int pixelBegin = 0,
+      pixelEnd = mDataWidth;
+  if( p.updateRgn )
+  { // We restrict drawing to the actually requested update region.
+    QRect clipRect = p.updateRgn->boundingRect();
+    pixelBegin = max( clipRect.left() - mLabelWidth - 1, 0 );
+    pixelEnd = min( clipRect.right() - mLabelWidth + 2, mDataWidth );
+  }
+  // Each pixel column is represented by two points, one at the minimum and
+  // one at the maximum of the samples mapped to that column.
+  delete[] mpSignalPoints;
+  mpSignalPoints = NULL;
+  int maxPoints = 2 * ( pixelEnd - pixelBegin + 1 );
+  if( maxPoints < 2 )
+    return;
+  try
+  {
+    mpSignalPoints = new QPoint[maxPoints];
+  }
+  catch( const bad_alloc& )
+  {
+    throw std_bad_alloc( "Could not allocate memory for " << maxPoints << " points" );
+  }
+  int numPens = static_cast<int>( p.signalPens.size() );
+  double valueRange = mMaxValue - mMinValue;
+
+  for( int i = 0; i < mNumDisplayChannels; ++i )
+  {
+    int channelBottom = ChannelBottom( i ),
+        channel = i + mTopGroup * mChannelGroupSize;
+    p.painter->setPen( p.signalPens[ channel % numPens ] );
+    int numPoints = 0;
+    for( int px = pixelBegin; px < pixelEnd; ++px )
+    {
+      int sampleBegin = FirstSampleAtPixel( px ),
+          sampleEnd = min( FirstSampleAtPixel( px + 1 ), mNumSamples );
+      // Polylines are split at the cursor, as in DrawSignalPolyline().
+      int split = ( sampleBegin <= mSampleCursor && mSampleCursor < sampleEnd ) ? mSampleCursor : sampleBegin;
+      for( int part = 0; part < 2; ++part )
+      {
+        int begin = part ? split : sampleBegin,
+            end = part ? sampleEnd : split;
+        if( part && split != sampleBegin && numPoints > 0 )
+        {
+          p.painter->drawPolyline( mpSignalPoints, numPoints );
+          numPoints = 0;
+        }
+        if( begin >= end )
+          continue;
+        GenericSignal::ValueType minValue, maxValue;
+        if( mEnvelope.Range( mData, channel, begin, end, minValue, maxValue ) )
+        {
+          int x = mLabelWidth + px,
+              y1 = ToInt( channelBottom - 1 - baseInterval * ( minValue - mMinValue ) / valueRange ),
+              y2 = ToInt( channelBottom - 1 - baseInterval * ( maxValue - mMinValue ) / valueRange );
+          // Enter each column from the end closer to the previous point.
+          if( numPoints > 0 && ::abs( mpSignalPoints[numPoints - 1].y() - y2 ) < ::abs( mpSignalPoints[numPoints - 1].y() - y1 ) )
+            swap( y1, y2 );
+          mpSignalPoints[numPoints++] = QPoint( x, y1 );
+          mpSignalPoints[numPoints++] = QPoint( x, y2 );
+        }
+        else if( numPoints > 0 )
+        {
+          p.painter->drawPolyline( mpSignalPoints, numPoints );
+          numPoints = 0;
+        }
+      }
+    }
+    if( numPoints > 0 )
+      p.painter->drawPolyline( mpSignalPoints, numPoints );
+# ifdef _WIN32
+    ::Sleep( 0 );
+# endif // _WIN32
+  }
+}
+
 void
 SignalDisplay::DrawSignalField2d( const PaintInfo& p )
 {
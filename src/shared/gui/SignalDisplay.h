@@ -36,6 +36,7 @@
 #include "Color.h"
 #include "Label.h"
 #include "OSMutex.h"
+#include "SignalEnvelope.h"
 #include <set>
 #include <vector>
 
@@ -65,6 +66,9 @@ class SignalDisplay
     cTickWidth = cAxisWidth,
     cTickLength = 4,
     cInitialMaxDisplayGroups = 32,
+    // Above this number of samples per pixel, signals are drawn from
+    // their min/max envelope rather than sample by sample.
+    cEnvelopeSamplesPerPixel = 2,
   };
 
   static const RGBColor cAxisColorDefault,
@@ -220,6 +224,10 @@ class SignalDisplay
   inline
   int PosToSample( int p )
     { return mDataWidth ? ( ( p - mLabelWidth ) * mNumSamples ) / int( mDataWidth ) : 0; }
+  // The first sample s for which SampleLeft( s ) >= mLabelWidth + p.
+  inline
+  int FirstSampleAtPixel( int p )
+    { return mDataWidth ? static_cast<int>( ( static_cast<long long>( p ) * mNumSamples + mDataWidth - 1 ) / mDataWidth ) : 0; }
 
   inline
   int MarkerChannelTop( int ch )
@@ -286,6 +294,7 @@ class SignalDisplay
   LabelList     mChannelLabels,
                 mXAxisMarkers;
   GenericSignal mData;
+  SignalEnvelope mEnvelope;
   OSMutex       mDataLock;
 
  private:
@@ -293,6 +302,7 @@ class SignalDisplay
   void SetupPainting( PaintInfo&, const void* );
   void ClearBackground( const PaintInfo& );
   void DrawSignalPolyline( const PaintInfo& );
+  void DrawSignalEnvelope( const PaintInfo& );
   void DrawSignalField2d( const PaintInfo& );
   void DrawMarkerChannels( const PaintInfo& );
   void DrawCursor( const PaintInfo& );
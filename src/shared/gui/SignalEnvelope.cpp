@@ -0,0 +1,250 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A multi-resolution min/max envelope of a signal buffer.
+//   For each channel, minima and maxima over buckets of samples are kept
+//   in a binary tree, such that the range of values within an arbitrary
+//   interval of samples may be obtained at logarithmic cost.
+//   The envelope refers to a GenericSignal that is owned by the caller,
+//   and must be updated whenever the signal's data change.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "SignalEnvelope.h"
+#include "Numeric.h"
+#include "UnitTest.h"
+
+#include <limits>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+static const float cInf = numeric_limits<float>::infinity();
+
+SignalEnvelope::SignalEnvelope()
+: mChannels( 0 ),
+  mSamples( 0 ),
+  mLeaves( 1 )
+{
+}
+
+SignalEnvelope&
+SignalEnvelope::Rebuild( const GenericSignal& inSignal )
+{
+  mChannels = inSignal.Channels();
+  mSamples = inSignal.Elements();
+  int buckets = ( mSamples + BucketSize - 1 ) / BucketSize;
+  mLeaves = 1;
+  while( mLeaves < buckets )
+    mLeaves <<= 1;
+  mMin.clear();
+  mMin.resize( mChannels, vector<float>( 2 * mLeaves, cInf ) );
+  mMax.clear();
+  mMax.resize( mChannels, vector<float>( 2 * mLeaves, -cInf ) );
+  if( buckets > 0 )
+    for( int ch = 0; ch < mChannels; ++ch )
+      UpdateLeaves( inSignal, ch, 0, buckets - 1 );
+  return *this;
+}
+
+SignalEnvelope&
+SignalEnvelope::Update( const GenericSignal& inSignal, int inBegin, int inEnd )
+{
+  for( int ch = 0; ch < mChannels; ++ch )
+    Update( inSignal, ch, inBegin, inEnd );
+  return *this;
+}
+
+SignalEnvelope&
+SignalEnvelope::Update( const GenericSignal& inSignal, int inChannel, int inBegin, int inEnd )
+{
+  if( inSignal.Channels() != mChannels || inSignal.Elements() != mSamples )
+    return Rebuild( inSignal );
+
+  int begin = max( inBegin, 0 ),
+      end = min( inEnd, mSamples );
+  if( begin < end )
+    UpdateLeaves( inSignal, inChannel, begin / BucketSize, ( end - 1 ) / BucketSize );
+  return *this;
+}
+
+bool
+SignalEnvelope::Range( const GenericSignal& inSignal, int inChannel, int inBegin, int inEnd,
+                       GenericSignal::ValueType& outMin, GenericSignal::ValueType& outMax ) const
+{
+  float minValue = cInf,
+        maxValue = -cInf;
+  int begin = max( inBegin, 0 ),
+      end = min( inEnd, mSamples );
+  int firstBucket = ( begin + BucketSize - 1 ) / BucketSize,
+      endBucket = end / BucketSize;
+  if( firstBucket >= endBucket )
+  { // No complete bucket within range.
+    ScanSamples( inSignal, inChannel, begin, end, minValue, maxValue );
+  }
+  else
+  {
+    ScanSamples( inSignal, inChannel, begin, firstBucket * BucketSize, minValue, maxValue );
+    ScanSamples( inSignal, inChannel, endBucket * BucketSize, end, minValue, maxValue );
+    const vector<float>& treeMin = mMin[inChannel],
+                       & treeMax = mMax[inChannel];
+    int l = firstBucket + mLeaves,
+        r = endBucket + mLeaves;
+    while( l < r )
+    {
+      if( l & 1 )
+      {
+        minValue = min( minValue, treeMin[l] );
+        maxValue = max( maxValue, treeMax[l] );
+        ++l;
+      }
+      if( r & 1 )
+      {
+        --r;
+        minValue = min( minValue, treeMin[r] );
+        maxValue = max( maxValue, treeMax[r] );
+      }
+      l >>= 1;
+      r >>= 1;
+    }
+  }
+  outMin = minValue;
+  outMax = maxValue;
+  return minValue <= maxValue;
+}
+
+void
+SignalEnvelope::UpdateLeaves( const GenericSignal& inSignal, int inChannel, int inFirstBucket, int inLastBucket )
+{
+  vector<float>& treeMin = mMin[inChannel],
+               & treeMax = mMax[inChannel];
+  for( int bucket = inFirstBucket; bucket <= inLastBucket; ++bucket )
+  {
+    float minValue = cInf,
+          maxValue = -cInf;
+    ScanSamples( inSignal, inChannel, bucket * BucketSize, min( ( bucket + 1 ) * BucketSize, mSamples ), minValue, maxValue );
+    treeMin[mLeaves + bucket] = minValue;
+    treeMax[mLeaves + bucket] = maxValue;
+  }
+  // Propagate changes up to the root, one level at a time.
+  int lo = ( mLeaves + inFirstBucket ) >> 1,
+      hi = ( mLeaves + inLastBucket ) >> 1;
+  while( lo > 0 )
+  {
+    for( int i = lo; i <= hi; ++i )
+    {
+      treeMin[i] = min( treeMin[2 * i], treeMin[2 * i + 1] );
+      treeMax[i] = max( treeMax[2 * i], treeMax[2 * i + 1] );
+    }
+    lo >>= 1;
+    hi >>= 1;
+  }
+}
+
+void
+SignalEnvelope::ScanSamples( const GenericSignal& inSignal, int inChannel, int inBegin, int inEnd, float& ioMin, float& ioMax ) const
+{
+  for( int i = inBegin; i < inEnd; ++i )
+  {
+    GenericSignal::ValueType value = inSignal( inChannel, i );
+    if( !IsNaN( value ) )
+    {
+      float f = static_cast<float>( value );
+      ioMin = min( ioMin, f );
+      ioMax = max( ioMax, f );
+    }
+  }
+}
+
+UnitTest( SignalEnvelopeTest )
+{
+  GenericSignal signal( 2, 1000 );
+  for( int ch = 0; ch < signal.Channels(); ++ch )
+    for( int i = 0; i < signal.Elements(); ++i )
+      signal( ch, i ) = ( i % 97 ) ? ::rand() % 1000 : NaN( signal( ch, i ) );
+  SignalEnvelope envelope;
+  envelope.Rebuild( signal );
+  for( int trial = 0; trial < 2000; ++trial )
+  {
+    if( trial % 100 == 0 )
+    {
+      int pos = ::rand() % signal.Elements();
+      signal( 1, pos ) = ::rand() % 2000 - 1000;
+      envelope.Update( signal, 1, pos, pos + 1 );
+    }
+    int ch = trial % 2,
+        begin = ::rand() % signal.Elements(),
+        end = begin + ::rand() % ( signal.Elements() - begin + 1 );
+    float expectedMin = cInf,
+          expectedMax = -cInf;
+    for( int i = begin; i < end; ++i )
+      if( !IsNaN( signal( ch, i ) ) )
+      {
+        expectedMin = min<float>( expectedMin, signal( ch, i ) );
+        expectedMax = max<float>( expectedMax, signal( ch, i ) );
+      }
+    GenericSignal::ValueType resultMin, resultMax;
+    bool valid = envelope.Range( signal, ch, begin, end, resultMin, resultMax );
+    TestFail_if( valid != ( expectedMin <= expectedMax ), "[" << begin << "," << end << ")" );
+    TestFail_if( valid && resultMin != expectedMin, "[" << begin << "," << end << "): " << resultMin << " vs " << expectedMin );
+    TestFail_if( valid && resultMax != expectedMax, "[" << begin << "," << end << "): " << resultMax << " vs " << expectedMax );
+  }
+}
+
+UnitTest( SignalEnvelopePixelTest )
+{
+  // Computes per-pixel minima and maxima as SignalDisplay::DrawSignalEnvelope()
+  // does, for a display that shows 203 samples per pixel, such that pixels do
+  // not align with buckets, and compares them against a scan of each sample.
+  const int channels = 4,
+            pixels = 100,
+            samplesPerPixel = 203;
+  GenericSignal signal( channels, pixels * samplesPerPixel );
+  for( int ch = 0; ch < signal.Channels(); ++ch )
+    for( int i = 0; i < signal.Elements(); ++i )
+      signal( ch, i ) = ( i % 1009 ) ? ::rand() % 1000 : NaN( signal( ch, i ) );
+  SignalEnvelope envelope;
+  envelope.Rebuild( signal );
+  for( int ch = 0; ch < channels; ++ch )
+    for( int px = 0; px < pixels; ++px )
+    {
+      int begin = px * samplesPerPixel,
+          end = begin + samplesPerPixel;
+      float expectedMin = cInf,
+            expectedMax = -cInf;
+      for( int i = begin; i < end; ++i )
+        if( !IsNaN( signal( ch, i ) ) )
+        {
+          expectedMin = min<float>( expectedMin, signal( ch, i ) );
+          expectedMax = max<float>( expectedMax, signal( ch, i ) );
+        }
+      GenericSignal::ValueType resultMin, resultMax;
+      bool valid = envelope.Range( signal, ch, begin, end, resultMin, resultMax );
+      TestFail_if( !valid, "channel " << ch << ", pixel " << px << ": no valid samples" );
+      TestFail_if( resultMin != expectedMin || resultMax != expectedMax,
+        "channel " << ch << ", pixel " << px << ": [" << resultMin << "," << resultMax << "] vs ["
+        << expectedMin << "," << expectedMax << "]" );
+    }
+}
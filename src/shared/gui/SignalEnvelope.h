@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A multi-resolution min/max envelope of a signal buffer.
+//   For each channel, minima and maxima over buckets of samples are kept
+//   in a binary tree, such that the range of values within an arbitrary
+//   interval of samples may be obtained at logarithmic cost.
+//   The envelope refers to a GenericSignal that is owned by the caller,
+//   and must be updated whenever the signal's data change.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef SIGNAL_ENVELOPE_H
+#define SIGNAL_ENVELOPE_H
+
+#include "GenericSignal.h"
+#include <vector>
+
+class SignalEnvelope
+{
+ public:
+  // Number of samples in a leaf bucket. Samples within partially covered
+  // leaf buckets are read from the signal directly.
+  enum { BucketSize = 8 };
+
+  SignalEnvelope();
+
+  // Re-computes the entire envelope from the signal, adapting to its size.
+  SignalEnvelope& Rebuild( const GenericSignal& );
+  // Re-computes the envelope for a range of samples in a single channel.
+  SignalEnvelope& Update( const GenericSignal&, int channel, int begin, int end );
+  // Re-computes the envelope for a range of samples in all channels.
+  SignalEnvelope& Update( const GenericSignal&, int begin, int end );
+
+  // Determines minimum and maximum over samples in [begin, end), ignoring NaNs.
+  // Returns false if there are no valid samples in the range.
+  bool Range( const GenericSignal&, int channel, int begin, int end,
+              GenericSignal::ValueType& outMin, GenericSignal::ValueType& outMax ) const;
+
+ private:
+  void UpdateLeaves( const GenericSignal&, int channel, int firstBucket, int lastBucket );
+  void ScanSamples( const GenericSignal&, int channel, int begin, int end, float& ioMin, float& ioMax ) const;
+
+  int mChannels,
+      mSamples,
+      mLeaves; // number of leaves in each tree, a power of two
+  // Trees are stored in heap order, i.e. node i has children 2i and 2i+1,
+  // and leaves start at index mLeaves. Empty nodes contain +inf/-inf.
+  std::vector< std::vector<float> > mMin,
+                                    mMax;
+};
+
+#endif // SIGNAL_ENVELOPE_H
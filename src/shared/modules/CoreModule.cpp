@@ -42,6 +42,7 @@
 #include "FileUtils.h"
 #include "ProcessUtils.h"
 #include "ExceptionCatcher.h"
+#include "PrecisionTime.h"
 
 #include <string>
 #include <sstream>
@@ -121,6 +122,8 @@ bool ModuleConnection::OnStateVector( std::istream& s )
 { return mrParent.HandleStateVector( s ); }
 bool ModuleConnection::OnSysCommand( std::istream& s )
 { return mrParent.HandleSysCommand( s ); }
+bool ModuleConnection::OnLatencyTrace( std::istream& s )
+{ return mrParent.HandleLatencyTrace( s ); }
 bool ModuleConnection::OnSend( const VisSignalConst& s )
 { return mrParent.OnSendSignal( &s.Signal(), *this ); }
 bool ModuleConnection::OnSend( const VisSignal& s )
@@ -128,10 +131,12 @@ bool ModuleConnection::OnSend( const VisSignal& s )
 
 // CoreModule class
 CoreModule::CoreModule()
-: mFiltersInitialized( false ),
+: mOperator( *this ),
+  mNextModule( *this ),
+  mPreviousModule( *this ),
   mTerminating( false ),
   mRunning( false ),
-  mActiveResting( false ),
+  mFiltersInitialized( false ),
   mStartRunPending( false ),
   mStopRunPending( false ),
   mNeedStopRun( false ),
@@ -139,9 +144,10 @@ CoreModule::CoreModule()
   mGlobalID( NULL ),
   mOperatorBackLink( false ),
   mAutoConfig( false ),
-  mOperator( *this ),
-  mPreviousModule( *this ),
-  mNextModule( *this )
+  mActiveResting( false ),
+  mLatencyTracing( false ),
+  mLatencyTraceReceived( false ),
+  mBlockReceived( 0 )
 {
   mOperatorSocket.set_tcpnodelay( true );
   mNextModuleSocket.set_tcpnodelay( true );
@@ -649,6 +655,8 @@ CoreModule::InitializeFilters()
   {
     if( mParamlist.Exists( "OperatorBackLink" ) )
       mOperatorBackLink = ::atoi( mParamlist["OperatorBackLink"].Value().c_str() );
+    mLatencyTracing = mParamlist.Exists( "LatencyTracing" )
+                      && ::atoi( mParamlist["LatencyTracing"].Value().c_str() );
     if( !mAutoConfig )
     {
       if( IsLastModule() )
@@ -723,12 +731,26 @@ CoreModule::BroadcastParameterChanges()
 
   if( !changedParameters.Empty() )
   {
+    if( mOperator.Protocol().Provides( ProtocolVersion::ParamSnapshots ) )
+      for( int i = 0; i < changedParameters.Size(); ++i )
+        mSyncedParams[changedParameters[i].Name()] = changedParameters[i];
     mOperator.Send( changedParameters );
     if( !mOperator.Send( SysCommand::EndOfParameter ) )
       bcierr << "Could not publish changed parameters" << endl;
   }
 }
 
+void
+CoreModule::RestoreParameters()
+{
+  for( int i = 0; i < mParamlist.Size(); ++i )
+  {
+    Param& p = mParamlist[i];
+    if( p.Changed() && mSyncedParams.Exists( p.Name() ) )
+      p = mSyncedParams[p.Name()];
+  }
+}
+
 void
 CoreModule::ProcessFilters()
 {
@@ -739,6 +761,8 @@ CoreModule::ProcessFilters()
   EnvironmentBase::EnterProcessingPhase( &mParamlist, &mStatelist, &mStatevector );
   GenericFilter::ProcessFilters( mInputSignal, mOutputSignal, !( mRunning || wasRunning ) );
   EnvironmentBase::EnterNonaccessPhase();
+  if( mLatencyTracing )
+    TraceProcessed();
   if( bcierr__.Empty() && ( mRunning || wasRunning ) )
     SendOutput();
   if( bcierr__.Empty() && mStopRunPending )
@@ -750,6 +774,14 @@ CoreModule::ProcessFilters()
 void
 CoreModule::SendOutput()
 {
+  if( mLatencyTracing && mLatencyTrace.Hops() > 0 )
+  {
+    mLatencyTrace[mLatencyTrace.Hops() - 1].sent = PrecisionTime::Nanoseconds();
+    if( IsLastModule() )
+      mOperator.Send( mLatencyTrace );
+    else
+      mNextModule.Send( mLatencyTrace );
+  }
   if( IsLastModule() && mOperatorBackLink )
   {
     mOperator.Send( mStatevector );
@@ -760,6 +792,22 @@ CoreModule::SendOutput()
     mNextModule.Send( mOutputSignal );
 }
 
+void
+CoreModule::TraceProcessed()
+{
+  // The source module starts a new trace for each block. Other modules append
+  // to the trace received from the previous module, or start an empty trace
+  // if there was none.
+  if( MODTYPE == 1 )
+    mLatencyTrace.Reset( mLatencyTrace.Block() + 1, LatencyTrace::LastAcquisition() );
+  else if( !mLatencyTraceReceived )
+    mLatencyTrace.Reset( 0, 0 );
+  mLatencyTraceReceived = false;
+  LatencyTrace::Hop& hop = mLatencyTrace.AddHop( MODTYPE );
+  hop.received = mBlockReceived;
+  hop.processed = PrecisionTime::Nanoseconds();
+}
+
 void
 CoreModule::StateUpdate()
 {
@@ -779,7 +827,14 @@ CoreModule::HandleParam( istream& is )
   ParamList& list = mReceivingNextModuleInfo ? mNextModuleInfo : mParamlist;
   Param p;
   if( p.ReadBinary( is ) )
+  {
     list[p.Name()] = p;
+    if( &list == &mParamlist && mOperator.Protocol().Provides( ProtocolVersion::ParamSnapshots ) )
+    {
+      list[p.Name()].Unchanged();
+      mSyncedParams[p.Name()] = p;
+    }
+  }
   return is ? true : false;
 }
 
@@ -848,6 +903,8 @@ CoreModule::HandleVisSignalProperties( istream& is )
 bool
 CoreModule::HandleStateVector( istream& is )
 {
+  if( mLatencyTracing )
+    mBlockReceived = PrecisionTime::Nanoseconds();
   mStatevector.ReadBinary( is );
   if( mInputSignal.Properties().IsEmpty() )
     ProcessFilters();
@@ -866,6 +923,8 @@ CoreModule::HandleSysCommand( istream& is )
     }
     else if( s == SysCommand::EndOfParameter )
     {
+      if( !mReceivingNextModuleInfo && mOperator.Protocol().Provides( ProtocolVersion::ParamSnapshots ) )
+        RestoreParameters();
       mReceivingNextModuleInfo = false;
       mFiltersInitialized = false;
     }
@@ -885,6 +944,13 @@ CoreModule::HandleSysCommand( istream& is )
   return is ? true : false;
 }
 
+bool
+CoreModule::HandleLatencyTrace( istream& is )
+{
+  mLatencyTraceReceived = !!mLatencyTrace.ReadBinary( is );
+  return is ? true : false;
+}
+
 bool
 CoreModule::HandleProtocolVersion( istream& is )
 {
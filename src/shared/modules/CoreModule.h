@@ -67,6 +67,7 @@
 #include "ProtocolVersion.h"
 #include "ThreadedSockbuf.h"
 #include "GenericVisualization.h"
+#include "LatencyTrace.h"
 #include "OSMutex.h"
 
 #if MODTYPE
@@ -144,6 +145,7 @@ class ModuleConnection
   bool OnVisSignalProperties( std::istream& );
   bool OnStateVector( std::istream& );
   bool OnSysCommand( std::istream& );
+  bool OnLatencyTrace( std::istream& );
 
   bool OnSend( const VisSignal& );
   bool OnSend( const VisSignalConst& );
@@ -193,8 +195,12 @@ class CoreModule
   void StartRunFilters();
   void StopRunFilters();
   void BroadcastParameterChanges();
+  // When the operator sends only parameters that changed, restores parameters
+  // that were modified locally, and not reported to the operator.
+  void RestoreParameters();
   void ProcessFilters();
   void SendOutput();
+  void TraceProcessed();
 
   void StateUpdate();
 
@@ -207,12 +213,14 @@ class CoreModule
   bool HandleStateVector( std::istream& );
   bool HandleSysCommand( std::istream& );
   bool HandleProtocolVersion( std::istream& );
+  bool HandleLatencyTrace( std::istream& );
 
   bool OnSendSignal( const GenericSignal*, const ModuleConnection& );
 
  private:
   ParamList        mParamlist,
-                   mNextModuleInfo;
+                   mNextModuleInfo,
+                   mSyncedParams; // as last received from, or reported to, the operator
   StateList        mStatelist;
   StateVector      mStatevector,
                    mInitialStatevector;
@@ -236,6 +244,10 @@ class CoreModule
                    mAutoConfig;
   std::string      mThisModuleIP;
   bool             mActiveResting;
+  bool             mLatencyTracing,
+                   mLatencyTraceReceived;
+  long long        mBlockReceived;
+  LatencyTrace     mLatencyTrace;
   std::map<const GenericSignal*, int> mLargeSignals;
 };
 
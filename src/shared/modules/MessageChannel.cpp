@@ -37,6 +37,7 @@
 #include "StateVector.h"
 #include "GenericSignal.h"
 #include "SysCommand.h"
+#include "LatencyTrace.h"
 #include "GenericVisualization.h"
 #include "LengthField.h"
 #include "SockStream.h"
@@ -60,6 +61,24 @@ namespace
   void SaveDebugInfo( istream& );
   string GetDebugHistory( istream& );
   iostream sDummy( 0 );
+
+  // Writes a Param message with numeric values in binary form.
+  struct BinaryParamValues
+  {
+    BinaryParamValues( const Param& p ) : p( p ) {}
+    ostream& WriteBinary( ostream& os ) const
+      { return p.WriteBinary( os, true ); }
+    const Param& p;
+  };
+
+  // Writes a VisBitmap message, using the tiled format where appropriate.
+  struct TiledVisBitmap
+  {
+    TiledVisBitmap( const VisBitmap& b ) : b( b ) {}
+    ostream& WriteBinary( ostream& os ) const
+      { return b.WriteBinary( os, true ); }
+    const VisBitmap& b;
+  };
 }
 
 namespace bci
@@ -98,6 +117,8 @@ MessageChannel::Init()
 {
   mpInputLock = 0;
   mpOutputLock = 0;
+  mAutoFlush = true;
+  mBufferedInput = false;
   ResetStatistics();
 }
 
@@ -108,7 +129,7 @@ MessageChannel::~MessageChannel()
 #define CONSIDER(x)                         \
   case Header<x>::descSupp:                 \
     pType = #x;                             \
-    On##x( is ) || is.ignore( length ); \
+    On##x( in ) || in.ignore( length ); \
     break;
 
 // Main message handling functions.
@@ -125,7 +146,18 @@ MessageChannel::HandleMessage()
   descSupp |= is.get();
   LengthField<2> length;
   length.ReadBinary( is );
-  streamoff msgStart = is.tellg();
+  istringstream buffer;
+  bool buffered = mBufferedInput && is && length > 0;
+  if( buffered )
+  {
+    string body( length, '\0' );
+    is.read( &body[0], length );
+    buffer.str( body );
+    if( !is )
+      buffer.setstate( ios::failbit );
+  }
+  istream& in = buffered ? buffer : is;
+  streamoff msgStart = in.tellg();
   const char* pType = 0;
   switch( descSupp )
   {
@@ -140,16 +172,18 @@ MessageChannel::HandleMessage()
     CONSIDER( VisSignalProperties );
     CONSIDER( VisBitmap );
     CONSIDER( VisCfg );
+    CONSIDER( LatencyTrace );
     default:
       ;
   }
 
-  SaveDebugInfo( is );
-  streamoff end = is.tellg();
-  if( is.fail() )
+  SaveDebugInfo( in );
+  streamoff end = in.tellg();
+  if( in.fail() )
   {
-    is.clear();
-    end = is.tellg();
+    in.clear();
+    end = in.tellg();
+    in.setstate( ios::failbit );
     is.setstate( ios::failbit );
   }
   streamoff diff = ( msgStart < 0 || end < 0 ) ? -1 : end - msgStart;
@@ -165,6 +199,8 @@ MessageChannel::HandleMessage()
     );
 
   ++mMessagesReceived;
+  if( buffered )
+    end = is.tellg();
   if( end >= 0 && start >= 0 && mBytesReceived >= 0 )
     mBytesReceived += ( end - start );
   else
@@ -189,14 +225,20 @@ MessageChannel::Send( const T& t )
 {
   if( !OnSend( t ) )
     return false;
+  return SendMessage( Header<T>::descSupp, t );
+}
 
+template<class T>
+bool
+MessageChannel::SendMessage( int inDescSupp, const T& t )
+{
   bool omitLength = mProtocol.Provides( ProtocolVersion::ZeroMessageLengthFields );
 
   Lock _(mpOutputLock);
   ostream& os = Output();
   streamoff start = os.tellp();
-  os.put( static_cast<unsigned char>( Header<T>::descSupp >> 8 ) );
-  os.put( static_cast<unsigned char>( Header<T>::descSupp & 0xff ) );
+  os.put( static_cast<unsigned char>( inDescSupp >> 8 ) );
+  os.put( static_cast<unsigned char>( inDescSupp & 0xff ) );
   if( omitLength )
   {
     LengthField<2> length = 0;
@@ -213,7 +255,9 @@ MessageChannel::Send( const T& t )
     length.WriteBinary( os );
     os.write( str.data(), length );
   }
-  if( os.flush() )
+  if( mAutoFlush )
+    os.flush();
+  if( os )
   {
     ++mMessagesSent;
     streamoff end = os.tellp();
@@ -249,6 +293,17 @@ MessageChannel::Send( const SignalProperties& signalProperties )
   return Send( VisSignalProperties( signalProperties ) );
 }
 
+template<>
+bool
+MessageChannel::Send( const VisBitmap& bitmap )
+{
+  if( !OnSend( bitmap ) )
+    return false;
+  if( mProtocol.Provides( ProtocolVersion::TiledBitmaps ) )
+    return SendMessage( Header<VisBitmap>::descSupp, TiledVisBitmap( bitmap ) );
+  return SendMessage( Header<VisBitmap>::descSupp, bitmap );
+}
+
 template<>
 bool
 MessageChannel::Send( const BitmapImage& bitmap )
@@ -256,6 +311,26 @@ MessageChannel::Send( const BitmapImage& bitmap )
   return Send( VisBitmap( bitmap ) );
 }
 
+template<>
+bool
+MessageChannel::Send( const Param& param )
+{
+  if( !OnSend( param ) )
+    return false;
+  if( mProtocol.Provides( ProtocolVersion::BinaryParamValues ) )
+    return SendMessage( Header<Param>::descSupp, BinaryParamValues( param ) );
+  return SendMessage( Header<Param>::descSupp, param );
+}
+
+template<>
+bool
+MessageChannel::Send( const LatencyTrace& trace )
+{
+  if( !mProtocol.Provides( ProtocolVersion::LatencyTraces ) || !OnSend( trace ) )
+    return false;
+  return SendMessage( Header<LatencyTrace>::descSupp, trace );
+}
+
 template<>
 bool
 MessageChannel::Send( const ParamList& parameters )
@@ -282,6 +357,7 @@ template bool MessageChannel::Send( const SysCommand& );
 template bool MessageChannel::Send( const State& );
 template bool MessageChannel::Send( const StateVector& );
 template bool MessageChannel::Send( const VisSignal& );
+template bool MessageChannel::Send( const VisSignalConst& );
 template bool MessageChannel::Send( const VisMemo& );
 template bool MessageChannel::Send( const VisCfg& );
 template bool MessageChannel::Send( const VisSignalProperties& );
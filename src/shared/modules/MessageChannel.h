@@ -41,6 +41,7 @@ class VisBitmap;
 class VisCfg;
 class StateVector;
 class SysCommand;
+class LatencyTrace;
 
 namespace Tiny { class LockableObject; }
 
@@ -71,6 +72,18 @@ class MessageChannel : Uncopyable
       { mpOutputLock = p; }
     void SetInputLock( Tiny::LockableObject* p )
       { mpInputLock = p; }
+    // When auto flush is off, Send() leaves flushing the output stream to
+    // the caller, such that messages may be combined into larger writes.
+    void SetAutoFlush( bool b )
+      { mAutoFlush = b; }
+    bool AutoFlush() const
+      { return mAutoFlush; }
+    // When input buffering is on, HandleMessage() reads each message in a
+    // single piece, and parses it from memory.
+    void SetBufferedInput( bool b )
+      { mBufferedInput = b; }
+    bool BufferedInput() const
+      { return mBufferedInput; }
 
     const ProtocolVersion& Protocol() const
       { return mProtocol; }
@@ -99,6 +112,7 @@ class MessageChannel : Uncopyable
     virtual bool OnSysCommand( std::istream& ) { return false; }
     virtual bool OnVisSignalProperties( std::istream& ) { return false; }
     virtual bool OnVisBitmap( std::istream& ) { return false; }
+    virtual bool OnLatencyTrace( std::istream& ) { return false; }
 
     virtual bool OnSend( const ProtocolVersion& ) { return true; }
     virtual bool OnSend( const Status& ) { return true; }
@@ -111,17 +125,21 @@ class MessageChannel : Uncopyable
     virtual bool OnSend( const SysCommand& ) { return true; }
     virtual bool OnSend( const VisSignalProperties& ) { return true; }
     virtual bool OnSend( const VisBitmap& ) { return true; }
+    virtual bool OnSend( const LatencyTrace& ) { return true; }
 
     ProtocolVersion& Protocol()
       { return mProtocol; }
 
   private:
     void Init();
+    template<typename T>
+      bool SendMessage( int descSupp, const T& );
 
     template<class content_type> struct Header;
     std::ostream& mrOutput;
     std::istream& mrInput;
     Tiny::LockableObject* mpOutputLock, *mpInputLock;
+    bool mAutoFlush, mBufferedInput;
     ProtocolVersion mProtocol;
 
     int mMessagesSent, mMessagesReceived;
@@ -153,6 +171,8 @@ template<> struct MessageChannel::Header<StateVector>
 { enum { descSupp = 0x0500 }; };
 template<> struct MessageChannel::Header<SysCommand>
 { enum { descSupp = 0x0600 }; };
+template<> struct MessageChannel::Header<LatencyTrace>
+{ enum { descSupp = 0x0700 }; };
 
 } // namespace bci
 
@@ -38,6 +38,7 @@
 #include "FeedbackTask.h"
 #include "PrecisionTime.h"
 #include "BCIException.h"
+#include "AudioMixer.h"
 
 using namespace std;
 
@@ -188,6 +189,8 @@ FeedbackTask::Resting( const GenericSignal& Input, GenericSignal& Output )
 void
 FeedbackTask::Process( const GenericSignal& Input, GenericSignal& Output )
 {
+  // Sounds played while processing this block are scheduled relative to its beginning.
+  AudioMixer::SetBlockTime();
   if( State( "PauseApplication" ) )
   {
     Resting( Input, Output );
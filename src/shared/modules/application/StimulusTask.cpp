@@ -38,6 +38,9 @@
 #include "StimulusTask.h"
 #include "MeasurementUnits.h"
 #include "BCIException.h"
+#include "ImageCache.h"
+#include "AudioMixer.h"
+#include "StopWatch.h"
 
 #include <iomanip>
 #include <set>
@@ -209,9 +212,22 @@ StimulusTask::Initialize( const SignalProperties& Input,
   mInterpretMode = Parameter( "InterpretMode" );
   mAccumulateEvidence = ( Parameter( "AccumulateEvidence" ) != 0 );
   mMinimumEvidence = Parameter( "MinimumEvidence" );
+
+  mPauseApplicationState = ResolveState( "PauseApplication" );
+  mStimulusBeginState = ResolveState( "StimulusBegin" );
+  mStimulusCodeResState = ResolveOptionalState( "StimulusCodeRes", 0 );
   
+  ImageCache::Instance().ResetStatistics();
+  StopWatch watch;
   bcidbg( 2 ) << "Event: Initialize" << endl;
   OnInitialize( Input );
+  ImageCache::Statistics stats = ImageCache::Instance().GetStatistics();
+  bcidbg( 2 ) << "Initialization took " << watch.Lapse() << "ms; "
+              << "image requests: " << stats.requests
+              << ", cache hits: " << stats.hits
+              << ", images computed: " << stats.computed
+              << " in " << stats.computeTime << "ms"
+              << endl;
 }
 
 void
@@ -231,11 +247,23 @@ StimulusTask::StartRun()
 
   bcidbg( 2 ) << "Event: StartRun" << endl;
   OnStartRun();
+  // Stimuli that have not been preloaded by OnStartRun() are preloaded in
+  // order of stimulus codes.
+  for( AssociationMap::iterator i = mAssociations.begin(); i != mAssociations.end(); ++i )
+    i->second.Preload();
 
   mStimulusCode = 0;
   mPhase = preRun;
 }
 
+void
+StimulusTask::PreloadStimulus( int inStimulusCode )
+{
+  AssociationMap::iterator i = mAssociations.find( inStimulusCode );
+  if( i != mAssociations.end() )
+    i->second.Preload();
+}
+
 void
 StimulusTask::StopRun()
 {
@@ -293,14 +321,16 @@ StimulusTask::Resting( const GenericSignal& Input, GenericSignal& Output )
 void
 StimulusTask::Process( const GenericSignal& Input, GenericSignal& Output )
 {
-  if( State( "PauseApplication" ) )
+  // Sounds played while processing this block are scheduled relative to its beginning.
+  AudioMixer::SetBlockTime();
+  if( mPauseApplicationState() )
   {
     Resting( Input, Output );
     return;
   }
   // Dispatch the Process() call to StimulusTask's handler functions.
   // Check for classification information before calling handlers.
-  int stimulusCodeRes = OptionalState( "StimulusCodeRes", 0 );
+  int stimulusCodeRes = mStimulusCodeResState();
   if( mInterpretMode != InterpretModes::None && stimulusCodeRes > 0 )
   {
     bcidbg( 2 ) << "Received result for stimulus code #" << stimulusCodeRes
@@ -331,7 +361,7 @@ StimulusTask::Process( const GenericSignal& Input, GenericSignal& Output )
         if( stimulusDuration < 0 )
           stimulusDuration = mStimulusDuration;
         doProgress = ( mBlocksInPhase >= stimulusDuration );
-        State( "StimulusBegin" ) = ( mBlocksInPhase == 0 && !doProgress );
+        mStimulusBeginState() = ( mBlocksInPhase == 0 && !doProgress );
         doProgress |= EarlyOffset( Input, Associations()[ mStimulusCode ] );
         DoStimulus( Input, doProgress );
       } break;
@@ -387,6 +417,7 @@ StimulusTask::Process( const GenericSignal& Input, GenericSignal& Output )
         /* fall through */
         case preRun:
           mStimulusCode = OnNextStimulusCode();
+          PreloadStimulus( mStimulusCode );
           if( mStimulusCode > 0 )
           { // Enter pre sequence phase
             State( "PhaseInSequence" ) = PhaseInSequence::PreSequence;
@@ -446,6 +477,7 @@ StimulusTask::Process( const GenericSignal& Input, GenericSignal& Output )
           mISIDuration += ( RandomNumberGenerator.Random() * ( durationDelta + 1 ) )
                                            / ( RandomNumberGenerator.RandMax() + 1 );
           mStimulusCode = OnNextStimulusCode();
+          PreloadStimulus( mStimulusCode );
           mPhase = ISI;
         } break;
 
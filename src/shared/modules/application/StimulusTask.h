@@ -197,6 +197,8 @@ class StimulusTask : public ApplicationBase
  private:
   // Special method for determining whether to finish presenting a stimulus early
   bool EarlyOffset(  const GenericSignal&, const Association& );
+  // Starts preparing the stimuli associated with a stimulus code ahead of presentation.
+  void PreloadStimulus( int );
 
  private:
   int mPhase,
@@ -218,6 +220,11 @@ class StimulusTask : public ApplicationBase
   Expression mEarlyOffsetExpression;
   double     mEarlyOffsetPreviousValue;
 
+  // States accessed from Process().
+  StateHandle mPauseApplicationState,
+              mStimulusBeginState,
+              mStimulusCodeResState;
+
   // Display elements.
   ApplicationWindow& mrDisplay;
   TextField*         mpMessageField;
@@ -0,0 +1,702 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A mixing engine that plays any number of sounds through a
+//   single output stream.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "AudioMixer.h"
+#include "PrecisionTime.h"
+#include "ThreadUtils.h"
+#include "UnitTest.h"
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+using namespace Tiny;
+
+double AudioMixer::sBlockTime = 0;
+
+// Sound and Voice
+class AudioMixer::Sound
+{
+ public:
+  Sound() : frames( 0 ), refCount( 0 ) {}
+  string file;
+  vector<float> data; // interleaved, at the mixer's sampling rate
+  int frames;
+  int refCount;
+};
+
+class AudioMixer::Voice
+{
+ public:
+  Voice()
+  : pSound( 0 ), startFrame( 0 ), position( 0 ), active( false ), playSequence( 0 ),
+    pClientSound( 0 ), requested( 0 ), completed( 0 ), publishedPosition( 0 )
+  { for( int ch = 0; ch < Channels; ++ch ) gain[ch] = 1; }
+  // Audio thread side
+  Sound* pSound;
+  float gain[Channels];
+  int64_t startFrame;
+  int position;
+  bool active;
+  int32_t playSequence;
+  // Client side
+  Sound* pClientSound;
+  volatile int32_t requested; // incremented for each call to Play()
+  // Written by the audio thread
+  volatile int32_t completed, // sequence number of the last completed play
+                   publishedPosition;
+};
+
+namespace
+{
+
+const int Channels = AudioMixer::Channels;
+
+uint32_t
+GetLE( istream& is, int inBytes )
+{
+  uint32_t value = 0;
+  for( int i = 0; i < inBytes; ++i )
+    value |= uint32_t( uint8_t( is.get() ) ) << ( 8 * i );
+  return value;
+}
+
+// Reads a wave file, and converts it into interleaved stereo at the given
+// sampling rate.
+bool
+ReadWaveFile( const string& inFile, int inSamplingRate, vector<float>& outData )
+{
+  ifstream file( inFile.c_str(), ios::binary | ios::in );
+  char id[4];
+  if( !file.read( id, 4 ) || string( id, 4 ) != "RIFF" )
+    return false;
+  GetLE( file, 4 );
+  if( !file.read( id, 4 ) || string( id, 4 ) != "WAVE" )
+    return false;
+
+  int format = 0, channels = 0, rate = 0, bits = 0;
+  vector<char> samples;
+  while( samples.empty() && file.read( id, 4 ) )
+  {
+    string chunk( id, 4 );
+    uint32_t size = GetLE( file, 4 );
+    if( !file )
+      return false;
+    streampos next = file.tellg() + streamoff( size + ( size & 1 ) );
+    if( chunk == "fmt " )
+    {
+      format = GetLE( file, 2 );
+      channels = GetLE( file, 2 );
+      rate = GetLE( file, 4 );
+      GetLE( file, 6 ); // byte rate, block alignment
+      bits = GetLE( file, 2 );
+      if( format == 0xfffe && size >= 26 )
+      { // WAVE_FORMAT_EXTENSIBLE, the subformat begins with the format tag
+        GetLE( file, 8 );
+        format = GetLE( file, 2 );
+      }
+    }
+    else if( chunk == "data" )
+    {
+      samples.resize( size );
+      if( size > 0 && !file.read( &samples[0], size ) )
+        samples.resize( static_cast<size_t>( file.gcount() ) );
+    }
+    file.seekg( next );
+  }
+  bool pcm = ( format == 1 && ( bits == 8 || bits == 16 || bits == 24 || bits == 32 ) ),
+       ieee = ( format == 3 && bits == 32 );
+  if( !( pcm || ieee ) || channels < 1 || rate < 1 )
+    return false;
+
+  int bytes = bits / 8;
+  size_t inFrames = samples.size() / ( bytes * channels );
+  vector<float> in( inFrames * Channels );
+  for( size_t frame = 0; frame < inFrames; ++frame )
+    for( int ch = 0; ch < Channels; ++ch )
+    { // A mono signal goes into both output channels, excess channels are ignored.
+      const uint8_t* p = reinterpret_cast<const uint8_t*>( &samples[( frame * channels + min( ch, channels - 1 ) ) * bytes] );
+      uint32_t raw = 0;
+      for( int i = 0; i < bytes; ++i )
+        raw |= uint32_t( p[i] ) << ( 8 * i );
+      float value = 0;
+      if( ieee )
+        ::memcpy( &value, &raw, sizeof( value ) );
+      else if( bytes == 1 )
+        value = ( int( raw ) - 128 ) / 128.0f;
+      else
+      {
+        int shift = 32 - bits;
+        value = static_cast<float>( int32_t( raw << shift ) / 2147483648.0 );
+      }
+      in[frame * Channels + ch] = value;
+    }
+
+  if( rate == inSamplingRate )
+    outData.swap( in );
+  else
+  { // Linear interpolation.
+    double step = double( rate ) / inSamplingRate;
+    size_t outFrames = static_cast<size_t>( inFrames / step );
+    outData.resize( outFrames * Channels );
+    for( size_t frame = 0; frame < outFrames; ++frame )
+    {
+      double pos = frame * step;
+      size_t i = static_cast<size_t>( pos );
+      float f = static_cast<float>( pos - i );
+      size_t j = min( i + 1, inFrames - 1 );
+      for( int ch = 0; ch < Channels; ++ch )
+        outData[frame * Channels + ch] = ( 1 - f ) * in[i * Channels + ch] + f * in[j * Channels + ch];
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+// AudioMixer
+AudioMixer::AudioMixer( Backend* inpBackend, int inSamplingRate, int inBufferFrames, double inLatency )
+: mpBackend( inpBackend ),
+  mOk( false ),
+  mSamplingRate( inSamplingRate ),
+  mBufferFrames( inBufferFrames ),
+  mLatency( inLatency ),
+  mGarbagePending( 0 ),
+  mNumActive( 0 ),
+  mFrame( 0 ),
+  mClockSequence( 0 ),
+  mClockOffset( Now() ),
+  mStarted( 0 ),
+  mLate( 0 )
+{
+  mOk = mpBackend && mpBackend->Open( *this );
+}
+
+AudioMixer::~AudioMixer()
+{
+  if( mpBackend )
+  {
+    if( mOk )
+      mpBackend->Close();
+    delete mpBackend;
+  }
+  mCommands.Clear();
+  CollectGarbage();
+  for( set<Voice*>::iterator i = mVoices.begin(); i != mVoices.end(); ++i )
+    delete *i;
+  for( set<Voice*>::iterator i = mDetachedVoices.begin(); i != mDetachedVoices.end(); ++i )
+    delete *i;
+  for( map<string, Sound*>::iterator i = mSounds.begin(); i != mSounds.end(); ++i )
+    delete i->second;
+}
+
+AudioMixer::Sound*
+AudioMixer::LoadSound( const string& inFile )
+{
+  Mutex::Lock lock( mMutex );
+  CollectGarbage();
+  Sound* pSound = 0;
+  map<string, Sound*>::iterator i = mSounds.find( inFile );
+  if( i != mSounds.end() )
+    pSound = i->second;
+  else
+  {
+    pSound = new Sound;
+    if( !ReadWaveFile( inFile, mSamplingRate, pSound->data ) )
+    {
+      delete pSound;
+      return 0;
+    }
+    pSound->file = inFile;
+    pSound->frames = static_cast<int>( pSound->data.size() / Channels );
+    mSounds[inFile] = pSound;
+  }
+  ++pSound->refCount;
+  return pSound;
+}
+
+void
+AudioMixer::ReleaseSound( Sound* p )
+{
+  Mutex::Lock lock( mMutex );
+  if( p && --p->refCount == 0 )
+  {
+    mSounds.erase( p->file );
+    delete p;
+  }
+}
+
+AudioMixer::Voice*
+AudioMixer::NewVoice()
+{
+  Mutex::Lock lock( mMutex );
+  CollectGarbage();
+  if( mVoices.size() + mDetachedVoices.size() >= MaxVoices )
+    return 0;
+  Voice* pVoice = new Voice;
+  mVoices.insert( pVoice );
+  Send( Command( Command::attach, pVoice ) );
+  return pVoice;
+}
+
+void
+AudioMixer::DeleteVoice( Voice* p )
+{
+  Mutex::Lock lock( mMutex );
+  if( p && mVoices.erase( p ) )
+  {
+    mDetachedVoices.insert( p );
+    Send( Command( Command::detach, p ) );
+  }
+  CollectGarbage();
+}
+
+AudioMixer&
+AudioMixer::SetSound( Voice* p, Sound* s )
+{
+  Mutex::Lock lock( mMutex );
+  if( s )
+    ++s->refCount;
+  // The voice's previous sound is released once the audio thread is done with it.
+  p->pClientSound = s;
+  Command c( Command::setSound, p );
+  c.pSound = s;
+  Send( c );
+  return *this;
+}
+
+AudioMixer&
+AudioMixer::SetGain( Voice* p, float inLeft, float inRight )
+{
+  Command c( Command::setGain, p );
+  c.gain[0] = inLeft;
+  c.gain[1] = inRight;
+  Mutex::Lock lock( mMutex );
+  Send( c );
+  return *this;
+}
+
+AudioMixer&
+AudioMixer::Play( Voice* p )
+{
+  return PlayAt( p, OnsetFrame() );
+}
+
+AudioMixer&
+AudioMixer::PlayAt( Voice* p, int64_t inFrame )
+{
+  Mutex::Lock lock( mMutex );
+  Command c( Command::play, p );
+  c.frame = inFrame;
+  ++Atomic( p->requested );
+  Send( c );
+  return *this;
+}
+
+AudioMixer&
+AudioMixer::Stop( Voice* p )
+{
+  Mutex::Lock lock( mMutex );
+  Send( Command( Command::stop, p ) );
+  return *this;
+}
+
+bool
+AudioMixer::IsPlaying( const Voice* p ) const
+{
+  return p->requested != p->completed;
+}
+
+int
+AudioMixer::Position( const Voice* p ) const
+{
+  return IsPlaying( p ) ? p->publishedPosition : 0;
+}
+
+void
+AudioMixer::SetBlockTime()
+{
+  sBlockTime = Now();
+}
+
+double
+AudioMixer::Now()
+{
+  return 1e-9 * PrecisionTime::Nanoseconds();
+}
+
+double
+AudioMixer::ClockOffset() const
+{ // The audio thread updates the offset between sequence number increments.
+  double offset = 0;
+  int32_t sequence = 0;
+  do
+  {
+    while( ( sequence = mClockSequence ) & 1 )
+      ThreadUtils::Yield();
+    MemoryFence();
+    offset = mClockOffset;
+    MemoryFence();
+  } while( sequence != mClockSequence );
+  return offset;
+}
+
+int64_t
+AudioMixer::FrameAt( double inTime ) const
+{
+  return static_cast<int64_t>( ::floor( ( inTime - ClockOffset() ) * mSamplingRate + 0.5 ) );
+}
+
+int64_t
+AudioMixer::OnsetFrame() const
+{
+  double now = Now(),
+         latency = mLatency / 1e3,
+         reference = sBlockTime;
+  if( now - reference >= latency )
+    reference = now;
+  return FrameAt( reference + latency );
+}
+
+AudioMixer::Statistics
+AudioMixer::GetStatistics() const
+{
+  Statistics s = { mStarted, mLate };
+  return s;
+}
+
+void
+AudioMixer::Send( const Command& c )
+{ // Called with the mutex locked.
+  if( mOk )
+  { // When a ring is full, wait for the audio thread to catch up.
+    if( c.type == Command::detach || c.type == Command::setSound )
+    {
+      CollectGarbage();
+      while( mGarbagePending >= GarbageCapacity )
+      {
+        ThreadUtils::SleepFor( 1 );
+        CollectGarbage();
+      }
+      ++mGarbagePending;
+    }
+    while( !mCommands.Push( c ) )
+      ThreadUtils::SleepFor( 1 );
+  }
+  else
+  { // Without an audio thread, voices do not play.
+    switch( c.type )
+    {
+      case Command::play:
+        c.pVoice->completed = c.pVoice->requested;
+        break;
+      case Command::setSound:
+        Dispose( Garbage( 0, c.pVoice->pSound ) );
+        c.pVoice->pSound = c.pSound;
+        break;
+      case Command::detach:
+        Dispose( Garbage( c.pVoice ) );
+        break;
+      default:
+        ;
+    }
+  }
+}
+
+void
+AudioMixer::CollectGarbage()
+{ // Called with the mutex locked.
+  Garbage g;
+  while( mGarbage.Pop( g ) )
+  {
+    --mGarbagePending;
+    Dispose( g );
+  }
+}
+
+void
+AudioMixer::Dispose( const Garbage& g )
+{ // Called with the mutex locked.
+  Sound* pSound = g.pSound;
+  if( g.pVoice )
+  {
+    pSound = g.pVoice->pSound;
+    mDetachedVoices.erase( g.pVoice );
+    delete g.pVoice;
+  }
+  if( pSound && --pSound->refCount == 0 )
+  {
+    mSounds.erase( pSound->file );
+    delete pSound;
+  }
+}
+
+void
+AudioMixer::Apply( const Command& c )
+{ // Called from the audio thread.
+  Voice* p = c.pVoice;
+  switch( c.type )
+  {
+    case Command::attach:
+      mActive[mNumActive++] = p;
+      break;
+
+    case Command::detach:
+      for( int i = 0; i < mNumActive; ++i )
+        if( mActive[i] == p )
+          mActive[i] = mActive[--mNumActive];
+      p->completed = p->requested;
+      mGarbage.Push( Garbage( p ) ); // never full, see Send()
+      break;
+
+    case Command::setSound:
+      mGarbage.Push( Garbage( 0, p->pSound ) );
+      p->pSound = c.pSound;
+      p->active = false;
+      p->completed = p->playSequence;
+      break;
+
+    case Command::setGain:
+      for( int ch = 0; ch < Channels; ++ch )
+        p->gain[ch] = c.gain[ch];
+      break;
+
+    case Command::play:
+      ++p->playSequence;
+      ++Atomic( mStarted );
+      p->startFrame = c.frame;
+      if( p->startFrame < mFrame )
+      {
+        ++Atomic( mLate );
+        p->startFrame = mFrame;
+      }
+      p->position = 0;
+      p->publishedPosition = 0;
+      p->active = ( p->pSound != 0 );
+      if( !p->active )
+        p->completed = p->playSequence;
+      break;
+
+    case Command::stop:
+      p->active = false;
+      p->completed = p->playSequence;
+      break;
+
+    default:
+      ;
+  }
+}
+
+void
+AudioMixer::Render( float* outBuffer, int inFrames, double inOutputTime )
+{
+  // Update the relation between real time and output frames, smoothing
+  // out jitter in the backend's time stamps.
+  double measured = inOutputTime - double( mFrame ) / mSamplingRate,
+         offset = mClockOffset;
+  if( mFrame == 0 || ::fabs( measured - offset ) > double( mBufferFrames ) / mSamplingRate )
+    offset = measured; // first buffer, or after a dropout
+  else
+    offset += 0.05 * ( measured - offset );
+  ++Atomic( mClockSequence );
+  MemoryFence();
+  mClockOffset = offset;
+  MemoryFence();
+  ++Atomic( mClockSequence );
+
+  Command c;
+  while( mCommands.Pop( c ) )
+    Apply( c );
+
+  ::memset( outBuffer, 0, inFrames * Channels * sizeof( *outBuffer ) );
+  for( int i = 0; i < mNumActive; ++i )
+  {
+    Voice* p = mActive[i];
+    if( !p->active )
+      continue;
+    int64_t begin = p->startFrame - mFrame;
+    if( begin >= inFrames )
+      continue;
+    if( begin < 0 )
+      begin = 0;
+    int count = min<int>( inFrames - static_cast<int>( begin ), p->pSound->frames - p->position );
+    if( count > 0 )
+    { // An empty sound has no data to address, and completes immediately.
+      const float* pIn = &p->pSound->data[0] + p->position * Channels;
+      float* pOut = outBuffer + begin * Channels;
+      for( int frame = 0; frame < count; ++frame )
+        for( int ch = 0; ch < Channels; ++ch )
+          *pOut++ += p->gain[ch] * *pIn++;
+      p->position += count;
+    }
+    p->publishedPosition = p->position;
+    if( p->position >= p->pSound->frames )
+    {
+      p->active = false;
+      p->completed = p->playSequence;
+    }
+  }
+  mFrame += inFrames;
+}
+
+// NullBackend
+AudioMixer::NullBackend::NullBackend()
+: mpMixer( 0 ),
+  mTerminating( 0 )
+{
+}
+
+AudioMixer::NullBackend::~NullBackend()
+{
+  Close();
+}
+
+bool
+AudioMixer::NullBackend::Open( AudioMixer& inMixer )
+{
+  mpMixer = &inMixer;
+  mTerminating = 0;
+  return ReusableThread::Run( *this );
+}
+
+void
+AudioMixer::NullBackend::Close()
+{
+  mTerminating = 1;
+  ReusableThread::Wait();
+}
+
+void
+AudioMixer::NullBackend::OnRun()
+{ // Render each buffer at the time when its first frame would be output.
+  int frames = mpMixer->BufferFrames();
+  double rate = mpMixer->SamplingRate(),
+         start = AudioMixer::Now();
+  vector<float> buffer( frames * Channels );
+  for( int64_t frame = 0; !mTerminating; frame += frames )
+  {
+    double outputTime = start + frame / rate,
+           wait = outputTime - AudioMixer::Now();
+    if( wait > 0 )
+      ThreadUtils::SleepFor( static_cast<int>( wait * 1e3 ) );
+    mpMixer->Render( &buffer[0], frames, outputTime );
+    OnOutput( &buffer[0], frames, outputTime );
+  }
+}
+
+namespace
+{
+  // A backend without an audio thread. Instead, the test calls Render()
+  // with simulated output times.
+  class ManualBackend : public AudioMixer::Backend
+  {
+   public:
+    bool Open( AudioMixer& ) { return true; }
+    void Close() {}
+  };
+}
+
+UnitTest( AudioMixerOnsetJitterTest )
+{ // Play a short click at pseudo-random times, with jitter in the backend's
+  // time stamps, and compare the output time of its onset with the time at
+  // which it was requested. Time is simulated, so results are reproducible.
+  const int rate = 44100, bufferFrames = 512, clickFrames = 64;
+  const double latency = 20, period = double( bufferFrames ) / rate, start = 100;
+  AudioMixer mixer( new ManualBackend, rate, bufferFrames, latency );
+  TestFail_if( !mixer.Ok(), "could not open manual backend" );
+  AudioMixer::Sound* pSound = new AudioMixer::Sound;
+  pSound->data.assign( clickFrames * Channels, 0.5f );
+  pSound->frames = clickFrames;
+  pSound->refCount = 1;
+  AudioMixer::Voice* pVoice = mixer.NewVoice();
+  mixer.SetSound( pVoice, pSound );
+
+  vector<float> buffer( bufferFrames * Channels );
+  vector<double> requests, onsets;
+  bool silent = true;
+  uint32_t random = 1;
+  double next = start + 0.05;
+  for( int64_t frame = 0; frame < 4 * rate; frame += bufferFrames )
+  { // Each buffer is rendered one period before its first frame is output.
+    double outputTime = start + double( frame ) / rate,
+           now = outputTime - period;
+    random = random * 1664525 + 1013904223;
+    if( now >= next )
+    {
+      double request = now + ( random >> 24 ) * period / 256;
+      requests.push_back( request );
+      mixer.PlayAt( pVoice, mixer.FrameAt( request + latency / 1e3 ) );
+      next = request + 0.03 + ( ( random >> 16 ) & 0xff ) * 1e-4;
+    }
+    double jitter = ( int( random & 0xff ) - 128 ) * 4e-6; // within 0.5ms
+    mixer.Render( &buffer[0], bufferFrames, outputTime + jitter );
+    for( int i = 0; i < bufferFrames; ++i )
+    {
+      bool s = ( buffer[i * Channels] == 0 );
+      if( silent && !s )
+        onsets.push_back( outputTime + double( i ) / rate );
+      silent = s;
+    }
+  }
+  TestFail_if( requests.size() < 50, "only " << requests.size() << " requests" );
+  TestFail_if( mixer.GetStatistics().started != int( requests.size() ),
+               mixer.GetStatistics().started << " onsets started for " << requests.size() << " requests" );
+  TestFail_if( mixer.GetStatistics().late != 0, mixer.GetStatistics().late << " late onsets" );
+  TestFail_if( onsets.size() != requests.size(),
+               onsets.size() << " onsets for " << requests.size() << " requests" );
+  double maxJitter = 0;
+  for( size_t i = 0; i < min( requests.size(), onsets.size() ); ++i )
+  {
+    double jitter = ::fabs( onsets[i] - requests[i] - latency / 1e3 );
+    maxJitter = max( maxJitter, jitter );
+  }
+  TestFail_if( maxJitter > 1e-3, "maximum onset jitter is " << maxJitter * 1e3 << "ms" );
+
+  // An onset in the past is played immediately, and counted as late.
+  mixer.PlayAt( pVoice, 0 );
+  mixer.Render( &buffer[0], bufferFrames, start + 4.0 + period );
+  TestFail_if( mixer.GetStatistics().late != 1, "late onset not counted" );
+  TestFail_if( buffer[0] == 0, "late onset not played immediately" );
+
+  // A sound without frames completes without output.
+  AudioMixer::Sound* pEmpty = new AudioMixer::Sound;
+  pEmpty->refCount = 1;
+  mixer.SetSound( pVoice, pEmpty );
+  mixer.PlayAt( pVoice, 0 );
+  mixer.Render( &buffer[0], bufferFrames, start + 4.0 + 2 * period );
+  TestFail_if( mixer.IsPlaying( pVoice ), "empty sound still playing" );
+  TestFail_if( buffer[0] != 0, "empty sound produced output" );
+
+  mixer.DeleteVoice( pVoice );
+  mixer.Render( &buffer[0], bufferFrames, start + 4.0 + 3 * period );
+  mixer.ReleaseSound( pSound );
+  mixer.ReleaseSound( pEmpty );
+}
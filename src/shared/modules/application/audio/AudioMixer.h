@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A mixing engine that plays any number of sounds through a
+//   single output stream.
+//   Sounds are loaded from wave files into memory, and converted to the
+//   mixer's sampling rate and format when loaded. Voices play sounds, and are
+//   controlled by commands that are passed to the audio thread through a
+//   preallocated lock-free ring buffer, so the audio thread never waits for
+//   a lock, and never allocates or frees memory.
+//   Voices start at a given frame of the output stream. The output stream's
+//   clock is related to real time through time stamps provided by the
+//   backend, and Play() schedules a voice's onset at a fixed latency after
+//   the beginning of the current data block, as set by SetBlockTime().
+//   Thus, onset jitter does not depend on the output buffer size, nor on
+//   the time spent in processing a data block before a sound is played.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include "Uncopyable.h"
+#include "Mutex.h"
+#include "Atomic.h"
+#include "ReusableThread.h"
+#include "Runnable.h"
+
+class AudioMixer : private Uncopyable
+{
+ public:
+  enum { Channels = 2, MaxVoices = 256 };
+
+  class Backend
+  {
+   public:
+    virtual ~Backend() {}
+    // Opens the output device, and starts calling AudioMixer::Render()
+    // from an audio thread. Returns false if the device could not be opened.
+    virtual bool Open( AudioMixer& ) = 0;
+    // Stops calling AudioMixer::Render(), and closes the output device.
+    virtual void Close() = 0;
+  };
+  class NullBackend;
+
+  struct Statistics
+  {
+    int started, // number of voice onsets
+        late;    // number of onsets that occurred later than scheduled
+  };
+
+  // The mixer takes ownership of the backend.
+  AudioMixer( Backend*, int samplingRate = 44100, int bufferFrames = 256, double latencyMs = 30 );
+  ~AudioMixer();
+
+  bool Ok() const
+    { return mOk; }
+  int SamplingRate() const
+    { return mSamplingRate; }
+  int BufferFrames() const
+    { return mBufferFrames; }
+  double Latency() const // ms
+    { return mLatency; }
+
+  // Sounds are shared by all voices playing the same file.
+  class Sound;
+  // Returns NULL if the file could not be read.
+  Sound* LoadSound( const std::string& file );
+  void ReleaseSound( Sound* );
+
+  class Voice;
+  Voice* NewVoice();
+  void DeleteVoice( Voice* );
+
+  AudioMixer& SetSound( Voice*, Sound* );
+  AudioMixer& SetGain( Voice*, float left, float right );
+  // Starts a voice at the fixed latency after the beginning of the current
+  // data block, or after the current time if the block began too long ago.
+  AudioMixer& Play( Voice* );
+  // Starts a voice at the given frame of the output stream.
+  AudioMixer& PlayAt( Voice*, int64_t frame );
+  AudioMixer& Stop( Voice* );
+  bool IsPlaying( const Voice* ) const;
+  // Number of frames played since onset, zero if not playing.
+  int Position( const Voice* ) const;
+
+  // Records the current time as the beginning of the current data block.
+  static void SetBlockTime();
+  // Current time in seconds, as measured by PrecisionTime::Nanoseconds().
+  static double Now();
+  // Output stream frame that is output at the given time.
+  int64_t FrameAt( double time ) const;
+  // Output stream frame at which a voice started with Play() would begin.
+  int64_t OnsetFrame() const;
+
+  Statistics GetStatistics() const;
+
+  // To be called by backends from their audio thread.
+  // Renders interleaved stereo frames. The output time is the time at which
+  // the first frame will be output, as given by Now().
+  void Render( float* outBuffer, int frames, double outputTime );
+
+ private:
+  void CollectGarbage();
+  double ClockOffset() const;
+
+  // A fixed-capacity queue for a single producer and a single consumer.
+  // Its storage is allocated with the mixer, so neither Push() nor Pop()
+  // touches the heap. Capacity must be a power of two.
+  template<class T, int Capacity> class Ring
+  {
+   public:
+    Ring() : mRead( 0 ), mWrite( 0 ) {}
+    bool Empty() const
+      { return mRead == mWrite; }
+    bool Full() const
+      { return uint32_t( mWrite ) - uint32_t( mRead ) >= uint32_t( Capacity ); }
+    void Clear()
+      { mRead = mWrite; }
+    bool Push( const T& t )
+      {
+        if( Full() )
+          return false;
+        mData[uint32_t( mWrite ) % Capacity] = t;
+        Tiny::MemoryFence();
+        ++Tiny::Atomic( mWrite );
+        return true;
+      }
+    bool Pop( T& t )
+      {
+        if( Empty() )
+          return false;
+        Tiny::MemoryFence();
+        t = mData[uint32_t( mRead ) % Capacity];
+        Tiny::MemoryFence();
+        ++Tiny::Atomic( mRead );
+        return true;
+      }
+   private:
+    T mData[Capacity];
+    volatile int32_t mRead, mWrite;
+  };
+  enum { CommandCapacity = 4 * MaxVoices, GarbageCapacity = MaxVoices };
+
+  struct Command
+  {
+    enum Type { none, attach, detach, setSound, setGain, play, stop };
+    Command( Type t = none, Voice* v = 0 ) : type( t ), pVoice( v ), pSound( 0 ), frame( 0 ) {}
+    Type type;
+    Voice* pVoice;
+    Sound* pSound;
+    float gain[Channels];
+    int64_t frame;
+  };
+  void Send( const Command& );
+  void Apply( const Command& );
+  struct Garbage
+  {
+    Garbage( Voice* v = 0, Sound* s = 0 ) : pVoice( v ), pSound( s ) {}
+    Voice* pVoice;
+    Sound* pSound;
+  };
+  void Dispose( const Garbage& );
+
+  Backend* mpBackend;
+  bool mOk;
+  int mSamplingRate,
+      mBufferFrames;
+  double mLatency;
+
+  // Client side, protected by mMutex.
+  Tiny::Mutex mMutex;
+  std::map<std::string, Sound*> mSounds;
+  std::set<Voice*> mVoices,
+                   mDetachedVoices;
+  // Number of garbage items the audio thread may still produce. Each detach
+  // and setSound command produces exactly one.
+  int mGarbagePending;
+
+  // Client to audio thread, and audio thread to client.
+  Ring<Command, CommandCapacity> mCommands;
+  Ring<Garbage, GarbageCapacity> mGarbage;
+
+  // Audio thread side.
+  Voice* mActive[MaxVoices];
+  int mNumActive;
+  int64_t mFrame;
+
+  // Written by the audio thread, read by any thread.
+  volatile int32_t mClockSequence;
+  double mClockOffset;
+  volatile int32_t mStarted,
+                   mLate;
+
+  static double sBlockTime;
+};
+
+// A backend that does not output anything but renders in real time, for
+// testing, and when no output device is available.
+class AudioMixer::NullBackend : public AudioMixer::Backend, private Tiny::ReusableThread, private Tiny::Runnable
+{
+ public:
+  NullBackend();
+  ~NullBackend();
+  bool Open( AudioMixer& );
+  void Close();
+
+ protected:
+  // Called from the audio thread for each rendered buffer.
+  virtual void OnOutput( const float*, int /*frames*/, double /*outputTime*/ ) {}
+
+ private:
+  void OnRun();
+  AudioMixer* mpMixer;
+  volatile int32_t mTerminating;
+};
+
+#endif // AUDIO_MIXER_H
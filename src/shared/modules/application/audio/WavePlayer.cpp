@@ -2,7 +2,7 @@
 // $Id$
 // Authors: juergen.mellinger@uni-tuebingen.de,
 //          halder@informatik.uni-tuebingen.de
-// Description: The Win32 implementation of the WavePlayer interface.
+// Description: Implementations of the WavePlayer interface.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -33,6 +33,8 @@
 #include "Resources.h"
 #include "BCIException.h"
 #include "BCIStream.h"
+#include <cmath>
+#include <algorithm>
 
 using namespace std;
 
@@ -40,16 +42,179 @@ int WavePlayer::sNumInstances = 0;
 
 #if USE_DSOUND
 
-LPDIRECTSOUND       WavePlayer::sPDS = NULL;
-LPDIRECTSOUNDBUFFER WavePlayer::sPrimarySoundBuffer = NULL;
+#include <windows.h>
+#include <mmsystem.h>
+#include <dsound.h>
+#include <vector>
 
+namespace
+{
+// Streams the mixer's output through a looping DirectSound buffer.
+class DSoundBackend : public AudioMixer::Backend, private ReusableThread, private Runnable
+{
+ public:
+  DSoundBackend()
+  : mpMixer( NULL ), mDllHandle( NULL ), mpDS( NULL ), mpPrimaryBuffer( NULL ),
+    mpBuffer( NULL ), mBufferBytes( 0 ), mWritePos( 0 ), mTerminating( 0 )
+  {}
+  ~DSoundBackend()
+  { Close(); }
+  bool Open( AudioMixer& );
+  void Close();
+
+ private:
+  void OnRun();
+
+  enum { FrameBytes = AudioMixer::Channels * sizeof( short ), BufferChunks = 8 };
+  AudioMixer* mpMixer;
+  HINSTANCE mDllHandle;
+  LPDIRECTSOUND mpDS;
+  LPDIRECTSOUNDBUFFER mpPrimaryBuffer,
+                      mpBuffer;
+  int mBufferBytes,
+      mWritePos;
+  volatile int32_t mTerminating;
+};
+
+bool
+DSoundBackend::Open( AudioMixer& inMixer )
+{
+  mpMixer = &inMixer;
+  mDllHandle = ::LoadLibrary( "dsound.dll" );
+  typedef HRESULT ( WINAPI* LPFUNC_DSOUNDCREATE )( LPCGUID, LPDIRECTSOUND*, LPUNKNOWN );
+  LPFUNC_DSOUNDCREATE DSoundCreate = reinterpret_cast<LPFUNC_DSOUNDCREATE>(
+    ::GetProcAddress( mDllHandle, "DirectSoundCreate" ) );
+  // Create an object that utilizes the default device.
+  if( DSoundCreate == NULL || DS_OK != DSoundCreate( NULL, &mpDS, NULL ) )
+    return false;
+  if( DS_OK != mpDS->SetCooperativeLevel( ::GetDesktopWindow(), DSSCL_EXCLUSIVE ) )
+    return false;
+
+  DSBUFFERDESC desc;
+  ::ZeroMemory( &desc, sizeof( desc ) );
+  desc.dwSize = sizeof( desc );
+  desc.dwFlags = DSBCAPS_PRIMARYBUFFER;
+  if( DS_OK != mpDS->CreateSoundBuffer( &desc, &mpPrimaryBuffer, NULL ) )
+    return false;
+
+  WAVEFORMATEX format;
+  ::ZeroMemory( &format, sizeof( format ) );
+  format.wFormatTag = WAVE_FORMAT_PCM;
+  format.nChannels = AudioMixer::Channels;
+  format.nSamplesPerSec = mpMixer->SamplingRate();
+  format.wBitsPerSample = 8 * sizeof( short );
+  format.nBlockAlign = FrameBytes;
+  format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+  mBufferBytes = BufferChunks * mpMixer->BufferFrames() * FrameBytes;
+  ::ZeroMemory( &desc, sizeof( desc ) );
+  desc.dwSize = sizeof( desc );
+  desc.dwFlags = DSBCAPS_GETCURRENTPOSITION2 | DSBCAPS_GLOBALFOCUS;
+  desc.dwBufferBytes = mBufferBytes;
+  desc.lpwfxFormat = &format;
+  if( DS_OK != mpDS->CreateSoundBuffer( &desc, &mpBuffer, NULL ) )
+    return false;
+
+  void* p = NULL;
+  DWORD length = 0;
+  if( DS_OK != mpBuffer->Lock( 0, 0, &p, &length, NULL, NULL, DSBLOCK_ENTIREBUFFER ) )
+    return false;
+  ::memset( p, 0, length );
+  mpBuffer->Unlock( p, length, NULL, 0 );
+  if( DS_OK != mpBuffer->Play( 0, 0, DSBPLAY_LOOPING ) )
+    return false;
+  DWORD play = 0, write = 0;
+  mpBuffer->GetCurrentPosition( &play, &write );
+  mWritePos = write;
+
+  ::timeBeginPeriod( 1 ); // for 1ms polling intervals
+  mTerminating = 0;
+  return ReusableThread::Run( *this );
+}
+
+void
+DSoundBackend::Close()
+{
+  mTerminating = 1;
+  ReusableThread::Wait();
+  if( mpBuffer != NULL )
+  {
+    ::timeEndPeriod( 1 );
+    mpBuffer->Stop();
+    mpBuffer->Release();
+    mpBuffer = NULL;
+  }
+  if( mpPrimaryBuffer != NULL )
+  {
+    mpPrimaryBuffer->Release();
+    mpPrimaryBuffer = NULL;
+  }
+  if( mpDS != NULL )
+  {
+    mpDS->Release();
+    mpDS = NULL;
+  }
+  if( mDllHandle != NULL )
+  {
+    ::FreeLibrary( mDllHandle );
+    mDllHandle = NULL;
+  }
+}
+
+void
+DSoundBackend::OnRun()
+{ // Keep two chunks of mixer output ahead of DirectSound's write cursor.
+  int chunkFrames = mpMixer->BufferFrames(),
+      chunkBytes = chunkFrames * FrameBytes;
+  double rate = mpMixer->SamplingRate();
+  std::vector<float> mix( chunkFrames * AudioMixer::Channels );
+  while( !mTerminating )
+  {
+    DWORD play = 0, write = 0;
+    if( DS_OK != mpBuffer->GetCurrentPosition( &play, &write ) )
+      break;
+    double now = AudioMixer::Now();
+    int queued = ( mWritePos - static_cast<int>( play ) + mBufferBytes ) % mBufferBytes,
+        safe = ( static_cast<int>( write ) - static_cast<int>( play ) + mBufferBytes ) % mBufferBytes;
+    if( queued < safe || queued > mBufferBytes - chunkBytes )
+    { // The play cursor has overtaken us.
+      mWritePos = write;
+      queued = safe;
+    }
+    while( queued < safe + 2 * chunkBytes )
+    {
+      mpMixer->Render( &mix[0], chunkFrames, now + ( queued / FrameBytes ) / rate );
+      void* p[2] = { NULL, NULL };
+      DWORD length[2] = { 0, 0 };
+      if( DS_OK == mpBuffer->Lock( mWritePos, chunkBytes, &p[0], &length[0], &p[1], &length[1], 0 ) )
+      {
+        const float* pIn = &mix[0];
+        for( int i = 0; i < 2; ++i )
+        {
+          short* pOut = static_cast<short*>( p[i] );
+          for( DWORD j = 0; j < length[i] / sizeof( short ); ++j )
+          {
+            float value = *pIn++ * 32768.0f;
+            *pOut++ = static_cast<short>( std::max( -32768.0f, std::min( 32767.0f, value ) ) );
+          }
+        }
+        mpBuffer->Unlock( p[0], length[0], p[1], length[1] );
+      }
+      mWritePos = ( mWritePos + chunkBytes ) % mBufferBytes;
+      queued += chunkBytes;
+    }
+    ThreadUtils::SleepFor( 1 );
+  }
+}
+} // namespace
+
+AudioMixer* WavePlayer::spMixer = NULL;
 
 WavePlayer::WavePlayer()
 : mVolume( 1.0 ),
   mPan( 0.0 ),
-  mSamplingRate( 0 ),
-  mSecondaryBuffer( NULL ),
-  mErrorState( noError )
+  mErrorState( noError ),
+  mpSound( NULL ),
+  mpVoice( NULL )
 {
   Construct();
 }
@@ -57,9 +222,9 @@ WavePlayer::WavePlayer()
 WavePlayer::WavePlayer( const WavePlayer& inOriginal )
 : mVolume( 1.0 ),
   mPan( 0.0 ),
-  mSamplingRate( 0 ),
-  mSecondaryBuffer( NULL ),
-  mErrorState( noError )
+  mErrorState( noError ),
+  mpSound( NULL ),
+  mpVoice( NULL )
 {
   Construct();
   Assign( inOriginal );
@@ -85,62 +250,29 @@ WavePlayer::~WavePlayer()
 void
 WavePlayer::Construct()
 {
-  ++sNumInstances;
-
-  if( sNumInstances <= 1 )
-  {
-    HINSTANCE dllHandle = ::LoadLibrary( "dsound.dll" );
-    typedef WORD ( WINAPI* LPFUNC_DSOUNDCREATE )( LPCGUID, LPDIRECTSOUND*, LPUNKNOWN );
-    LPFUNC_DSOUNDCREATE DSoundCreate = reinterpret_cast<LPFUNC_DSOUNDCREATE>(
-      ::GetProcAddress( dllHandle, "DirectSoundCreate" ) );
-    if( DSoundCreate != NULL )
-    {
-      // Create an object that utilizes the direct sound interface.
-      //  NULL causes it to use the default device,
-      //  sPDS will receive the DirectSound pointer.
-      //  The last variable must be null because aggregation is not supported.
-      if( DS_OK == DSoundCreate( NULL, &sPDS, NULL ) )
-      {
-        // SetCooperative level determines how this instance of the device
-        // interacts with the rest of the system.
-        if( DS_OK == sPDS->SetCooperativeLevel( ::GetDesktopWindow(), DSSCL_EXCLUSIVE ) )
-        {
-          DSBUFFERDESC dsbd;
-          ::ZeroMemory( &dsbd, sizeof( DSBUFFERDESC ) );
-          dsbd.dwSize        = sizeof( DSBUFFERDESC );
-          dsbd.dwFlags       = DSBCAPS_PRIMARYBUFFER;
-          dsbd.dwBufferBytes = 0;
-          dsbd.lpwfxFormat   = NULL;
-          sPDS->CreateSoundBuffer( &dsbd, &sPrimarySoundBuffer, NULL );
-        }
-      }
-    }
-    if( dllHandle != NULL )
-      ::FreeLibrary( dllHandle );
-    PlayDummySound(); // make sure that sound output is properly initialized
-  }
-  if( sPrimarySoundBuffer == NULL )
+  bool first = ( sNumInstances++ < 1 );
+  if( first )
+    spMixer = new AudioMixer( new DSoundBackend, 44100, 256, 40 );
+  if( spMixer->Ok() )
+    mpVoice = spMixer->NewVoice();
+  if( mpVoice == NULL )
     mErrorState = initError;
+  if( first )
+    PlayDummySound(); // make sure that sound output is properly initialized
 }
 
 void
 WavePlayer::Destruct()
 {
   Clear();
+  if( mpVoice != NULL )
+    spMixer->DeleteVoice( mpVoice );
+  mpVoice = NULL;
 
-  --sNumInstances;
-  if( sNumInstances < 1 )
+  if( --sNumInstances < 1 )
   {
-    if( sPrimarySoundBuffer != NULL )
-    {
-      sPrimarySoundBuffer->Release();
-      sPrimarySoundBuffer = NULL;
-    }
-    if( sPDS != NULL )
-    {
-      sPDS->Release();
-      sPDS=NULL;
-    }
+    delete spMixer;
+    spMixer = NULL;
   }
 }
 
@@ -158,13 +290,14 @@ WavePlayer::Clear()
   if( IsPlaying() )
     Stop();
 
-  if( mSecondaryBuffer != NULL )
+  if( mpSound != NULL )
   {
-    mSecondaryBuffer->Release();
-    mSecondaryBuffer = NULL;
+    if( mpVoice != NULL )
+      spMixer->SetSound( mpVoice, NULL );
+    spMixer->ReleaseSound( mpSound );
+    mpSound = NULL;
   }
   mFile = "";
-  mSamplingRate = 0;
 }
 
 WavePlayer&
@@ -176,127 +309,19 @@ WavePlayer::SetFile( const string& inFileName )
     return *this;
 
   Error err = noError;
-
-  string fileName = FileUtils::AbsolutePath( inFileName );
-  HMMIO fileHandle = mmioOpen( const_cast<char*>( fileName.c_str() ), NULL, MMIO_READ | MMIO_ALLOCBUF );
-  if( fileHandle == NULL )
-    err = fileOpeningError;
-
-  MMCKINFO parentChunkInfo,
-           childChunkInfo;
-  MMIOINFO info;
-  MMRESULT sysErr;
-
-  if( err == noError )
-  {
-    // Read the chunks we need to play the file.
-    parentChunkInfo.fccType = mmioFOURCC( 'W', 'A', 'V', 'E' );
-    sysErr = mmioDescend( fileHandle, &parentChunkInfo, NULL, MMIO_FINDRIFF );
-    if( sysErr != MMSYSERR_NOERROR )
-      // The file doesn't contain a WAVE chunk.
-      err = fileOpeningError;
-  }
-
-  if( err == noError )
-  {
-    childChunkInfo.ckid = mmioFOURCC( 'f', 'm', 't', ' ' );
-    sysErr = mmioDescend( fileHandle, &childChunkInfo, &parentChunkInfo, MMIO_FINDCHUNK );
-    if( sysErr != MMSYSERR_NOERROR )
-      // The file doesn't contain a fmt chunk.
-      err = fileOpeningError;
-  }
-
-  // Read the fmt chunk into a WAVEFORMATEX structure.
-  WAVEFORMATEX fileFormat;
-
-  if( err == noError )
-  {
-    fileFormat.cbSize = 0;
-    if( childChunkInfo.cksize > sizeof( fileFormat ) )
-      // The chunk does not fit into the WAVEFORMATEX structure.
-      err = fileOpeningError;
-  }
-
-  if( err == noError )
-  {
-    if( mmioRead( fileHandle, ( char* )&fileFormat, childChunkInfo.cksize )
-        != ( long )childChunkInfo.cksize )
-      // There is not enough data in the file.
-      err = fileOpeningError;
-  }
-
-  if( err == noError )
-  {
-    mmioAscend( fileHandle, &childChunkInfo, 0 );
-    // Get to the data chunk.
-    childChunkInfo.ckid = mmioFOURCC( 'd', 'a', 't', 'a' );
-    sysErr = mmioDescend( fileHandle, &childChunkInfo, &parentChunkInfo, MMIO_FINDCHUNK );
-    if( sysErr != MMSYSERR_NOERROR )
-      // The file doesn't contain a data chunk.
-      err = fileOpeningError;
-  }
-
-  long dataLength = 0;
-  if( err == noError )
-  {
-    // Resize the file buffer to contain all data.
-    dataLength = childChunkInfo.cksize;
-    sysErr = mmioSetBuffer( fileHandle, NULL, dataLength, 0 );
-    if( sysErr != MMSYSERR_NOERROR )
-      // The new buffer size could not be set. Should not happen
-      // in a WIN32 environment if virtual memory is configured
-      // reasonably.
-      err = fileOpeningError;
-  }
-
-  if( err == noError )
-  {
-    // Make sure the data is in the buffer.
-    sysErr = mmioAdvance( fileHandle, NULL, MMIO_READ );
-    if( sysErr != MMSYSERR_NOERROR )
-      err = fileOpeningError;
-  }
-
-  if( err == noError )
-  {
-    // Get a pointer to the buffer and enter it into the WAVEHDR structure.
-    sysErr = mmioGetInfo( fileHandle, &info, 0 );
-    if( sysErr != MMSYSERR_NOERROR || info.cchBuffer != dataLength )
+  if( mpVoice == NULL )
+    err = initError;
+  else
+  { // Sounds are decoded into memory once, and shared between WavePlayers.
+    mpSound = spMixer->LoadSound( FileUtils::AbsolutePath( inFileName ) );
+    if( mpSound == NULL )
       err = fileOpeningError;
-  }
-
-  if( err == noError )
-  {
-    mSamplingRate = fileFormat.nSamplesPerSec;
-    mBitsPerSample = fileFormat.wBitsPerSample;
-
-    DSBUFFERDESC bufdesc;
-    ::memset( &bufdesc, 0, sizeof( DSBUFFERDESC ) );
-    bufdesc.dwSize = sizeof( DSBUFFERDESC );
-    bufdesc.dwFlags = DSBCAPS_CTRLVOLUME | DSBCAPS_CTRLPAN | DSBCAPS_GLOBALFOCUS;
-    bufdesc.dwBufferBytes = childChunkInfo.cksize;
-    bufdesc.lpwfxFormat = &fileFormat;
-
-    err = genError;
-    if( DS_OK == sPDS->CreateSoundBuffer( &bufdesc, &mSecondaryBuffer, NULL ) )
+    else
     {
-      void* pWrite = NULL;
-      unsigned long length = 0;
-      if( DS_OK == mSecondaryBuffer->Lock( 0, childChunkInfo.cksize,
-                     &pWrite, &length, NULL, NULL, DSBLOCK_ENTIREBUFFER ) )
-      {
-        ::mmioRead( fileHandle, reinterpret_cast<char*>( pWrite ), length );
-        if( DS_OK == mSecondaryBuffer->Unlock( pWrite, length, NULL, 0 ) )
-          err = noError;
-      }
+      spMixer->SetSound( mpVoice, mpSound );
+      mFile = inFileName;
     }
-    ::mmioClose( fileHandle, 0 );
   }
-  if( err != noError )
-    Clear();
-  else
-    mFile = inFileName;
-
   mErrorState = err;
   return *this;
 }
@@ -304,74 +329,80 @@ WavePlayer::SetFile( const string& inFileName )
 WavePlayer&
 WavePlayer::Play()
 {
-  if( mSecondaryBuffer != NULL )
-  {
-    mSecondaryBuffer->SetCurrentPosition( 0 );
-    mSecondaryBuffer->Play( 0, 0, 0 );
-  }
+  if( mpSound != NULL )
+    spMixer->Play( mpVoice );
   return *this;
 }
 
+// Gains follow the DirectSound convention: Volume attenuates both channels
+// by up to 100dB, and Pan attenuates the opposite channel by up to 100dB.
+static float
+Attenuation( float inFraction )
+{
+  return static_cast<float>( ::pow( 10.0, -5.0 * inFraction ) );
+}
+
+void
+WavePlayer::UpdateGain()
+{
+  float gain = Attenuation( 1 - mVolume );
+  spMixer->SetGain( mpVoice,
+    gain * Attenuation( std::max( 0.0f, mPan ) ),
+    gain * Attenuation( std::max( 0.0f, -mPan ) ) );
+}
+
 WavePlayer&
 WavePlayer::SetVolume( float inVolume )
 {
-  LONG value = static_cast<LONG>( DSBVOLUME_MIN + inVolume *( DSBVOLUME_MAX - DSBVOLUME_MIN ) );
   if( inVolume < 0 || inVolume > 1 )
     mErrorState = invalidParams;
-  else if( mSecondaryBuffer == NULL )
+  else if( mpVoice == NULL )
     mErrorState = initError;
-  else if( DS_OK != mSecondaryBuffer->SetVolume( value ) )
-    mErrorState = genError;
   else
+  {
+    mVolume = inVolume;
+    UpdateGain();
     mErrorState = noError;
+  }
   return *this;
 }
 
 WavePlayer&
 WavePlayer::SetPan( float inPan )
 {
-  LONG value = static_cast<LONG>( DSBPAN_CENTER + inPan * ( DSBPAN_RIGHT - DSBPAN_CENTER ) );
   if( inPan < -1 || inPan > 1 )
     mErrorState = invalidParams;
-  else if( mSecondaryBuffer == NULL )
+  else if( mpVoice == NULL )
     mErrorState = initError;
-  else if( DS_OK != mSecondaryBuffer->SetPan( value ) )
-    mErrorState = genError;
   else
+  {
+    mPan = inPan;
+    UpdateGain();
     mErrorState = noError;
+  }
   return *this;
 }
 
 WavePlayer&
 WavePlayer::Stop()
 {
-  if( mSecondaryBuffer != NULL && IsPlaying() )
-    mSecondaryBuffer->Stop();
+  if( mpVoice != NULL && IsPlaying() )
+    spMixer->Stop( mpVoice );
   return *this;
 }
 
 bool
 WavePlayer::IsPlaying() const
 {
-  bool result = false;
-  if( mSecondaryBuffer != NULL )
-  {
-    DWORD status;
-    if( DS_OK == mSecondaryBuffer->GetStatus( &status ) )
-      result = ( status & DSBSTATUS_PLAYING );
-  }
-  return result;
+  return mpVoice != NULL && spMixer->IsPlaying( mpVoice );
 }
 
 float
 WavePlayer::PlayingPos() const
 {
-  if( !IsPlaying() || ( mSecondaryBuffer == NULL ) )
+  if( !IsPlaying() )
     return 0.0;
-
-  unsigned long pos;
-  mSecondaryBuffer->GetCurrentPosition( &pos, NULL );
-  return 1e3f * ( pos * 8 ) / ( mSamplingRate * mBitsPerSample );
+  return 1e3f * spMixer->Position( mpVoice ) / spMixer->SamplingRate();
 }
 
 #else // USE_DSOUND
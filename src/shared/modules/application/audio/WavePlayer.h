@@ -3,6 +3,8 @@
 // Authors: juergen.mellinger@uni-tuebingen.de,
 //          halder@informatik.uni-tuebingen.de
 // Description: A PCM audio output interface class.
+//   With DirectSound, all instances play through a single AudioMixer, which
+//   is created with the first instance, and deleted with the last one.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -32,9 +34,7 @@
 #endif // USE_DSOUND, _WIN32
 
 #if USE_DSOUND
-#include <windows.h>
-#include <mmsystem.h>
-#include <dsound.h>
+#include "AudioMixer.h"
 #else //USE_DSOUND
 #include <QSound>
 #endif // USE_DSOUND
@@ -96,11 +96,11 @@ class WavePlayer
   static  int sNumInstances;
 
 #if USE_DSOUND
-          DWORD               mSamplingRate;
-          DWORD               mBitsPerSample;
-          LPDIRECTSOUNDBUFFER mSecondaryBuffer;
-  static  LPDIRECTSOUND       sPDS;
-  static  LPDIRECTSOUNDBUFFER sPrimarySoundBuffer;
+  void UpdateGain();
+
+          AudioMixer::Sound*  mpSound;
+          AudioMixer::Voice*  mpVoice;
+  static  AudioMixer*         spMixer;
 #else // USE_DSOUND
   QSound* mpSound;
   bool    mVolumeWarningIssued,
@@ -43,6 +43,7 @@ ApplicationWindow::ApplicationWindow( const std::string& inName )
   mWidth( 0 ),
   mHeight( 0 ),
   mTemporalDecimation( 0 ),
+  mTileBudget( 0 ),
   mBlockCount( 0 )
 {
   if( mName == DefaultName )
@@ -55,6 +56,7 @@ ApplicationWindow::ApplicationWindow( const std::string& inName )
     mParamNames.Visualize = "VisualizeApplicationWindow";
     mParamNames.SpatialDecimation = "AppWindowSpatialDecimation";
     mParamNames.TemporalDecimation = "AppWindowTemporalDecimation";
+    mParamNames.TileBudget = "AppWindowTileBudget";
   }
   else
   {
@@ -66,6 +68,7 @@ ApplicationWindow::ApplicationWindow( const std::string& inName )
     mParamNames.Visualize = string( "Visualize" ) + mName + "Window";
     mParamNames.SpatialDecimation = mName + "WindowSpatialDecimation";
     mParamNames.TemporalDecimation = mName + "WindowTemporalDecimation";
+    mParamNames.TileBudget = mName + "WindowTileBudget";
     GUI::DisplayWindow::SetTitle( string( "BCI2000 " ) + mName );
   }
 
@@ -98,6 +101,7 @@ ApplicationWindow::Publish()
     { "$visualize$", mParamNames.Visualize.c_str() },
     { "$spatialdecimation$", mParamNames.SpatialDecimation.c_str() },
     { "$temporaldecimation$", mParamNames.TemporalDecimation.c_str() },
+    { "$tilebudget$", mParamNames.TileBudget.c_str() },
   };
   const char* parameters[] =
   {
@@ -118,6 +122,8 @@ ApplicationWindow::Publish()
       "// $name$ window decimation (shrinking) factor",
     "Visualize:$name$%20Window int $temporaldecimation$= 4 16 1 % "
       "// $name$ window time decimation factor",
+    "Visualize:$name$%20Window int $tilebudget$= 0 0 0 % "
+      "// maximum number of changed 16x16 tiles sent per $name$ window frame, 0 for no limit",
   };
   for( size_t i = 0; i < sizeof( parameters ) / sizeof( *parameters ); ++i )
   {
@@ -163,6 +169,7 @@ ApplicationWindow::Initialize()
   if( mDoVisualize )
   {
     mTemporalDecimation = Parameter( mParamNames.TemporalDecimation );
+    mTileBudget = Parameter( mParamNames.TileBudget );
     int spatialDecimation = Parameter( mParamNames.SpatialDecimation );
     mWidth = static_cast<int>( ( DisplayWindow::Context().rect.right - DisplayWindow::Context().rect.left ) / spatialDecimation );
     mHeight = static_cast<int>( ( DisplayWindow::Context().rect.bottom - DisplayWindow::Context().rect.top ) / spatialDecimation );
@@ -177,7 +184,7 @@ ApplicationWindow::PostInitialize()
   DisplayWindow::Show();
   DisplayWindow::Update();
   if( mDoVisualize )
-    mVis.SendReferenceFrame( DisplayWindow::BitmapData( mWidth, mHeight ) );
+    SendReferenceFrame();
 }
 
 void
@@ -192,7 +199,7 @@ ApplicationWindow::PostStopRun()
   DisplayWindow::Update();
 
   if( mDoVisualize )
-    mVis.SendReferenceFrame( DisplayWindow::BitmapData( mWidth, mHeight ) );
+    SendReferenceFrame();
 }
 
 void
@@ -202,7 +209,18 @@ ApplicationWindow::PostProcess()
   State( "StimulusTime" ) = PrecisionTime::Now();
 
   if( mDoVisualize && ( ++mBlockCount %= mTemporalDecimation ) == 0 )
-    mVis.SendDifferenceFrame( DisplayWindow::BitmapData( mWidth, mHeight ) );
+  { // Only tiles touched by invalidations since the previous frame are read and sent.
+    DisplayWindow::UpdateBitmapData( mImageBuffer, mTiles, mWidth, mHeight, mTileBudget );
+    mVis.SendDifferenceFrame( mImageBuffer, mTiles );
+  }
+}
+
+void
+ApplicationWindow::SendReferenceFrame()
+{
+  mImageBuffer = BitmapImage();
+  DisplayWindow::UpdateBitmapData( mImageBuffer, mTiles, mWidth, mHeight );
+  mVis.SendReferenceFrame( mImageBuffer );
 }
 
 #ifdef __BORLANDC__
@@ -29,12 +29,13 @@
 //     WindowLeft, WindowTop, WindowWidth, WindowHeight for positioning
 //     parameters;
 //     VisualizeApplicationWindow, AppWindowSpatialDecimation, 
-//     AppWindowTemporalDecimation for visualization parameters;
+//     AppWindowTemporalDecimation, AppWindowTileBudget for visualization
+//     parameters;
 //     ApplicationWindow as the visualization ID.
 //   For all other window names, dependent names are constructed as follows:
 //     <name>WindowLeft, <name>WindowTop, <name>WindowWidth, <name>WindowHeight;
 //     Visualize<name>Window, <name>WindowSpatialDecimation, 
-//     <name>WindowTemporalDecimation;
+//     <name>WindowTemporalDecimation, <name>WindowTileBudget;
 //     <name>Window as the visualization ID.
 //
 // $BEGIN_BCI2000_LICENSE$
@@ -65,6 +66,7 @@
 #include "GenericVisualization.h"
 #include <string>
 #include <map>
+#include <vector>
 
 class ApplicationWindowList;
 class ApplicationWindowClient;
@@ -97,6 +99,9 @@ class ApplicationWindow : public GUI::DisplayWindow, private EnvironmentExtensio
   virtual void PostStopRun();
   virtual void PostProcess();
 
+ private:
+  void SendReferenceFrame();
+
   // Properties
  public:
   const std::string& Name() const
@@ -130,15 +135,18 @@ class ApplicationWindow : public GUI::DisplayWindow, private EnvironmentExtensio
                 BackgroundColor,
                 Visualize,
                 SpatialDecimation,
-                TemporalDecimation;
+                TemporalDecimation,
+                TileBudget;
   } mParamNames;
 
   BitmapVisualization      mVis;
   BitmapImage              mImageBuffer;
+  std::vector<int>         mTiles;
   bool                     mDoVisualize;
   int                      mWidth,
                            mHeight,
                            mTemporalDecimation,
+                           mTileBudget,
                            mBlockCount;
 
  private:
@@ -185,6 +185,13 @@ Association::Conceal()
   return *this;
 }
 
+Association&
+Association::Preload()
+{
+  mStimuli.Preload();
+  return *this;
+}
+
 Association&
 Association::Select()
 {
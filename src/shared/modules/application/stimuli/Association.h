@@ -71,6 +71,7 @@ class Association
 
   Association& Present();
   Association& Conceal();
+  Association& Preload();
   Association& Select();
 
   SetOfStimuli& Stimuli();
@@ -0,0 +1,477 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A process-wide cache of decoded stimulus images.
+//   See the header file for details.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "ImageCache.h"
+
+#include "VisualStimulus.h"
+#include "ReusableThread.h"
+#include "Runnable.h"
+#include "Waitable.h"
+#include "StopWatch.h"
+#include "ThreadUtils.h"
+#include <algorithm>
+
+#if USE_QT
+# include <QImage>
+# include <QImageReader>
+# include <QColor>
+#endif
+
+using namespace std;
+using namespace Tiny;
+
+// ImageCache::Key
+ImageCache::Key::Key( const string& inFile, int inWidth, int inHeight, int inMode, float inDimFactor )
+: file( inFile ),
+  width( inWidth ),
+  height( inHeight ),
+  mode( inMode ),
+  dimFactor( inDimFactor )
+{
+  if( mode != VisualStimulus::Intensify && mode != VisualStimulus::Dim )
+    dimFactor = 1;
+}
+
+bool
+ImageCache::Key::operator<( const Key& k ) const
+{
+  if( file != k.file )
+    return file < k.file;
+  if( width != k.width )
+    return width < k.width;
+  if( height != k.height )
+    return height < k.height;
+  if( mode != k.mode )
+    return mode < k.mode;
+  return dimFactor < k.dimFactor;
+}
+
+// ImageCache::Entry
+struct ImageCache::Entry
+{
+  enum State { Queued, Running, Done };
+
+  Entry( const Key& k )
+  : key( k ), refCount( 0 ), state( Queued ), pImage( 0 ), bytes( 0 ) {}
+  ~Entry()
+  {
+#if USE_QT
+    delete pImage;
+#endif
+  }
+
+  Key key;
+  int refCount;
+  State state;
+  QImage* pImage;
+  size_t bytes;
+  Waitable done;
+  list<Entry*>::iterator unusedPos;
+};
+
+// ImageCache::Handle
+ImageCache::Handle::Handle()
+: mpEntry( 0 )
+{
+}
+
+ImageCache::Handle::Handle( Entry* p )
+: mpEntry( p )
+{ // Reference is added by the caller.
+}
+
+ImageCache::Handle::Handle( const Handle& h )
+: mpEntry( h.mpEntry )
+{
+  if( mpEntry )
+    ImageCache::Instance().AddRef( mpEntry );
+}
+
+ImageCache::Handle&
+ImageCache::Handle::operator=( const Handle& h )
+{
+  if( h.mpEntry )
+    ImageCache::Instance().AddRef( h.mpEntry );
+  if( mpEntry )
+    ImageCache::Instance().Release( mpEntry );
+  mpEntry = h.mpEntry;
+  return *this;
+}
+
+ImageCache::Handle::~Handle()
+{
+  if( mpEntry )
+    ImageCache::Instance().Release( mpEntry );
+}
+
+bool
+ImageCache::Handle::Ready() const
+{
+  return mpEntry && mpEntry->done.Wait( 0 );
+}
+
+const QImage*
+ImageCache::Handle::Image() const
+{
+  if( !mpEntry )
+    return 0;
+  ImageCache& cache = ImageCache::Instance();
+  if( cache.Claim( mpEntry ) )
+    cache.Compute( mpEntry );
+  else
+    mpEntry->done.Wait();
+  return mpEntry->pImage;
+}
+
+// ImageCache::Worker
+class ImageCache::Worker : public ReusableThread, private Runnable
+{
+ public:
+  Worker( ImageCache& cache ) : mCache( cache ) {}
+  void Start()
+  { // The thread may still be returning from its previous run.
+    ReusableThread::Wait();
+    ReusableThread::Run( *this );
+  }
+
+ private:
+  void OnRun()
+  {
+    Entry* p = 0;
+    while( ( p = mCache.NextJob( this ) ) != 0 )
+      mCache.Compute( p );
+  }
+  ImageCache& mCache;
+};
+
+// ImageCache
+ImageCache&
+ImageCache::Instance()
+{
+  static ImageCache instance;
+  return instance;
+}
+
+ImageCache::ImageCache()
+: mUnusedBytes( 0 ),
+  mUnusedBytesLimit( 64 * 1024 * 1024 )
+{
+  ResetStatistics();
+  int numWorkers = max( 1, ThreadUtils::NumberOfProcessors() - 1 );
+  for( int i = 0; i < numWorkers; ++i )
+    mWorkers.push_back( new Worker( *this ) );
+  mIdleWorkers = mWorkers;
+}
+
+ImageCache::~ImageCache()
+{
+  {
+    Mutex::Lock lock( mMutex );
+    mQueue.clear();
+    mPreloadQueue.clear();
+  }
+  for( size_t i = 0; i < mWorkers.size(); ++i )
+  {
+    mWorkers[i]->ReusableThread::Wait();
+    delete mWorkers[i];
+  }
+  for( EntryMap::iterator i = mEntries.begin(); i != mEntries.end(); ++i )
+    delete i->second;
+}
+
+ImageCache::Handle
+ImageCache::Request( const Key& inKey )
+{
+  Entry* p = 0;
+  bool queued = false;
+  {
+    Mutex::Lock lock( mMutex );
+    ++mStatistics.requests;
+    EntryMap::iterator i = mEntries.find( inKey );
+    if( i != mEntries.end() )
+    {
+      p = i->second;
+      ++mStatistics.hits;
+      if( p->refCount == 0 && p->state == Entry::Done )
+      {
+        mUnused.erase( p->unusedPos );
+        mUnusedBytes -= p->bytes;
+      }
+    }
+    else
+    {
+      p = new Entry( inKey );
+      mEntries[inKey] = p;
+      mQueue.push_back( p );
+      queued = true;
+    }
+    ++p->refCount;
+  }
+  if( queued )
+    StartWorker();
+  return Handle( p );
+}
+
+ImageCache&
+ImageCache::Preload( const Handle& inHandle )
+{
+  Entry* p = inHandle.mpEntry;
+  if( p )
+  {
+    Mutex::Lock lock( mMutex );
+    deque<Entry*>::iterator i = find( mQueue.begin(), mQueue.end(), p );
+    if( i != mQueue.end() )
+    {
+      mQueue.erase( i );
+      mPreloadQueue.push_back( p );
+    }
+  }
+  return *this;
+}
+
+bool
+ImageCache::ReadSize( const string& inFile, int& outWidth, int& outHeight )
+{
+  outWidth = 0;
+  outHeight = 0;
+#if USE_QT
+  QImageReader reader( QString( inFile.c_str() ) );
+  QSize size;
+  if( reader.canRead() )
+    size = reader.size();
+  if( !size.isValid() )
+  { // Not all formats provide the size without decoding the image.
+    QImage img;
+    if( !img.load( QString( inFile.c_str() ) ) )
+      return false;
+    size = img.size();
+  }
+  outWidth = size.width();
+  outHeight = size.height();
+  return true;
+#else
+  return false;
+#endif
+}
+
+ImageCache::Statistics
+ImageCache::GetStatistics() const
+{
+  Mutex::Lock lock( mMutex );
+  return mStatistics;
+}
+
+ImageCache&
+ImageCache::ResetStatistics()
+{
+  Mutex::Lock lock( mMutex );
+  mStatistics.requests = 0;
+  mStatistics.hits = 0;
+  mStatistics.computed = 0;
+  mStatistics.computeTime = 0;
+  return *this;
+}
+
+ImageCache&
+ImageCache::SetUnusedBytesLimit( size_t inLimit )
+{
+  Mutex::Lock lock( mMutex );
+  mUnusedBytesLimit = inLimit;
+  EvictUnused();
+  return *this;
+}
+
+size_t
+ImageCache::UnusedBytesLimit() const
+{
+  return mUnusedBytesLimit;
+}
+
+void
+ImageCache::AddRef( Entry* p )
+{
+  Mutex::Lock lock( mMutex );
+  ++p->refCount;
+}
+
+void
+ImageCache::Release( Entry* p )
+{
+  Mutex::Lock lock( mMutex );
+  if( --p->refCount == 0 && p->state == Entry::Done )
+  {
+    p->unusedPos = mUnused.insert( mUnused.end(), p );
+    mUnusedBytes += p->bytes;
+    EvictUnused();
+  }
+}
+
+void
+ImageCache::EvictUnused()
+{ // Called with the mutex locked.
+  while( mUnusedBytes > mUnusedBytesLimit && !mUnused.empty() )
+  {
+    Entry* p = mUnused.front();
+    mUnused.pop_front();
+    mUnusedBytes -= p->bytes;
+    mEntries.erase( p->key );
+    delete p;
+  }
+}
+
+void
+ImageCache::StartWorker()
+{
+  Worker* pWorker = 0;
+  {
+    Mutex::Lock lock( mMutex );
+    if( !mIdleWorkers.empty() )
+    {
+      pWorker = mIdleWorkers.back();
+      mIdleWorkers.pop_back();
+    }
+  }
+  if( pWorker )
+    pWorker->Start();
+}
+
+ImageCache::Entry*
+ImageCache::NextJob( Worker* inWorker )
+{
+  Mutex::Lock lock( mMutex );
+  deque<Entry*>& queue = mPreloadQueue.empty() ? mQueue : mPreloadQueue;
+  if( queue.empty() )
+  {
+    mIdleWorkers.push_back( inWorker );
+    return 0;
+  }
+  Entry* p = queue.front();
+  queue.pop_front();
+  p->state = Entry::Running;
+  return p;
+}
+
+bool
+ImageCache::Claim( Entry* p )
+{
+  Mutex::Lock lock( mMutex );
+  if( p->state != Entry::Queued )
+    return false;
+  deque<Entry*>::iterator i = find( mPreloadQueue.begin(), mPreloadQueue.end(), p );
+  if( i != mPreloadQueue.end() )
+    mPreloadQueue.erase( i );
+  else
+    mQueue.erase( find( mQueue.begin(), mQueue.end(), p ) );
+  p->state = Entry::Running;
+  return true;
+}
+
+#if USE_QT
+static void
+ApplyMode( QImage& ioImg, int inMode, float inDimFactor )
+{
+  switch( inMode )
+  {
+    case VisualStimulus::Intensify:
+      ioImg = ioImg.convertToFormat( QImage::Format_Indexed8 );
+      for( int i = 0; i < ioImg.colorCount(); ++i )
+        ioImg.setColor( i, QColor( ioImg.color( i ) ).lighter( static_cast<int>( 100 * inDimFactor ) ).rgb() );
+      break;
+
+    case VisualStimulus::Grayscale:
+      ioImg = ioImg.convertToFormat( QImage::Format_Indexed8 );
+      for( int i = 0; i < ioImg.colorCount(); ++i )
+        ioImg.setColor( i, QColor( ioImg.color( i ) ).value() );
+      break;
+
+    case VisualStimulus::Invert:
+      ioImg.invertPixels();
+      break;
+
+    case VisualStimulus::Dim:
+      ioImg = ioImg.convertToFormat( QImage::Format_Indexed8 );
+      for( int i = 0; i < ioImg.colorCount(); ++i )
+        ioImg.setColor( i, QColor( ioImg.color( i ) ).darker( static_cast<int>( 100 * inDimFactor ) ).rgb() );
+      break;
+
+    case VisualStimulus::ShowHide:
+    default:
+      ;
+  }
+}
+#endif // USE_QT
+
+void
+ImageCache::Compute( Entry* p )
+{ // Called without the mutex locked, on an entry in Running state.
+  StopWatch watch;
+  QImage* pImage = 0;
+  size_t bytes = 0;
+#if USE_QT
+  const Key& k = p->key;
+  if( k.width == 0 && k.height == 0 && k.mode == None )
+  {
+    pImage = new QImage;
+    if( !pImage->load( QString( k.file.c_str() ) ) )
+    {
+      delete pImage;
+      pImage = 0;
+    }
+  }
+  else
+  { // Derived images are computed from the cached original.
+    Handle original = Request( Key( k.file ) );
+    const QImage* pOriginal = original.Image();
+    if( pOriginal )
+    {
+      pImage = new QImage( *pOriginal );
+      if( k.width > 0 && k.height > 0 )
+        *pImage = pImage->scaled( k.width, k.height );
+      ApplyMode( *pImage, k.mode, k.dimFactor );
+    }
+  }
+  if( pImage )
+    bytes = pImage->byteCount();
+#endif // USE_QT
+  double time = watch.Lapse();
+
+  Mutex::Lock lock( mMutex );
+  p->pImage = pImage;
+  p->bytes = bytes;
+  p->state = Entry::Done;
+  p->done.Set();
+  ++mStatistics.computed;
+  mStatistics.computeTime += time;
+  if( p->refCount == 0 )
+  {
+    p->unusedPos = mUnused.insert( mUnused.end(), p );
+    mUnusedBytes += p->bytes;
+    EvictUnused();
+  }
+}
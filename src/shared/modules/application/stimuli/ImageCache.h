@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A process-wide cache of decoded stimulus images.
+//   Images are identified by file, target size, and the presentation mode
+//   applied to them. Decoding, scaling, and mode conversion are done on
+//   worker threads; requesting an image queues its computation, and
+//   obtaining the image from its handle waits for the result, or computes it
+//   in the calling thread if no worker has started on it yet.
+//   Entries are reference counted through handles. Entries that are no longer
+//   referenced remain in the cache up to a total size limit, such that
+//   images decoded during preflight are available during initialization.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <string>
+#include <map>
+#include <list>
+#include <deque>
+#include <vector>
+#include "Uncopyable.h"
+#include "Mutex.h"
+
+class QImage;
+
+class ImageCache : private Uncopyable
+{
+ public:
+  enum { None = -1 };
+  struct Key
+  {
+    Key( const std::string& file = "", int width = 0, int height = 0, int mode = None, float dimFactor = 1 );
+    bool operator<( const Key& ) const;
+
+    std::string file;  // absolute path
+    int width,         // target size, or zero to keep the original size
+        height;
+    int mode;          // a VisualStimulus::PresentationMode, or None
+    float dimFactor;   // for the Intensify and Dim modes
+  };
+
+  struct Entry;
+  class Handle
+  {
+   public:
+    Handle();
+    Handle( const Handle& );
+    Handle& operator=( const Handle& );
+    ~Handle();
+
+    bool Empty() const
+      { return mpEntry == 0; }
+    // True if the image is available without waiting.
+    bool Ready() const;
+    // Returns the image, or NULL if the file could not be read.
+    const QImage* Image() const;
+
+   private:
+    friend class ImageCache;
+    explicit Handle( Entry* );
+    Entry* mpEntry;
+  };
+
+  struct Statistics
+  {
+    int requests,
+        hits,
+        computed;
+    double computeTime; // ms, summed over threads
+  };
+
+  static ImageCache& Instance();
+
+  // Returns a handle to the requested image, and queues its computation if
+  // it is not in the cache.
+  Handle Request( const Key& );
+  // Moves an image's computation ahead of those that were not preloaded.
+  // Preloaded images are computed in the order of Preload() calls.
+  ImageCache& Preload( const Handle& );
+
+  // Reads an image's original size from its file header.
+  // Returns false if the file does not exist, or is not a readable image.
+  static bool ReadSize( const std::string& file, int& width, int& height );
+
+  Statistics GetStatistics() const;
+  ImageCache& ResetStatistics();
+
+  // Maximum total size of images that are kept while not referenced by any handle.
+  ImageCache& SetUnusedBytesLimit( size_t );
+  size_t UnusedBytesLimit() const;
+
+ private:
+  ImageCache();
+  ~ImageCache();
+
+  class Worker;
+  void AddRef( Entry* );
+  void Release( Entry* );
+  void StartWorker();
+  Entry* NextJob( Worker* );
+  bool Claim( Entry* );
+  void Compute( Entry* );
+  void EvictUnused();
+
+  Tiny::Mutex mMutex;
+  typedef std::map<Key, Entry*> EntryMap;
+  EntryMap mEntries;
+  std::deque<Entry*> mQueue,
+                     mPreloadQueue;
+  std::list<Entry*> mUnused; // least recently used first
+  size_t mUnusedBytes,
+         mUnusedBytesLimit;
+  std::vector<Worker*> mWorkers,
+                       mIdleWorkers;
+  Statistics mStatistics;
+};
+
+#endif // IMAGE_CACHE_H
@@ -28,6 +28,7 @@
 
 #include "ImageStimulus.h"
 
+#include "ImageCache.h"
 #include "FileUtils.h"
 #include "BCIStream.h"
 #include "NumericConstants.h"
@@ -42,28 +43,48 @@
 using namespace std;
 using namespace GUI;
 
-#if USE_QT
 struct ImageStimulusPrivateData
 {
-  QImage* mpImage;
+  // Images are decoded, scaled, and converted by the image cache; pixmaps
+  // are created from them in the GUI thread when first needed.
+  ImageCache::Handle mImage,
+                     mImageNormal,
+                     mImageHighlighted;
+  int mOriginalWidth,
+      mOriginalHeight;
+#if USE_QT
   QPixmap* mpImageBufferNormal,
          * mpImageBufferHighlighted;
+#endif // USE_QT
 
   ImageStimulusPrivateData()
-  : mpImage( 0 ),
-    mpImageBufferNormal( 0 ),
+  : mOriginalWidth( 0 ),
+    mOriginalHeight( 0 )
+#if USE_QT
+    , mpImageBufferNormal( 0 ),
     mpImageBufferHighlighted( 0 )
+#endif // USE_QT
   {}
   ~ImageStimulusPrivateData()
   {
-    delete mpImage;
+    ClearBuffers();
+  }
+  void ClearBuffers()
+  {
+    mImageNormal = ImageCache::Handle();
+    mImageHighlighted = ImageCache::Handle();
+#if USE_QT
     delete mpImageBufferNormal;
+    mpImageBufferNormal = NULL;
     delete mpImageBufferHighlighted;
+    mpImageBufferHighlighted = NULL;
+#endif // USE_QT
   }
 };
 
+#if USE_QT
 static QPixmap*
-NewBufferFromImage( QImage& inImage, bool inTransparent )
+NewBufferFromImage( const QImage& inImage, bool inTransparent )
 {
   QPixmap* pBuffer = new QPixmap( QPixmap::fromImage( inImage ) );
   if( inTransparent && !inImage.hasAlphaChannel() )
@@ -75,6 +96,17 @@ NewBufferFromImage( QImage& inImage, bool inTransparent )
   return pBuffer;
 }
 
+static void
+CreateBuffer( ImageCache::Handle& ioHandle, QPixmap*& ioBuffer, bool inTransparent )
+{
+  if( !ioHandle.Empty() && ioBuffer == NULL )
+  {
+    const QImage* pImage = ioHandle.Image();
+    if( pImage != NULL )
+      ioBuffer = NewBufferFromImage( *pImage, inTransparent );
+    ioHandle = ImageCache::Handle();
+  }
+}
 #endif // USE_QT
 
 ImageStimulus::ImageStimulus( GraphDisplay& display )
@@ -92,25 +124,20 @@ ImageStimulus::~ImageStimulus()
 ImageStimulus&
 ImageStimulus::SetFile( const string& inName )
 {
-  bool errorOccurred = false;
-
-  // Attempt to load the image
-#if USE_QT
-  delete mpData->mpImage;
-  mpData->mpImage = new QImage();
-  errorOccurred = !mpData->mpImage->load( QString( FileUtils::AbsolutePath( inName ).c_str() ) );
-#endif
-
-  // An error occurred while loading the image
-  if( errorOccurred )
+  string path = FileUtils::AbsolutePath( inName );
+  mpData->ClearBuffers();
+  mpData->mImage = ImageCache::Handle();
+  // Only the image size is read here; decoding is done by the image cache.
+  if( !ImageCache::ReadSize( path, mpData->mOriginalWidth, mpData->mOriginalHeight ) )
   {
     bcierr << "Could not load image from file \"" << inName << "\"" << endl;
-    delete mpData->mpImage;
-    mpData->mpImage = NULL;
     mFile = "";
   }
   else
+  {
+    mpData->mImage = ImageCache::Instance().Request( ImageCache::Key( path ) );
     mFile = inName;
+  }
 
   Change();
   return *this;
@@ -139,22 +166,25 @@ ImageStimulus::RenderingMode() const
   return mRenderingMode;
 }
 
-#if USE_QT
 int
 ImageStimulus::OriginalWidth() const
 {
-  return mpData->mpImage ? mpData->mpImage->width() : 0;
+  return mpData->mImage.Empty() ? 0 : mpData->mOriginalWidth;
 }
 
 int
 ImageStimulus::OriginalHeight() const
 {
-  return mpData->mpImage ? mpData->mpImage->height() : 0;
+  return mpData->mImage.Empty() ? 0 : mpData->mOriginalHeight;
 }
 
+#if USE_QT
 void
 ImageStimulus::OnPaint( const DrawContext& inDC )
 {
+  bool transparent = ( mRenderingMode == GUI::RenderingMode::Transparent );
+  CreateBuffer( mpData->mImageNormal, mpData->mpImageBufferNormal, transparent );
+  CreateBuffer( mpData->mImageHighlighted, mpData->mpImageBufferHighlighted, transparent );
   // Draw the proper buffered image using the given DrawContext
   QPixmap* pBuffer = BeingPresented() ?
                      mpData->mpImageBufferHighlighted :
@@ -196,67 +226,54 @@ ImageStimulus::OnMove( DrawContext& ioDC )
 void
 ImageStimulus::OnChange( DrawContext& ioDC )
 {
-  delete mpData->mpImageBufferNormal;
-  mpData->mpImageBufferNormal = NULL;
-  delete mpData->mpImageBufferHighlighted;
-  mpData->mpImageBufferHighlighted = NULL;
+  mpData->ClearBuffers();
 
   AdjustRect( ioDC.rect );
   int width = ioDC.rect.Width(),
       height = ioDC.rect.Height();
 
-#if USE_QT
-
-  if( mpData->mpImage != NULL )
+  if( !mpData->mImage.Empty() )
   {
     bool storeScaled = width * height < 2 * OriginalWidth() * OriginalHeight();
     storeScaled |= width < OriginalWidth();
     storeScaled |= height < OriginalHeight();
-    QImage img = storeScaled ? mpData->mpImage->scaled( width, height ) : *mpData->mpImage;
-    // Create the normal pixmap
+    if( !storeScaled )
+      width = height = 0;
+    ImageCache& cache = ImageCache::Instance();
+    string path = FileUtils::AbsolutePath( mFile );
+    // Request the normal and the highlighted image; they are computed in the
+    // background, and converted into pixmaps when painted first.
     if( PresentationMode() != ShowHide )
-      mpData->mpImageBufferNormal = NewBufferFromImage( img, mRenderingMode == GUI::RenderingMode::Transparent );
-    // Create the highlighted pixmap by modifying img
-    switch( PresentationMode() )
-    {
-      case ShowHide:
-        delete mpData->mpImageBufferNormal;
-        mpData->mpImageBufferNormal = NULL;
-        break;
-
-      case Intensify:
-        img = img.convertToFormat( QImage::Format_Indexed8 );
-        for( int i = 0; i < img.colorCount(); ++i )
-          img.setColor( i, QColor( img.color( i ) ).lighter( static_cast<int>( 100 * DimFactor() ) ).rgb() );
-        break;
-
-      case Grayscale:
-        img = img.convertToFormat( QImage::Format_Indexed8 );
-        for( int i = 0; i < img.colorCount(); ++i )
-          img.setColor( i, QColor( img.color( i ) ).value() );
-        break;
-
-      case Invert:
-        img.invertPixels();
-        break;
-
-      case Dim:
-        img = img.convertToFormat( QImage::Format_Indexed8 );
-        for( int i = 0; i < img.colorCount(); ++i )
-          img.setColor( i, QColor( img.color( i ) ).darker( static_cast<int>( 100 * DimFactor() ) ).rgb() );
-        break;
-    }
-    mpData->mpImageBufferHighlighted = NewBufferFromImage( img, mRenderingMode == GUI::RenderingMode::Transparent );
+      mpData->mImageNormal = cache.Request( ImageCache::Key( path, width, height ) );
+    int mode = ( PresentationMode() == ShowHide ) ? int( ImageCache::None ) : PresentationMode();
+    mpData->mImageHighlighted = cache.Request( ImageCache::Key( path, width, height, mode, DimFactor() ) );
   }
+}
 
+void
+ImageStimulus::OnPreload()
+{ // Images that are ready are converted into pixmaps now, others are computed
+  // ahead of images that have not been preloaded.
+  ImageCache::Handle* handles[] = { &mpData->mImageNormal, &mpData->mImageHighlighted };
+#if USE_QT
+  QPixmap** buffers[] = { &mpData->mpImageBufferNormal, &mpData->mpImageBufferHighlighted };
+  bool transparent = ( mRenderingMode == GUI::RenderingMode::Transparent );
 #endif // USE_QT
-
+  for( size_t i = 0; i < sizeof( handles ) / sizeof( *handles ); ++i )
+  {
+#if USE_QT
+    if( handles[i]->Ready() )
+      CreateBuffer( *handles[i], *buffers[i], transparent );
+    else
+#endif // USE_QT
+      ImageCache::Instance().Preload( *handles[i] );
+  }
 }
 
 void
 ImageStimulus::AdjustRect( GUI::Rect& ioRect ) const
 {
-  if( mpData->mpImage != NULL )
+  if( !mpData->mImage.Empty() )
   {
     int width = ioRect.Width(),
         height = ioRect.Height(),
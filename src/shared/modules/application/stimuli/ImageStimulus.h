@@ -49,6 +49,8 @@ class ImageStimulus : public VisualStimulus, public GUI::GraphObject
   virtual void OnChange( GUI::DrawContext& );
   virtual void OnMove( GUI::DrawContext& );
   virtual void OnResize( GUI::DrawContext& );
+  // Stimulus event handlers
+  virtual void OnPreload();
 
  private:
   void AdjustRect( GUI::Rect& ) const;
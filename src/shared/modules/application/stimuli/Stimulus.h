@@ -61,6 +61,8 @@ class Stimulus
     { OnPresent(); return *this; }
   Stimulus& Conceal()
     { OnConceal(); return *this; }
+  Stimulus& Preload()
+    { OnPreload(); return *this; }
 
  protected:
   // Event handling interface
@@ -73,6 +75,10 @@ class Stimulus
   //  This event is called Conceal rather than Hide because "Hide" is already
   //  used for making a graphic element invisible.
   virtual void OnConceal() = 0;
+  //  The OnPreload event is sent ahead of presentation, in the order in which
+  //  stimuli are expected to be presented. Stimuli that take time to prepare
+  //  should start preparing in its handler, without blocking.
+  virtual void OnPreload() {}
 
  private:
   int mTag;
@@ -109,6 +115,8 @@ class SetOfStimuli : public std::set<Stimulus*>
     { for( iterator i = begin(); i != end(); ++i ) ( *i )->Present(); }
   void Conceal()
     { for( iterator i = begin(); i != end(); ++i ) ( *i )->Conceal(); }
+  void Preload()
+    { for( iterator i = begin(); i != end(); ++i ) ( *i )->Preload(); }
 };
 
 #endif // STIMULUS_H
@@ -144,12 +144,13 @@ AverageDisplay::Initialize( const SignalProperties& Input, const SignalPropertie
   mBaselineSamples.resize( numChannels );
 #endif // SET_BASELINE
   mLastTargetCode = 0;
+  mTargetCode = ResolveState( "TargetCode" );
 }
 
 void
 AverageDisplay::Process( const GenericSignal& Input, GenericSignal& Output )
 {
-  int targetCode = State( "TargetCode" );
+  int targetCode = mTargetCode();
   if( targetCode == 0 && targetCode != mLastTargetCode )
   {
     size_t targetIndex = find( mTargetCodes.begin(), mTargetCodes.end(), mLastTargetCode ) - mTargetCodes.begin();
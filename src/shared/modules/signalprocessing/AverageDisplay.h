@@ -59,6 +59,7 @@ class AverageDisplay : public GenericFilter
   std::vector<std::vector<std::vector<std::vector<double> > > > mPowerSums;
 
   int mLastTargetCode;
+  StateHandle mTargetCode;
 
 #ifdef SET_BASELINE
   // Baseline stuff that should really be factored out.
@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A filter that reduces the sampling rate by an integer factor,
+//   applying FIR anti-aliasing lowpass filters in one or more stages.
+//   The filter may be used in source modules as well as in signal processing
+//   modules; it updates the output signal's sampling rate accordingly.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "DownsamplingFilter.h"
+#include "BCIStream.h"
+#include "UnitTest.h"
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+// Place the filter after the AlignmentFilter in source modules,
+// and at the beginning of signal processing.
+RegisterFilter( DownsamplingFilter, 1.15 );
+
+static const double cStopbandAttenuation = 80; // dB
+
+DownsamplingFilter::DownsamplingFilter()
+{
+  BEGIN_PARAMETER_DEFINITIONS
+    "Filtering:Downsampling int DownsamplingFactor= 1 1 1 % "
+      "// factor by which to reduce the sampling rate, must divide SampleBlockSize",
+    "Filtering:Downsampling float DownsamplingPassband= 0.8 0.8 0 1 "
+      "// passband edge, as a fraction of the output Nyquist frequency",
+  END_PARAMETER_DEFINITIONS
+}
+
+DownsamplingFilter::~DownsamplingFilter()
+{
+}
+
+void
+DownsamplingFilter::Preflight( const SignalProperties& Input, SignalProperties& Output ) const
+{
+  int DownsamplingFactor = Parameter( "DownsamplingFactor" );
+  PreflightCondition( DownsamplingFactor >= 1 );
+  double DownsamplingPassband = Parameter( "DownsamplingPassband" );
+  PreflightCondition( DownsamplingPassband > 0 && DownsamplingPassband < 1 );
+  Output = Input;
+  if( DownsamplingFactor > 1 )
+  {
+    if( Input.Elements() % DownsamplingFactor != 0 )
+      bcierr << "The DownsamplingFactor parameter (now " << DownsamplingFactor << ") "
+             << "must be a divider of the number of input samples "
+             << "(now " << Input.Elements() << ")"
+             << endl;
+    else
+      Output.SetElements( Input.Elements() / DownsamplingFactor )
+            .ElementUnit().SetGain( Input.ElementUnit().Gain() * DownsamplingFactor )
+                          .SetRawMin( 0 )
+                          .SetRawMax( Input.Elements() / DownsamplingFactor - 1 );
+  }
+}
+
+void
+DownsamplingFilter::Initialize( const SignalProperties& Input, const SignalProperties& Output )
+{
+  mStages.clear();
+  mStageData.clear();
+
+  int factor = Parameter( "DownsamplingFactor" );
+  if( factor > 1 )
+    bciout << "Downsampling from " << Input.SamplingRate() << "Hz to " << Output.SamplingRate() << "Hz";
+
+  // All stages share the final passband edge; in units of the input sampling rate:
+  double passbandEdge = Parameter( "DownsamplingPassband" ) / 2.0 / factor;
+  vector<int> stageFactors = StageFactors( factor );
+  int elements = Input.Elements();
+  mStageData.push_back( vector<Real>( elements * Input.Channels() ) );
+  for( size_t i = 0; i < stageFactors.size(); ++i )
+  {
+    int stageFactor = stageFactors[i];
+    mStages.push_back( FIRDecimator<Real>() );
+    mStages.back().SetDecimation( stageFactor )
+                  .SetCoefficients( FIRDecimator<Real>::DesignLowpass( stageFactor, passbandEdge, cStopbandAttenuation ) )
+                  .SetChannels( Input.Channels() );
+    elements /= stageFactor;
+    passbandEdge *= stageFactor;
+    mStageData.push_back( vector<Real>( elements * Input.Channels() ) );
+  }
+}
+
+void
+DownsamplingFilter::StartRun()
+{
+  for( size_t i = 0; i < mStages.size(); ++i )
+    mStages[i].Initialize();
+}
+
+void
+DownsamplingFilter::Process( const GenericSignal& Input, GenericSignal& Output )
+{
+  if( mStages.empty() )
+  {
+    Output = Input;
+    return;
+  }
+  const int channels = Input.Channels();
+  if( channels < 1 || Output.Elements() < 1 )
+    return;
+  Real* p = &mStageData.front()[0];
+  for( int sample = 0; sample < Input.Elements(); ++sample )
+    for( int ch = 0; ch < channels; ++ch )
+      *p++ = Input( ch, sample );
+  for( size_t i = 0; i < mStages.size(); ++i )
+    mStages[i].Process( &mStageData[i][0], static_cast<int>( mStageData[i].size() ) / channels, &mStageData[i + 1][0] );
+  const Real* q = &mStageData.back()[0];
+  for( int sample = 0; sample < Output.Elements(); ++sample )
+    for( int ch = 0; ch < channels; ++ch )
+      Output( ch, sample ) = *q++;
+}
+
+vector<int>
+DownsamplingFilter::StageFactors( int inDecimation )
+{
+  // Decimating by prime factors, larger factors first, keeps the total number
+  // of taps low: stages after the first one operate at lower sampling rates,
+  // and the final stages are half-band filters, of which half the taps are zero.
+  vector<int> factors;
+  int remainder = inDecimation;
+  for( int divisor = 2; divisor <= remainder; )
+  {
+    if( remainder % divisor == 0 )
+    {
+      factors.push_back( divisor );
+      remainder /= divisor;
+    }
+    else
+      ++divisor;
+  }
+  sort( factors.begin(), factors.end(), greater<int>() );
+  return factors;
+}
+
+UnitTest( DownsamplingFilterTest )
+{
+  const int decimation = 16,
+            blockSize = 32,
+            blocks = 64,
+            // Each block yields two output samples. The passband tone has 0.3
+            // cycles per output sample, so 30 blocks contain 18 whole periods.
+            measuredBlocks = 30;
+  const double passbandEdge = 0.4 / decimation;
+  vector<int> stageFactors = DownsamplingFilter::StageFactors( decimation );
+  TestFail_if( stageFactors.size() != 4, "wrong number of stages" );
+  for( int test = 0; test < 3; ++test )
+  {
+    // Input frequencies: DC, within the passband, and aliasing into the passband.
+    const double frequency[] = { 0, 0.3 / decimation, 1.0 / decimation - 0.2 / decimation };
+    const double expectedRms[] = { 1, ::sqrt( 0.5 ), 0 };
+    vector< FIRDecimator<double> > stages( stageFactors.size() );
+    double edge = passbandEdge;
+    for( size_t i = 0; i < stages.size(); ++i )
+    {
+      stages[i].SetDecimation( stageFactors[i] )
+               .SetCoefficients( FIRDecimator<double>::DesignLowpass( stageFactors[i], edge, cStopbandAttenuation ) )
+               .SetChannels( 1 );
+      edge *= stageFactors[i];
+    }
+    double sumOfSquares = 0;
+    int count = 0;
+    for( int block = 0; block < blocks; ++block )
+    {
+      GenericSignal signal( 1, blockSize );
+      for( int i = 0; i < blockSize; ++i )
+        signal( 0, i ) = ::cos( 2 * M_PI * frequency[test] * ( block * blockSize + i ) );
+      for( size_t i = 0; i < stages.size(); ++i )
+      {
+        GenericSignal output( 1, signal.Elements() / stageFactors[i] );
+        stages[i].Process( signal, output );
+        signal = output;
+      }
+      if( block >= blocks - measuredBlocks ) // skip the initial transient
+        for( int i = 0; i < signal.Elements(); ++i, ++count )
+          sumOfSquares += signal( 0, i ) * signal( 0, i );
+    }
+    double rms = ::sqrt( sumOfSquares / count );
+    TestFail_if( ::fabs( rms - expectedRms[test] ) > 1e-3,
+                 "frequency " << frequency[test] << ": rms " << rms );
+  }
+}
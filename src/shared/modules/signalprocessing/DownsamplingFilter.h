@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A filter that reduces the sampling rate by an integer factor,
+//   applying FIR anti-aliasing lowpass filters in one or more stages.
+//   The filter may be used in source modules as well as in signal processing
+//   modules; it updates the output signal's sampling rate accordingly.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef DOWNSAMPLING_FILTER_H
+#define DOWNSAMPLING_FILTER_H
+
+#include "GenericFilter.h"
+#include "FIRDecimator.h"
+#include <vector>
+
+class DownsamplingFilter : public GenericFilter
+{
+ public:
+  typedef double Real;
+
+  DownsamplingFilter();
+  ~DownsamplingFilter();
+
+  void Preflight( const SignalProperties&, SignalProperties& ) const;
+  void Initialize( const SignalProperties&, const SignalProperties& );
+  void StartRun();
+  void Process( const GenericSignal&, GenericSignal& );
+
+  // Splits a decimation factor into factors for individual stages,
+  // in the order in which they should be applied.
+  static std::vector<int> StageFactors( int decimation );
+
+ private:
+  std::vector< FIRDecimator<Real> > mStages;
+  // Input and output data of each stage, in the FIRDecimator's internal
+  // layout, with the channels of each sample adjacent in memory.
+  std::vector< std::vector<Real> > mStageData;
+};
+
+#endif // DOWNSAMPLING_FILTER_H
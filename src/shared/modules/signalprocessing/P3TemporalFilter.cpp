@@ -120,6 +120,12 @@ P3TemporalFilter::Initialize( const SignalProperties& /*Input*/,
   mNumberOfSequences = OptionalParameter( "NumberOfSequences", mEpochsToAverage );
   mSingleEpochMode = ( Parameter( "SingleEpochMode" ) == 1 );
 
+  mStimulusCode = ResolveState( "StimulusCode" );
+  mStimulusType = ResolveState( "StimulusType" );
+  mStimulusBegin = ResolveOptionalState( "StimulusBegin", 0 );
+  mStimulusCodeRes = ResolveState( "StimulusCodeRes" );
+  mStimulusTypeRes = ResolveState( "StimulusTypeRes" );
+
   mVisualize = int( Parameter( "VisualizeP3TemporalFiltering" ) );
   if( mVisualize )
   {
@@ -153,12 +159,12 @@ P3TemporalFilter::Process( const GenericSignal& Input, GenericSignal& Output )
 
   if( mEpochsToAverage > 0 || mSingleEpochMode )
   {
-    int curStimulusCode = State( "StimulusCode" );
-    mStimulusTypes[ curStimulusCode ] = State( "StimulusType" );
+    int curStimulusCode = mStimulusCode();
+    mStimulusTypes[ curStimulusCode ] = mStimulusType();
     // If the StimulusBegin state is available, use it to detect stimulus onset.
     // Otherwise, check whether StimulusCode has just switched to nonzero.
     bool stimulusOnset = curStimulusCode > 0 &&
-           ( OptionalState( "StimulusBegin", 0 ) || mPreviousStimulusCode == 0 );
+           ( mStimulusBegin() || mPreviousStimulusCode == 0 );
     if( stimulusOnset )
     { // First block of stimulus presentation -- create a new epoch buffer.
       bcidbg( 3 ) << "New epoch for stimulus code #" << curStimulusCode << endl;
@@ -166,8 +172,8 @@ P3TemporalFilter::Process( const GenericSignal& Input, GenericSignal& Output )
     }
     mPreviousStimulusCode = curStimulusCode;
 
-    State( "StimulusCodeRes" ) = 0;
-    State( "StimulusTypeRes" ) = 0;
+    mStimulusCodeRes() = 0;
+    mStimulusTypeRes() = 0;
     for( EpochMap::iterator i = mEpochs.begin(); i != mEpochs.end(); ++i )
     {
       int stimulusCode = i->first;
@@ -194,8 +200,8 @@ P3TemporalFilter::Process( const GenericSignal& Input, GenericSignal& Output )
             for( int channel = 0; channel < Output.Channels(); ++channel )
               for( int sample = 0; sample < Output.Elements(); ++sample )
                 Output( channel, sample ) = ( *j )->Data()( channel, sample ) / mEpochsToAverage;
-            State( "StimulusCodeRes" ) = stimulusCode;
-            State( "StimulusTypeRes" ) = mStimulusTypes[ stimulusCode ];
+            mStimulusCodeRes() = stimulusCode;
+            mStimulusTypeRes() = mStimulusTypes[ stimulusCode ];
           }
           else if( mEpochSums[ stimulusCode ]->Count() == mEpochsToAverage )
           { // When the number of required epochs is reached, copy the buffer average
@@ -205,8 +211,8 @@ P3TemporalFilter::Process( const GenericSignal& Input, GenericSignal& Output )
             for( int channel = 0; channel < Output.Channels(); ++channel )
               for( int sample = 0; sample < Output.Elements(); ++sample )
                 Output( channel, sample ) = ( *mEpochSums[ stimulusCode ] )( channel, sample ) / mEpochsToAverage;
-            State( "StimulusCodeRes" ) = stimulusCode;
-            State( "StimulusTypeRes" ) = mStimulusTypes[ stimulusCode ];
+            mStimulusCodeRes() = stimulusCode;
+            mStimulusTypeRes() = mStimulusTypes[ stimulusCode ];
           }
           
           if( mEpochSums[ stimulusCode ]->Count() == mEpochsToAverage )
@@ -56,6 +56,11 @@ class P3TemporalFilter : public GenericFilter
       mNumberOfSequences;
   bool mSingleEpochMode;
 
+  StateHandle mStimulusCode,
+              mStimulusType,
+              mStimulusBegin,
+              mStimulusCodeRes,
+              mStimulusTypeRes;
   std::map<State::ValueType, State::ValueType> mStimulusTypes;
   State::ValueType mPreviousStimulusCode;
   SignalProperties mOutputProperties;
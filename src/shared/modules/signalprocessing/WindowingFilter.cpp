@@ -33,15 +33,17 @@
 #pragma hdrstop
 
 #include "WindowingFilter.h"
-#include "Detrend.h"
 #include "BCIException.h"
 
 using namespace std;
 
 WindowingThread::WindowingThread()
-: mInputElements( 0 ),
-  mDetrend( None ),
-  mWindowFunction( Rectangular )
+: mDetrend( None ),
+  mWindowFunction( Rectangular ),
+  mInputElements( 0 ),
+  mWindowLength( 0 ),
+  mPosition( 0 ),
+  mSamplesSinceResum( 0 )
 {
 }
 
@@ -92,15 +94,15 @@ WindowingThread::OnInitialize( const SignalProperties& Input,
                                const SignalProperties& Output )
 {
   size_t numSamples = Output.Elements();
+  mWindowLength = static_cast<int>( numSamples );
   mBuffers.clear();
-  mBuffers.resize( Channels().size(), DataVector( numSamples ) );
+  mBuffers.resize( Channels().size(), DataVector( 2 * numSamples ) );
+  mSums.resize( Channels().size() );
+  mWeightedSums.resize( Channels().size() );
   mInputElements = Input.Elements();
+  ResetBuffers();
 
   mDetrend = Parameter( "Detrend" );
-  if( mDetrend == None )
-    mDetrendBuffer.resize( 0 );
-  else
-    mDetrendBuffer.resize( numSamples );
 
   mWindowFunction = Parameter( "WindowFunction" );
   mWindow.resize( numSamples );
@@ -117,60 +119,128 @@ WindowingThread::OnInitialize( const SignalProperties& Input,
 void
 WindowingThread::OnProcess( const GenericSignal& Input, GenericSignal& Output )
 {
+  if( mWindowLength < 1 )
+    return;
+
+  int newSamples = min( mInputElements, mWindowLength );
+  mSamplesSinceResum += newSamples;
+  bool resum = ( mInputElements >= mWindowLength || mSamplesSinceResum >= mWindowLength );
+  if( resum )
+    mSamplesSinceResum = 0;
+
+  int writePosition = mPosition;
+  if( mInputElements < mWindowLength )
+    mPosition = ( mPosition + mInputElements ) % mWindowLength;
+
+  const Real n = mWindowLength;
   for( size_t ch = 0; ch < Channels().size(); ++ch )
   {
-    // Fill the rightmost part of the buffer with new input:
-    size_t i = max<ptrdiff_t>( 0, mBuffers[ch].size() - mInputElements ),
-           j = 0;
-    while( i < mBuffers[ch].size() )
-      mBuffers[ch][i++] = Input( Channels()[ch], j++ );
+    ReadInput( Input, ch, writePosition );
+    if( resum && mDetrend != None )
+      ComputeSums( ch );
 
-    DataVector* pDetrendedData = NULL;
+    // Offset and slope of the trend to be removed.
+    Real offset = 0,
+         slope = 0;
     switch( mDetrend )
     {
       case None:
-        pDetrendedData = &mBuffers[ch];
         break;
 
       case Mean:
-        Detrend::MeanDetrend( mBuffers[ch], mDetrendBuffer );
-        pDetrendedData = &mDetrendBuffer;
+        offset = mSums[ch] / n;
         break;
 
       case Linear:
-        Detrend::LinearDetrend( mBuffers[ch], mDetrendBuffer );
-        pDetrendedData = &mDetrendBuffer;
-        break;
+      {
+        Real x2 = ( 2 * n - 1 ) * ( n - 1 ) * n / 6,
+             x = n * ( n - 1 ) / 2,
+             y = mSums[ch],
+             xy = mWeightedSums[ch];
+        slope = ( xy - x * y / n ) / ( x2 - ( x * x / n ) );
+        offset = ( y - slope * x ) / n;
+      } break;
 
       default:
         throw std_logic_error( "Unknown detrend option" );
     }
 
+    const Real* pData = &mBuffers[ch][mPosition];
+    int outputChannel = Channels()[ch];
     if( mWindowFunction == Rectangular )
-      for( size_t i = 0; i < pDetrendedData->size(); ++i )
-        Output( Channels()[ch], i ) = ( *pDetrendedData )[i];
+      for( int i = 0; i < mWindowLength; ++i )
+        Output( outputChannel, i ) = pData[i] - ( slope * i + offset );
     else
-      for( size_t i = 0; i < pDetrendedData->size(); ++i )
-        Output( Channels()[ch], i ) = mWindow[i] * ( *pDetrendedData )[i];
+      for( int i = 0; i < mWindowLength; ++i )
+        Output( outputChannel, i ) = mWindow[i] * ( pData[i] - ( slope * i + offset ) );
   }
 }
 
 void
-WindowingThread::OnPostProcess()
+WindowingThread::OnStartRun()
 {
-  for( size_t ch = 0; ch < Channels().size(); ++ch )
-  {
-    // Move existing data towards the beginning of the buffer.
-    size_t i = 0,
-           j = mInputElements;
-    while( j < mBuffers[ch].size() )
-      mBuffers[ch][i++] = mBuffers[ch][j++];
-  }
+  ResetBuffers();
 }
 
 void
-WindowingThread::OnStartRun()
+WindowingThread::ResetBuffers()
 {
   for( size_t ch = 0; ch < mBuffers.size(); ++ch )
+  {
     mBuffers[ch] = 0;
+    mSums[ch] = 0;
+    mWeightedSums[ch] = 0;
+  }
+  mPosition = 0;
+  mSamplesSinceResum = 0;
+}
+
+void
+WindowingThread::ReadInput( const GenericSignal& Input, size_t ch, int inWritePosition )
+{
+  DataVector& buffer = mBuffers[ch];
+  int inputChannel = Channels()[ch];
+  if( mInputElements >= mWindowLength )
+  { // As before, a window shorter than the input block receives the block's first samples.
+    for( int i = 0; i < mWindowLength; ++i )
+      buffer[i] = buffer[i + mWindowLength] = Input( inputChannel, i );
+    return;
+  }
+  // Overwrite the oldest samples with new input, and update sums accordingly.
+  Real removedSum = 0,
+       removedWeightedSum = 0,
+       addedSum = 0,
+       addedWeightedSum = 0;
+  int pos = inWritePosition;
+  for( int j = 0; j < mInputElements; ++j )
+  {
+    Real oldValue = buffer[pos],
+         newValue = Input( inputChannel, j );
+    removedSum += oldValue;
+    removedWeightedSum += j * oldValue;
+    addedSum += newValue;
+    addedWeightedSum += ( mWindowLength - mInputElements + j ) * newValue;
+    buffer[pos] = buffer[pos + mWindowLength] = newValue;
+    if( ++pos == mWindowLength )
+      pos = 0;
+  }
+  // Remaining samples move towards the beginning of the window by mInputElements positions.
+  Real remainingSum = mSums[ch] - removedSum;
+  mWeightedSums[ch] += addedWeightedSum - removedWeightedSum - mInputElements * remainingSum;
+  mSums[ch] = remainingSum + addedSum;
+}
+
+void
+WindowingThread::ComputeSums( size_t ch )
+{
+  const Real* pData = &mBuffers[ch][mPosition];
+  Real sum = 0,
+       weightedSum = 0;
+  for( int i = 0; i < mWindowLength; ++i )
+  {
+    sum += pData[i];
+    weightedSum += i * pData[i];
+  }
+  mSums[ch] = sum;
+  mWeightedSums[ch] = weightedSum;
 }
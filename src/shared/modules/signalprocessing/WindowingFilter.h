@@ -50,19 +50,32 @@ class WindowingThread : public FilterThread
   void OnPreflight( const SignalProperties&, SignalProperties& ) const;
   void OnInitialize( const SignalProperties&, const SignalProperties& );
   void OnProcess( const GenericSignal&, GenericSignal& );
-  void OnPostProcess();
   void OnStartRun();
 
  private:
   typedef GenericSignal::ValueType Real;
   typedef std::valarray<Real> DataVector;
 
+  void ResetBuffers();
+  void ReadInput( const GenericSignal&, size_t ch, int writePosition );
+  void ComputeSums( size_t ch );
+
+  // Each channel's buffer is a ring of mWindowLength samples, stored twice
+  // in succession such that the current window is always contiguous,
+  // starting at mPosition. For detrending, the sum of samples, and the sum
+  // of samples weighted with their position in the window, are updated
+  // incrementally, and re-computed once per buffer cycle to avoid the
+  // accumulation of rounding errors.
   std::vector<DataVector> mBuffers;
-  DataVector mDetrendBuffer,
-             mWindow;
+  std::vector<Real> mSums,
+                    mWeightedSums;
+  DataVector mWindow;
   int mDetrend,
       mWindowFunction,
-      mInputElements;
+      mInputElements,
+      mWindowLength,
+      mPosition,
+      mSamplesSinceResum;
 };
 
 struct WindowingFilter : ThreadedFilter<WindowingThread> {};
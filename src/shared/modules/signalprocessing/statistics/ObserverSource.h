@@ -61,6 +61,7 @@ class ObserverSource : public DataSource
   const DimensionList& SampleDimensions() const { return mSampleDimensions; }
   const DimensionList& OuterDimensions() const { return mOuterDimensions; }
   const StatisticalObserver::Observer& SingleObserver( size_t ) const;
+  const std::vector<StatisticalObserver::Observer*>& Observers() const { return mObservers; }
 
  protected:
   void OnInitialize( const Context& );
@@ -37,6 +37,7 @@
 #include "WildcardMatch.h"
 #include "IndexList.h"
 #include "BCIException.h"
+#include "BCIAssert.h"
 
 using namespace std;
 using namespace bci;
@@ -100,6 +101,7 @@ StatisticsFilter::StatisticsFilter()
 
 StatisticsFilter::~StatisticsFilter()
 {
+  ClearSchedule();
   Clear( mContext );
 }
 
@@ -109,6 +111,7 @@ StatisticsFilter::Preflight( const SignalProperties& Input,
                                    SignalProperties& Output ) const
 {
   DataSource::SetAbortFlag( false );
+  OptionalParameter( "NumberOfThreads" );
   Context context;
   context.type = Context::preflight;
   GenericSignal signal( Input );
@@ -154,10 +157,12 @@ void
 StatisticsFilter::Initialize( const SignalProperties& Input,
                               const SignalProperties& Output )
 {
+  ClearSchedule();
   Clear( mContext );
   GenericSignal signal( Input );
   mContext.signal = &signal;
   Configure( mContext );
+  ScheduleFlushes();
   mScripts[OnInitialize].Execute();
   InitializeVisualizations( mContext );
 }
@@ -169,6 +174,7 @@ StatisticsFilter::Process( const GenericSignal& Input, GenericSignal& Output )
   mScripts[OnProcess].Execute( &Input );
   mContext.signal = &Input;
   ProcessSources( mContext );
+  FlushObservers();
   ProcessVisualizations( mContext );
   if( mpOutputView )
     Output = mpOutputView->Signal();
@@ -412,6 +418,58 @@ StatisticsFilter::ProcessSources( const Context& ioContext ) const
     ( *ioContext.dependencies )[i]->Process( ioContext );
 }
 
+void
+StatisticsFilter::ScheduleFlushes()
+{
+  ObserverList observers;
+  for( size_t i = 0; i < mDependencies.size(); ++i )
+  {
+    const ObserverSource* pSource = dynamic_cast<ObserverSource*>( mDependencies[i] );
+    if( pSource )
+      observers.insert( observers.end(), pSource->Observers().begin(), pSource->Observers().end() );
+  }
+  if( observers.empty() )
+    return;
+
+  int numberOfThreads = OptionalParameter( "NumberOfThreads", -1 );
+  if( numberOfThreads <= 0 )
+    numberOfThreads = ThreadUtils::NumberOfProcessors();
+  size_t numPortions = min<size_t>( observers.size(), numberOfThreads );
+  for( size_t i = 1; i < numPortions; ++i )
+    mThreads.push_back( new FlushThread );
+  mSchedule.resize( numPortions );
+  for( size_t i = 0; i < observers.size(); ++i )
+    mSchedule[i % numPortions].push_back( observers[i] );
+}
+
+void
+StatisticsFilter::FlushObservers()
+{
+  if( mSchedule.empty() )
+    return;
+  for( size_t i = 1; i < mSchedule.size(); ++i )
+    mThreads[i - 1]->Start( mSchedule[i] );
+  for( size_t i = 0; i < mSchedule.front().size(); ++i )
+    mSchedule.front()[i]->Flush();
+  string errors;
+  for( size_t i = 1; i < mSchedule.size(); ++i )
+  {
+    mThreads[i - 1]->Wait();
+    errors += mThreads[i - 1]->Error();
+  }
+  if( !errors.empty() )
+    throw bciexception( errors );
+}
+
+void
+StatisticsFilter::ClearSchedule()
+{
+  for( size_t i = 0; i < mThreads.size(); ++i )
+    delete mThreads[i];
+  mThreads.clear();
+  mSchedule.clear();
+}
+
 void
 StatisticsFilter::ProcessVisualizations( const Context& inContext ) const
 {
@@ -455,3 +513,27 @@ StatisticsFilter::AbortThread::Execute()
   return timeoutOccurred;
 }
 
+StatisticsFilter::FlushThread&
+StatisticsFilter::FlushThread::Start( const ObserverList& inObservers )
+{
+  mpObservers = &inObservers;
+  mError.clear();
+  if( !ReusableThread::Run( *this ) )
+    throw std_runtime_error( "Could not start execution: thread busy" );
+  return *this;
+}
+
+void
+StatisticsFilter::FlushThread::OnRun()
+{
+  bciassert( mpObservers != NULL );
+  try
+  {
+    for( size_t i = 0; i < mpObservers->size(); ++i )
+      ( *mpObservers )[i]->Flush();
+  }
+  catch( const exception& e )
+  {
+    mError = string( e.what() ) + "\n";
+  }
+}
@@ -31,6 +31,9 @@
 #include "DataSource.h"
 #include "Expression.h"
 #include "OSThread.h"
+#include "ReusableThread.h"
+#include "Runnable.h"
+#include "StatisticalObserver.h"
 #include <vector>
 
 class ViewSource;
@@ -70,6 +73,9 @@ class StatisticsFilter : public GenericFilter
    void InitializeSources( const Context& ) const;
    void InitializeVisualizations( const Context& ) const;
    void ProcessSources( const Context& ) const;
+   void ScheduleFlushes();
+   void FlushObservers();
+   void ClearSchedule();
    void ProcessVisualizations( const Context& ) const;
    void Clear( const Context& ) const;
 
@@ -85,6 +91,27 @@ class StatisticsFilter : public GenericFilter
    enum { OnStartRun = 0, OnStopRun, OnInitialize, OnProcess, NumEvents };
    ScriptContainer mScripts;
 
+   // Sources are processed in order, and observers defer the blocked update
+   // of their covariance matrices. Once all sources have been processed,
+   // deferred updates are committed by distributing observers over portions,
+   // with the first portion flushed in the filter's own thread. Each observer
+   // is only touched by a single thread, so no synchronization is needed.
+   typedef std::vector<StatisticalObserver::ObserverBase*> ObserverList;
+   class FlushThread : public ReusableThread, private Runnable
+   {
+    public:
+     FlushThread& Start( const ObserverList& );
+     const std::string& Error() const { return mError; }
+    private:
+     void OnRun();
+    private:
+     const ObserverList* mpObservers;
+     std::string mError;
+   };
+   typedef std::vector<ObserverList> PortionContainer;
+   PortionContainer mSchedule;
+   std::vector<FlushThread*> mThreads;
+
    class AbortThread : public OSThread
    {
     public:
@@ -36,6 +36,7 @@
 #include "BCIException.h"
 #include "BCIEvent.h"
 #include "PrecisionTime.h"
+#include "LatencyTrace.h"
 #include "ClassName.h"
 #include "MeasurementUnits.h"
 #include "StringUtils.h"
@@ -83,6 +84,7 @@ DataIOFilter::DataIOFilter()
   mSampleBlockSize( 0 ),
   mPrevStimulusTime( 0 )
 {
+  mBCIEvents.SetStateList( States );
   BCIEvent::SetEventQueue( &mBCIEvents );
 
   // Find available GenericFileWriter descendants and determine which one to use.
@@ -100,11 +102,11 @@ DataIOFilter::DataIOFilter()
     if( fileFormat == "DAT" )
       fileFormat = "BCI2000";
 
-    string writerName = fileFormat + "FileWriter";
+    string writerName = fileFormat + "FILEWRITER";
     for( writerSet::const_iterator i = availableFileWriters.begin();
          mpFileWriter == NULL && i != availableFileWriters.end();
          ++i )
-      if( writerName == ClassName( typeid( **i ) ) )
+      if( writerName == StringUtils::ToUpper( ClassName( typeid( **i ) ) ) )
         mpFileWriter = *i;
 
     if( !mpFileWriter )
@@ -445,6 +447,7 @@ DataIOFilter::Initialize( const SignalProperties& /*Input*/,
   const SignalProperties& adcOutput = mADCOutput.Properties();
   mBlockDuration = 1e3 / adcOutput.UpdateRate();
   mSampleBlockSize = adcOutput.Elements();
+  mBCIEvents.SetStateList( States );
 
   State( "Recording" ) = 0;
   mpADC->CallInitialize( adcOutput, adcOutput );
@@ -666,6 +669,7 @@ DataIOFilter::AcquireData()
 {
   PrecisionTime prevSourceTime = static_cast<PrecisionTime::NumType>( State( "SourceTime" ) );
   mpADC->CallProcess( mADCOutput, mADCOutput );
+  LatencyTrace::MarkAcquisition();
   if( !mpADC->SetsSourceTime() )
     State( "SourceTime" ) = PrecisionTime::Now();
 
@@ -736,56 +740,53 @@ DataIOFilter::ProcessBCIEvents()
     int offset = static_cast<int>(
       ( ( mBlockDuration - ( PrecisionTime::UnsignedDiff( sourceTime, mBCIEvents.FrontTimeStamp() ) + 1 ) ) * mSampleBlockSize ) / mBlockDuration
     );
-    istringstream iss( mBCIEvents.FrontDescriptor() );
-    string name;
-    iss >> name;
-    State::ValueType value;
-    iss >> value;
-    int duration;
-    if( !( iss >> duration ) )
-      duration = -1;
-
-    int kind = ( *States )[name].Kind();
-    if( kind != State::EventKind )
+    const EventQueue::Event& event = mBCIEvents.Front();
+    if( event.stateIndex < 0 )
+    {
+      istringstream iss( event.descriptor );
+      string name;
+      iss >> name;
       throw std_invalid_argument(
         "Trying to set state \"" << name << "\" from an event. "
         "This state was not defined as an event state. "
         "Use BEGIN_EVENT_DEFINITIONS/END_EVENT_DEFINITIONS to define states "
         "as event states."
       );
+    }
+    const class State& state = ( *States )[event.stateIndex];
+    StateAccessor accessor( state );
 
-    bcidbg( 10 ) << "Setting State \"" << name
-                 << "\" to " << value
+    bcidbg( 10 ) << "Setting State \"" << state.Name()
+                 << "\" to " << event.value
                  << " at offset " << offset
-                 << " with duration " << duration
-                 << " from event:\n" << mBCIEvents.FrontDescriptor()
+                 << " with duration " << event.duration
                  << endl;
 
     offset = max( offset, 0 );
-    if( duration < 0 )
+    if( event.duration < 0 )
     { // No duration given -- set the state at the current and following positions.
-      Statevector->SetStateValue( name, offset, value );
+      Statevector->SetStateValue( accessor, offset, event.value );
     }
-    else if( duration == 0 )
+    else if( event.duration == 0 )
     { // Set the state at a single position only.
       // For zero duration events, avoid overwriting a previous event by
       // moving the current one if possible, and reposting if not.
-      while( offset <= mSampleBlockSize && Statevector->StateValue( name, offset ) != 0 )
+      while( offset <= mSampleBlockSize && Statevector->StateValue( accessor, offset ) != 0 )
         ++offset;
       if( offset == mSampleBlockSize )
       { // Re-post the event to be processed in the next block
-        mBCIEvents.PushBack( mBCIEvents.FrontDescriptor(), mBCIEvents.FrontTimeStamp() );
+        mBCIEvents.PushBack( event );
       }
       else
       {
-        Statevector->SetStateValue( name, offset, value );
-        Statevector->SetStateValue( name, offset + 1, 0 );
+        Statevector->SetStateValue( accessor, offset, event.value );
+        Statevector->SetStateValue( accessor, offset + 1, 0 );
       }
     }
     else
     {
       bcierr__ << "Event durations > 0 are currently unsupported "
-               << "(" << iss.str() << ")"
+               << "(" << state.Name() << " " << event.value << " " << event.duration << ")"
                << endl;
     }
     mBCIEvents.PopFront();
@@ -226,7 +226,14 @@ JoystickLogger::JoystickThread::JoystickThread( const JOYCAPS& inJoycaps )
   m_prevButton1( -1 ),
   m_prevButton2( -1 ),
   m_prevButton3( -1 ),
-  m_prevButton4( -1 )
+  m_prevButton4( -1 ),
+  m_xPosEvent( BCIEvent::StateIndex( "JoystickXpos" ) ),
+  m_yPosEvent( BCIEvent::StateIndex( "JoystickYpos" ) ),
+  m_zPosEvent( BCIEvent::StateIndex( "JoystickZpos" ) ),
+  m_button1Event( BCIEvent::StateIndex( "JoystickButtons1" ) ),
+  m_button2Event( BCIEvent::StateIndex( "JoystickButtons2" ) ),
+  m_button3Event( BCIEvent::StateIndex( "JoystickButtons3" ) ),
+  m_button4Event( BCIEvent::StateIndex( "JoystickButtons4" ) )
 {
   OSThread::Start();
 }
@@ -256,19 +263,19 @@ int JoystickLogger::JoystickThread::Execute()
     GetJoyPos( xPos, yPos, zPos, button1, button2, button3, button4 );
 
     if( xPos != m_prevXPos )
-      bcievent << "JoystickXpos " << xPos;
+      BCIEvent::Post( m_xPosEvent, xPos );
     if( yPos != m_prevYPos )
-      bcievent << "JoystickYpos " << yPos;
+      BCIEvent::Post( m_yPosEvent, yPos );
     if( zPos != m_prevZPos )
-      bcievent << "JoystickZpos " << zPos;
+      BCIEvent::Post( m_zPosEvent, zPos );
     if( button1 != m_prevButton1 )
-      bcievent << "JoystickButtons1 " << button1;
+      BCIEvent::Post( m_button1Event, button1 );
     if( button2 != m_prevButton2 )
-      bcievent << "JoystickButtons2 " << button2;
+      BCIEvent::Post( m_button2Event, button2 );
     if( button3 != m_prevButton3 )
-      bcievent << "JoystickButtons3 " << button3;
+      BCIEvent::Post( m_button3Event, button3 );
     if( button4 != m_prevButton4 )
-      bcievent << "JoystickButtons4 " << button4;
+      BCIEvent::Post( m_button4Event, button4 );
 
     m_prevXPos = xPos;
     m_prevYPos = yPos;
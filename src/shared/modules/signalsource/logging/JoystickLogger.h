@@ -81,6 +81,14 @@ class JoystickLogger : public EnvironmentExtension
             m_prevButton2,
             m_prevButton3,
             m_prevButton4;
+    // Event state indices, resolved once for binary event posting.
+    int     m_xPosEvent,
+            m_yPosEvent,
+            m_zPosEvent,
+            m_button1Event,
+            m_button2Event,
+            m_button3Event,
+            m_button4Event;
 
   } *mpJoystickThread;
 };
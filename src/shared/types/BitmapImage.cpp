@@ -5,6 +5,9 @@
 //   run-length encoding.
 //   BitmapImages support subtraction and addition to allow for efficient
 //   transmission of differences between subsequent frames.
+//   For partial updates, images are divided into square tiles which are
+//   numbered row by row. When writing an image in which some tiles are
+//   entirely zero, only the remaining tiles are encoded.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -31,10 +34,108 @@
 
 #include "BitmapImage.h"
 #include "BCIException.h"
+#include "UnitTest.h"
 #include <string>
+#include <vector>
+#include <sstream>
+#include <cstdlib>
 
 using namespace std;
 
+// In the tiled format, the width field has its most significant bit set, and
+// is followed by the number of encoded tiles. Each encoded tile is given by its
+// index, followed by runs that cover the tile's pixels row by row.
+static const int cTiledFlag = 0x8000;
+
+namespace
+{
+
+void
+PutLE( string& ioBuffer, uint32_t inValue, int inBytes )
+{
+  for( int i = 0; i < inBytes; ++i, inValue >>= 8 )
+    ioBuffer += static_cast<char>( inValue & 0xff );
+}
+
+uint32_t
+GetLE( istream& is, int inBytes )
+{
+  uint32_t value = 0;
+  for( int i = 0; i < inBytes; ++i )
+    value |= uint32_t( uint8_t( is.get() ) ) << ( 8 * i );
+  return value;
+}
+
+class RunEncoder
+{
+ public:
+  RunEncoder( string& ioBuffer )
+    : mrBuffer( ioBuffer ), mValue( 0 ), mLength( 0 )
+    {}
+  // Runs may continue across calls.
+  void Encode( const uint16_t* p, const uint16_t* pEnd )
+    {
+      while( p < pEnd )
+      {
+        if( mLength == 0 )
+        {
+          mValue = *p++;
+          mLength = 1;
+        }
+        const uint16_t* pRunEnd = min( pEnd, p + ( 0x100 - mLength ) ),
+                      * q = p;
+        while( q < pRunEnd && *q == mValue )
+          ++q;
+        mLength += static_cast<int>( q - p );
+        p = q;
+        if( p < pEnd || mLength == 0x100 )
+          Flush();
+      }
+    }
+  void Flush()
+    {
+      if( mLength > 0 )
+      {
+        PutLE( mrBuffer, mLength - 1, 1 );
+        PutLE( mrBuffer, mValue, 2 );
+        mLength = 0;
+      }
+    }
+ private:
+  string& mrBuffer;
+  uint16_t mValue;
+  int mLength;
+};
+
+class RunDecoder
+{
+ public:
+  RunDecoder( istream& is )
+    : mrStream( is ), mValue( 0 ), mRemaining( 0 )
+    {}
+  void Decode( uint16_t* p, uint16_t* pEnd )
+    {
+      while( p < pEnd && mrStream )
+      {
+        if( mRemaining == 0 )
+        {
+          mRemaining = GetLE( mrStream, 1 ) + 1;
+          mValue = GetLE( mrStream, 2 );
+        }
+        int count = min<int>( mRemaining, pEnd - p );
+        std::fill( p, p + count, mValue );
+        p += count;
+        mRemaining -= count;
+      }
+    }
+ private:
+  istream& mrStream;
+  uint16_t mValue;
+  int mRemaining;
+};
+
+} // namespace
+
 BitmapImage::BitmapImage( int inWidth, int inHeight )
 : mWidth( inWidth ),
   mHeight( inHeight ),
@@ -105,6 +206,32 @@ BitmapImage::SetBackground( const BitmapImage& b )
   return *this;
 }
 
+BitmapImage&
+BitmapImage::CopyTile( const BitmapImage& b, int inTile )
+{
+  DimensionCheck( b );
+  TileCheck( inTile );
+  int x, y, xEnd, yEnd;
+  TileRange( inTile, x, y, xEnd, yEnd );
+  for( ; y < yEnd; ++y )
+    std::memcpy( mpData + y * mWidth + x, b.mpData + y * mWidth + x, ( xEnd - x ) * sizeof( *mpData ) );
+  return *this;
+}
+
+BitmapImage&
+BitmapImage::SetTileDifference( const BitmapImage& a, const BitmapImage& b, int inTile )
+{
+  DimensionCheck( a );
+  DimensionCheck( b );
+  TileCheck( inTile );
+  int x, y, xEnd, yEnd;
+  TileRange( inTile, x, y, xEnd, yEnd );
+  for( ; y < yEnd; ++y )
+    for( int i = y * mWidth + x; i < y * mWidth + xEnd; ++i )
+      mpData[ i ] = a.mpData[ i ] - b.mpData[ i ];
+  return *this;
+}
+
 void
 BitmapImage::DimensionCheck( const BitmapImage& b ) const
 {
@@ -112,46 +239,158 @@ BitmapImage::DimensionCheck( const BitmapImage& b ) const
     throw std_invalid_argument( "BitmapImage dimension mismatch" );
 }
 
+void
+BitmapImage::TileCheck( int inTile ) const
+{
+  if( inTile < 0 || inTile >= Tiles() )
+    throw std_range_error( "BitmapImage tile index out of range: " << inTile );
+}
+
+void
+BitmapImage::TileRange( int inTile, int& outX, int& outY, int& outXEnd, int& outYEnd ) const
+{
+  outX = ( inTile % HorizontalTiles() ) * TileSize;
+  outY = ( inTile / HorizontalTiles() ) * TileSize;
+  outXEnd = min<int>( outX + TileSize, mWidth );
+  outYEnd = min<int>( outY + TileSize, mHeight );
+}
+
+bool
+BitmapImage::TileIsZero( int inTile ) const
+{
+  int x, y, xEnd, yEnd;
+  TileRange( inTile, x, y, xEnd, yEnd );
+  for( ; y < yEnd; ++y )
+  {
+    const uint16_t* p = mpData + y * mWidth + x,
+                  * pEnd = mpData + y * mWidth + xEnd;
+    while( p < pEnd )
+      if( *p++ != 0 )
+        return false;
+  }
+  return true;
+}
+
 ostream&
-BitmapImage::WriteBinary( ostream& os ) const
+BitmapImage::WriteBinary( ostream& os, bool inAllowTiles ) const
 {
-  os.put( mWidth & 0xff ).put( mWidth >> 8 )
-    .put( mHeight & 0xff ).put( mHeight >> 8 );
+  vector<int> tiles;
+  if( inAllowTiles )
+    for( int tile = 0; tile < Tiles(); ++tile )
+      if( !TileIsZero( tile ) )
+        tiles.push_back( tile );
+  bool tiled = inAllowTiles && static_cast<int>( tiles.size() ) < Tiles() && mWidth < cTiledFlag;
 
-  uint16_t* pData = mpData,
-        * pEnd = mpData + mWidth * mHeight;
-  while( pData < pEnd )
+  string buffer;
+  PutLE( buffer, tiled ? mWidth | cTiledFlag : mWidth, 2 );
+  PutLE( buffer, mHeight, 2 );
+  if( tiled )
+  {
+    PutLE( buffer, static_cast<uint32_t>( tiles.size() ), 4 );
+    for( size_t i = 0; i < tiles.size(); ++i )
+    {
+      PutLE( buffer, tiles[i], 4 );
+      int x, y, xEnd, yEnd;
+      TileRange( tiles[i], x, y, xEnd, yEnd );
+      RunEncoder encoder( buffer );
+      for( ; y < yEnd; ++y )
+        encoder.Encode( mpData + y * mWidth + x, mpData + y * mWidth + xEnd );
+      encoder.Flush();
+    }
+  }
+  else
   {
-    int value = *pData,
-        length = 0;
-    while( pData < pEnd && *pData == value && length < 0x100 )
-      ++pData, ++length;
-    os.put( --length & 0xff ).put( value & 0xff ).put( value >> 8 );
+    RunEncoder encoder( buffer );
+    encoder.Encode( mpData, mpData + mWidth * mHeight );
+    encoder.Flush();
   }
-  return os;
+  return os.write( buffer.data(), buffer.size() );
 }
 
 istream&
 BitmapImage::ReadBinary( istream& is )
 {
-  mWidth = uint8_t( is.get() );
-  mWidth |= uint8_t( is.get() ) << 8;
-  mHeight = uint8_t( is.get() );
-  mHeight |= uint8_t( is.get() ) << 8;
+  int width = GetLE( is, 2 );
+  bool tiled = ( width & cTiledFlag );
+  mWidth = width & ~cTiledFlag;
+  mHeight = GetLE( is, 2 );
 
   delete[] mpData;
   mpData = new uint16_t[ mWidth * mHeight ];
 
-  uint16_t* pData = mpData,
-        * pEnd = mpData + mWidth * mHeight;
-  while( pData < pEnd )
+  if( tiled )
   {
-    int length_1 = uint8_t( is.get() );
-    int value = uint8_t( is.get() );
-    value |= uint8_t( is.get() ) << 8;
-    for( int i = 0; i <= length_1 && pData < pEnd; ++i )
-      *pData++ = value;
+    SetBlack();
+    uint32_t count = GetLE( is, 4 );
+    for( uint32_t i = 0; i < count && is; ++i )
+    {
+      int tile = GetLE( is, 4 );
+      if( tile < 0 || tile >= Tiles() )
+      {
+        is.setstate( ios::failbit );
+        break;
+      }
+      int x, y, xEnd, yEnd;
+      TileRange( tile, x, y, xEnd, yEnd );
+      RunDecoder decoder( is );
+      for( ; y < yEnd; ++y )
+        decoder.Decode( mpData + y * mWidth + x, mpData + y * mWidth + xEnd );
+    }
+  }
+  else
+  {
+    RunDecoder decoder( is );
+    decoder.Decode( mpData, mpData + mWidth * mHeight );
   }
   return is;
 }
 
+UnitTest( BitmapImageTiledEncodingTest )
+{
+  const int width = 100, height = 37;
+  BitmapImage image( width, height );
+  image.SetBlack();
+  int changedTiles[] = { 0, 3, 13, image.Tiles() - 1 };
+  for( size_t i = 0; i < sizeof( changedTiles ) / sizeof( *changedTiles ); ++i )
+  {
+    int tile = changedTiles[i],
+        x = ( tile % image.HorizontalTiles() ) * BitmapImage::TileSize,
+        y = ( tile / image.HorizontalTiles() ) * BitmapImage::TileSize;
+    for( int j = 0; j < 50; ++j )
+    {
+      int px = min( x + ::rand() % BitmapImage::TileSize, width - 1 ),
+          py = min( y + ::rand() % BitmapImage::TileSize, height - 1 );
+      image( px, py ) = RGBColor( ::rand() & 0xffffff );
+    }
+  }
+  BitmapImage reference( width, height );
+  for( int x = 0; x < width; ++x )
+    for( int y = 0; y < height; ++y )
+      reference( x, y ) = RGBColor( ( x * 4 ) << 16 | ( y * 4 ) );
+  BitmapImage* images[] = { &image, &reference };
+  for( size_t i = 0; i < 2 * sizeof( images ) / sizeof( *images ); ++i )
+  {
+    bool allowTiles = i & 1;
+    stringstream stream;
+    images[i / 2]->WriteBinary( stream, allowTiles );
+    bool tiled = stream.str()[1] & 0x80;
+    TestFail_if( tiled != ( allowTiles && images[i / 2] == &image ), "Unexpected format for image " << i );
+    BitmapImage result;
+    result.ReadBinary( stream );
+    TestFail_if( !stream, "Stream error when reading image " << i );
+    TestFail_if( result.Width() != width || result.Height() != height, "Dimension mismatch for image " << i );
+    TestFail_if( std::memcmp( result.RawData(), images[i / 2]->RawData(), width * height * sizeof( uint16_t ) ),
+                 "Data mismatch for image " << i );
+  }
+  BitmapImage difference( width, height ),
+              updated( reference );
+  difference.SetBlack();
+  for( size_t i = 0; i < sizeof( changedTiles ) / sizeof( *changedTiles ); ++i )
+  {
+    difference.SetTileDifference( image, reference, changedTiles[i] );
+    updated.CopyTile( image, changedTiles[i] );
+  }
+  reference += difference;
+  TestFail_if( std::memcmp( reference.RawData(), updated.RawData(), width * height * sizeof( uint16_t ) ),
+               "Difference mismatch" );
+}
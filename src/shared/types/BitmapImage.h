@@ -5,6 +5,9 @@
 //   run-length encoding.
 //   BitmapImages support subtraction and addition to allow for efficient
 //   transmission of differences between subsequent frames.
+//   For partial updates, images are divided into square tiles which are
+//   numbered row by row. When writing an image in which some tiles are
+//   entirely zero, only the remaining tiles are encoded.
 //
 // $BEGIN_BCI2000_LICENSE$
 // 
@@ -127,6 +130,25 @@ class BitmapImage
       return PixelRef( *this, x, y );
     }
 
+  // Tile geometry
+  enum { TileSize = 16 };
+  int HorizontalTiles() const
+    {
+      return ( mWidth + TileSize - 1 ) / TileSize;
+    }
+  int VerticalTiles() const
+    {
+      return ( mHeight + TileSize - 1 ) / TileSize;
+    }
+  int Tiles() const
+    {
+      return HorizontalTiles() * VerticalTiles();
+    }
+  // Copy a tile from an image of equal dimensions.
+  BitmapImage& CopyTile( const BitmapImage&, int tile );
+  // Within a tile, set pixels to the difference between two images of equal dimensions.
+  BitmapImage& SetTileDifference( const BitmapImage&, const BitmapImage&, int tile );
+
   BitmapImage& operator+=( const BitmapImage& );
   BitmapImage& operator-=( const BitmapImage& );
 
@@ -144,11 +166,17 @@ class BitmapImage
   BitmapImage& SetBackground( const BitmapImage& );
 
 
-  std::ostream& WriteBinary( std::ostream& ) const;
+  // The tiled format may only be used when the receiver supports it,
+  // see ProtocolVersion::TiledBitmaps.
+  std::ostream& WriteBinary( std::ostream&, bool allowTiles = false ) const;
   std::istream& ReadBinary( std::istream& );
 
  private:
   void DimensionCheck( const BitmapImage& ) const;
+  void TileCheck( int ) const;
+  // Pixel range of a tile, with end positions clipped to the image.
+  void TileRange( int tile, int& x, int& y, int& xEnd, int& yEnd ) const;
+  bool TileIsZero( int ) const;
 
   int     mWidth,
           mHeight;
@@ -87,6 +87,7 @@ static struct { const char* name; int id; } sCfgIDs[] =
 
     CFGID( ShowNumericValues ),
     CFGID( AutoScale ),
+    CFGID( CoalesceFrames ),
 
 };
 
@@ -91,6 +91,9 @@ class CfgID
 
       ShowNumericValues,
       AutoScale,
+      // Set to a nonzero value to have the operator drop intermediate signal
+      // frames when the display does not keep up with incoming data.
+      CoalesceFrames,
       // When adding new values, don't forget to add them to the string list in CfgID.cpp as well.
   };
 
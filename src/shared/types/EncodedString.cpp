@@ -34,6 +34,7 @@
 
 #include "EncodedString.h"
 #include <sstream>
+#include <cstdio>
 
 using namespace std;
 
@@ -51,34 +52,44 @@ static const char cEscapeChar = '%';
 istream&
 EncodedString::ReadFromStream( istream& is )
 {
-  string newContent;
-  if( is >> newContent )
+  // Characters are taken from the stream buffer, and decoded in a single pass.
+  istream::sentry sentry( is ); // skips whitespace
+  if( sentry )
   {
-    size_t pos = newContent.find( cEscapeChar, 0 );
-    while( pos != npos )
+    streambuf* pBuf = is.rdbuf();
+    string newContent;
+    int c = pBuf->sgetc();
+    while( c != EOF && !::isspace( c ) )
     {
-      newContent.erase( pos, 1 );
-
-      size_t numDigits = 0;
-      char curDigit;
-      int hexValue = 0;
-      while( pos + numDigits < newContent.size() && numDigits < 2
-             && ::isxdigit( curDigit = newContent[ pos + numDigits ] ) )
+      if( c == cEscapeChar )
       {
-        if( !::isdigit( curDigit ) )
-          curDigit = ::toupper( curDigit ) - 'A' + 10;
-        else
-          curDigit -= '0';
-        hexValue = ( hexValue << 4 ) + curDigit;
-        ++numDigits;
+        int numDigits = 0,
+            hexValue = 0;
+        c = pBuf->snextc();
+        while( c != EOF && numDigits < 2 && ::isxdigit( c ) )
+        {
+          int digit = ::isdigit( c ) ? c - '0' : ::toupper( c ) - 'A' + 10;
+          hexValue = ( hexValue << 4 ) + digit;
+          ++numDigits;
+          c = pBuf->snextc();
+        }
+        if( hexValue > 0 )
+          newContent += static_cast<char>( hexValue );
+        else if( c != EOF && !::isspace( c ) )
+        { // A character following a zero escape is taken literally.
+          newContent += static_cast<char>( c );
+          c = pBuf->snextc();
+        }
+      }
+      else
+      {
+        newContent += static_cast<char>( c );
+        c = pBuf->snextc();
       }
-      newContent.erase( pos, numDigits );
-      if( hexValue > 0 )
-        newContent.insert( pos, 1, static_cast<char>( hexValue ) );
-
-      pos = newContent.find( cEscapeChar, pos + 1 );
     }
-    *this = newContent;
+    if( c == EOF )
+      is.setstate( ios::eofbit );
+    swap( newContent );
   }
   return is;
 }
@@ -101,6 +112,17 @@ EncodedString::WriteToStream( ostream& os, const string& forbiddenChars ) const
   else
   {
     const string& self = *this;
+    size_t pos = 0;
+    while( pos < size()
+           && self[ pos ] >= 0
+           && ::isprint( self[ pos ] )
+           && !::isspace( self[ pos ] )
+           && self[ pos ] != cEscapeChar
+           && forbiddenChars.find( self[ pos ] ) == npos )
+      ++pos;
+    if( pos == size() ) // nothing to encode
+      return os.write( data(), size() );
+
     ostringstream oss;
     oss << hex;
     for( size_t pos = 0; pos < size(); ++pos )
@@ -72,6 +72,69 @@ struct ShmPool_ : private map<string, ShmPtr>
 
 StaticObject<ShmPool_> ShmPool;
 
+// Signal data are transferred with a single read or write call per signal,
+// and converted from or to little endian byte order in memory.
+template<typename T, class Dest>
+void
+GetValues( const char* p, int channels, int elements, Dest& d )
+{
+  BinaryData<T, LittleEndian> value;
+  for( int i = 0; i < channels; ++i )
+    for( int j = 0; j < elements; ++j )
+    {
+      p = value.Get( p );
+      d( i, j ) = value;
+    }
+}
+
+template<typename T>
+void
+PutValues( const GenericSignal& s, char* p )
+{
+  for( int i = 0; i < s.Channels(); ++i )
+    for( int j = 0; j < s.Elements(); ++j )
+      p = BinaryData<T, LittleEndian>( s( i, j ) ).Put( p );
+}
+
+// A float buffer with values arranged channel by channel.
+struct FloatBuffer
+{
+  FloatBuffer( float* p, int elements ) : mp( p ), mElements( elements ) {}
+  float& operator()( int ch, int el ) { return mp[ch * mElements + el]; }
+  float* mp;
+  int mElements;
+};
+
+}
+
+template<class Dest>
+bool
+GenericSignal::ReadValues( istream& is, SignalType inType, int inChannels, int inElements, Dest& outDest )
+{
+  if( inType == SignalType::float24 )
+  {
+    for( int i = 0; i < inChannels; ++i )
+      for( int j = 0; j < inElements; ++j )
+        outDest( i, j ) = GetValue_float24( is );
+    return true;
+  }
+  vector<char> buffer( inChannels * inElements * inType.Size() );
+  if( !buffer.empty() && is.read( &buffer[0], buffer.size() ) )
+    switch( inType )
+    {
+      case SignalType::int16:
+        GetValues<int16_t>( &buffer[0], inChannels, inElements, outDest );
+        break;
+      case SignalType::float32:
+        GetValues<float>( &buffer[0], inChannels, inElements, outDest );
+        break;
+      case SignalType::int32:
+        GetValues<int32_t>( &buffer[0], inChannels, inElements, outDest );
+        break;
+      default:
+        return false;
+    }
+  return true;
 }
 
 const GenericSignal::ValueType GenericSignal::NaN = numeric_limits<ValueType>::quiet_NaN();
@@ -184,9 +247,29 @@ GenericSignal::WriteBinary( ostream& os ) const
     os.write( mSharedMemory->Name().c_str(), mSharedMemory->Name().length() + 1 );
   }
   else
-    for( int i = 0; i < Channels(); ++i )
-      for( int j = 0; j < Elements(); ++j )
-        WriteValueBinary( os, i, j );
+  {
+    vector<char> buffer( Channels() * Elements() * Type().Size() );
+    char* p = buffer.empty() ? 0 : &buffer[0];
+    switch( Type() )
+    {
+      case SignalType::int16:
+        PutValues<int16_t>( *this, p );
+        break;
+      case SignalType::float32:
+        PutValues<float>( *this, p );
+        break;
+      case SignalType::int32:
+        PutValues<int32_t>( *this, p );
+        break;
+      default:
+        p = 0;
+        for( int i = 0; i < Channels(); ++i )
+          for( int j = 0; j < Elements(); ++j )
+            WriteValueBinary( os, i, j );
+    }
+    if( p )
+      os.write( p, buffer.size() );
+  }
   return os;
 }
 
@@ -209,10 +292,42 @@ GenericSignal::ReadBinary( istream& is )
     AttachToSharedMemory( name );
     MemoryFence();
   }
-  else
-    for( int i = 0; i < Channels(); ++i )
-      for( int j = 0; j < Elements(); ++j )
-        ReadValueBinary( is, i, j );
+  else if( !ReadValues( is, Type(), Channels(), Elements(), *this ) )
+    is.setstate( is.failbit );
+  return is;
+}
+
+istream&
+GenericSignal::ReadBinaryAsFloat( istream& is, int& outChannels, int& outElements, vector<float>& outData )
+{
+  SignalType     type;
+  LengthField<2> channels,
+                 elements;
+  type.ReadBinary( is );
+  channels.ReadBinary( is );
+  elements.ReadBinary( is );
+  if( !is )
+    return is;
+  outChannels = static_cast<int>( channels );
+  outElements = static_cast<int>( elements );
+  size_t count = channels * elements;
+  outData.resize( count );
+  if( type.Shared() )
+  {
+    type.SetShared( false );
+    GenericSignal signal( SignalProperties( channels, elements, type ) );
+    string name;
+    getline( is, name, '\0' );
+    signal.AttachToSharedMemory( name );
+    MemoryFence();
+    for( int i = 0; i < outChannels; ++i )
+      for( int j = 0; j < outElements; ++j )
+        outData[i * outElements + j] = static_cast<float>( signal( i, j ) );
+    return is;
+  }
+  FloatBuffer buffer( count ? &outData[0] : 0, outElements );
+  if( !ReadValues( is, type, outChannels, outElements, buffer ) )
+    is.setstate( is.failbit );
   return is;
 }
 
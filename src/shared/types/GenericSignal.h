@@ -96,10 +96,18 @@ class GenericSignal
     std::istream& ReadValueBinary( std::istream&, size_t ch, size_t el );
     std::ostream& WriteBinary( std::ostream& ) const;
     std::istream& ReadBinary( std::istream& );
+    // Reads a signal's binary representation into a float buffer, with values
+    // arranged channel by channel, avoiding construction of a GenericSignal
+    // object. The buffer is resized as needed, so it may be reused across calls.
+    static std::istream& ReadBinaryAsFloat( std::istream&, int& outChannels, int& outElements, std::vector<float>& );
 
   private:
     static void PutValue_float24( std::ostream&, ValueType );
     static ValueType GetValue_float24( std::istream& );
+    // Reads values of the given type into a destination that is indexed by
+    // channel and element, as in dest( ch, el ). Returns false if the type is
+    // not supported.
+    template<class Dest> static bool ReadValues( std::istream&, SignalType, int channels, int elements, Dest& );
 
     GenericSignal& AssignFrom( const GenericSignal& );
     void AttachToSharedMemory( const std::string& );
@@ -43,6 +43,14 @@ using namespace std;
 // Common to all visualization messages.
 istream&
 VisBase::ReadBinary( istream& is )
+{
+  ReadVisID( is, mVisID );
+  ReadBinarySelf( is );
+  return is;
+}
+
+istream&
+VisBase::ReadVisID( istream& is, ::VisID& outVisID )
 {
   int visID = is.get();
   if( visID == SourceID::ExtendedFormat )
@@ -50,20 +58,27 @@ VisBase::ReadBinary( istream& is )
     string s;
     getline( is, s, '\0' );
     istringstream iss( s );
-    iss >> mVisID;
+    iss >> outVisID;
   }
   else
   {
     ostringstream oss;
     oss << visID;
-    mVisID = oss.str();
+    outVisID = oss.str();
   }
-  ReadBinarySelf( is );
   return is;
 }
 
 ostream&
 VisBase::WriteBinary( ostream& os ) const
+{
+  WriteVisID( os );
+  WriteBinarySelf( os );
+  return os;
+}
+
+ostream&
+VisBase::WriteVisID( ostream& os ) const
 {
   // We use the traditional message format if the visID can be represented
   // as a single byte number.
@@ -87,7 +102,6 @@ VisBase::WriteBinary( ostream& os ) const
       os << mVisID;
     os.put( '\0' );
   }
-  WriteBinarySelf( os );
   return os;
 }
 
@@ -247,6 +261,13 @@ VisBitmap::WriteBinarySelf( ostream& os ) const
   mBitmap.WriteBinary( os );
 }
 
+ostream&
+VisBitmap::WriteBinary( ostream& os, bool inAllowTiles ) const
+{
+  WriteVisID( os );
+  return mBitmap.WriteBinary( os, inAllowTiles );
+}
+
 
 static bci::MessageChannel* spOutputChannel = 0;
 
@@ -336,4 +357,25 @@ BitmapVisualization::SendDifferenceFrame( const BitmapImage& b )
   }
 }
 
+void
+BitmapVisualization::SendDifferenceFrame( const BitmapImage& b, const std::vector<int>& inTiles )
+{
+  if( b.Width() != mImageBuffer.Width() || b.Height() != mImageBuffer.Height() )
+  {
+    SendReferenceFrame( b );
+  }
+  else if( !inTiles.empty() )
+  {
+    if( mDifference.Width() != b.Width() || mDifference.Height() != b.Height() )
+      mDifference = BitmapImage( b.Width(), b.Height() );
+    mDifference.SetBlack();
+    for( size_t i = 0; i < inTiles.size(); ++i )
+    {
+      mDifference.SetTileDifference( b, mImageBuffer, inTiles[i] );
+      mImageBuffer.CopyTile( b, inTiles[i] );
+    }
+    Send( mDifference );
+  }
+}
+
 
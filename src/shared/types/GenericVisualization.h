@@ -30,6 +30,7 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 #include "CfgID.h"
 #include "VisID.h"
 #include "GenericSignal.h"
@@ -60,6 +61,12 @@ class VisBase
 
     std::istream& ReadBinary( std::istream& );
     std::ostream& WriteBinary( std::ostream& ) const;
+    // Reads the visID from a message header, leaving the stream positioned
+    // at the message body.
+    static std::istream& ReadVisID( std::istream&, ::VisID& );
+
+  protected:
+    std::ostream& WriteVisID( std::ostream& ) const;
 
   private:
     virtual void ReadBinarySelf( std::istream& ) = 0;
@@ -183,6 +190,8 @@ class VisBitmap : public VisBase
     const ::BitmapImage& BitmapImage() const { return mBitmap; }
     operator const ::BitmapImage&() const    { return mBitmap; }
 
+    std::ostream& WriteBinary( std::ostream&, bool allowTiles = false ) const;
+
   private:
     virtual void ReadBinarySelf( std::istream& );
     virtual void WriteBinarySelf( std::ostream& ) const;
@@ -284,9 +293,13 @@ class BitmapVisualization : public GenericVisualization
 
     void SendReferenceFrame( const BitmapImage& );
     void SendDifferenceFrame( const BitmapImage& );
+    // Sends differences within the given tiles only, assuming that other tiles
+    // did not change since the previous frame.
+    void SendDifferenceFrame( const BitmapImage&, const std::vector<int>& tiles );
 
   private:
-    BitmapImage mImageBuffer;
+    BitmapImage mImageBuffer,
+                mDifference;
 };
 
 template<typename T>
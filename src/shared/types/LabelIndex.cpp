@@ -185,9 +185,18 @@ LabelIndex::TrivialLabel( size_t index )
   const int trivialBase = 1; // Channels are counted from 1,
                              // so trivial labels should start with 1 to avoid
                              // user confusion.
-  ostringstream oss;
-  oss << index + trivialBase;
-  return oss.str();
+  // Avoid stream formatting, which dominates the time needed to resize
+  // large lists and matrices.
+  char buf[32],
+     * p = buf + sizeof( buf );
+  size_t n = index + trivialBase;
+  *--p = '\0';
+  do
+  {
+    *--p = static_cast<char>( '0' + n % 10 );
+    n /= 10;
+  } while( n );
+  return p;
 }
 
 // **************************************************************************
@@ -199,7 +208,6 @@ LabelIndex::TrivialLabel( size_t index )
 bool
 LabelIndex::IsTrivial() const
 {
-  Sync();
   bool trivial = true;
   for( size_t i = 0; trivial && i < mReverseIndex.size(); ++i )
     trivial &= ( mReverseIndex[ i ] == TrivialLabel( i ) );
@@ -0,0 +1,277 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A LatencyTrace accompanies a data block on its way through
+//   the core modules. It holds the time at which the block was acquired, and
+//   the times at which each module received, processed, and sent the block.
+//   All times are in ns as returned by PrecisionTime::Nanoseconds(), so they
+//   are comparable only between modules running on the same machine.
+//   A LatencyReport collects traces into per-hop histograms.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "LatencyTrace.h"
+#include "PrecisionTime.h"
+#include "BinaryData.h"
+#include "UnitTest.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdint.h>
+
+using namespace std;
+
+long long LatencyTrace::sLastAcquisition = 0;
+
+void
+LatencyTrace::MarkAcquisition()
+{
+  sLastAcquisition = PrecisionTime::Nanoseconds();
+}
+
+const char*
+LatencyTrace::ModuleName( int inModule )
+{
+  static const char* names[] = { "Source", "SignalProcessing", "Application" };
+  if( inModule < 1 || inModule > static_cast<int>( sizeof( names ) / sizeof( *names ) ) )
+    return "Module";
+  return names[inModule - 1];
+}
+
+LatencyTrace&
+LatencyTrace::Reset( unsigned int inBlock, long long inAcquired )
+{
+  mBlock = inBlock;
+  mAcquired = inAcquired;
+  mHops.clear();
+  return *this;
+}
+
+LatencyTrace::Hop&
+LatencyTrace::AddHop( int inModule )
+{
+  Hop hop = { inModule, 0, 0, 0 };
+  if( mHops.size() >= MaxHops )
+    mHops.erase( mHops.begin() );
+  mHops.push_back( hop );
+  return mHops.back();
+}
+
+ostream&
+LatencyTrace::WriteBinary( ostream& os ) const
+{
+  BinaryData<uint32_t, LittleEndian>( mBlock ).Put( os );
+  BinaryData<int64_t, LittleEndian>( mAcquired ).Put( os );
+  BinaryData<uint8_t, LittleEndian>( mHops.size() ).Put( os );
+  for( size_t i = 0; i < mHops.size(); ++i )
+  {
+    BinaryData<uint8_t, LittleEndian>( mHops[i].module ).Put( os );
+    BinaryData<int64_t, LittleEndian>( mHops[i].received ).Put( os );
+    BinaryData<int64_t, LittleEndian>( mHops[i].processed ).Put( os );
+    BinaryData<int64_t, LittleEndian>( mHops[i].sent ).Put( os );
+  }
+  return os;
+}
+
+istream&
+LatencyTrace::ReadBinary( istream& is )
+{
+  mBlock = BinaryData<uint32_t, LittleEndian>( is );
+  mAcquired = BinaryData<int64_t, LittleEndian>( is );
+  int hops = BinaryData<uint8_t, LittleEndian>( is );
+  if( hops > MaxHops )
+    is.setstate( ios::failbit );
+  mHops.clear();
+  for( int i = 0; is && i < hops; ++i )
+  {
+    Hop hop;
+    hop.module = BinaryData<uint8_t, LittleEndian>( is );
+    hop.received = BinaryData<int64_t, LittleEndian>( is );
+    hop.processed = BinaryData<int64_t, LittleEndian>( is );
+    hop.sent = BinaryData<int64_t, LittleEndian>( is );
+    mHops.push_back( hop );
+  }
+  return is;
+}
+
+// LatencyReport
+void
+LatencyReport::Clear()
+{
+  mHistograms.clear();
+  mPrevious.Reset( 0, 0 );
+  mTraces = 0;
+}
+
+void
+LatencyReport::Add( const LatencyTrace& inTrace )
+{
+  if( inTrace.Hops() < 1 )
+    return;
+  ++mTraces;
+  const LatencyTrace::Hop& first = inTrace[0];
+  if( mPrevious.Hops() > 0 && inTrace.Block() == mPrevious.Block() + 1 )
+  {
+    const LatencyTrace::Hop& last = mPrevious[mPrevious.Hops() - 1];
+    Add( string( LatencyTrace::ModuleName( last.module ) ) + " to " + LatencyTrace::ModuleName( first.module ),
+         first.received - last.sent );
+  }
+  Add( "Acquisition to " + string( LatencyTrace::ModuleName( first.module ) ) + " processed",
+       first.processed - inTrace.Acquired() );
+  for( int i = 0; i < inTrace.Hops(); ++i )
+  {
+    const LatencyTrace::Hop& hop = inTrace[i];
+    string name = LatencyTrace::ModuleName( hop.module );
+    if( i > 0 )
+    {
+      const LatencyTrace::Hop& prev = inTrace[i - 1];
+      Add( string( LatencyTrace::ModuleName( prev.module ) ) + " to " + name, hop.received - prev.sent );
+      Add( name + " processing", hop.processed - hop.received );
+    }
+    Add( name + " output", hop.sent - hop.processed );
+  }
+  const LatencyTrace::Hop& last = inTrace[inTrace.Hops() - 1];
+  Add( "Acquisition to " + string( LatencyTrace::ModuleName( last.module ) ) + " sent",
+       last.sent - inTrace.Acquired() );
+  mPrevious = inTrace;
+}
+
+void
+LatencyReport::Add( const string& inName, long long inNs )
+{
+  Find( inName ).Add( inNs );
+}
+
+LatencyReport::Histogram&
+LatencyReport::Find( const string& inName )
+{
+  for( vector<Histogram>::iterator i = mHistograms.begin(); i != mHistograms.end(); ++i )
+    if( i->name == inName )
+      return *i;
+  Histogram h;
+  h.name = inName;
+  h.count = 0;
+  h.min = 0;
+  h.max = 0;
+  h.sum = 0;
+  fill( h.bins, h.bins + Bins, 0 );
+  mHistograms.push_back( h );
+  return mHistograms.back();
+}
+
+void
+LatencyReport::Histogram::Add( long long inNs )
+{
+  if( count == 0 || inNs < min )
+    min = inNs;
+  if( count == 0 || inNs > max )
+    max = inNs;
+  sum += inNs;
+  ++count;
+  int bin = 0;
+  for( long long us = inNs / 1000; us > 0 && bin < Bins - 1; us >>= 1 )
+    ++bin;
+  ++bins[bin];
+}
+
+long long
+LatencyReport::Histogram::Percentile( double inP ) const
+{
+  int n = 0, bin = 0;
+  while( bin < Bins - 1 && ( n += bins[bin] ) < inP * count )
+    ++bin;
+  if( bin == Bins - 1 )
+    return max;
+  return ( 1LL << bin ) * 1000;
+}
+
+ostream&
+LatencyReport::WriteToStream( ostream& os ) const
+{ // Format into a local stream, leaving the caller's stream flags untouched.
+  ostringstream oss;
+  oss << "Latency report, " << mTraces << " blocks\n";
+  for( vector<Histogram>::const_iterator i = mHistograms.begin(); i != mHistograms.end(); ++i )
+  {
+    const Histogram& h = *i;
+    oss << h.name << ": "
+        << fixed << setprecision( 1 )
+        << "min " << h.min * 1e-3 << "us, "
+        << "mean " << h.sum / h.count * 1e-3 << "us, "
+        << "99% below " << h.Percentile( 0.99 ) * 1e-3 << "us, "
+        << "max " << h.max * 1e-3 << "us\n";
+    for( int bin = 0; bin < Bins; ++bin )
+    {
+      if( h.bins[bin] == 0 )
+        continue;
+      oss << "  ";
+      if( bin == 0 )
+        oss << "below 1us";
+      else if( bin == Bins - 1 )
+        oss << "above " << ( 1LL << ( bin - 1 ) ) << "us";
+      else
+        oss << ( 1LL << ( bin - 1 ) ) << "us to " << ( 1LL << bin ) << "us";
+      oss << ": " << h.bins[bin] << "\n";
+    }
+  }
+  return os << oss.str();
+}
+
+UnitTest( LatencyTraceTest )
+{
+  LatencyTrace t;
+  t.Reset( 7, 1000000 );
+  for( int module = 1; module <= 3; ++module )
+  {
+    LatencyTrace::Hop& hop = t.AddHop( module );
+    hop.received = 1000000 + module * 100000;
+    hop.processed = hop.received + 50000;
+    hop.sent = hop.processed + 1000;
+  }
+  ostringstream oss;
+  t.WriteBinary( oss );
+  istringstream iss( oss.str() );
+  LatencyTrace r;
+  TestFail_if( !r.ReadBinary( iss ), "" );
+  TestFail_if( r.Block() != 7 || r.Acquired() != 1000000 || r.Hops() != 3, "" );
+  for( int i = 0; i < r.Hops(); ++i )
+  {
+    TestFail_if( r[i].module != t[i].module, "" );
+    TestFail_if( r[i].received != t[i].received || r[i].processed != t[i].processed || r[i].sent != t[i].sent, "" );
+  }
+
+  LatencyReport report;
+  report.Add( t );
+  t.Reset( 8, t.Acquired() + 20000000 );
+  LatencyTrace::Hop& hop = t.AddHop( 1 );
+  hop.received = r[2].sent + 3000;
+  hop.processed = hop.sent = t.Acquired();
+  report.Add( t );
+  TestFail_if( report.Traces() != 2, "" );
+  ostringstream out;
+  report.WriteToStream( out );
+  TestFail_if( out.str().find( "SignalProcessing processing: min 50.0us" ) == string::npos, out.str() );
+  TestFail_if( out.str().find( "Application to Source: min 3.0us" ) == string::npos, out.str() );
+  TestFail_if( out.str().find( "32us to 64us: 1" ) == string::npos, out.str() );
+  TestFail_if( ( out.flags() & ios::floatfield ) != 0 || out.precision() != 6, "stream format changed" );
+}
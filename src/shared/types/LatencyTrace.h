@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A LatencyTrace accompanies a data block on its way through
+//   the core modules. It holds the time at which the block was acquired, and
+//   the times at which each module received, processed, and sent the block.
+//   All times are in ns as returned by PrecisionTime::Nanoseconds(), so they
+//   are comparable only between modules running on the same machine.
+//   A LatencyReport collects traces into per-hop histograms.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+class LatencyTrace
+{
+ public:
+  enum { MaxHops = 16 };
+  struct Hop
+  {
+    int module; // 1: Source, 2: SignalProcessing, 3: Application
+    long long received,
+              processed,
+              sent;
+  };
+
+  LatencyTrace()
+    : mBlock( 0 ), mAcquired( 0 )
+    {}
+
+  unsigned int Block() const
+    { return mBlock; }
+  long long Acquired() const
+    { return mAcquired; }
+  int Hops() const
+    { return static_cast<int>( mHops.size() ); }
+  const Hop& operator[]( int i ) const
+    { return mHops[i]; }
+  Hop& operator[]( int i )
+    { return mHops[i]; }
+
+  // Starts a new trace, removing all hops.
+  LatencyTrace& Reset( unsigned int block, long long acquired );
+  // Appends a hop with all times set to zero.
+  Hop& AddHop( int module );
+
+  std::ostream& WriteBinary( std::ostream& ) const;
+  std::istream& ReadBinary( std::istream& );
+
+  static const char* ModuleName( int module );
+
+  // The source module's DataIOFilter marks the time at which the ADC
+  // delivered a data block.
+  static void MarkAcquisition();
+  static long long LastAcquisition()
+    { return sLastAcquisition; }
+
+ private:
+  unsigned int mBlock;
+  long long mAcquired;
+  std::vector<Hop> mHops;
+
+  static long long sLastAcquisition;
+};
+
+class LatencyReport
+{
+ public:
+  // Histogram bin i counts durations in [2^(i-1), 2^i) microseconds,
+  // bin 0 counts durations below 1us, and the last bin counts durations
+  // above its lower limit.
+  enum { Bins = 26 };
+
+  LatencyReport()
+    { Clear(); }
+  void Clear();
+  // Adds a trace's durations to the histograms. Consecutive blocks are
+  // used to compute the time from the last module back to the source module.
+  void Add( const LatencyTrace& );
+  int Traces() const
+    { return mTraces; }
+
+  std::ostream& WriteToStream( std::ostream& ) const;
+
+ private:
+  struct Histogram
+  {
+    std::string name;
+    int count;
+    long long min, max;
+    double sum;
+    int bins[Bins];
+
+    void Add( long long ns );
+    long long Percentile( double ) const;
+  };
+  Histogram& Find( const std::string& );
+  void Add( const std::string&, long long ns );
+
+  std::vector<Histogram> mHistograms;
+  LatencyTrace mPrevious;
+  int mTraces;
+};
+
+inline
+std::ostream& operator<<( std::ostream& os, const LatencyReport& r )
+{ return r.WriteToStream( os ); }
+
+#endif // LATENCY_TRACE_H
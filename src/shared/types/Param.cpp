@@ -27,9 +27,13 @@
 #include "Brackets.h"
 #include "BCIException.h"
 #include "BCIAssert.h"
+#include "BinaryData.h"
+#include "UnitTest.h"
 
 #include <sstream>
 #include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
 
 using namespace std;
 
@@ -38,6 +42,61 @@ static const string sCommentSeparator = "//";
 static const string sReadonlyTag = "(readonly)";
 static const string cEmptyString = "";
 
+// List and matrix values are transmitted in binary form if there are at
+// least cMinBinaryValues of them, and each value is a number in canonical
+// form, such that the receiver restores the original strings from numbers.
+// Binary values start with a tag that never occurs in an EncodedString,
+// followed by a type specifier.
+static const size_t cMinBinaryValues = 16;
+static const char cBinaryValuesTag = '\x01';
+enum { Int32Values = 'i', Float64Values = 'd' };
+
+static const char*
+CanonicalFormat( double d, char* buf )
+{
+  ::sprintf( buf, "%.15g", d );
+  return buf;
+}
+
+// Returns Int32Values or Float64Values if a string is identical to the
+// output of CanonicalFormat() for its numeric value, and 0 otherwise.
+// Exponents are not accepted because their format differs across platforms.
+static int
+CanonicalType( const string& s )
+{
+  const char* begin = s.c_str(),
+            * end = begin + s.length(),
+            * p = begin;
+  if( *p == '-' )
+    ++p;
+  const char* intBegin = p;
+  while( p < end && ::isdigit( *p ) )
+    ++p;
+  int intDigits = static_cast<int>( p - intBegin );
+  if( intDigits == 0 || ( intDigits > 1 && *intBegin == '0' ) )
+    return 0;
+  int digits = ( *intBegin == '0' ) ? 0 : intDigits;
+  bool isInteger = ( p == end );
+  if( !isInteger && *p == '.' )
+  {
+    const char* fracBegin = ++p;
+    while( p < end && ::isdigit( *p ) )
+      ++p;
+    if( p == fracBegin || p[-1] == '0' )
+      return 0;
+    int leadingZeros = 0;
+    if( digits == 0 )
+      while( fracBegin[leadingZeros] == '0' )
+        ++leadingZeros;
+    if( leadingZeros > 3 )
+      return 0;
+    digits += static_cast<int>( p - fracBegin ) - leadingZeros;
+  }
+  if( p != end || digits > 15 || ( digits == 0 && *begin == '-' ) )
+    return 0;
+  return isInteger && digits < 10 ? Int32Values : Float64Values;
+}
+
 const ctype<char>&
 Param::ct()
 {
@@ -289,6 +348,12 @@ Param::Changed() const
 // **************************************************************************
 istream&
 Param::ReadFromStream( istream& is )
+{
+  return Read( is, false );
+}
+
+istream&
+Param::Read( istream& is, bool inBinaryValues )
 {
   mChanged = true;
   mSections.clear();
@@ -338,9 +403,12 @@ Param::ReadFromStream( istream& is )
   // Not all matrix/list entries are required for a parameter definition.
   mValues.resize( mDim1Index.Size() * mDim2Index.Size(), sDefaultValue );
   ValueContainer::iterator i = mValues.begin();
-  while( i != mValues.end() && is.peek() != EOF
-                               && delimiters.find( is.peek() ) == string::npos )
-    is >> ws >> *i++;
+  if( inBinaryValues && ReadBinaryValues( is ) )
+    i = mValues.end();
+  int c;
+  while( i != mValues.end() && ( c = is.peek() ) != EOF
+                               && delimiters.find( c ) == string::npos )
+    is >> *i++; // skips whitespace
 
   // Remaining elements are optional.
   string remainder;
@@ -391,6 +459,12 @@ Param::ReadFromStream( istream& is )
 // **************************************************************************
 ostream&
 Param::WriteToStream( ostream& os ) const
+{
+  return Write( os, false );
+}
+
+ostream&
+Param::Write( ostream& os, bool inBinaryValues ) const
 {
   bool isUnnamed = mName.empty();
   if( isUnnamed ) // Un-named parameters are enclosed in brackets.
@@ -402,8 +476,9 @@ Param::WriteToStream( ostream& os ) const
     os << RowLabels() << ' ' << ColumnLabels() << ' ';
   else if( mType.find( "list" ) != mType.npos )
     os << Labels() << ' ';
-  for( int i = 0; i < NumValues(); ++i )
-    os << Value( i ) << ' ';
+  if( !( inBinaryValues && WriteBinaryValues( os ) ) )
+    for( int i = 0; i < NumValues(); ++i )
+      os << Value( i ) << ' ';
   if( !( mDefaultValue.empty() && mLowRange.empty() && mHighRange.empty() ) )
     os << mDefaultValue << ' '
        << mLowRange << ' '
@@ -430,7 +505,7 @@ Param::WriteToStream( ostream& os ) const
 istream&
 Param::ReadBinary( istream& is )
 {
-  ReadFromStream( is );
+  Read( is, true );
   // Some old modules out there don't send CRLF after binary Param messages.
   if( !is.eof() && ( is.get() != '\r' ) )
     is.setstate( ios::failbit );
@@ -447,9 +522,126 @@ Param::ReadBinary( istream& is )
 // Returns:    Output stream written into.
 // **************************************************************************
 ostream&
-Param::WriteBinary( ostream& os ) const
+Param::WriteBinary( ostream& os, bool inNumericValues ) const
+{
+  return Write( os, inNumericValues ).write( "\r\n", 2 );
+}
+
+// A stream buffer that computes a 64 bit FNV-1a hash over its input.
+namespace {
+class HashBuf : public streambuf
 {
-  return WriteToStream( os ).write( "\r\n", 2 );
+ public:
+  HashBuf() : mHash( 14695981039346656037ULL ) {}
+  uint64_t Hash() const { return mHash; }
+
+ protected:
+  int overflow( int c )
+  {
+    if( c != EOF )
+      Add( static_cast<char>( c ) );
+    return 0;
+  }
+  streamsize xsputn( const char* s, streamsize n )
+  {
+    for( streamsize i = 0; i < n; ++i )
+      Add( s[i] );
+    return n;
+  }
+
+ private:
+  void Add( char c )
+  {
+    mHash ^= static_cast<unsigned char>( c );
+    mHash *= 1099511628211ULL;
+  }
+  uint64_t mHash;
+};
+} // namespace
+
+// **************************************************************************
+// Function:   Hash
+// Purpose:    Computes a hash over the parameter's binary representation,
+//             without creating a copy of it.
+// Parameters: N/A
+// Returns:    Hash value.
+// **************************************************************************
+uint64_t
+Param::Hash() const
+{
+  HashBuf buf;
+  ostream os( &buf );
+  WriteBinary( os, true );
+  return buf.Hash();
+}
+
+// **************************************************************************
+// Function:   WriteBinaryValues
+// Purpose:    Writes list or matrix values as binary numbers, provided that
+//             each value is a number in canonical form.
+// Parameters: Output stream to write into.
+// Returns:    True if values were written, false if they need to be
+//             written as text.
+// **************************************************************************
+bool
+Param::WriteBinaryValues( ostream& os ) const
+{
+  if( mValues.size() < cMinBinaryValues )
+    return false;
+  bool int32 = true;
+  for( ValueContainer::const_iterator i = mValues.begin(); i != mValues.end(); ++i )
+  {
+    int type = i->mpString ? CanonicalType( *i->mpString ) : 0;
+    if( !type )
+      return false;
+    int32 = int32 && type == Int32Values;
+  }
+  os.put( cBinaryValuesTag ).put( int32 ? Int32Values : Float64Values );
+  for( ValueContainer::const_iterator i = mValues.begin(); i != mValues.end(); ++i )
+    if( int32 )
+      BinaryData<int32_t, LittleEndian>( i->mNumber ).Put( os );
+    else
+      BinaryData<double, LittleEndian>( i->mNumber ).Put( os );
+  os.put( ' ' );
+  return true;
+}
+
+// **************************************************************************
+// Function:   ReadBinaryValues
+// Purpose:    Reads list or matrix values written by WriteBinaryValues().
+//             Values are restored in canonical string form.
+// Parameters: Input stream to read from.
+// Returns:    True if values were read, false if they are given as text.
+// **************************************************************************
+bool
+Param::ReadBinaryValues( istream& is )
+{
+  if( mValues.size() < cMinBinaryValues )
+    return false;
+  while( is.peek() == ' ' )
+    is.get();
+  if( is.peek() != cBinaryValuesTag )
+    return false;
+  is.get();
+  int type = is.get();
+  if( type != Int32Values && type != Float64Values )
+    is.setstate( ios::failbit );
+  char buf[32];
+  for( ValueContainer::iterator i = mValues.begin(); is && i != mValues.end(); ++i )
+  {
+    delete i->mpParam;
+    i->mpParam = NULL;
+    if( type == Int32Values )
+      i->mNumber = BinaryData<int32_t, LittleEndian>( is );
+    else
+      i->mNumber = BinaryData<double, LittleEndian>( is );
+    CanonicalFormat( i->mNumber, buf );
+    if( i->mpString )
+      i->mpString->assign( buf );
+    else
+      i->mpString = new EncodedString( buf );
+  }
+  return true;
 }
 
 // **************************************************************************
@@ -552,6 +744,7 @@ Param::ParamValue::Assign( const ParamValue& p )
 
     delete mpString;
     mpString = p.mpString ? new EncodedString( *p.mpString ) : 0;
+    mNumber = p.mNumber;
 
     delete pt; // defer deletion in case assignment is from a child
   }
@@ -572,6 +765,7 @@ Param::ParamValue::Assign( const string& s )
     mpString = new EncodedString( s );
     delete mpParam;
     mpParam = NULL;
+    mNumber = ParseNumber( s );
   }
 }
 
@@ -590,6 +784,7 @@ Param::ParamValue::Assign( const Param& p )
     mpParam = new Param( p );
     delete mpString;
     mpString = NULL;
+    mNumber = 0;
   }
 }
 
@@ -615,6 +810,41 @@ Param::ParamValue::ToString() const
   return *result;
 }
 
+// **************************************************************************
+// Function:   ToNumber
+// Purpose:    Returns a ParamValue's numeric value.
+//             For strings, this is the value computed on assignment.
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+double
+Param::ParamValue::ToNumber() const
+{
+  return mpParam ? ParseNumber( ToString() ) : mNumber;
+}
+
+// **************************************************************************
+// Function:   ParseNumber
+// Purpose:    Converts a string into a number.
+//             Strings that are not decimal numbers are interpreted as
+//             hexadecimal numbers.
+// Parameters: String to convert.
+// Returns:    Numeric value, or zero.
+// **************************************************************************
+double
+Param::ParamValue::ParseNumber( const string& s )
+{
+  double result = ::atof( s.c_str() );
+  // Avoid creating a stream for strings that cannot contain a hex number.
+  if( result == 0.0 && s.find_first_of( "123456789abcdefABCDEF" ) != string::npos )
+  {
+    uint64_t n = 0;
+    if( istringstream( s ) >> hex >> n )
+      result = static_cast<double>( n );
+  }
+  return result;
+}
+
 // **************************************************************************
 // Function:   ToParam
 // Purpose:    Returns a ParamValue as a Param.
@@ -689,10 +919,13 @@ Param::ParamValue::WriteToStream( ostream& os ) const
 istream&
 Param::ParamValue::ReadFromStream( istream& is )
 {
-  delete mpString;
+  // An existing string object is re-used to avoid heap operations when
+  // reading large lists or matrices.
+  EncodedString* pString = mpString;
   mpString = NULL;
   delete mpParam;
   mpParam = NULL;
+  mNumber = 0;
   if( is >> ws )
   {
     if( Brackets::IsOpening( is.peek() ) )
@@ -702,10 +935,14 @@ Param::ParamValue::ReadFromStream( istream& is )
     }
     else
     {
-      mpString = new EncodedString;
+      mpString = pString ? pString : new EncodedString;
+      pString = NULL;
+      mpString->clear();
       is >> *mpString;
+      mNumber = ParseNumber( *mpString );
     }
   }
+  delete pString;
   return is;
 }
 
@@ -728,4 +965,63 @@ Param::ParamValue::ConstructParamBuf() const
     sParamBuf.SetDimensions( 0, 0 );
 }
 
+UnitTest( ParamBinaryValuesTest )
+{
+  const char* numbers[] =
+  {
+    "0", "1", "-17", "999999999", "1000000000", "0.5", "-0.25",
+    "3.14159265358979", "0.0001", "-123456.789", "100000000000000",
+  };
+  const char* texts[] = { "-0", "0.10", "1e-05", "0.00001", "+1", "abc", "" };
+  const size_t numNumbers = sizeof( numbers ) / sizeof( *numbers ),
+               numTexts = sizeof( texts ) / sizeof( *texts );
+  for( size_t t = 0; t <= numTexts; ++t )
+  {
+    Param p( "Test list Values= 1 0 // test" );
+    p.SetNumValues( 3 * numNumbers );
+    for( int i = 0; i < p.NumValues(); ++i )
+      p.Value( i ) = numbers[i % numNumbers];
+    if( t < numTexts )
+      p.Value( 1 ) = texts[t];
+    ostringstream binary;
+    p.WriteBinary( binary, true );
+    bool isBinary = binary.str().find( cBinaryValuesTag ) != string::npos;
+    TestFail_if( isBinary != ( t == numTexts ), "Unexpected encoding for \"" << p.Value( 1 ).ToString() << "\"" );
+    Param q;
+    istringstream is( binary.str() );
+    TestFail_if( !q.ReadBinary( is ), "Could not read binary values" );
+    ostringstream expected, result;
+    expected << p;
+    result << q;
+    TestFail_if( result.str() != expected.str(), "Mismatch: \"" << result.str() << "\" vs \"" << expected.str() << "\"" );
+    for( int i = 0; i < q.NumValues(); ++i )
+      TestFail_if( q.Value( i ).ToNumber() != p.Value( i ).ToNumber(), "Numeric mismatch at index " << i );
+    q.Value( 0 ) = "2";
+    TestFail_if( q.Value( 0 ).ToNumber() != 2, "Numeric value not updated" );
+  }
+}
 
+UnitTest( ParamHashTest )
+{
+  Param p( "Filtering matrix SpatialFilter= 3 3 1 0 0 0 1 0 0 0 1 0 % % // test" );
+  p.SetDimensions( 64, 64 );
+  for( int row = 0; row < p.NumRows(); ++row )
+    for( int col = 0; col < p.NumColumns(); ++col )
+      p.Value( row, col ) = ( row == col ) ? "1" : "-0.015625";
+  Param q = p;
+  TestFail_if( q.Hash() != p.Hash(), "Copies differ in hash" );
+  // A parameter received with binary values has the same hash as its original.
+  ostringstream binary;
+  p.WriteBinary( binary, true );
+  istringstream is( binary.str() );
+  TestFail_if( !q.ReadBinary( is ), "Could not read binary values" );
+  TestFail_if( q.Hash() != p.Hash(), "Transmitted parameter differs in hash" );
+  q.Value( 63, 0 ) = "-0.015624";
+  TestFail_if( q.Hash() == p.Hash(), "Changed value not detected" );
+  q = p;
+  q.RowLabels()[0] = "Fz";
+  TestFail_if( q.Hash() == p.Hash(), "Changed label not detected" );
+  q = p;
+  q.SetComment( "changed" );
+  TestFail_if( q.Hash() == p.Hash(), "Changed comment not detected" );
+}
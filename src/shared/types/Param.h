@@ -30,6 +30,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <stdint.h>
 #include "EncodedString.h"
 #include "LabelIndex.h"
 #include "HierarchicalLabel.h"
@@ -54,19 +55,19 @@ class Param
      };
 
      ParamValue()
-       : mpString( new EncodedString ), mpParam( NULL )
+       : mpString( new EncodedString ), mpParam( NULL ), mNumber( 0 )
        {}
      ParamValue( const ParamValue& p )
-       : mpString( NULL ), mpParam( NULL )
+       : mpString( NULL ), mpParam( NULL ), mNumber( 0 )
        { Assign( p ); }
      ParamValue( const char* s )
-       : mpString( new EncodedString( s ) ), mpParam( NULL )
+       : mpString( new EncodedString( s ) ), mpParam( NULL ), mNumber( ParseNumber( s ) )
        {}
      ParamValue( const std::string& s )
-       : mpString( new EncodedString( s ) ), mpParam( NULL )
+       : mpString( new EncodedString( s ) ), mpParam( NULL ), mNumber( ParseNumber( s ) )
        {}
      ParamValue( const Param& p )
-       : mpString( NULL ), mpParam( new Param( p ) )
+       : mpString( NULL ), mpParam( new Param( p ) ), mNumber( 0 )
        {}
      ~ParamValue()
        { delete mpString; delete mpParam; }
@@ -99,6 +100,8 @@ class Param
      void Assign( const std::string& );
      void Assign( const Param& );
      const std::string& ToString() const;
+     // The numeric value of a string is parsed when the string is assigned.
+     double             ToNumber() const;
      const Param*       ToParam() const;
      Param*             ToParam();
 
@@ -107,9 +110,11 @@ class Param
 
     private:
      void ConstructParamBuf() const;
+     static double ParseNumber( const std::string& );
 
      EncodedString* mpString;
      Param*         mpParam;
+     double         mNumber;
 
      static Param       sParamBuf;
      static std::string sStringBuf;
@@ -248,8 +253,20 @@ class Param
   // Stream io
   std::ostream&       WriteToStream( std::ostream& ) const;
   std::istream&       ReadFromStream( std::istream& );
-  std::ostream&       WriteBinary( std::ostream& ) const;
+  // With numericValues set, WriteBinary() transmits numeric list and matrix
+  // entries as binary numbers, which ReadBinary() understands from
+  // protocol version 2.4 on.
+  std::ostream&       WriteBinary( std::ostream&, bool numericValues = false ) const;
   std::istream&       ReadBinary( std::istream& );
+  // A hash of the parameter's full content, which allows to detect whether a
+  // parameter differs from a previously transmitted version.
+  uint64_t            Hash() const;
+
+ private:
+  std::ostream&       Write( std::ostream&, bool binaryValues ) const;
+  std::istream&       Read( std::istream&, bool binaryValues );
+  bool                WriteBinaryValues( std::ostream& ) const;
+  bool                ReadBinaryValues( std::istream& );
 
  private:
   HierarchicalLabel   mSections;
@@ -39,6 +39,11 @@ class ProtocolVersion
   {
     static const Version v[] =
     {
+      { 2, 8, "Tiled bitmaps" },
+      { 2, 7, "Block batches" },
+      { 2, 6, "Parameter snapshots" },
+      { 2, 5, "Latency traces" },
+      { 2, 4, "Binary parameter values" },
       { 2, 3, "Zero message length fields" },
       { 2, 2, "Shared signal storage" },
       { 2, 1, "NextModuleInfo from Operator" },
@@ -56,6 +61,11 @@ class ProtocolVersion
      NextModuleInfo,
      SharedSignalStorage,
      ZeroMessageLengthFields,
+     BinaryParamValues,
+     LatencyTraces,
+     ParamSnapshots,
+     BlockBatches,
+     TiledBitmaps,
    };
 
    ProtocolVersion()
@@ -108,6 +118,16 @@ bool ProtocolVersion::Provides( int feature ) const
       return AtLeast( ProtocolVersion( 2, 2 ) );
     case ZeroMessageLengthFields:
       return AtLeast( ProtocolVersion( 2, 3 ) );
+    case BinaryParamValues:
+      return AtLeast( ProtocolVersion( 2, 4 ) );
+    case LatencyTraces:
+      return AtLeast( ProtocolVersion( 2, 5 ) );
+    case ParamSnapshots:
+      return AtLeast( ProtocolVersion( 2, 6 ) );
+    case BlockBatches:
+      return AtLeast( ProtocolVersion( 2, 7 ) );
+    case TiledBitmaps:
+      return AtLeast( ProtocolVersion( 2, 8 ) );
   }
   return false;
 }
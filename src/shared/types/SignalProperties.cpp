@@ -102,16 +102,6 @@ SignalProperties::ElementIndex( const std::string& address ) const
   return idx >= Elements() ? -1 : idx;
 }
 
-size_t
-SignalProperties::LinearIndex( size_t ch, size_t el ) const
-{
-  if( ch >= size_t( Channels() ) )
-    bcidebug( "Channel index out of bounds" );
-  if( el >= size_t( Elements() ) )
-    bcidebug( "Element index out of bounds" );
-  return ch * Elements() + el;
-}
-
 void
 SignalProperties::InitMembers( size_t inChannels, size_t inElements )
 {
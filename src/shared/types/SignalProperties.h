@@ -32,6 +32,7 @@
 #include "LabelIndex.h"
 #include "ValueList.h"
 #include "EncodedString.h"
+#include "BCIAssert.h"
 
 class SignalProperties
 {
@@ -177,6 +178,18 @@ class SignalProperties
     enum { none = -1, true_ = 1, false_ = 0 } mIsStream;
 };
 
+// Inline because it is called for each access to a signal value.
+inline
+size_t
+SignalProperties::LinearIndex( size_t ch, size_t el ) const
+{
+  if( ch >= size_t( Channels() ) )
+    bcidebug( "Channel index out of bounds" );
+  if( el >= size_t( Elements() ) )
+    bcidebug( "Element index out of bounds" );
+  return ch * Elements() + el;
+}
+
 inline
 std::ostream& operator<<( std::ostream& os, const SignalProperties& s )
 { return s.WriteToStream( os ); }
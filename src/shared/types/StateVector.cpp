@@ -35,6 +35,7 @@
 
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 using namespace std;
 
@@ -78,7 +79,7 @@ StateVector::StateValue( const string& inName, size_t inSample ) const
   if( mpStateList && mpStateList->Exists( inName ) )
   {
     const State& s = ( *mpStateList )[ inName ];
-    result = mSamples[ inSample ].StateValue( s.Location(), s.Length() );
+    result = mSamples[ inSample ].StateValue( StateAccessor( s ) );
   };
   return result;
 }
@@ -96,9 +97,10 @@ StateVector::StateValue( const string& inName, size_t inSample ) const
 State::ValueType
 StateVector::StateValue( size_t inLocation, size_t inLength, size_t inSample ) const
 {
-  return mSamples[ inSample ].StateValue( inLocation, inLength );
+  return StateValue( StateAccessor( inLocation, inLength ), inSample );
 }
 
+
 // **************************************************************************
 // Function:   SetStateValue
 // Purpose:    sets a state's value in the state vector block
@@ -111,7 +113,7 @@ StateVector::SetStateValue( const string& inName, size_t inSample, State::ValueT
   if( mpStateList && mpStateList->Exists( inName ) )
   {
     const State& s = ( *mpStateList )[ inName ];
-    SetStateValue( s.Location(), s.Length(), inSample, inValue );
+    SetStateValue( StateAccessor( s ), inSample, inValue );
   }
 }
 
@@ -121,7 +123,7 @@ StateVector::SetStateValue( const string& inName, State::ValueType inValue )
   if( mpStateList && mpStateList->Exists( inName ) )
   {
     const State& s = ( *mpStateList )[ inName ];
-    SetStateValue( s.Location(), s.Length(), inValue );
+    SetStateValue( StateAccessor( s ), 0, inValue );
   }
 }
 
@@ -137,8 +139,25 @@ StateVector::SetStateValue( const string& inName, State::ValueType inValue )
 void
 StateVector::SetStateValue( size_t inLocation, size_t inLength, size_t inSample, State::ValueType inValue )
 {
-  for( int i = static_cast<int>( inSample ); i < Samples(); ++i )
-    mSamples[ i ].SetStateValue( inLocation, inLength, inValue );
+  SetStateValue( StateAccessor( inLocation, inLength ), inSample, inValue );
+}
+
+void
+StateVector::SetStateValue( const StateAccessor& inAccessor, size_t inSample, State::ValueType inValue )
+{
+  FillStateValue( inAccessor, inSample, mSamples.size(), inValue );
+}
+
+void
+StateVector::FillStateValue( const StateAccessor& inAccessor, size_t inBegin, size_t inEnd, State::ValueType inValue )
+{
+  size_t end = min( inEnd, mSamples.size() );
+  if( inBegin < end )
+  {
+    mSamples[ inBegin ].CheckAccess( inAccessor, inValue );
+    for( size_t i = inBegin; i < end; ++i )
+      inAccessor.Set( mSamples[ i ].Data(), inValue );
+  }
 }
 
 void
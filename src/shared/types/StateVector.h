@@ -57,6 +57,11 @@ class StateVector
   void             SetStateValue( const std::string& name, size_t sample, State::ValueType value );
   void             SetStateValue( size_t location, size_t length, State::ValueType value );
   void             SetStateValue( size_t location, size_t length, size_t sample, State::ValueType value );
+  // Accessor versions avoid repeated computation of bit offsets and masks.
+  State::ValueType StateValue( const StateAccessor&, size_t sample = 0 ) const;
+  void             SetStateValue( const StateAccessor&, size_t sample, State::ValueType value );
+  // Sets a state's value for samples in [begin, end), checking access only once.
+  void             FillStateValue( const StateAccessor&, size_t begin, size_t end, State::ValueType value );
   void             PostStateChange( const std::string& name, State::ValueType value );
   void             CommitStateChanges();
 
@@ -70,6 +75,13 @@ class StateVector
   std::vector<StateVectorSample> mSamples;
 };
 
+inline
+State::ValueType
+StateVector::StateValue( const StateAccessor& inAccessor, size_t inSample ) const
+{
+  return mSamples[ inSample ].StateValue( inAccessor );
+}
+
 
 inline
 std::ostream& operator<<( std::ostream& os, const StateVector& s )
@@ -37,6 +37,39 @@
 
 using namespace std;
 
+// StateAccessor
+StateAccessor::StateAccessor()
+: mLocation( 0 ),
+  mLength( 0 ),
+  mByteOffset( 0 ),
+  mShift( 0 ),
+  mMask( 0 )
+{
+}
+
+StateAccessor::StateAccessor( size_t inLocation, size_t inLength )
+: mLocation( inLocation ),
+  mLength( inLength ),
+  mByteOffset( inLocation / 8 ),
+  mShift( inLocation % 8 ),
+  mMask( 0 )
+{
+  if( inLength > 8 * sizeof( State::ValueType ) )
+    throw std_range_error( "Invalid state length: " << inLength );
+  mMask = inLength ? ~WordType( 0 ) >> ( 8 * sizeof( WordType ) - inLength ) : 0;
+}
+
+StateAccessor::StateAccessor( const State& inState )
+: mLocation( 0 ),
+  mLength( 0 ),
+  mByteOffset( 0 ),
+  mShift( 0 ),
+  mMask( 0 )
+{
+  *this = StateAccessor( inState.Location(), inState.Length() );
+}
+
+// StateVectorSample
 StateVectorSample::StateVectorSample( const StateVectorSample& s )
 : mByteLength( 0 ),
   mpData( NULL )
@@ -48,10 +81,9 @@ StateVectorSample::StateVectorSample( size_t inByteLength )
 : mByteLength( inByteLength ),
   mpData( NULL )
 {
-  mpData = new unsigned char[ mByteLength ];
+  mpData = new unsigned char[ mByteLength + StateAccessor::Padding ];
   // at the very beginning, initialize the state vector to all 0 bytes
-  for( size_t i = 0; i < mByteLength; ++i )
-    mpData[ i ] = 0;
+  ::memset( mpData, 0, mByteLength + StateAccessor::Padding );
 }
 
 StateVectorSample::~StateVectorSample()
@@ -70,10 +102,13 @@ StateVectorSample::operator=( const StateVectorSample& s )
 {
   if( &s != this )
   {
-    mByteLength = s.mByteLength;
-    delete[] mpData;
-    mpData = new unsigned char[ mByteLength ];
-    ::memcpy( mpData, s.mpData, mByteLength );
+    if( !mpData || mByteLength != s.mByteLength )
+    {
+      mByteLength = s.mByteLength;
+      delete[] mpData;
+      mpData = new unsigned char[ mByteLength + StateAccessor::Padding ];
+    }
+    ::memcpy( mpData, s.mpData, mByteLength + StateAccessor::Padding );
   }
   return *this;
 }
@@ -115,21 +150,7 @@ StateVectorSample::CopyFromMasked( const StateVectorSample& inSample, const Stat
 State::ValueType
 StateVectorSample::StateValue( size_t inLocation, size_t inLength ) const
 {
-  if( inLength > 8 * sizeof( State::ValueType ) )
-    throw std_range_error( "Invalid state length: " << inLength );
-  if( inLocation + inLength > 8 * mByteLength )
-    throw std_range_error( "Accessing non-existent state vector data, location: " << inLocation );
-
-  State::ValueType result = 0;
-  for( int bitIndex = static_cast<int>( inLocation + inLength ) - 1;
-       bitIndex >= static_cast<int>( inLocation );
-       --bitIndex )
-  {
-    result <<= 1;
-    if( mpData[ bitIndex / 8 ] & ( 1 << ( bitIndex % 8 ) ) )
-      result |= 1;
-  }
-  return result;
+  return StateValue( StateAccessor( inLocation, inLength ) );
 }
 
 
@@ -144,36 +165,36 @@ StateVectorSample::StateValue( size_t inLocation, size_t inLength ) const
 void
 StateVectorSample::SetStateValue( size_t inLocation, size_t inLength, State::ValueType inValue )
 {
-  State::ValueType valueMask = ( ~State::ValueType( 0 ) >> ( 8 * sizeof( State::ValueType ) - inLength ) );
-  if( inValue < 0 || ( inValue & valueMask ) != inValue )
+  SetStateValue( StateAccessor( inLocation, inLength ), inValue );
+}
+
+// **************************************************************************
+// Function:   CheckAccess
+// Purpose:    Throws an exception if a state value cannot be accessed.
+// Parameters: accessor ... accessor for the state
+//             value    ... value of the state
+// Returns:    N/A
+// **************************************************************************
+void
+StateVectorSample::CheckAccess( const StateAccessor& inAccessor ) const
+{
+  if( inAccessor.RequiredBytes() > mByteLength )
+    throw std_range_error( "Accessing non-existent state vector data, location: " << inAccessor.Location() );
+}
+
+void
+StateVectorSample::CheckAccess( const StateAccessor& inAccessor, State::ValueType inValue ) const
+{
+  if( !inAccessor.Accepts( inValue ) )
     throw std_range_error(
       "Illegal value "
       << inValue
       << " was passed to "
-      << inLength
+      << inAccessor.Length()
       << "-bit state at address "
-      << inLocation
+      << inAccessor.Location()
       );
-  if( inLength > 8 * sizeof( State::ValueType ) )
-    throw std_range_error( "Invalid state length of " << inLength );
-  if( inLocation + inLength > 8 * mByteLength )
-    throw std_range_error( "Accessing non-existent state vector data, location: " << inLocation );
-  SetStateValue_( inLocation, inLength, inValue );
-}
-
-void
-StateVectorSample::SetStateValue_( size_t inLocation, size_t inLength, State::ValueType inValue )
-{ // This is a separate function to work around a strange bug in C++ Builder 2010.
-  State::ValueType value = inValue;
-  for( size_t bitIndex = inLocation; bitIndex < inLocation + inLength; ++bitIndex )
-  {
-    unsigned char mask = 1 << ( bitIndex % 8 );
-    if( value & 1 ) // When the Builder bug occurs, the constant 1 (or any value) is replaced with 8 in the assembly.
-      mpData[ bitIndex / 8 ] |= mask;
-    else
-      mpData[ bitIndex / 8 ] &= ~mask;
-    value >>= 1;
-  }
+  CheckAccess( inAccessor );
 }
 
 // **************************************************************************
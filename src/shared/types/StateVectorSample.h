@@ -28,7 +28,51 @@
 #define STATE_VECTOR_SAMPLE_H
 
 #include <iostream>
+#include <cstring>
+#include <inttypes.h>
 #include "State.h"
+#include "BinaryData.h"
+
+// A StateAccessor reads and writes a state's bits in binary state vector data.
+// The state's bit location and length are resolved into byte offset, shift,
+// and mask on construction, such that each access amounts to reading, and
+// possibly writing, a single 64-bit word (two words for states longer than
+// 56 bits). Data must extend at least 2*sizeof(uint64_t) bytes beyond the
+// state's last byte; StateVectorSample guarantees this for its data.
+class StateAccessor
+{
+ public:
+  typedef uint64_t WordType;
+  enum { Padding = 2 * sizeof( WordType ) };
+
+  StateAccessor();
+  StateAccessor( size_t location, size_t length );
+  explicit StateAccessor( const State& );
+
+  size_t Location() const
+    { return mLocation; }
+  size_t Length() const
+    { return mLength; }
+  // Number of bytes a state vector must have to contain the state.
+  size_t RequiredBytes() const
+    { return ( mLocation + mLength + 7 ) / 8; }
+  bool   Accepts( State::ValueType value ) const
+    { return ( static_cast<WordType>( value ) & ~mMask ) == 0; }
+
+  // Unchecked access.
+  State::ValueType Get( const unsigned char* ) const;
+  void             Set( unsigned char*, State::ValueType ) const;
+
+ private:
+  static WordType Load( const unsigned char* );
+  static void     Store( unsigned char*, WordType );
+
+  size_t   mLocation,
+           mLength,
+           mByteOffset;
+  int      mShift;
+  WordType mMask;
+};
 
 class StateVectorSample
 {
@@ -50,15 +94,89 @@ class StateVectorSample
 
   State::ValueType StateValue( size_t location, size_t length ) const;
   void             SetStateValue( size_t location, size_t length, State::ValueType value );
+  // Faster versions using an accessor that has been set up in advance.
+  State::ValueType StateValue( const StateAccessor& ) const;
+  void             SetStateValue( const StateAccessor&, State::ValueType value );
+  // Throws an exception if the state does not fit into this state vector sample,
+  // or if the value is out of range for the state.
+  void             CheckAccess( const StateAccessor& ) const;
+  void             CheckAccess( const StateAccessor&, State::ValueType value ) const;
 
   std::ostream&  WriteBinary( std::ostream& ) const;
   std::istream&  ReadBinary( std::istream& );
 
  private:
-  void           SetStateValue_( size_t, size_t, State::ValueType );
   size_t         mByteLength; // the length of the binary representation
-  unsigned char* mpData;      // binary state data
+  unsigned char* mpData;      // binary state data, followed by StateAccessor::Padding zero bytes
 };
 
+inline
+StateAccessor::WordType
+StateAccessor::Load( const unsigned char* p )
+{
+  WordType w = 0;
+  if( Tiny::HostOrder == Tiny::LittleEndian )
+    ::memcpy( &w, p, sizeof( w ) );
+  else
+    for( int i = sizeof( w ) - 1; i >= 0; --i )
+      w = w << 8 | p[i];
+  return w;
+}
+
+inline
+void
+StateAccessor::Store( unsigned char* p, WordType w )
+{
+  if( Tiny::HostOrder == Tiny::LittleEndian )
+    ::memcpy( p, &w, sizeof( w ) );
+  else
+    for( size_t i = 0; i < sizeof( w ); ++i, w >>= 8 )
+      p[i] = w & 0xff;
+}
+
+inline
+State::ValueType
+StateAccessor::Get( const unsigned char* inData ) const
+{
+  const unsigned char* p = inData + mByteOffset;
+  WordType w = Load( p ) >> mShift;
+  if( mShift + mLength > 8 * sizeof( WordType ) )
+    w |= Load( p + sizeof( WordType ) ) << ( 8 * sizeof( WordType ) - mShift );
+  return static_cast<State::ValueType>( w & mMask );
+}
+
+inline
+void
+StateAccessor::Set( unsigned char* ioData, State::ValueType inValue ) const
+{
+  unsigned char* p = ioData + mByteOffset;
+  WordType value = static_cast<WordType>( inValue ) & mMask;
+  Store( p, ( Load( p ) & ~( mMask << mShift ) ) | ( value << mShift ) );
+  if( mShift + mLength > 8 * sizeof( WordType ) )
+  {
+    int highShift = static_cast<int>( 8 * sizeof( WordType ) ) - mShift;
+    p += sizeof( WordType );
+    Store( p, ( Load( p ) & ~( mMask >> highShift ) ) | ( value >> highShift ) );
+  }
+}
+
+inline
+State::ValueType
+StateVectorSample::StateValue( const StateAccessor& inAccessor ) const
+{
+  if( inAccessor.RequiredBytes() > mByteLength )
+    CheckAccess( inAccessor );
+  return inAccessor.Get( mpData );
+}
+
+inline
+void
+StateVectorSample::SetStateValue( const StateAccessor& inAccessor, State::ValueType inValue )
+{
+  if( inAccessor.RequiredBytes() > mByteLength || !inAccessor.Accepts( inValue ) )
+    CheckAccess( inAccessor, inValue );
+  inAccessor.Set( mpData, inValue );
+}
+
 #endif // STATE_VECTOR_SAMPLE_H
 
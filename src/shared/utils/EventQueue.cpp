@@ -2,7 +2,8 @@
 // $Id$
 // Author: juergen.mellinger@uni-tuebingen.de
 // Description: A thread-safe event queue.
-//   An event is defined by a string description, and a time stamp.
+//   An event sets an event state to a value, optionally for a limited
+//   duration, and has a time stamp.
 //
 // $BEGIN_BCI2000_LICENSE$
 //
@@ -29,44 +30,153 @@
 
 #include "EventQueue.h"
 #include "BCIException.h"
-#include <cstring>
+#include "Thread.h"
+#include "UnitTest.h"
+#include <sstream>
+#include <vector>
 
 using namespace std;
 
+int
+EventQueue::FindEventState( const string& inName ) const
+{
+  if( mpStateList && mpStateList->Exists( inName ) )
+  {
+    int idx = mpStateList->Index( inName );
+    if( ( *mpStateList )[idx].Kind() == State::EventKind )
+      return idx;
+  }
+  return -1;
+}
+
 void
 EventQueue::PushBack( const string& inDescriptor, PrecisionTime inTimeStamp )
 {
-  mQueue.Produce( make_pair( inDescriptor, inTimeStamp ) );
-  if( !mEventsAllowed )
-    throw std_runtime_error(
-      "No events allowed when receiving \"" << inDescriptor << "\" event "
-      "-- trying to record events outside the \"running\" state?"
-    );
+  Event event;
+  istringstream iss( inDescriptor );
+  string name;
+  iss >> name >> event.value;
+  if( !( iss >> event.duration ) )
+    event.duration = -1;
+  event.stateIndex = FindEventState( name );
+  if( event.stateIndex < 0 )
+    event.descriptor = inDescriptor;
+  event.timeStamp = inTimeStamp;
+  PushBack( event );
 }
 
 void
-EventQueue::PopFront()
+EventQueue::PushBack( int inStateIndex, State::ValueType inValue, int inDuration, PrecisionTime inTimeStamp )
 {
-  mFront = mQueue.AwaitConsumption( 0 );
+  Event event;
+  event.stateIndex = inStateIndex;
+  event.value = inValue;
+  event.duration = inDuration;
+  event.timeStamp = inTimeStamp;
+  PushBack( event );
 }
 
-bool
-EventQueue::IsEmpty()
+void
+EventQueue::PushBack( const Event& inEvent )
 {
-  if( !mFront && !mQueue.Empty() )
-    PopFront();
-  return !mFront;
+  mQueue.Produce( inEvent );
+  if( !mEventsAllowed )
+  {
+    string descriptor = inEvent.descriptor;
+    if( descriptor.empty() && mpStateList && inEvent.stateIndex >= 0 && inEvent.stateIndex < mpStateList->Size() )
+    {
+      ostringstream oss;
+      oss << ( *mpStateList )[inEvent.stateIndex].Name() << " " << inEvent.value;
+      descriptor = oss.str();
+    }
+    throw std_runtime_error(
+      "No events allowed when receiving \"" << descriptor << "\" event "
+      "-- trying to record events outside the \"running\" state?"
+    );
+  }
 }
 
-const std::string&
-EventQueue::FrontDescriptor() const
+namespace
 {
-  return mFront->first;
+  class TestProducer : public Thread
+  {
+   public:
+    TestProducer( EventQueue& q, Waitable& pushed, int stateIndex, int count )
+      : mrQueue( q ), mrPushed( pushed ), mStateIndex( stateIndex ), mCount( count ) {}
+   private:
+    int Execute()
+    {
+      for( int i = 1; i <= mCount; ++i )
+      {
+        mrQueue.PushBack( mStateIndex, i, 0, PrecisionTime::Now() );
+        mrPushed.Set();
+      }
+      return 0;
+    }
+    EventQueue& mrQueue;
+    Waitable& mrPushed;
+    int mStateIndex, mCount;
+  };
 }
 
-PrecisionTime
-EventQueue::FrontTimeStamp() const
+UnitTest( EventQueueTest )
 {
-  return mFront->second;
-}
+  const int numProducers = 4,
+            numEvents = 1000;
+  StateList states;
+  State noEvent;
+  noEvent.FromDefinition( "NoEvent 16 0 0 0" );
+  states.Add( noEvent.SetKind( State::StateKind ) );
+  for( int i = 0; i < numProducers; ++i )
+  {
+    ostringstream oss;
+    oss << "TestEvent" << i << " 32 0 0 0";
+    State s;
+    s.FromDefinition( oss.str() );
+    states.Add( s.SetKind( State::EventKind ) );
+  }
+  EventQueue queue;
+  queue.SetStateList( &states );
+  TestFail_if( queue.FindEventState( "NoEvent" ) >= 0, "" );
+  TestFail_if( queue.FindEventState( "Undefined" ) >= 0, "" );
+  queue.AllowEvents();
+  queue.PushBack( "TestEvent0 0 0", PrecisionTime::Now() );
+  TestFail_if( queue.IsEmpty(), "" );
+  TestFail_if( queue.Front().stateIndex != queue.FindEventState( "TestEvent0" ), "" );
+  TestFail_if( queue.Front().duration != 0, "" );
+  queue.PopFront();
 
+  Waitable pushed;
+  std::vector<TestProducer*> producers;
+  std::vector<State::ValueType> lastValue( states.Size(), 0 );
+  for( int i = 0; i < numProducers; ++i )
+  {
+    ostringstream oss;
+    oss << "TestEvent" << i;
+    producers.push_back( new TestProducer( queue, pushed, queue.FindEventState( oss.str() ), numEvents ) );
+  }
+  for( size_t i = 0; i < producers.size(); ++i )
+    producers[i]->Start();
+  int received = 0;
+  while( received < numProducers * numEvents )
+  {
+    if( queue.IsEmpty() )
+    { // Block until a producer signals, rather than spinning on the queue.
+      // The timeout only guards against a missed wakeup.
+      pushed.Wait( 10 );
+      pushed.Reset();
+      continue;
+    }
+    const EventQueue::Event& event = queue.Front();
+    TestFail_if( event.value != lastValue[event.stateIndex] + 1, "events out of order" );
+    lastValue[event.stateIndex] = event.value;
+    queue.PopFront();
+    ++received;
+  }
+  for( size_t i = 0; i < producers.size(); ++i )
+  {
+    producers[i]->TerminateWait();
+    delete producers[i];
+  }
+  TestFail_if( !queue.IsEmpty(), "" );
+}
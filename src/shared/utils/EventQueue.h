@@ -2,7 +2,13 @@
 // $Id$
 // Author: juergen.mellinger@uni-tuebingen.de
 // Description: A thread-safe event queue.
-//   An event is defined by a string description, and a time stamp.
+//   An event sets an event state to a value, optionally for a limited
+//   duration, and has a time stamp.
+//   Events are resolved into binary records when they are posted, such
+//   that no string processing is required when they are consumed.
+//   Events given as a string description ("<state name> <value> [<duration>]")
+//   are parsed in the posting thread; for high event rates, obtain a
+//   state index once using FindEventState(), and post binary events.
 //
 // $BEGIN_BCI2000_LICENSE$
 // 
@@ -27,31 +33,59 @@
 #ifndef EVENT_QUEUE_H
 #define EVENT_QUEUE_H
 
-#include "SynchronizedQueue.h"
+#include "LockfreeQueue.h"
+#include "Synchronized.h"
 #include "PrecisionTime.h"
+#include "StateList.h"
+#include <string>
 
 class EventQueue
 {
-  typedef SynchronizedQueue< std::pair<std::string, PrecisionTime> > Queue;
-
  public:
+  struct Event
+  {
+    Event()
+      : stateIndex( -1 ), value( 0 ), duration( -1 ), timeStamp( 0 )
+      {}
+    int              stateIndex; // index into the state list, or -1 if unresolved
+    State::ValueType value;
+    int              duration;   // -1 if not specified
+    PrecisionTime    timeStamp;
+    std::string      descriptor; // kept for unresolved events only
+  };
+
   EventQueue()
-    : mEventsAllowed( false )
+    : mEventsAllowed( false ),
+      mpStateList( NULL )
     {}
   void AllowEvents()
     { mEventsAllowed = true; }
   void DenyEvents()
     { mEventsAllowed = false; }
-  bool IsEmpty();
+  // The state list must remain unchanged while events are allowed.
+  void SetStateList( const StateList* inpStateList )
+    { mpStateList = inpStateList; }
+  // Returns the index of the named event state, or -1 if there is no such event state.
+  int FindEventState( const std::string& name ) const;
+
   void PushBack( const std::string& inDescriptor, PrecisionTime );
-  void PopFront();
-  const std::string& FrontDescriptor() const;
-  PrecisionTime FrontTimeStamp() const;
+  void PushBack( int stateIndex, State::ValueType value, int duration, PrecisionTime );
+  void PushBack( const Event& );
+
+  // Consumer side.
+  bool IsEmpty() const
+    { return mQueue.Empty(); }
+  void PopFront()
+    { mQueue.Pop(); }
+  const Event& Front() const
+    { return *mQueue.Front(); }
+  PrecisionTime FrontTimeStamp() const
+    { return mQueue.Front()->timeStamp; }
 
  private:
-  Queue mQueue;
-  mutable Queue::Consumable mFront;
+  LockfreeQueue<Event> mQueue;
   Synchronized<bool> mEventsAllowed;
+  const StateList* mpStateList;
 };
 
 #endif // EVENT_QUEUE_H
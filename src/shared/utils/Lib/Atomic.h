@@ -231,7 +231,8 @@ Tiny::MemoryFence()
 
 #else // GCC builtins
 
-#define ATOMIC_PTR_(v) reinterpret_cast<volatile long*>(&v)
+// long is 64 bits wide on LP64 platforms, so we must not cast to long here.
+#define ATOMIC_PTR_(v) (&v)
 
 inline int32_t
 Tiny::Atomic_::Increment( volatile int32_t& v )
@@ -29,6 +29,7 @@
 
 #include <iostream>
 #include <limits>
+#include <cstring>
 
 #include <sys/param.h>
 #ifndef BYTE_ORDER
@@ -61,6 +62,16 @@ template<> struct BinaryIO<true>
     union { const T* t; const char* c; } p = { &t };
     return os.write( p.c, sizeof( T ) );
   }
+  template<typename T> static
+  void Get( const char* s, T& t )
+  {
+    ::memcpy( &t, s, sizeof( T ) );
+  }
+  template<typename T> static
+  void Put( char* s, const T& t )
+  {
+    ::memcpy( s, &t, sizeof( T ) );
+  }
 };
 template<> struct BinaryIO<false>
 {
@@ -82,6 +93,22 @@ template<> struct BinaryIO<false>
       os.put( *--q );
     return os;
   }
+  template<typename T> static
+  void Get( const char* s, T& t )
+  {
+    union { T* t; char* c; } p = { &t };
+    char* q = p.c + sizeof( T );
+    while( q > p.c )
+      *--q = *s++;
+  }
+  template<typename T> static
+  void Put( char* s, const T& t )
+  {
+    union { const T* t; const char* c; } p = { &t };
+    const char* q = p.c + sizeof( T );
+    while( q > p.c )
+      *s++ = *--q;
+  }
 };
 
 template<bool b> struct ErrorIf;
@@ -100,6 +127,9 @@ template<typename T, int DataByteOrder> class BinaryData
   static int Size() { return static_cast<int>( sizeof( T ) ); }
   std::istream& Get( std::istream& is ) { return BinaryIO<DataByteOrder == HostOrder>::Get( is, mData ); }
   std::ostream& Put( std::ostream& os ) const { return BinaryIO<DataByteOrder == HostOrder>::Put( os, mData ); }
+  // Memory io, independent of alignment. Returns a pointer past the data.
+  const char* Get( const char* p ) { BinaryIO<DataByteOrder == HostOrder>::Get( p, mData ); return p + sizeof( T ); }
+  char* Put( char* p ) const { BinaryIO<DataByteOrder == HostOrder>::Put( p, mData ); return p + sizeof( T ); }
 
  private:
   T mData;
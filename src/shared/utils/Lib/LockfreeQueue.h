@@ -0,0 +1,134 @@
+//////////////////////////////////////////////////////////////////////
+// $Id$
+// Author: agent@local
+// Description: A queue for multiple producer threads and a single
+//   consumer thread that does not use locks.
+//   Producers exchange the queue's head pointer atomically, and link
+//   the previous head to the new element afterwards. The consumer side
+//   always keeps a dummy element which precedes the front element.
+//   An element becomes visible to the consumer once it is linked, so an
+//   element may briefly remain invisible while its producer is between
+//   exchanging and linking.
+//   Unlike SynchronizedQueue, there is no way to wait for elements.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+///////////////////////////////////////////////////////////////////////
+#ifndef TINY_LOCKFREE_QUEUE_H
+#define TINY_LOCKFREE_QUEUE_H
+
+#include "Uncopyable.h"
+#include "Atomic.h"
+
+namespace Tiny
+{
+
+template<class T> class LockfreeQueue : Uncopyable
+{ // Multiple producers, single consumer
+ public:
+  LockfreeQueue();
+  ~LockfreeQueue();
+
+  // May be called from any thread.
+  void Produce( const T& );
+
+  // To be called from the consumer thread only.
+  bool Empty() const
+    { return Front() == 0; }
+  T* Front();
+  const T* Front() const;
+  void Pop();
+  void Clear();
+
+ private:
+  struct Element
+  { Element() : pNext( 0 ) {}
+    Element( const T& t ) : pNext( 0 ), data( t ) {}
+    Element* volatile pNext;
+    T data;
+  };
+  Element* volatile mpHead; // most recently produced element
+  Element* mpTail; // dummy element, owned by the consumer
+};
+
+// LockfreeQueue Implementation
+template<class T>
+LockfreeQueue<T>::LockfreeQueue()
+: mpHead( new Element ),
+  mpTail( mpHead )
+{
+}
+
+template<class T>
+LockfreeQueue<T>::~LockfreeQueue()
+{
+  Clear();
+  delete mpTail;
+}
+
+template<class T> void
+LockfreeQueue<T>::Produce( const T& t )
+{
+  Element* p = new Element( t );
+  MemoryFence(); // element data must be visible before the element is linked
+  Element* pPrev = Atomic( mpHead ).Exchange( p );
+  pPrev->pNext = p;
+}
+
+template<class T> T*
+LockfreeQueue<T>::Front()
+{
+  Element* p = mpTail->pNext;
+  if( !p )
+    return 0;
+  MemoryFence();
+  return &p->data;
+}
+
+template<class T> const T*
+LockfreeQueue<T>::Front() const
+{
+  return const_cast<LockfreeQueue*>( this )->Front();
+}
+
+template<class T> void
+LockfreeQueue<T>::Pop()
+{
+  Element* p = mpTail->pNext;
+  if( p )
+  { // The popped element becomes the new dummy element.
+    delete mpTail;
+    mpTail = p;
+    p->data = T();
+  }
+}
+
+template<class T> void
+LockfreeQueue<T>::Clear()
+{
+  while( mpTail->pNext )
+    Pop();
+}
+
+} // namespace
+
+using Tiny::LockfreeQueue;
+
+#endif // TINY_LOCKFREE_QUEUE_H
@@ -48,22 +48,39 @@ GetPrecTimeBase()
   return result;
 }
 
-static LARGE_INTEGER sPrecTimeBase = { 0 };
+// Initialized once at startup, and never written afterwards, so it may be
+// read from any thread without synchronization.
+static const LARGE_INTEGER sPrecTimeBase = GetPrecTimeBase();
+
+static LARGE_INTEGER
+PrecTimeBase()
+{ // When called during static initialization, sPrecTimeBase may not be
+  // initialized yet.
+  return sPrecTimeBase.QuadPart != 0 ? sPrecTimeBase : GetPrecTimeBase();
+}
 
 PrecisionTime
 PrecisionTime::Now()
 {
-  if( sPrecTimeBase.QuadPart == 0 )
-  {
-    sPrecTimeBase = GetPrecTimeBase();
-    if( sPrecTimeBase.QuadPart == 0 )
-      throw std_runtime_error( "Your system does not provide a high precision timer" );
-  }
+  LARGE_INTEGER base = PrecTimeBase();
+  if( base.QuadPart == 0 )
+    throw std_runtime_error( "Your system does not provide a high precision timer" );
   // Get the current time from the Windows precision timer.
   LARGE_INTEGER prectime;
   if( !::QueryPerformanceCounter( &prectime ) )
     throw std_runtime_error( "Could not read high precision timer: " << SysError().Message() );
-  return static_cast<PrecisionTime::NumType>( ( prectime.QuadPart * 1000 ) / sPrecTimeBase.QuadPart );
+  return static_cast<PrecisionTime::NumType>( ( prectime.QuadPart * 1000 ) / base.QuadPart );
+}
+
+long long
+PrecisionTime::Nanoseconds()
+{
+  LARGE_INTEGER base = PrecTimeBase(), prectime;
+  ::QueryPerformanceCounter( &prectime );
+  // Avoid overflow by converting seconds and fractions separately.
+  long long seconds = prectime.QuadPart / base.QuadPart,
+            fraction = prectime.QuadPart % base.QuadPart;
+  return seconds * 1000000000LL + ( fraction * 1000000000LL ) / base.QuadPart;
 }
 
 // **************************************************************************
@@ -85,6 +102,15 @@ PrecisionTime::Now()
   return multiplier * double(mach_absolute_time() - mt0);
 }
 
+long long
+PrecisionTime::Nanoseconds()
+{
+  static mach_timebase_info_data_t mtbinfo = { 0, 0 };
+  if( mtbinfo.denom == 0 )
+    mach_timebase_info( &mtbinfo );
+  return static_cast<long long>( mach_absolute_time() * mtbinfo.numer / mtbinfo.denom );
+}
+
 // **************************************************************************
 #else // neither _WIN32 nor __APPLE__
 // **************************************************************************
@@ -99,6 +125,14 @@ PrecisionTime::Now()
   return ( t.tv_sec * 1000 ) + t.tv_nsec / 1000000;
 }
 
+long long
+PrecisionTime::Nanoseconds()
+{
+  struct timespec t;
+  ::clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
 // **************************************************************************
 #endif // _WIN32, __APPLE__
 // **************************************************************************
@@ -49,6 +49,10 @@ class PrecisionTime
   static PrecisionTime Now();
   static NumType UnsignedDiff( NumType, NumType );
   static int     SignedDiff( NumType, NumType );
+  // Monotonic time in ns, with the full resolution of the system's timer.
+  // Unlike Now(), this does not wrap around, and is suited for measuring
+  // durations below 1ms.
+  static long long Nanoseconds();
 
  private:
   NumType mValue;
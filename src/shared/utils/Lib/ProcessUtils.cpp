@@ -35,6 +35,7 @@
 # include <vector>
 # include <fcntl.h>
 # include <sys/stat.h>
+# include <sys/resource.h>
 # if USE_POSIX_SEMAPHORES
 #  include <semaphore.h>
 # else // USE_POSIX_SEMAPHORES
@@ -394,6 +395,39 @@ GlobalID::Cleanup( const string& inName )
 
 } // namespace
 
+size_t
+ProcessUtils::PeakMemoryUsage()
+{
+#if _WIN32
+  // Avoid a link dependency on psapi.lib by importing GetProcessMemoryInfo() at runtime.
+  struct Counters
+  {
+    DWORD cb, PageFaultCount;
+    SIZE_T PeakWorkingSetSize, WorkingSetSize,
+           QuotaPeakPagedPoolUsage, QuotaPagedPoolUsage,
+           QuotaPeakNonPagedPoolUsage, QuotaNonPagedPoolUsage,
+           PagefileUsage, PeakPagefileUsage;
+  };
+  typedef BOOL ( WINAPI *GetProcessMemoryInfoFn )( HANDLE, Counters*, DWORD );
+  static GetProcessMemoryInfoFn GetProcessMemoryInfo_ = reinterpret_cast<GetProcessMemoryInfoFn>(
+    ::GetProcAddress( ::LoadLibraryA( "psapi.dll" ), "GetProcessMemoryInfo" )
+  );
+  Counters counters = { sizeof( counters ) };
+  if( GetProcessMemoryInfo_ && GetProcessMemoryInfo_( ::GetCurrentProcess(), &counters, sizeof( counters ) ) )
+    return counters.PeakWorkingSetSize;
+  return 0;
+#else // _WIN32
+  struct rusage usage;
+  if( ::getrusage( RUSAGE_SELF, &usage ) )
+    return 0;
+# if __APPLE__
+  return usage.ru_maxrss;
+# else // __APPLE__
+  return usage.ru_maxrss * 1024;
+# endif // __APPLE__
+#endif // _WIN32
+}
+
 bool
 ProcessUtils::AssertSingleInstance( int inArgc, char** inArgv, const std::string& inID, int inTimeout )
 {
@@ -38,6 +38,9 @@ bool ExecuteAsynchronously( const std::string& executable, const std::string& ar
 
 void GoIdle(); // Satisfy parent processes using WaitForInputIdle().
 
+// Peak physical memory used by the current process, in bytes, or 0 if unavailable.
+size_t PeakMemoryUsage();
+
 bool AssertSingleInstance( int argc, char** argv, const std::string& id = "", int timeout = 0 );
 
 } // namespace